@@ -24,3 +24,11 @@ Uint32 crc8FeedN (Uint32 polynom, Uint32 shiftRegister, const Uint8 *data, Uint3
 	return shiftRegister;
 }
 
+Uint32 crc32FeedN (Uint32 crc, const Uint8 *data, Uint32 n) {
+	crc = ~crc;
+	for (Uint32 i=0; i<n; i++) {
+		crc ^= data[i];
+		for (int b=0; b<8; b++) crc = crc>>1 ^ (crc&1 ? 0xEDB88320 : 0);
+	}
+	return ~crc;
+}
@@ -40,5 +40,13 @@ Uint32 crc8Feed (Uint32 polynomial, Uint32 shiftRegister, Uint8 data);
 
 Uint32 crc8FeedN (Uint32 polynomial, Uint32 shiftRegister, const Uint8 *data, Uint32 n);
 
+/** Calculates the CRC-32 of IEEE 802.3 (reflected polynomial 0xEDB88320), the same as zlib's crc32().
+ * @param crc the CRC of the preceding data, 0 initially.
+ * @param data the data to add to the stream.
+ * @param n the number of bytes.
+ * @return the CRC of all data so far.
+ */
+Uint32 crc32FeedN (Uint32 crc, const Uint8 *data, Uint32 n);
+
 #endif
 
@@ -18,6 +18,7 @@
 #include <dogDriver.h>
 #include <st7565.h>
 #include <integers.h>
+#include <gfxmono.h>
 
 int eadogm128Init(void) {
 	static const char initSeq[] = {
@@ -42,6 +43,12 @@ void eadogm128Line(int line) {
 	dogDriverWaitFor(tid);
 }
 
+int eadogm128StartLine(int line) {
+	static char cmd;
+	cmd = DISPLAY_SCROLL_Y | line & 63;
+	return dogDriverWriteCommand(&cmd,1);
+}
+
 void eadogm128Page(int page) {
 	char cmd[] = { DISPLAY_PAGE | page & 7 };
 	int tid = 0;
@@ -79,3 +86,59 @@ int eadogm128Clear(int pattern8) {
 	return dogDriverStartTransfer((const char*)(Int)pattern8,128*64/8,&callbackWriteFbClear,0);
 }
 
+//SLICE
+/** Copies a whole framebuffer in column order into the ST7565 RAM. Scanning direction is page by page of ST7565:
+ * 8 pages a 128 bytes each.
+ */
+static DogByte callbackWriteFb(const char *data, int index, int n, int subIndex) {
+	const int byteX = index & 127;
+	const int byteY = index >> 7;
+	const Uint8 dataByte = data[byteY+byteX*8];
+	if (byteX!=0) return DOG_DATA | dataByte;
+	else {	// page needs to be selected first, then column
+		switch(subIndex & 3) {
+			case 0:	return DOG_PREFIX | DOG_CMD | DISPLAY_PAGE | byteY & 7;
+			case 1:	return DOG_PREFIX | DOG_CMD | DISPLAY_COLUMN | 0;
+			case 2: return DOG_PREFIX | DOG_CMD | 0;
+			default: return DOG_DATA | dataByte;
+		}
+	}
+}
+
+/** Copies a column window of one page.
+ * @param data the first byte of the window in the framebuffer.
+ * @param subIndex the higher 16 bits are page<<8 | first column.
+ */
+static DogByte callbackWritePage(const char *data, int index, int n, int subIndex) {
+	const int window = subIndex>>16;
+	if (index==0) switch(subIndex & 3) {
+		case 0:	return DOG_PREFIX | DOG_CMD | DISPLAY_PAGE | window>>8 & 7;
+		case 1:	return DOG_PREFIX | DOG_CMD | DISPLAY_COLUMN | (window & 0xFF)>>4;
+		case 2: return DOG_PREFIX | DOG_CMD | window & 0xF;
+	}
+	return DOG_DATA | (Uint8)data[index*8];
+}
+
+int eadogm128Flush(Gfxmono *gfx) {
+	GfxmonoDirty *dirty = &gfx->dirty;
+	if (!gfxmonoIsDirty(gfx)) return 0;
+
+	if (dirty->x0==0 && dirty->y0==0 && dirty->x1==128 && dirty->y1==64) {	// full refresh in a single transfer
+		const int tid = dogDriverStartTransfer(gfx->pixels,128*64/8,&callbackWriteFb,0);
+		if (tid) gfxmonoDirtyClear(gfx);
+		return tid;
+	}
+
+	int tid = 0;
+	for (int page=dirty->y0/8; page<=(dirty->y1-1)/8; page++) {
+		const char *window = (const char*)gfx->pixels + dirty->x0*8 + page;
+		const int t = dogDriverStartTransfer(window,dirty->x1-dirty->x0,&callbackWritePage,(page<<8 | dirty->x0)<<16);
+		if (!t) {	// queue full: the remaining pages stay dirty
+			dirty->y0 = page*8;
+			return tid;
+		}
+		tid = t;
+	}
+	gfxmonoDirtyClear(gfx);
+	return tid;
+}
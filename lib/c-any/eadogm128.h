@@ -16,6 +16,8 @@
 #ifndef eadogm128_h
 #define eadogm128_h
 
+#include <gfxmono.h>
+
 /** @file
  * @brief Generic functions for driving a EA DOGM128 module with SPI.
  *
@@ -29,6 +31,13 @@ int eadogm128Init(void);
  */
 void eadogm128Line(int line);
 
+/** Sets the display start line, the RAM line shown at the top of the panel. Scrolling this way does not require
+ * rewriting the RAM. Non-blocking function.
+ * @param line the RAM line 0..63.
+ * @return the transfer ID, 0 if the transfer queue is full.
+ */
+int eadogm128StartLine(int line);
+
 /** Blocking function.
  */
 void eadogm128Page(int page);
@@ -48,4 +57,13 @@ enum {
  */
 int eadogm128Clear(int pattern8);
 
+/** Transfers the dirty area of a 128x64 framebuffer in column order (unitX=64, unitY=1), like fb128x64. Only the
+ * pages and the column window covered by the dirty area are sent, one transfer per page, or a single transfer if the
+ * whole framebuffer is dirty. Pages, that do not fit into the transfer queue, remain dirty for the next call.
+ * Non-blocking function.
+ * @param gfx the framebuffer.
+ * @return the transfer ID of the last page enqueued, 0 if nothing was transferred.
+ */
+int eadogm128Flush(Gfxmono *gfx);
+
 #endif
@@ -22,8 +22,16 @@
 extern Uint64	graphicsBuffer[128];
 extern Gfxmono	frameBuffer;
 
+/** Transfers the modified part of the framebuffer to the display. Non-blocking.
+ * @return the transfer ID of the last transfer, 0 if nothing was transferred.
+ */
 int eadogm128FbUpdate(void);
 
+/** Transfers the whole framebuffer to the display, for example after a reset of the controller. Non-blocking.
+ * @return the transfer ID, 0 if the transfer queue is full.
+ */
+int eadogm128FbRefresh(void);
+
 void eadogm128FbClear(bool color);
 
 void eadogm128FbChess(int w);
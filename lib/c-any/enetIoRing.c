@@ -0,0 +1,63 @@
+/*
+  enetIoRing.c - enetIoRing.h on top of single packet drivers (enetIoFifo.h).
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <enetIoRing.h>
+#include <enetIoFifo.h>
+
+// All functions are weak: drivers with descriptor rings replace them.
+
+__attribute__((weak))
+int enetIoRxBurst(Fifo **frames, int n) {
+	if (n>0 && enetIoFifoCanRead()) {
+		frames[0] = enetIoFifoReadBegin();
+		return 1;
+	}
+	else return 0;
+}
+
+__attribute__((weak))
+void enetIoRxRelease(int n) {
+	if (n>0) enetIoFifoReadEnd();
+}
+
+__attribute__((weak))
+int enetIoTxReserve(Fifo **frames, int n) {
+	if (n>0 && enetIoFifoCanWrite()) {
+		frames[0] = enetIoFifoWriteBegin();
+		return 1;
+	}
+	else return 0;
+}
+
+__attribute__((weak))
+void enetIoTxQueue(Fifo *frame) {
+	enetIoFifoWriteEnd();
+}
+
+__attribute__((weak))
+bool enetIoTxQueueRx(Fifo *frame) {
+	Fifo *writer;
+	Fifo reader = *frame;
+	if (1==enetIoTxReserve(&writer,1) && fifoPutFifo(writer,&reader)) {
+		enetIoTxQueue(writer);
+		return true;
+	}
+	else return false;
+}
+
+__attribute__((weak))
+void enetIoTxDoorbell(void) {
+}
+
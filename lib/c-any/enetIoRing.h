@@ -0,0 +1,52 @@
+#ifndef enetIoRing_h
+#define enetIoRing_h
+
+/** @file
+ * @brief Burst interface of Ethernet drivers: rings of receive and transmit descriptors.
+ *
+ * Like with enetIoFifo.h, the driver owns all buffers. Received frames are handed out in bursts and remain valid
+ * until released, transmit frames are queued and sent all together by a single doorbell. A received frame can be
+ * modified in place and queued for transmission without copying, for replies like ICMP echo.
+ *
+ * Drivers without descriptor rings do not implement these functions: the default implementation (enetIoRing.c) maps
+ * them to the single packet functions of enetIoFifo.h, one frame per burst.
+ */
+
+#include <stdbool.h>
+#include <fifo.h>
+
+/** Hands out received frames. Frames handed out before, but not yet released, are returned again first.
+ * @param frames the destination for the frames, which are Fifos containing one whole frame each.
+ * @param n the maximum number of frames.
+ * @return the number of frames, 0 if nothing was received.
+ */
+int enetIoRxBurst(Fifo **frames, int n);
+
+/** Releases received frames for reception of further frames.
+ * @param n the number of frames to release, the oldest ones first.
+ */
+void enetIoRxRelease(int n);
+
+/** Provides empty transmit buffers. Buffers not queued are returned again by later calls, in empty state.
+ * @param frames the destination for the buffers.
+ * @param n the maximum number of buffers.
+ * @return the number of buffers, 0 if all are in use.
+ */
+int enetIoTxReserve(Fifo **frames, int n);
+
+/** Queues a reserved transmit buffer. It is sent with the next enetIoTxDoorbell().
+ * @param frame a buffer provided by enetIoTxReserve(), containing the frame.
+ */
+void enetIoTxQueue(Fifo *frame);
+
+/** Queues a received frame for transmission. It must not be released before the next enetIoTxDoorbell().
+ * @param frame the whole frame, typically modified in place. Only the readable contents is sent.
+ * @return true, if the frame was queued, false if the transmit ring is full.
+ */
+bool enetIoTxQueueRx(Fifo *frame);
+
+/** Starts the transmission of all queued frames.
+ */
+void enetIoTxDoorbell(void);
+
+#endif
@@ -68,30 +68,115 @@ bool fifoPutnetEthernetArpHeader(Fifo *fifo, const EthernetArpHeader *header) {
 		fifoPutnetIp4Address(fifo,&header->sourceIp4Address);
 		fifoPutnetEthernetAddress(fifo,&header->destinationEthernetAddress);
 		fifoPutnetIp4Address(fifo,&header->destinationIp4Address);
-		return false;
+		return true;
 	}
 	else return false;
 }
 
 //SLICE
+// The hash index and the LRU list are kept within the table: entry i holds the head of hash bucket i, the chain
+// through the entries of a bucket and the neighbours in the LRU list. All links are indexes+1, 0 means none.
+// The cache functions up to ethernetArpCacheSet() share these helpers, so they are linked together as one slice.
+
+static inline int hashBucket(const EthernetArpCache *cache, const Ip4Address *ip4Address) {
+	return (Uint64)(Uint32)(ip4Address->int32 * 2654435761u) * cache->elements >> 32;
+}
+
+static void lruUnlink(EthernetArpCache *cache, int index) {
+	EthernetArpCacheEntry *entry = &cache->table[index];
+	if (entry->newer) cache->table[entry->newer-1].older = entry->older;
+	else cache->lruNewest = entry->older;
+	if (entry->older) cache->table[entry->older-1].newer = entry->newer;
+	else cache->lruOldest = entry->newer;
+	entry->newer = entry->older = 0;
+}
+
+static void lruInsertNewest(EthernetArpCache *cache, int index) {
+	EthernetArpCacheEntry *entry = &cache->table[index];
+	entry->older = cache->lruNewest;
+	entry->newer = 0;
+	if (cache->lruNewest) cache->table[cache->lruNewest-1].newer = index+1;
+	else cache->lruOldest = index+1;
+	cache->lruNewest = index+1;
+}
+
+static void lruInsertOldest(EthernetArpCache *cache, int index) {
+	EthernetArpCacheEntry *entry = &cache->table[index];
+	entry->newer = cache->lruOldest;
+	entry->older = 0;
+	if (cache->lruOldest) cache->table[cache->lruOldest-1].older = index+1;
+	else cache->lruNewest = index+1;
+	cache->lruOldest = index+1;
+}
+
+static void lruTouch(EthernetArpCache *cache, int index) {
+	if (cache->lruNewest!=index+1) {
+		lruUnlink(cache,index);
+		lruInsertNewest(cache,index);
+	}
+}
+
+/** Removes an entry from the hash chain of its address, if it is in there.
+ */
+static void hashUnlink(EthernetArpCache *cache, int index) {
+	Uint16 *link = &cache->table[hashBucket(cache,&cache->table[index].ip4Address)].hashFirst;
+	for ( ; *link!=0; link = &cache->table[*link-1].hashNext) if (*link==index+1) {
+		*link = cache->table[index].hashNext;
+		cache->table[index].hashNext = 0;
+		return;
+	}
+}
+
+static void hashInsert(EthernetArpCache *cache, int index) {
+	Uint16 *first = &cache->table[hashBucket(cache,&cache->table[index].ip4Address)].hashFirst;
+	cache->table[index].hashNext = *first;
+	*first = index+1;
+}
+
+/** Builds the index of a table, that was set up by the user. Invalid entries are the least recently used ones.
+ */
+static void cacheIndex(EthernetArpCache *cache) {
+	cache->lruNewest = cache->lruOldest = 0;
+	for (int a=0; a<cache->elements; ++a) cache->table[a].hashFirst = cache->table[a].hashNext = 0;
+	for (int a=0; a<cache->elements; ++a) {
+		if (cache->table[a].state!=ETHERNET_ARP_INVALID) {
+			hashInsert(cache,a);
+			lruInsertNewest(cache,a);
+		}
+	}
+	for (int a=cache->elements-1; a>=0; --a) if (cache->table[a].state==ETHERNET_ARP_INVALID) lruInsertOldest(cache,a);
+	cache->indexed = true;
+}
+
+/** Finds a valid entry.
+ * @return the index or -1 if none.
+ */
+static int cacheFind(EthernetArpCache *cache, const Ip4Address *ip4Address) {
+	if (!cache->indexed) cacheIndex(cache);
+
+	for (int link = cache->table[hashBucket(cache,ip4Address)].hashFirst; link!=0; link = cache->table[link-1].hashNext)
+		if (cache->table[link-1].state!=ETHERNET_ARP_INVALID
+		&& ip4IsEqual(&cache->table[link-1].ip4Address,ip4Address)) return link-1;
+	return -1;
+}
+
 EthernetArpCacheEntry* ethernetArpCacheLookup(EthernetArpCache* cache, const Ip4Address *ip4Address,
 	int currentTime) {
-	for (int a=0; a<cache->elements; ++a)
-		if (cache->table[a].state & ETHERNET_ARP_RESOLVED	// resolved bit set
-		&& cache->table[a].ip4Address.int32==ip4Address->int32) {
-			cache->table[a].timeLookup = currentTime;
-			return cache->table+a;
-		}
+	const int a = cacheFind(cache,ip4Address);
+	if (a>=0 && cache->table[a].state & ETHERNET_ARP_RESOLVED) {	// resolved bit set
+		cache->table[a].timeLookup = currentTime;
+		lruTouch(cache,a);
+		return cache->table+a;
+	}
 
 	// not found, so install a 'REQUESTED' entry
 	EthernetArpCacheEntry *entry = ethernetArpCacheLru(cache, ip4Address, currentTime);
-	entry->ip4Address = *ip4Address;
 	entry->state = ETHERNET_ARP_UNRESOLVED;
 	entry->time = currentTime;
+	lruTouch(cache,entry-cache->table);
 	return 0;
 }
 
-//SLICE
 const Ip4Address* ethernetArpCacheNextRefresh(EthernetArpCache* cache, int time) {
 	// first the unresolved ones
 	for (int a=0; a<cache->elements; ++a) {
@@ -115,47 +200,45 @@ const Ip4Address* ethernetArpCacheNextRefresh(EthernetArpCache* cache, int time)
 	return 0;
 }
 
-//SLICE
 void ethernetArpCacheExpire(EthernetArpCache* cache, int currentTime) {
+	if (!cache->indexed) cacheIndex(cache);
+
 	for (int a=0; a<cache->elements; ++a)
 		if (cache->table[a].state!=ETHERNET_ARP_INVALID
-		&& cache->table[a].time+cache->entryLifeTime < currentTime)
+		&& cache->table[a].time+cache->entryLifeTime < currentTime) {
 			cache->table[a].state=ETHERNET_ARP_INVALID;
+			hashUnlink(cache,a);
+			lruUnlink(cache,a);
+			lruInsertOldest(cache,a);	// first to be re-used
+		}
 }
 
-//SLICE
 EthernetArpCacheEntry* ethernetArpCacheLru(EthernetArpCache *cache, const Ip4Address* ip4Address, int currentTime) {
-	if (ip4Address!=0) for (int a=0; a<cache->elements; ++a)
-		if (cache->table[a].state!=ETHERNET_ARP_INVALID
-		&& ip4IsEqual(&cache->table[a].ip4Address,ip4Address)) return cache->table+a;
+	if (!cache->indexed) cacheIndex(cache);
+	if (ip4Address==0) return cache->table + cache->lruOldest-1;
 
-	// no exact match
-	int eldestIndex = 0;
-	int eldestTime = currentTime;
-	for (int a=0; a<cache->elements; ++a) {
-		if (cache->table[a].state==ETHERNET_ARP_INVALID) {	// first free entry
-			return cache->table+a;
-		}
-		else {	// valid entry
-			if (cache->table[a].timeLookup<eldestTime) { 	// check if it's even older
-				eldestTime = cache->table[a].timeLookup;
-				eldestIndex = a;
-			}
-		}
-	}
-	return cache->table+eldestIndex;	// replace an existing one
+	const int found = cacheFind(cache,ip4Address);
+	if (found>=0) return cache->table+found;
+
+	// no exact match: re-use a free or the least recently used entry
+	const int a = cache->lruOldest-1;
+	EthernetArpCacheEntry *entry = &cache->table[a];
+	hashUnlink(cache,a);
+	entry->state = ETHERNET_ARP_INVALID;
+	entry->ip4Address = *ip4Address;
+	hashInsert(cache,a);
+	return entry;
 }
 
-//SLICE
 void ethernetArpCacheSet(EthernetArpCache* cache, const Ip4Address* ip4Address, const EthernetAddress *ethernetAddress,
 	int currentTime) {
 	EthernetArpCacheEntry* entry = ethernetArpCacheLru(cache,ip4Address,currentTime);
 
-	entry->ip4Address = *ip4Address;
 	entry->ethernetAddress = *ethernetAddress;
 	entry->time = currentTime;
 	entry->timeLookup = currentTime;
 	entry->state = ETHERNET_ARP_RESOLVED;
+	lruTouch(cache,entry-cache->table);
 }
 
 //SLICE
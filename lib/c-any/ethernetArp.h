@@ -72,6 +72,10 @@ typedef struct {
 	int			time;			///< time of installation of entry
 	int			timeLookup;		///< time of latest lookup
 	EthernetArpEntryState	state;			///< 0==ETHERNET_ARP_INVALID indicates unused entry
+	Uint16			hashFirst;		///< index: first entry of the hash bucket of this position
+	Uint16			hashNext;		///< index: next entry of the same hash bucket
+	Uint16			newer;			///< index: LRU list neighbour
+	Uint16			older;			///< index: LRU list neighbour
 } EthernetArpCacheEntry;
 
 /** Prints a mapping IP-address to EthernetAddress.
@@ -87,12 +91,19 @@ bool fifoPrintEthernetArpCacheEntry(Fifo *outputStream, const EthernetArpCacheEn
  * to RESOLVED and back to INVALID after expiry. In case of cache overflow, the least recently used entries are re-used,
  * independent on the specific state. If an entry is periodically looked up, but never updated it will be returned as
  * for refresh after the predefined refresh time.
+ *
+ * Lookups and updates take constant time: a hash index on the IP-address and a list of the entries in the order of
+ * their use are kept within the table. They are built on first use of the cache, so the table has to be changed
+ * by the functions below only.
  */
 typedef struct EthernetArpCache {
 	EthernetArpCacheEntry*	table;			///< zero the elements to provide a valid empty table
-	int			elements;		///< number of elements
+	int			elements;		///< number of elements, 1..65535
 	int			entryLifeTime;		///< how long should the entry be valid? Unit user-defined.
 	int			entryRefreshTime;	///< how often should we update used entries? 0 for never.
+	bool			indexed;		///< internal: the index is valid; zero initially
+	Uint16			lruNewest;		///< internal: most recently used entry
+	Uint16			lruOldest;		///< internal: least recently used entry, free entries first
 } EthernetArpCache;
 
 /** Prints out the whole ARP cache.
@@ -111,11 +122,13 @@ bool fifoPrintEthernetArpCache(Fifo *outputStream, const EthernetArpCache *cache
  */
 EthernetArpCacheEntry* ethernetArpCacheLookup(EthernetArpCache *cache, const Ip4Address* ip4Address, int time);
 
-/** Finds the least recently set table entry - the most likely to be disposable. Use this function to get new entries
+/** Finds the least recently used table entry - the most likely to be disposable. Use this function to get new entries
  * even though all entries are in use.
  * @param cache the cache
  * @param ip4Address if !=0 then an entry with this address will be returned if it exists even if its quite new.
- *   Otherwise any other Ip4Address may be in use of the returned entry.
+ *   Otherwise a free or the least recently used entry is assigned to this address, with state
+ *   ETHERNET_ARP_INVALID to be set by the caller. If ip4Address==0, the entry is only returned and must not be
+ *   modified.
  * @param time the current clock reading.
  * @return a cache entry, not neccessarily expired, not neccessarily unused.
  */
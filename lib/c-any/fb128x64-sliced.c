@@ -15,6 +15,7 @@
 
 //HEADER
 #include <fb128x64.h>
+#include <eadogm128.h>
 #include <dogDriver.h>
 #include <st7565.h>
 #include <string.h>
@@ -33,12 +34,14 @@ void fb128x64Chess(int w, bool colorBg) {
 	for (int i=0; i<64; ++i) if (w && (i/w) & 1) pattern |= 1llu<<i;
 	if (colorBg) pattern = ~pattern;
 	for (int x=0; x<128; ++x) fb128x64Buffer[x] = w && x/w & 1 ? pattern : ~pattern;
+	gfxmonoDirtyAll(&fb128x64);
 }
 
 //SLICE
 void fb128x64Clear(bool colorBg) {
 	const Uint64 pattern = colorBg ? ONES : 0;
 	for (int x=0; x<128; ++x) fb128x64Buffer[x] = pattern;
+	gfxmonoDirtyAll(&fb128x64);
 }
 
 //SLICE
@@ -52,6 +55,7 @@ void fb128x64ScrollY(int nY, bool colorBg) {
 		if (nY>=0) fb128x64Buffer[x] = fb128x64Buffer[x] << nY | pattern;
 		else fb128x64Buffer[x] = fb128x64Buffer[x] >> -nY | pattern;
 	}
+	gfxmonoDirtyAll(&fb128x64);
 }
 
 //SLICE
@@ -59,5 +63,39 @@ void fb128x64ScrollX(int nX, bool colorBg) {
 	const Uint64 pattern = colorBg ? ONES : 0;
 	if (nX>=0) for (int x=127; x>=0; --x) fb128x64Buffer[x] = x-nX >= 0 ? fb128x64Buffer[x-nX] : pattern;
 	else for (int x=0; x<128; ++x) fb128x64Buffer[x] = x-nX < 128 ? fb128x64Buffer[x-nX] : pattern;
+	gfxmonoDirtyAll(&fb128x64);
+}
+
+//SLICE
+static struct {
+	int	line;
+	bool	dirty;
+} startLine;
+
+void fb128x64SetStartLine(int line) {
+	startLine.line = line & 63;
+	startLine.dirty = true;
+}
+
+int fb128x64GetStartLine(void) {
+	return startLine.line;
+}
+
+int fb128x64Update(void) {
+	int tid = eadogm128Flush(&fb128x64);
+	if (startLine.dirty && !gfxmonoIsDirty(&fb128x64)) {	// after the contents of the new lines
+		const int t = eadogm128StartLine(startLine.line);
+		if (t) {
+			startLine.dirty = false;
+			tid = t;
+		}
+	}
+	return tid;
+}
+
+int fb128x64Refresh(void) {
+	gfxmonoDirtyAll(&fb128x64);
+	startLine.dirty = true;
+	return fb128x64Update();
 }
 
@@ -20,7 +20,8 @@
  * @brief A monochrome graphics framebuffer, typically used for the EA-DOGM128 L/M modules.
  *
  * This frame buffer uses a memory layout the suits the EA-DOG driver very well. Some basic graphics functions are
- * provided for convenience.
+ * provided for convenience. Drawing with the gfxmono functions records the area modified, which is all that
+ * fb128x64Update() transfers to the display. The functions of this module mark the whole buffer as modified.
  */
 
 #include <integers.h>
@@ -29,6 +30,27 @@
 extern Uint64	fb128x64Buffer[128];	///< data type not volatile - take care of that in ISR's!
 extern Gfxmono	fb128x64;
 
+/** Transfers the modified part of the framebuffer (see gfxmonoDirty()) to an EA DOGM128, followed by the start line,
+ * if it was changed. Parts, that do not fit into the transfer queue, are sent by the next call. Non-blocking.
+ * @return the transfer ID of the last transfer, 0 if nothing was transferred.
+ */
+int fb128x64Update(void);
+
+/** Transfers the whole framebuffer and the start line, for example after a reset of the controller. Non-blocking.
+ * @return the transfer ID of the last transfer, 0 if nothing was transferred.
+ */
+int fb128x64Refresh(void);
+
+/** Selects the buffer row shown at the top of the display. Rows wrap around, so contents can be scrolled by moving
+ * the start line instead of the buffer contents. Takes effect with the next fb128x64Update().
+ * @param line the buffer row 0..63.
+ */
+void fb128x64SetStartLine(int line);
+
+/** Returns the buffer row shown at the top of the display.
+ */
+int fb128x64GetStartLine(void);
+
 /** Clear the entire area to background color (efficiently).
  * @param colorBg the background color.
  */
@@ -14,6 +14,22 @@ static struct {
 	int y;
 } fbConsolePosition;
 
+static struct {
+	bool enabled;
+	int top;		///< the buffer text line shown at the top of the display
+} startLine;
+
+void fbConsoleScrollStartLine(bool enable) {
+	const int rows = fbConsoleY(startLine.top);
+	if (rows!=0) {	// move the text lines back to their places, for start line 0
+		for (int x=0; x<128; ++x) fb128x64Buffer[x] = fb128x64Buffer[x] >> rows | fb128x64Buffer[x] << 64-rows;
+		gfxmonoDirtyAll(&fb128x64);
+	}
+	startLine.enabled = enable;
+	startLine.top = 0;
+	fb128x64SetStartLine(0);
+}
+
 void fbConsoleInit(bool _colorFg) {
 	colorFg = _colorFg;
 	fbConsolePosition.x = 0;
@@ -22,11 +38,12 @@ void fbConsoleInit(bool _colorFg) {
 
 void fbConsoleClear(void) {
 	fb128x64Clear(!colorFg);	// clear to background color
+	if (startLine.enabled) fbConsoleScrollStartLine(true);
 }
 
 int fbConsoleXyChar(int x, int y, char c) {
 	const int gx = fbConsoleX(x);
-	const int gy = fbConsoleY(y);
+	const int gy = fbConsoleY((y+startLine.top) % N_Y);
 	gfxmonoDrawChar(&fb128x64,gx,gy,font,c,colorFg);
 	return x+1;
 }
@@ -54,7 +71,13 @@ void fbConsoleEolClear(int x, int y) {
 }
 
 void fbConsoleScrollY(int nY) {
-	fb128x64ScrollY(nY*8,!colorFg);
+	if (startLine.enabled) {	// rotate the lines, clear the ones scrolled in
+		startLine.top = ((startLine.top - nY) % N_Y + N_Y) % N_Y;
+		fb128x64SetStartLine(fbConsoleY(startLine.top));
+		if (nY<0) for (int y= nY>-N_Y ? N_Y+nY : 0; y<N_Y; y++) fbConsoleEolClear(0,y);
+		else for (int y=0; y<nY && y<N_Y; y++) fbConsoleEolClear(0,y);
+	}
+	else fb128x64ScrollY(nY*8,!colorFg);
 }
 
 void fbConsolePrintNewLine(void) {
@@ -65,7 +88,7 @@ void fbConsolePrintNewLine(void) {
 	else {	// scroll contents up
 		fbConsoleScrollY(-1);
 		fbConsolePosition.x = 0;
-		fbConsoleEolClear(fbConsolePosition.x, fbConsolePosition.y);
+		if (!startLine.enabled) fbConsoleEolClear(fbConsolePosition.x, fbConsolePosition.y);
 	}
 }
 
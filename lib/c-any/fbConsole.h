@@ -103,11 +103,19 @@ static inline void fbConsoleXyFifoEolClear(int x, int y, Fifo* text) {
 		y
 	);
 }
-/** Scrolls down the contents efficiently.
- * @param nY the number of characters to move the contents down. Negative for upward movement.
+/** Scrolls the text.
+ * @param nY the number of lines to move the text down, negative for upward movement.
  */
 void fbConsoleScrollY(int nY);
 
+/** Selects scrolling by the display start line (fb128x64SetStartLine()) instead of moving the framebuffer contents.
+ * Only the lines scrolled in are redrawn and transferred by fb128x64Update() then. Requires a display controller with
+ * a start line register, like the ST7565 of the EA DOGM128. The text lines are rotated within the framebuffer. They
+ * are moved back to their places by the next call, so the text stays in place when switching modes.
+ * @param enable true for scrolling by the start line, false for moving the contents.
+ */
+void fbConsoleScrollStartLine(bool enable);
+
 /** Print characters and do interpret control sequences like carriage return, line feed and form feed.
  * In addition to the three codes above, fbConsole supports direct x (code 0x80+x) or y (0x90+y) positioning.
  * Clear to end-of-line is 0x03 (ETX).
@@ -21,14 +21,14 @@
 //SLICE
 size_t fifoCanReadLinear(Fifo const *fifo) {
 	const size_t r = fifoCanRead(fifo);
-	const size_t l = fifo->size - fifo->rPos -1;
+	const size_t l = fifo->size - fifo->rPos;
 	return r<l ? r : l;
 }
 
 //SLICE
 size_t fifoCanWriteLinear(Fifo const *fifo) {
 	const size_t w = fifoCanWrite(fifo);
-	const size_t l = fifo->size - fifo->wPos -1;
+	const size_t l = fifo->size - fifo->wPos;
 	return w<l ? w : l;
 }
 
@@ -144,8 +144,8 @@ bool fifoPutInt32(Fifo *fifo, int value) {
 
 //SLICE
 bool fifoPutnetInt32(Fifo *fifo, int value) {
-	if (fifoCanWrite(fifo)>=2) {
-		for (int c=0; c<4; ++c) fifoWrite(fifo,value>>(32-8*c) & 0xFF);
+	if (fifoCanWrite(fifo)>=4) {
+		for (int c=0; c<4; ++c) fifoWrite(fifo,value>>(24-8*c) & 0xFF);
 		return true;
 	}
 	else return false;
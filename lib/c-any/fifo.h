@@ -342,6 +342,14 @@ static inline void fifoValidateWrite(Fifo *fifo) {
 	fifo->wTotal++;
 }
 
+// somewhat doubtful function:
+/** Validates n more characters, like n calls of fifoValidateWrite.
+ * WARNING: Not thread safe.
+ */
+static inline void fifoValidateWrites(Fifo *fifo, size_t n) {
+	fifo->wTotal += n;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // Other functions.
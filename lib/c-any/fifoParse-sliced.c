@@ -322,7 +322,11 @@ bool fifoParseBool(Fifo *text, bool *value) {
 bool fifoParseHexN(Fifo *fifo, unsigned *value, int minDigits, int maxDigits) {
 	Fifo clone = *fifo;
 	unsigned tValue = 0;
-	unsigned digits = 0;	// successfully read digits
+	int digits = 0;		// successfully read digits
+
+	// contiguous part first, the rest (wrap-around) char by char.
+	const size_t fast = parseHexSpan (fifoReadLinear (&clone),fifoCanReadLinear (&clone),&tValue,&digits,maxDigits);
+	if (fast) fifoSkipRead (&clone,fast);
 	while(fifoCanRead(&clone) && digits<maxDigits) {
 		const char c = fifoLookAhead(&clone);	// read, but don't advance
 		if (isHexDigit(c)) {
@@ -342,11 +346,30 @@ bool fifoParseHexN(Fifo *fifo, unsigned *value, int minDigits, int maxDigits) {
 	else return false;
 }
 
+//SLICE
+bool fifoParseHexBytes(Fifo *fifo, Uint8 *bytes, size_t n) {
+	Fifo clone = *fifo;
+	size_t b = parseHexBytesSpan (fifoReadLinear (&clone),fifoCanReadLinear (&clone),bytes,n);
+	if (b) fifoSkipRead (&clone,2*b);
+
+	// legibility characters, invalid characters and wrap-around are left to the general parser.
+	for ( ; b<n; b++) {
+		unsigned value;
+		if (fifoParseHexN (&clone,&value,2,2)) bytes[b] = value;
+		else return false;
+	}
+	fifoCopyReadPosition(fifo,&clone);
+	return true;
+}
+
 //SLICE
 bool fifoParseHex(Fifo *fifo, unsigned *value) {
 	Fifo clone = *fifo;
 	unsigned tValue = 0;
-	bool success = false;
+	int digits = 0;
+	const size_t fast = parseHexSpan (fifoReadLinear (&clone),fifoCanReadLinear (&clone),&tValue,&digits,INT32_MAX);
+	if (fast) fifoSkipRead (&clone,fast);
+	bool success = digits>0;
 	while(fifoCanRead(&clone)) {
 		const char c = fifoLookAhead(&clone);	// read, but don't advance
 		if (isHexDigit(c)) {
@@ -370,7 +393,10 @@ bool fifoParseHex(Fifo *fifo, unsigned *value) {
 bool fifoParseHexLimited(Fifo *fifo, unsigned *value, unsigned minimum, unsigned maximum) {
 	Fifo clone = *fifo;
 	unsigned tValue = 0;
-	bool success = false;
+	int digits = 0;
+	const size_t fast = parseHexSpan (fifoReadLinear (&clone),fifoCanReadLinear (&clone),&tValue,&digits,INT32_MAX);
+	if (fast) fifoSkipRead (&clone,fast);
+	bool success = digits>0;
 	while(fifoCanRead(&clone)) {
 		const char c = fifoLookAhead(&clone);	// read, but don't advance
 		if (isHexDigit(c)) {
@@ -441,19 +467,22 @@ bool fifoParseBinN(Fifo *fifo, unsigned *value, int minDigits, int maxDigits) {
 //SLICE
 bool fifoParseUnsigned(Fifo *fifo, unsigned *value) {
 	Fifo clone = *fifo;
-	unsigned tValue = 0;
-	bool success = false;
+	Uint64 tValue = 0;	// saturates beyond 32 bits
+	int digits = 0;
+	const size_t fast = parseDecimalSpan (fifoReadLinear (&clone),fifoCanReadLinear (&clone),&tValue,&digits);
+	if (fast) fifoSkipRead (&clone,fast);
 	while(fifoCanRead(&clone)) {
 		const char c = fifoLookAhead(&clone);	// read, but don't advance
 		if (isDigit(c)) {
-			tValue = 10*tValue + c - '0';
-			success = true;
+			tValue = tValue<=UINT32_MAX ? 10*tValue + c - '0' : tValue;
+			digits++;
 			fifoRead(&clone);
 		}
 		else if (isLegible (c)) fifoRead (&clone);	// just skip it
 		else break;
 	}
 
+	const bool success = digits>0 && tValue<=UINT32_MAX;	// overflow fails like any other invalid input
 	if (success) {
 		*value = tValue;
 		fifoCopyReadPosition(fifo,&clone);
@@ -465,19 +494,22 @@ bool fifoParseUnsigned(Fifo *fifo, unsigned *value) {
 //SLICE
 bool fifoParseUnsignedLimited(Fifo *fifo, unsigned *value, unsigned minimum, unsigned maximum) {
 	Fifo clone = *fifo;
-	unsigned tValue = 0;
-	bool success = false;
+	Uint64 tValue = 0;	// saturates beyond 32 bits
+	int digits = 0;
+	const size_t fast = parseDecimalSpan (fifoReadLinear (&clone),fifoCanReadLinear (&clone),&tValue,&digits);
+	if (fast) fifoSkipRead (&clone,fast);
 	while(fifoCanRead(&clone)) {
 		const char c = fifoLookAhead(&clone);	// read, but don't advance
 		if (isDigit(c)) {
-			tValue = 10*tValue + c - '0';
-			success = true;
+			tValue = tValue<=UINT32_MAX ? 10*tValue + c - '0' : tValue;
+			digits++;
 			fifoRead(&clone);
 		}
 		else if (isLegible (c)) fifoRead (&clone);	// just skip it
 		else break;
 	}
 
+	const bool success = digits>0 && tValue<=UINT32_MAX;	// overflow fails like any other invalid input
 	if (success && minimum<=tValue && tValue<=maximum) {
 		*value = tValue;
 		fifoCopyReadPosition(fifo,&clone);
@@ -521,24 +553,40 @@ bool fifoParseIntLimited(Fifo *fifo, int *value, int minimum, int maximum) {
 //SLICE
 bool fifoParseIntCStyle(Fifo *fifo, int *value) {
 	Fifo clone = *fifo;
-	if (fifoParseExactString (&clone,"0x") && fifoParseHex (&clone,(unsigned*)value)
-	|| fifoParseExactString (&clone,"0b") && fifoParseBin (&clone,(unsigned*)value) ) { 
-		fifoCopyReadPosition(fifo,&clone);
-		return true;
+	const bool negative = fifoParseExactChar(&clone,'-');
+	// check the prefix by look-ahead: most numbers don't have one.
+	if (fifoCanRead(&clone)>=2 && fifoLookAhead(&clone)=='0') {
+		const char prefix = fifoLookAheadRelative(&clone,1);
+		fifoSkipRead(&clone,2);
+		if (prefix=='x' && fifoParseHex (&clone,(unsigned*)value)
+		|| prefix=='b' && fifoParseBin (&clone,(unsigned*)value)) {
+			if (negative) *value = -(unsigned)*value;	// no overflow for -0x80000000
+			fifoCopyReadPosition(fifo,&clone);
+			return true;
+		}
 	}
-	else return fifoParseInt (fifo,value);
+	return fifoParseInt (fifo,value);
 }
 
 //SLICE
 bool fifoParseIntEng(Fifo *fifo, int *value) {
 	Fifo clone = *fifo;
 	if (fifoParseIntCStyle(&clone,value)) {
-		if (fifoParseExactString(&clone,"ki")) *value <<= 10;
-		else if (fifoParseExactString(&clone,"Mi")) *value <<= 20;
-		else if (fifoParseExactString(&clone,"Gi")) *value <<= 30;
-		else if (fifoParseExactChar(&clone,'k')) *value *= 1000;
-		else if (fifoParseExactChar(&clone,'M')) *value *= 1000*1000;
-		else if (fifoParseExactChar(&clone,'G')) *value *= 1000*1000*1000;
+		if (fifoCanRead(&clone)) {
+			const bool binary = fifoCanRead(&clone)>=2 && fifoLookAheadRelative(&clone,1)=='i';
+			int shift = 0;
+			int factor = 1;
+			switch(fifoLookAhead(&clone)) {
+				case 'k': shift = 10; factor = 1000; break;
+				case 'M': shift = 20; factor = 1000*1000; break;
+				case 'G': shift = 30; factor = 1000*1000*1000; break;
+			}
+			if (shift!=0) {
+				if (binary) *value <<= shift;
+				else *value *= factor;
+				fifoSkipRead(&clone, binary ? 2 : 1);
+			}
+		}
 		fifoCopyReadPosition(fifo,&clone);
 		return true;
 	}
@@ -214,6 +214,15 @@ bool fifoParseHex(Fifo *fifo, unsigned *value);
  */
 bool fifoParseHexN(Fifo *fifo, unsigned *value, int minDigits, int maxDigits);
 
+/** Parses a sequence of 2-digit hexadecimal bytes, like the data part of Intel hex records. Equivalent to n calls of
+ * fifoParseHexN(fifo,&byte,2,2), but the contiguous part of the input is decoded 4 bytes at once.
+ * @param fifo an fifo over the input string.
+ * @param bytes destination. Unspecified contents if parse fails.
+ * @param n the number of bytes to read.
+ * @return true, if all n bytes were read, false otherwise (and fifo's position unchanged).
+ */
+bool fifoParseHexBytes(Fifo *fifo, Uint8 *bytes, size_t n);
+
 /** Parses an hexadecimal string (without a prefix like 0x) and updates fifo position in case of success. Otherwise the
  * buffer's position is unchanged. I'm unsure, if this function is really needed.
  * @param fifo an fifo over the input string.
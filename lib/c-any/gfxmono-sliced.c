@@ -16,6 +16,137 @@
 
 #include <gfxmono.h>
 #include <integers.h>	//replaces: #include <limits.h>
+#include <string.h>
+#include <stdint.h>
+
+/* The blitter works on lines: the columns of a surface with unitY==1 (like the EA-DOG framebuffers) or the rows of a
+ * surface with unitX==1 (like most fonts). A line is a string of bits in memory, least significant bit of the lowest
+ * byte first. Lines are accessed in chunks of up to 32 bits using byte loads and stores only, because fonts are byte
+ * arrays of any alignment and Cortex-M0 does not support unaligned word access.
+ */
+
+enum {
+	LINES_NONE,	///< neither unitX nor unitY is 1: pixel by pixel
+	LINES_COLUMNS,
+	LINES_ROWS,
+};
+
+static inline int gfxmonoLines(const Gfxmono *gfx) {
+	return gfx->unitY==1 ? LINES_COLUMNS : gfx->unitX==1 ? LINES_ROWS : LINES_NONE;
+}
+
+/** Bit position of the pixel (x,y).
+ */
+static inline unsigned gfxmonoBit(const Gfxmono *gfx, int x, int y) {
+	return x*gfx->unitX + y*gfx->unitY;
+}
+
+/** Reads 1 to 32 bits starting at any bit position.
+ */
+static inline Uint32 bitsRead(const Uint8 *pixels, unsigned bit, unsigned n) {
+	const Uint8 *p = pixels + bit/8;
+	const unsigned shift = bit%8;
+	const unsigned bytes = (shift+n+7)/8;
+	Uint64 v = p[0];
+	for (unsigned i=1; i<bytes; i++) v |= (Uint64)p[i] << 8*i;
+	return (Uint32)(v>>shift) & 0xFFFFFFFFu>>(32-n);
+}
+
+/** Writes 1 to 32 bits starting at any bit position. Bytes covered completely are stored without reading them.
+ */
+static inline void bitsWrite(Uint8 *pixels, unsigned bit, unsigned n, Uint32 value) {
+	Uint8 *p = pixels + bit/8;
+	const unsigned shift = bit%8;
+	const unsigned bytes = (shift+n+7)/8;
+	const Uint64 mask = (Uint64)(0xFFFFFFFFu>>(32-n)) << shift;
+	const Uint64 v = (Uint64)value << shift;
+	for (unsigned i=0; i<bytes; i++) {
+		const Uint8 m = mask >> 8*i;
+		p[i] = m==0xFF ? v >> 8*i : p[i] & ~m | v >> 8*i & m;
+	}
+}
+
+/** Copies n bits, optionally inverted. Source and destination may overlap.
+ */
+static inline void bitsCopy(Uint8 *dst, unsigned d, const Uint8 *src, unsigned s, unsigned n, bool invert) {
+	const Uint32 flip = invert ? 0xFFFFFFFFu : 0;
+	const bool forward = (uintptr_t)dst*8+d <= (uintptr_t)src*8+s;
+
+	if (d%8==s%8) {	// same phase: head and tail bits, whole bytes in between
+		const unsigned head = (8-d%8) % 8 < n ? (8-d%8) % 8 : n;
+		const unsigned bytes = (n-head)/8;
+		const unsigned tail = n-head-bytes*8;
+		const Uint32 headBits = head ? bitsRead(src,s,head)^flip : 0;
+		const Uint32 tailBits = tail ? bitsRead(src,s+n-tail,tail)^flip : 0;
+		Uint8 *to = dst+(d+head)/8;
+		const Uint8 *from = src+(s+head)/8;
+		if (!invert && bytes>=16) memmove(to,from,bytes);
+		else if (forward) for (unsigned i=0; i<bytes; i++) to[i] = from[i]^flip;
+		else for (unsigned i=bytes; i>0; i--) to[i-1] = from[i-1]^flip;
+		if (head) bitsWrite(dst,d,head,headBits);
+		if (tail) bitsWrite(dst,d+n-tail,tail,tailBits);
+	}
+	else if (forward) {
+		for (unsigned k=0; k<n; k+=32) {
+			const unsigned c = n-k<32 ? n-k : 32;
+			bitsWrite(dst,d+k,c,bitsRead(src,s+k,c)^flip);
+		}
+	}
+	else for (unsigned k=n; k>0; ) {	// backward
+		const unsigned c = k<32 ? k : 32;
+		k -= c;
+		bitsWrite(dst,d+k,c,bitsRead(src,s+k,c)^flip);
+	}
+}
+
+/** Sets n bits to color.
+ */
+static inline void bitsFill(Uint8 *dst, unsigned d, unsigned n, bool color) {
+	const Uint32 pattern = color ? 0xFFFFFFFFu : 0;
+	const unsigned head = (8-d%8) % 8 < n ? (8-d%8) % 8 : n;
+	if (head) bitsWrite(dst,d,head,pattern);
+	const unsigned bytes = (n-head)/8;
+	Uint8 *to = dst+(d+head)/8;
+	if (bytes>=16) memset(to,pattern,bytes);
+	else for (unsigned i=0; i<bytes; i++) to[i] = pattern;
+	const unsigned tail = n-head-bytes*8;
+	if (tail) bitsWrite(dst,d+n-tail,tail,pattern);
+}
+
+/** Transposes an 8x8 bit matrix: bit c of byte r is exchanged with bit r of byte c.
+ */
+static inline Uint64 transpose8x8(Uint64 x) {
+	Uint64 t;
+	t = (x ^ x>>7) & 0x00AA00AA00AA00AAull;	x ^= t ^ t<<7;
+	t = (x ^ x>>14) & 0x0000CCCC0000CCCCull;	x ^= t ^ t<<14;
+	t = (x ^ x>>28) & 0x00000000F0F0F0F0ull;	x ^= t ^ t<<28;
+	return x;
+}
+
+/** Clips the offsets from..to-1 to the ones with 0<=start+offset<size.
+ */
+static inline void clip(int *from, int *to, int start, int size) {
+	if (start+*from<0) *from = -start;
+	if (start+*to>size) *to = size-start;
+}
+
+/** Fills a rectangle, that lies completely within gfx.
+ */
+static inline void gfxmonoFillClipped(Gfxmono *gfx, int x, int y, int nX, int nY, bool color) {
+	if (nX<=0 || nY<=0) return;
+
+	Uint8 *pixels = gfx->pixels;
+	switch(gfxmonoLines(gfx)) {
+		case LINES_COLUMNS:
+			for (int dx=0; dx<nX; dx++) bitsFill(pixels,gfxmonoBit(gfx,x+dx,y),nY,color);
+			break;
+		case LINES_ROWS:
+			for (int dy=0; dy<nY; dy++) bitsFill(pixels,gfxmonoBit(gfx,x,y+dy),nX,color);
+			break;
+		default:
+			for (int dx=0; dx<nX; dx++) for (int dy=0; dy<nY; dy++) gfxmonoSetPixelFast(gfx,x+dx,y+dy,color);
+	}
+}
 
 
 //SLICE
@@ -32,6 +163,8 @@ bool gfxmonoGetPixel(const Gfxmono *gfx, int x, int y) {
 		
 //SLICE
 void gfxmonoSetPixelFast(Gfxmono *gfx, int x, int y, bool color) {
+	gfxmonoDirty(gfx,x,y,1,1);
+
 	const unsigned bitNo = x*gfx->unitX + y*gfx->unitY;
 	const unsigned byteNo = bitNo / 8;
 	unsigned bitInByte = bitNo % 8;
@@ -52,29 +185,111 @@ bool gfxmonoGetPixelFast(const Gfxmono *gfx, int x, int y) {
 
 
 //SLICE
+/** Copies a rectangle, that lies completely within both surfaces.
+ */
+static void gfxmonoBitBltClipped(
+	Gfxmono *dst, int dstX, int dstY, int nX, int nY, bool invert,
+	const Gfxmono *src, int srcX, int srcY) {
+
+	Uint8 *dstPixels = dst->pixels;
+	const Uint8 *srcPixels = src->pixels;
+	const int dstLines = gfxmonoLines(dst);
+	const int srcLines = gfxmonoLines(src);
+
+	if (dstLines!=LINES_NONE && dstLines==srcLines) {
+		const bool columns = dstLines==LINES_COLUMNS;
+		const int n = columns ? nX : nY;
+		const unsigned length = columns ? nY : nX;
+		const unsigned dstStep = columns ? dst->unitX : dst->unitY;
+		const unsigned srcStep = columns ? src->unitX : src->unitY;
+		const unsigned d = gfxmonoBit(dst,dstX,dstY);
+		const unsigned s = gfxmonoBit(src,srcX,srcY);
+		// overlapping lines of the same surface: copy the last line first, if moving forward in memory
+		if ((uintptr_t)dstPixels*8+d > (uintptr_t)srcPixels*8+s)
+			for (int i=n-1; i>=0; i--) bitsCopy(dstPixels,d+i*dstStep,srcPixels,s+i*srcStep,length,invert);
+		else	for (int i=0; i<n; i++) bitsCopy(dstPixels,d+i*dstStep,srcPixels,s+i*srcStep,length,invert);
+	}
+	else if (dstLines!=LINES_NONE && srcLines!=LINES_NONE) {
+		// rows to columns or vice versa: tiles of 8x8 pixels, one byte per line
+		const bool srcColumns = srcLines==LINES_COLUMNS;
+		const unsigned srcStep = srcColumns ? src->unitX : src->unitY;
+		const unsigned dstStep = srcColumns ? dst->unitY : dst->unitX;
+		const int nSrcLines = srcColumns ? nX : nY;
+		const int length = srcColumns ? nY : nX;
+		const Uint64 flip = invert ? ~0ull : 0;
+		const unsigned s0 = gfxmonoBit(src,srcX,srcY);
+		const unsigned d0 = gfxmonoBit(dst,dstX,dstY);
+		// glyphs of 8 pixels per line drawn at multiples of 8: whole bytes
+		const bool aligned = srcStep%8==0 && dstStep%8==0 && s0%8==0 && d0%8==0;
+		for (int i=0; i<nSrcLines; i+=8) for (int j=0; j<length; j+=8) {
+			const int lines = nSrcLines-i<8 ? nSrcLines-i : 8;
+			const int bits = length-j<8 ? length-j : 8;
+			const unsigned s = s0 + i*srcStep + j;
+			const unsigned d = d0 + j*dstStep + i;
+			Uint64 tile = 0;
+			if (aligned && lines==8 && bits==8) {
+				for (int k=0; k<8; k++) tile |= (Uint64)srcPixels[(s+k*srcStep)/8] << 8*k;
+				tile = transpose8x8(tile) ^ flip;
+				for (int k=0; k<8; k++) dstPixels[(d+k*dstStep)/8] = tile >> 8*k;
+			}
+			else {
+				for (int k=0; k<lines; k++) tile |= (Uint64)bitsRead(srcPixels,s+k*srcStep,bits) << 8*k;
+				tile = transpose8x8(tile) ^ flip;
+				for (int k=0; k<bits; k++) bitsWrite(dstPixels,d+k*dstStep,lines,tile>>8*k & 0xFF);
+			}
+		}
+	}
+	else {	// pixel by pixel, reading every pixel of the same surface before overwriting it
+		const bool sameSurface = dstPixels==srcPixels;
+		const int stepX = sameSurface && dstX>srcX ? -1 : 1;
+		const int stepY = sameSurface && dstY>srcY ? -1 : 1;
+		for (int i=0; i<nX; i++) for (int j=0; j<nY; j++) {
+			const int dx = stepX>0 ? i : nX-1-i;
+			const int dy = stepY>0 ? j : nY-1-j;
+			gfxmonoSetPixelFast(dst,dstX+dx,dstY+dy,invert ^ gfxmonoGetPixelFast(src,srcX+dx,srcY+dy));
+		}
+	}
+}
+
 void gfxmonoBitBlt(
 	Gfxmono *dstGfxmono, int dstX, int dstY, int nX, int nY, bool color,
 	const Gfxmono *srcGfxmono, int srcX, int srcY) {
 
-	for (int dx=0; dx<nX; dx++) for (int dy=0; dy<nY; dy++) {
-		const bool pixel = !color ^ ((0<=srcX+dx && srcX+dx<srcGfxmono->nX && 0<=srcY+dy && srcY+dy<srcGfxmono->nY) ?
-				gfxmonoGetPixelFast(srcGfxmono,srcX+dx,srcY+dy) : false);
+	// offsets within the rectangle, that are written
+	int x0 = 0, x1 = nX, y0 = 0, y1 = nY;
+	clip(&x0,&x1,dstX,dstGfxmono->nX);
+	clip(&y0,&y1,dstY,dstGfxmono->nY);
+	if (x0>=x1 || y0>=y1) return;
+	gfxmonoDirty(dstGfxmono,dstX+x0,dstY+y0,x1-x0,y1-y0);
+
+	// ..and the offsets, that can be read from the source
+	int sx0 = x0, sx1 = x1, sy0 = y0, sy1 = y1;
+	clip(&sx0,&sx1,srcX,srcGfxmono->nX);
+	clip(&sy0,&sy1,srcY,srcGfxmono->nY);
+	if (sx0>=sx1 || sy0>=sy1) {
+		gfxmonoFillClipped(dstGfxmono,dstX+x0,dstY+y0,x1-x0,y1-y0,!color);
+		return;
+	}
 
+	gfxmonoBitBltClipped(dstGfxmono,dstX+sx0,dstY+sy0,sx1-sx0,sy1-sy0,!color,srcGfxmono,srcX+sx0,srcY+sy0);
 
-		if (0<=dstX+dx && dstX+dx<dstGfxmono->nX && 0<=dstY+dy && dstY+dy<dstGfxmono->nY)
-			gfxmonoSetPixelFast(dstGfxmono,dstX+dx,dstY+dy,pixel);
-	}
+	// reading outside the source results in 0, fill after copying in case the source is the destination
+	gfxmonoFillClipped(dstGfxmono,dstX+x0,dstY+y0,x1-x0,sy0-y0,!color);
+	gfxmonoFillClipped(dstGfxmono,dstX+x0,dstY+sy1,x1-x0,y1-sy1,!color);
+	gfxmonoFillClipped(dstGfxmono,dstX+x0,dstY+sy0,sx0-x0,sy1-sy0,!color);
+	gfxmonoFillClipped(dstGfxmono,dstX+sx1,dstY+sy0,x1-sx1,sy1-sy0,!color);
 }
 
 
 //SLICE
 void gfxmonoBitBltFill(Gfxmono *gfx, int x, int y, int nX, int nY, bool color) {
-	if (x<0) x = 0;
-	if (y<0) y = 0;
-	if (x+nX>gfx->nX) nX = gfx->nX - x;
-	if (y+nY>gfx->nY) nY = gfx->nY - y;
-
-	for (int dx=0; dx<nX; dx++) for (int dy=0; dy<nY; dy++) gfxmonoSetPixelFast(gfx,x+dx,y+dy,color);
+	int x0 = 0, x1 = nX, y0 = 0, y1 = nY;
+	clip(&x0,&x1,x,gfx->nX);
+	clip(&y0,&y1,y,gfx->nY);
+	if (x0<x1 && y0<y1) {
+		gfxmonoDirty(gfx,x+x0,y+y0,x1-x0,y1-y0);
+		gfxmonoFillClipped(gfx,x+x0,y+y0,x1-x0,y1-y0,color);
+	}
 }
 
 
@@ -221,29 +436,44 @@ void gfxmonoChess(Gfxmono *gfx, const R2 window, int w, bool color) {
 	}
 }
 
+//SLICE
 void gfxmonoScrollY(Gfxmono *gfx, const R2 window, int nUp, bool color) {
-	const R2 rGfx = {{ 0,0, gfx->nX, gfx->nY }};
-	const R2 dest = r2Intersect(rGfx,window);
+	const R2 rGfx = {{ 0,0, gfx->nX-1, gfx->nY-1 }};
+	const R2 area = r2Intersect(rGfx,window);
+	if (area.x0>area.x1 || area.y0>area.y1) return;
+
+	const int nX = area.x1-area.x0+1;
+	const int nY = area.y1-area.y0+1;
+	const int n = nUp>=0 ? (nUp<nY ? nUp : nY) : (-nUp<nY ? -nUp : nY);
+	if (n==0) return;
 
 	if (nUp>0) {	// scroll up
-		for (int y=dest.y0; y<=dest.y1; ++y) for (int x=dest.x0; x<=dest.x1; ++x)
-			gfxmonoSetPixelFast(gfx,x,y, y+nUp<=dest.y1 ? gfxmonoGetPixelFast(gfx,x,y+nUp) : color);
+		gfxmonoBitBlt(gfx,area.x0,area.y0,nX,nY-n,true,gfx,area.x0,area.y0+n);
+		gfxmonoBitBltFill(gfx,area.x0,area.y1-n+1,nX,n,color);
 	}
 	else {		// scroll down
-		for (int y=dest.y1; y>=dest.y0; --y) for (int x=dest.x0; x<=dest.x1; ++x)
-			gfxmonoSetPixelFast(gfx,x,y, dest.y0<=y+nUp ? gfxmonoGetPixelFast(gfx,x,y+nUp) : color);
-
+		gfxmonoBitBlt(gfx,area.x0,area.y0+n,nX,nY-n,true,gfx,area.x0,area.y0);
+		gfxmonoBitBltFill(gfx,area.x0,area.y0,nX,n,color);
 	}
 }
 
+//SLICE
 void gfxmonoScrollX(Gfxmono *gfx, const R2 window, int nLeft, bool color) {
-	const R2 rGfx = {{ 0,0, gfx->nX, gfx->nY }};
+	const R2 rGfx = {{ 0,0, gfx->nX-1, gfx->nY-1 }};
 	const R2 area = r2Intersect(rGfx,window);
-	if (nLeft>0)	// scroll left
-		for (int x=area.x0; x<=area.x1; ++x) for (int y=area.y0; y<=area.y1; ++y)
-			gfxmonoSetPixelFast(gfx,x,y, x+nLeft<=area.x1 ? gfxmonoGetPixelFast(gfx,x+nLeft,y) : color);
-	else		// scroll right
-		for (int x=area.x1; x>=area.x0; --x) for (int y=area.y0; y<=area.y1; ++y)
-			gfxmonoSetPixelFast(gfx,x,y, area.x0<=x+nLeft ? gfxmonoGetPixelFast(gfx,x+nLeft,y) : color);
+	if (area.x0>area.x1 || area.y0>area.y1) return;
 
+	const int nX = area.x1-area.x0+1;
+	const int nY = area.y1-area.y0+1;
+	const int n = nLeft>=0 ? (nLeft<nX ? nLeft : nX) : (-nLeft<nX ? -nLeft : nX);
+	if (n==0) return;
+
+	if (nLeft>0) {	// scroll left
+		gfxmonoBitBlt(gfx,area.x0,area.y0,nX-n,nY,true,gfx,area.x0+n,area.y0);
+		gfxmonoBitBltFill(gfx,area.x1-n+1,area.y0,n,nY,color);
+	}
+	else {		// scroll right
+		gfxmonoBitBlt(gfx,area.x0+n,area.y0,nX-n,nY,true,gfx,area.x0,area.y0);
+		gfxmonoBitBltFill(gfx,area.x0,area.y0,n,nY,color);
+	}
 }
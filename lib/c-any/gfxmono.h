@@ -24,7 +24,20 @@
 #include <stdbool.h>
 #include <geomInt.h>
 
+/** The area modified since the last display refresh: columns x0..x1-1 and rows y0..y1-1. The area is empty, if
+ * x0>=x1, like a zero-initialized one.
+ */
+typedef struct {
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+} GfxmonoDirty;
+
 /** Byte-oriented pixel drawing surface in memory upper left pixel is (0,0).
+ * Surfaces with unitY==1 (columns, like the framebuffers) or unitX==1 (rows, like most fonts) are copied and filled
+ * in bytes and words, all other layouts pixel by pixel.
+ * All drawing functions add the pixels they write to the dirty area. Display drivers transfer only this area.
  */
 typedef struct {
 	unsigned nX;		///< width of surface
@@ -32,8 +45,54 @@ typedef struct {
 	unsigned unitX;		///< how many bits to move in buffer, if x increases by one.
 	unsigned unitY;		///< how many bits to move in buffer, if y increases by one.
 	void *pixels;		///< pixel buffer memory.
+	GfxmonoDirty dirty;	///< area modified, not yet transferred to the display.
 } Gfxmono;
 
+/** Adds an area to the dirty area. Required after writing the pixel buffer directly.
+ * @param gfx the surface.
+ * @param x left bound.
+ * @param y upper bound.
+ * @param nX width, the area is clipped to the surface.
+ * @param nY height.
+ */
+static inline void gfxmonoDirty(Gfxmono *gfx, int x, int y, int nX, int nY) {
+	const int x0 = x<0 ? 0 : x;
+	const int y0 = y<0 ? 0 : y;
+	const int x1 = x+nX>(int)gfx->nX ? (int)gfx->nX : x+nX;
+	const int y1 = y+nY>(int)gfx->nY ? (int)gfx->nY : y+nY;
+	if (x0>=x1 || y0>=y1) return;
+
+	GfxmonoDirty *d = &gfx->dirty;
+	if (d->x0>=d->x1) {
+		d->x0 = x0; d->y0 = y0; d->x1 = x1; d->y1 = y1;
+	}
+	else {
+		if (x0<d->x0) d->x0 = x0;
+		if (y0<d->y0) d->y0 = y0;
+		if (x1>d->x1) d->x1 = x1;
+		if (y1>d->y1) d->y1 = y1;
+	}
+}
+
+/** Marks the whole surface as modified, forcing a full display refresh.
+ */
+static inline void gfxmonoDirtyAll(Gfxmono *gfx) {
+	gfxmonoDirty(gfx,0,0,gfx->nX,gfx->nY);
+}
+
+/** Checks, if the surface was modified since the last display refresh.
+ */
+static inline bool gfxmonoIsDirty(const Gfxmono *gfx) {
+	return gfx->dirty.x0<gfx->dirty.x1;
+}
+
+/** Marks the surface as unmodified. Used by display drivers after the transfer.
+ */
+static inline void gfxmonoDirtyClear(Gfxmono *gfx) {
+	const GfxmonoDirty empty = {};
+	gfx->dirty = empty;
+}
+
 /** Needed to define Fonts.
  */
 typedef struct CharLocation {
@@ -84,12 +143,16 @@ bool gfxmonoGetPixel(const Gfxmono *gfx, int x, int y);
 bool gfxmonoGetPixelFast(const Gfxmono *gfx, int x, int y);
 
 /** Copy a rectangular area from src to dst. Range checking is performed. Writing outside the bounds of dst has no
- * effect. Reading outside the bounds of src results in reads of 0 (false).
+ * effect. Reading outside the bounds of src results in reads of 0 (false). The areas may overlap, if src and dst are
+ * the same surface.
+ * @param color true for a copy, false for inverted pixels.
  */
 void gfxmonoBitBlt(
 	Gfxmono *dstGfxmono, int dstX, int dstY, int nX, int nY, bool color,
 	const Gfxmono *srcGfxmono, int srcX, int srcY);
 
+/** Fills a rectangular area. Pixels outside the bounds of gfx are not written.
+ */
 void gfxmonoBitBltFill(Gfxmono *gfx, int x0, int y0, int nX, int nY, bool color);
 
 /** Draws a single character.
@@ -171,12 +171,8 @@ bool fifoParseHexRecord(Fifo *fifo, HexRecord *record) {
 			checksum += record->offset + (record->offset>>8);
 			if (!fifoParseHexN(&clone,&record->type,2,2)) return false;
 			checksum += record->type;
-			for (int i = 0; i<length; i++) {
-				unsigned value;
-				if (!fifoParseHexN(&clone, &value, 2,2)) return false;
-				record->data[i] = value;
-				checksum += value;
-			}
+			if (!fifoParseHexBytes(&clone, record->data, length)) return false;
+			for (int i = 0; i<length; i++) checksum += record->data[i];
 			if (!fifoParseHexN(&clone,&record->checksum,2,2)) return false;
 			fifoCopyReadPosition(fifo,&clone);
 			return true;	// checksum == record->checksum;
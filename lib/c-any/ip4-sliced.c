@@ -3,6 +3,7 @@
 #include <fifoParse.h>
 #include <fifoPrint.h>
 #include <simpleMath.h>
+#include <onesComplement.h>
 
 //SLICE
 Ip4Address IP4_ADDRESS_BROADCAST = { .int8s = {255,255,255,255} };
@@ -129,14 +130,9 @@ bool fifoPutnetIp4Header(Fifo *fifo, Ip4Header const *ip4Header) {
  */
 Uint16 fifoCalculateOnesComplementSumBigEndian(Fifo *fifo) {
 	Fifo clone = *fifo;
-	Uint16 sum = 0;
-	while (2<=fifoCanRead(&clone)) {
-		const int word = (Uint8)fifoRead(&clone) | (Uint8)fifoRead(&clone) << 8;
-		sum = onesComplementAdd16(sum,changeEndian16(word));
-	}
-	// additional last byte, not on a 16-bit boundary
-	if (1==fifoCanRead(&clone)) sum = onesComplementAdd16(sum, changeEndian16((Uint8)fifoRead(&clone)));
-	return sum;
+	OnesComplementSum sum = {};
+	fifoOnesComplementSumAdd(&sum,&clone);
+	return onesComplementSumResult(&sum);
 }
 
 //SLICE
@@ -17,7 +17,7 @@ typedef struct __attribute__((packed,aligned(2))) {
 	Uint32		sequence;
 	Uint32		acknowledge;		///< acknowledge sequence number (next expected sequence number).
 	union {
-		struct __attribute__((packed,aligned(4))) {
+		struct __attribute__((packed)) {
 		/*
 			Uint16	dataOffset4:4;		///< The number of 32bit words of the TCP header. 
 			Uint16	reserved:6;		///< Must be zero
@@ -1,11 +1,14 @@
 #include <ipStack.h>
 #include <enetIoFifo.h>
+#include <enetIoRing.h>
 
 #include <fifo.h>
 #include <fifoPrint.h>
 #include <fifoParse.h>
 #include <string.h>
+#include <stddef.h>
 #include <simpleMath.h>
+#include <onesComplement.h>
 
 #include <macros.h>
 
@@ -55,6 +58,25 @@ const Ip4StackHandlers *handlers) {
 	ethernetArpCache = cache;
 }
 
+static bool	inBurst = false;	///< frames are queued and sent with one doorbell at the end of the burst
+static Fifo*	burstFrame = 0;		///< the received frame being handled, if owned by the current burst
+static Fifo	burstFrameWhole;	///< the whole received frame, before parsing
+
+/** Provides a transmit buffer.
+ * @return an empty buffer or 0, if none is available.
+ */
+static Fifo* txBegin(void) {
+	Fifo *fifo;
+	return 1==enetIoTxReserve(&fifo,1) ? fifo : 0;
+}
+
+/** Sends a transmit buffer, at the end of the burst at the latest.
+ */
+static void txEnd(Fifo *fifo) {
+	enetIoTxQueue(fifo);
+	if (!inBurst) enetIoTxDoorbell();
+}
+
 void initIp4Header(Ip4Header *ip4Header) {
 	ip4Header->version = 4;
 	ip4Header->headerLength4 = sizeof *ip4Header / 4;
@@ -67,6 +89,43 @@ void initIp4Header(Ip4Header *ip4Header) {
 	ip4Header->headerChecksum = 0;	// good starting point for a calculation
 }
 
+/** Turns a received echo request into the reply in place and queues it for transmission. This is possible only, if
+ * the frame belongs to the current burst and has no IP options. The addresses are swapped, which keeps the checksums
+ * and only TTL and ICMP type require checksum updates.
+ * @return true, if the reply was queued.
+ */
+static bool icmpEchoReplyInPlace(Fifo *fifo, EthernetHeader const *ethernetHeader, Ip4Header const *ip4Header,
+IcmpHeader const *icmpHeader) {
+	if (fifo!=burstFrame || ip4Header->headerLength4*4!=sizeof(Ip4Header)) return false;
+
+	const EthernetHeader responseEthernetHeader = {
+		.destinationAddress = ethernetHeader->sourceAddress,
+		.sourceAddress = ip4NetworkConfiguration->ethernetAddress,
+		.type = ETHERNET_TYPE_IP4,
+	};
+
+	Ip4Header responseIp4Header = *ip4Header;
+	responseIp4Header.sourceAddress = ip4Header->destinationAddress;
+	responseIp4Header.destinationAddress = ip4Header->sourceAddress;
+	responseIp4Header.ttl = ip4NetworkConfiguration->ttl!=0 ? ip4NetworkConfiguration->ttl : 255;
+	responseIp4Header.headerChecksum = onesComplementChecksumUpdate16(ip4Header->headerChecksum,
+		ip4Header->ttl<<8 | ip4Header->protocol, responseIp4Header.ttl<<8 | responseIp4Header.protocol);
+
+	IcmpHeader responseIcmpHeader = {
+		.type = ICMP_TYPE_ECHO_REPLY,
+		.code = 0,
+	};
+	responseIcmpHeader.checksum = onesComplementChecksumUpdate16(icmpHeader->checksum,
+		icmpHeader->type<<8 | icmpHeader->code, responseIcmpHeader.type<<8 | responseIcmpHeader.code);
+
+	Fifo rewriter;
+	fifoInitRewrite(&rewriter,&burstFrameWhole);
+	return fifoPutnetEthernetHeader(&rewriter,&responseEthernetHeader)
+		&& fifoPutnetIp4Header(&rewriter,&responseIp4Header)
+		&& fifoPutnetIcmpHeader(&rewriter,&responseIcmpHeader)
+		&& enetIoTxQueueRx(&burstFrameWhole);
+}
+
 static bool handleEthernetIp4IcmpPacket(Fifo *fifo, EthernetHeader const *ethernetHeader, Ip4Header const *ip4Header) {
 	IcmpHeader icmpHeader;
 	if (fifoGetnetIcmpHeader(fifo,&icmpHeader)) {
@@ -78,9 +137,11 @@ static bool handleEthernetIp4IcmpPacket(Fifo *fifo, EthernetHeader const *ethern
 				fifoPrintIcmpEcho(&out,&icmpEcho);
 			)
 			// generate response, if addressed to me
-			if (ip4IsEqual(&ip4Header->destinationAddress,&ip4NetworkConfiguration->ip4Address)
-			&& enetIoFifoCanWrite()) {
-				Fifo *response = enetIoFifoWriteBegin();
+			const bool toMe = ip4IsEqual(&ip4Header->destinationAddress,&ip4NetworkConfiguration->ip4Address);
+			if (toMe && icmpEchoReplyInPlace(fifo,ethernetHeader,ip4Header,&icmpHeader)) return true;
+
+			Fifo *response;
+			if (toMe && (response = txBegin())!=0) {
 				EthernetHeader responseEthernetHeader = {
 					.destinationAddress = ethernetHeader->sourceAddress, 
 					.sourceAddress = ip4NetworkConfiguration->ethernetAddress,
@@ -104,7 +165,9 @@ static bool handleEthernetIp4IcmpPacket(Fifo *fifo, EthernetHeader const *ethern
 					.checksum = 0,	// to be adjusted shortly...
 				};
 
-				responseIcmpHeader.checksum = ~icmpEchoChecksum(&responseIcmpHeader,&icmpEcho,fifo);
+				// only the type changes: no need to sum the message again (RFC 1624)
+				responseIcmpHeader.checksum = onesComplementChecksumUpdate16(icmpHeader.checksum,
+					icmpHeader.type<<8 | icmpHeader.code, responseIcmpHeader.type<<8 | responseIcmpHeader.code);
 
 				const bool success = 
 					fifoPutnetEthernetHeader(response,&responseEthernetHeader)
@@ -117,8 +180,7 @@ static bool handleEthernetIp4IcmpPacket(Fifo *fifo, EthernetHeader const *ethern
 				// copy message body back
 				while (fifoCanRead(fifo)) fifoWrite(response,fifoRead(fifo));
 
-				// checksum will go here
-				enetIoFifoWriteEnd();
+				txEnd(response);
 				return success;
 			}
 		}
@@ -128,8 +190,30 @@ static bool handleEthernetIp4IcmpPacket(Fifo *fifo, EthernetHeader const *ethern
 	return false;
 }
 
-bool handleEthernetIp4TcpPacket(Fifo *fifo, EthernetHeader const *ethernetHeader, Ip4Header const *ip4Header) {
-	return false;
+/** The TCP engine (ipStackTcp.c), if linked.
+ */
+InputPacketStatus tcpHandleSegment(Fifo *segment, const Ip4Header *ip4Header) __attribute__((weak));
+
+InputPacketStatus handleEthernetIp4TcpPacket(Fifo *fifo, EthernetHeader const *ethernetHeader,
+Ip4Header const *ip4Header) {
+	// truncate to the TCP segment, Ethernet may have added padding.
+	Fifo segment;
+	const int length = ip4Header->totalLength - ip4Header->headerLength4*4;
+	if (length<(int)sizeof(TcpHeader) || !fifoParseN(fifo,&segment,length)) return PACKET_DISCARDED;
+
+	if (tcpHandleSegment!=0) {
+		Fifo reader = segment;
+		const InputPacketStatus status = tcpHandleSegment(&reader,ip4Header);
+		if (status!=PACKET_PENDING) return status;
+	}
+
+	TcpHeader tcpHeader;
+	TcpOptions tcpOptions;
+	if (ip4StackHandlers!=0 && ip4StackHandlers->tcp!=0
+	&& fifoGetnetTcpHeader(&segment,&tcpHeader,&tcpOptions)) {
+		return ip4StackHandlers->tcp(&segment,&tcpHeader) ? PACKET_HANDLED : PACKET_PENDING;
+	}
+	else return PACKET_PENDING;
 }
 
 /** Generates an Ethernet packet suitable for answering a request.
@@ -206,6 +290,7 @@ void ip4HeaderRewrite(Fifo *rewriter, Fifo *reader) {
 	fifoPutnetIp4Header(rewriter,&ip4Header);
 }
 
+//UNUSED:
 /** Rewrites both IP and UDP header with correct length and checksum.
  * @param rewriter a fifo set up for rewriting
  * @param reader a fifo containing the whole IP packet.
@@ -250,26 +335,73 @@ void ip4UdpHeaderRewrite(Fifo *rewriter, Fifo *reader) {
 	fifoPutnetUdpHeader(rewriter,&udpHeader);
 }
 
+/** The host a packet is sent to: the destination itself in the current subnet, the gateway otherwise.
+ */
+static const Ip4Address* nextHop(const Ip4Address *destination) {
+	return ip4IsSubnet(&ip4NetworkConfiguration->ip4Address,ip4NetworkConfiguration->subnetBits,destination)
+		? destination : &ip4NetworkConfiguration->gateway;
+}
+
 /** Find the Ethernet address of the destination of an IP packet.
  * If it is a broadcast address, then use broadcast.
  * If it is in the current subnet, then it should be in the ARP cache
  * Otherwise send it to the gateway (which in turn should be in the ARP cache).
  */
 const EthernetAddress* destinationEthernetAddress(const Ip4Address *destination) {
-	const EthernetArpCacheEntry *cacheEntry = 0;
-
 	if (ip4IsBroadcast(destination)) return &ETHERNET_ADDRESS_BROADCAST;
-	if (ip4IsSubnet(&ip4NetworkConfiguration->ip4Address,ip4NetworkConfiguration->subnetBits,destination))
-		cacheEntry = ethernetArpCacheLookup(ethernetArpCache,destination,sysTickTimeMs);
-	else cacheEntry = ethernetArpCacheLookup(ethernetArpCache,&ip4NetworkConfiguration->gateway,sysTickTimeMs);
+	const EthernetArpCacheEntry *cacheEntry = ethernetArpCacheLookup(ethernetArpCache,nextHop(destination),
+		sysTickTimeMs);
 	if (cacheEntry!=0) return &cacheEntry->ethernetAddress;
 	else return 0;
 }
 
+Fifo* ip4SendBegin(const Ip4Address *destination, Uint8 protocol, Ip4Header *ip4Header) {
+	EthernetAddress const* ethernetAddress = destinationEthernetAddress(destination);
+	if (ethernetAddress==0) {
+		ethernetArpRequest(nextHop(destination));
+		return 0;
+	}
+
+	Fifo *outputStream = txBegin();
+	if (outputStream==0) return 0;
+
+	const EthernetHeader ethernetHeader = {
+		.destinationAddress = *ethernetAddress,
+		.sourceAddress = ip4NetworkConfiguration->ethernetAddress,
+		.type = ETHERNET_TYPE_IP4
+	};
+	fifoPutnetEthernetHeader(outputStream,&ethernetHeader);
+	*ip4Header = *ip4HeaderCreate(ip4NetworkConfiguration,destination,protocol);
+	fifoPutnetIp4Header(outputStream,ip4Header);
+	return outputStream;
+}
+
+void ip4SendEnd(Fifo *fifo, Ip4Header *ip4Header) {
+	Fifo reader = *fifo;
+	fifoSkipRead(&reader,sizeof(EthernetHeader));	// Ethernet header is already fine.
+	ip4Header->totalLength = fifoCanRead(&reader);
+	ip4Header->headerChecksum = 0;
+	ip4Header->headerChecksum = ~ip4HeaderChecksum(ip4Header);
+	Fifo rewriter;
+	fifoInitRewrite(&rewriter,&reader);
+	fifoPutnetIp4Header(&rewriter,ip4Header);
+	txEnd(fifo);
+}
+
+/** The UDP datagram being assembled. The checksum of the payload is accumulated whenever the payload is committed,
+ * so udpSendEnd() does not need to read the whole packet again.
+ */
+static struct {
+	Ip4Header		ip4Header;	///< as written, with the length of an empty datagram
+	UdpHeader		udpHeader;	///< as written, with the length of an empty datagram
+	Fifo			payload;	///< the payload written, but not summed yet
+	OnesComplementSum	sum;		///< the sum of the payload committed so far
+} udpSend;
+
 Fifo* udpSendBegin(const Ip4SocketAddress *destination, Uint16 sourcePort) {
-	if (!enetIoFifoCanWrite()) return 0;
+	Fifo *outputStream = txBegin();
+	if (outputStream==0) return 0;
 
-	Fifo *outputStream = enetIoFifoWriteBegin();
 	// look up hardware address from ARP cache.
 	EthernetAddress const* ethernetAddress = destinationEthernetAddress(&destination->ip4Address);
 	if (ethernetAddress==0) {
@@ -290,32 +422,201 @@ Fifo* udpSendBegin(const Ip4SocketAddress *destination, Uint16 sourcePort) {
 	fifoPutnetEthernetHeader(outputStream,&ethernetHeader);
 
 	// write IP4 header
-	fifoPutnetIp4Header(outputStream,
-		ip4HeaderCreate(ip4NetworkConfiguration,&destination->ip4Address,IP_PROTOCOL_UDP));
+	udpSend.ip4Header = *ip4HeaderCreate(ip4NetworkConfiguration,&destination->ip4Address,IP_PROTOCOL_UDP);
+	udpSend.ip4Header.totalLength = sizeof(Ip4Header) + sizeof(UdpHeader);
+	udpSend.ip4Header.headerChecksum = ~ip4HeaderChecksum(&udpSend.ip4Header);
+	fifoPutnetIp4Header(outputStream,&udpSend.ip4Header);
 
 	// write UDP header
-	UdpHeader responseUdpHeader = {
+	const UdpHeader responseUdpHeader = {
 		.source = sourcePort,
 		.destination = destination->port,
 		.length = sizeof(UdpHeader) + 0,
 		.checksum = 0,	// unused if 0
 	};
+	udpSend.udpHeader = responseUdpHeader;
 	fifoPutnetUdpHeader(outputStream,&responseUdpHeader);
+
 	// now comes the UDP contents.
+	udpSend.payload = *outputStream;
+	udpSend.payload.rTotal = outputStream->wTotal;	// empty
+	udpSend.payload.rPos = outputStream->wPos;
+	udpSend.sum = (OnesComplementSum){};
 	return outputStream;
 }
 
-void udpSendEnd(Fifo *fifo) {
-	Fifo reader = *fifo;
+void udpSendCommit(Fifo *fifo) {
+	fifoCopyWritePosition(&udpSend.payload,fifo);
+	fifoOnesComplementSumAdd(&udpSend.sum,&udpSend.payload);
+}
 
-	fifoSkipRead(&reader,sizeof(EthernetHeader));	// Ethernet header is already fine.
+bool udpSendWrite(Fifo *fifo, const void *data, size_t n) {
+	if (fifoCanWrite(fifo)<n) return false;
+
+	udpSendCommit(fifo);		// anything written otherwise before
+	fifoWriteN(fifo,data,n);
+	onesComplementSumAdd(&udpSend.sum,data,n);
+	fifoCopyWritePosition(&udpSend.payload,fifo);
+	fifoSkipRead(&udpSend.payload,n);
+	return true;
+}
+
+void udpSendEnd(Fifo *fifo) {
+	udpSendCommit(fifo);
+	const Uint16 length = sizeof(UdpHeader) + udpSend.sum.bytes;
+
+	// only the length changed since the header checksum was calculated (RFC 1624)
+	Ip4Header *ip4Header = &udpSend.ip4Header;
+	ip4Header->headerChecksum = onesComplementChecksumUpdate16(ip4Header->headerChecksum,
+		ip4Header->totalLength, sizeof(Ip4Header) + length);
+	ip4Header->totalLength = sizeof(Ip4Header) + length;
+
+	// pseudo header, UDP header and payload
+	UdpHeader *udpHeader = &udpSend.udpHeader;
+	udpHeader->length = length;
+	OnesComplementSum sum = {};
+	onesComplementSumAdd16(&sum,onesComplementSumResult(&udpSend.sum));
+	onesComplementSumAdd(&sum,&ip4Header->sourceAddress,sizeof(Ip4Address));
+	onesComplementSumAdd(&sum,&ip4Header->destinationAddress,sizeof(Ip4Address));
+	onesComplementSumAdd16(&sum,IP_PROTOCOL_UDP);
+	onesComplementSumAdd16(&sum,length);
+	onesComplementSumAdd16(&sum,udpHeader->source);
+	onesComplementSumAdd16(&sum,udpHeader->destination);
+	onesComplementSumAdd16(&sum,length);
+	udpHeader->checksum = ~onesComplementSumResult(&sum);
+	if (udpHeader->checksum==0) udpHeader->checksum = 0xFFFF;	// 0 means: no checksum
 
 	// rewrite IP,UDP
+	Fifo reader = *fifo;
+	fifoSkipRead(&reader,sizeof(EthernetHeader));	// Ethernet header is already fine.
 	Fifo rewriter;
 	fifoInitRewrite(&rewriter,&reader);
-	
-	ip4IpUdpHeaderRewrite(&rewriter,&reader);	// checksums, lengths...
-	enetIoFifoWriteEnd();
+	fifoPutnetIp4Header(&rewriter,ip4Header);
+	fifoPutnetUdpHeader(&rewriter,udpHeader);
+	txEnd(fifo);
+}
+
+void udpFlowInit(UdpFlow *flow, const Ip4SocketAddress *destination, Uint16 sourcePort) {
+	*flow = (UdpFlow) {
+		.destination = *destination,
+		.sourcePort = sourcePort,
+	};
+}
+
+/** Checks, if the ARP cache entry used for the template still holds the same mapping and has not expired, like
+ * ethernetArpCacheExpire() decides.
+ */
+static bool udpFlowValid(const UdpFlow *flow) {
+	const EthernetArpCacheEntry *entry = flow->arpEntry;
+	return flow->valid && (entry==0
+		|| (entry->state & ETHERNET_ARP_RESOLVED) && entry->time==flow->arpTime
+		&& ip4IsEqual(&entry->ip4Address,nextHop(&flow->destination.ip4Address))
+		&& !(entry->time+ethernetArpCache->entryLifeTime < sysTickTimeMs));
+}
+
+/** Builds the header template from the ARP cache.
+ * @return true, if the next hop is resolved.
+ */
+static bool udpFlowBuild(UdpFlow *flow) {
+	const Ip4Address *destination = &flow->destination.ip4Address;
+	EthernetAddress const *ethernetAddress = &ETHERNET_ADDRESS_BROADCAST;
+	flow->arpEntry = 0;
+	flow->valid = false;
+	if (!ip4IsBroadcast(destination)) {
+		const EthernetArpCacheEntry *entry = ethernetArpCacheLookup(ethernetArpCache,nextHop(destination),
+			sysTickTimeMs);
+		if (entry==0) {
+			ethernetArpRequest(nextHop(destination));
+			return false;
+		}
+		flow->arpEntry = entry;
+		flow->arpTime = entry->time;
+		ethernetAddress = &entry->ethernetAddress;
+	}
+
+	const EthernetHeader ethernetHeader = {
+		.destinationAddress = *ethernetAddress,
+		.sourceAddress = ip4NetworkConfiguration->ethernetAddress,
+		.type = ETHERNET_TYPE_IP4
+	};
+	Ip4Header ip4Header = *ip4HeaderCreate(ip4NetworkConfiguration,destination,IP_PROTOCOL_UDP);
+	ip4Header.totalLength = sizeof(Ip4Header) + sizeof(UdpHeader);
+	ip4Header.headerChecksum = ~ip4HeaderChecksum(&ip4Header);
+	const UdpHeader udpHeader = {
+		.source = flow->sourcePort,
+		.destination = flow->destination.port,
+		.length = sizeof(UdpHeader),
+		.checksum = 0,
+	};
+	Fifo writer;
+	fifoInitWrite(&writer,flow->header,sizeof flow->header);
+	fifoPutnetEthernetHeader(&writer,&ethernetHeader);
+	fifoPutnetIp4Header(&writer,&ip4Header);
+	fifoPutnetUdpHeader(&writer,&udpHeader);
+
+	OnesComplementSum sum = {};
+	onesComplementSumAdd(&sum,&ip4Header.sourceAddress,sizeof(Ip4Address));
+	onesComplementSumAdd(&sum,&ip4Header.destinationAddress,sizeof(Ip4Address));
+	onesComplementSumAdd16(&sum,IP_PROTOCOL_UDP);
+	onesComplementSumAdd16(&sum,udpHeader.source);
+	onesComplementSumAdd16(&sum,udpHeader.destination);
+	flow->sumBase = onesComplementSumResult(&sum);
+	flow->valid = true;
+	return true;
+}
+
+static inline void putBigEndian16(Uint8 *p, Uint16 value) {
+	p[0] = value>>8;
+	p[1] = value;
+}
+
+int udpFlowSend(UdpFlow *flow, const UdpFlowPayload *payloads, int n) {
+	for (int i=0; i<n; i++) if (payloads[i].size>UDP_FLOW_PAYLOAD_MAX) return -1;
+	if (!udpFlowValid(flow) && !udpFlowBuild(flow)) return 0;
+
+	enum {
+		IP4		=sizeof(EthernetHeader),
+		UDP		=IP4 + sizeof(Ip4Header),
+	};
+	const Uint16 ip4Checksum = (Uint16)flow->header[IP4+offsetof(Ip4Header,headerChecksum)]<<8
+		| flow->header[IP4+offsetof(Ip4Header,headerChecksum)+1];
+
+	int sent = 0;
+	while (sent<n) {
+		Fifo *frames[IP_STACK_BURST];
+		const int reserved = enetIoTxReserve(frames,MIN(n-sent,IP_STACK_BURST));
+		if (reserved==0) break;
+
+		int queued = 0;
+		for ( ; queued<reserved; queued++) {
+			const UdpFlowPayload *payload = &payloads[sent+queued];
+			if (fifoCanWrite(frames[queued]) < UDP_FLOW_HEADER_SIZE+payload->size) break;
+
+			// RFC 1624 update of the IP4 header checksum, the UDP checksum from the precomputed base
+			const Uint16 length = sizeof(UdpHeader) + payload->size;
+			OnesComplementSum sum = { .sum = flow->sumBase };
+			onesComplementSumAdd16(&sum,length);
+			onesComplementSumAdd16(&sum,length);
+			onesComplementSumAdd16(&sum,onesComplementSumSpan(payload->data,payload->size));
+			Uint16 udpChecksum = ~onesComplementSumResult(&sum);
+			if (udpChecksum==0) udpChecksum = 0xFFFF;	// 0 means: no checksum
+
+			Uint8 header[UDP_FLOW_HEADER_SIZE];
+			memcpy(header,flow->header,sizeof header);
+			putBigEndian16(header+IP4+offsetof(Ip4Header,totalLength),sizeof(Ip4Header)+length);
+			putBigEndian16(header+IP4+offsetof(Ip4Header,headerChecksum),onesComplementChecksumUpdate16(
+				ip4Checksum,sizeof(Ip4Header)+sizeof(UdpHeader),sizeof(Ip4Header)+length));
+			putBigEndian16(header+UDP+offsetof(UdpHeader,length),length);
+			putBigEndian16(header+UDP+offsetof(UdpHeader,checksum),udpChecksum);
+			fifoWriteN(frames[queued],header,sizeof header);
+			fifoWriteN(frames[queued],payload->data,payload->size);
+			enetIoTxQueue(frames[queued]);
+		}
+		sent += queued;
+		if (queued<reserved) break;	// transmit buffer smaller than a full frame: the rest is reserved again later
+	}
+	if (!inBurst && sent!=0) enetIoTxDoorbell();
+	return sent;
 }
 
 /** Sends back an ICMP destination unreachable message.
@@ -323,8 +624,8 @@ void udpSendEnd(Fifo *fifo) {
 bool icmpDestinationUnreachable(EthernetHeader const *ethernetHeader, Ip4Header const *ip4Header, int code,
 Fifo *ip4Datagram) {
 	// ICMP port unreachable / fragmented
-	if (enetIoFifoCanWrite()) {
-		Fifo *replyFifo = enetIoFifoWriteBegin();
+	Fifo *replyFifo = txBegin();
+	if (replyFifo!=0) {
 
 		// reply must include original IP-header + 64bits of packet body.
 		const int ip4ReplyLength = ip4Header->headerLength4*4 + 64/8;
@@ -372,7 +673,7 @@ Fifo *ip4Datagram) {
 		replyIcmpHeader.checksum = ~fifoCalculateOnesComplementSumBigEndian(&icmpReader);
 		fifoPutnetIcmpHeader(&rewriter,&replyIcmpHeader);
 
-		enetIoFifoWriteEnd();
+		txEnd(replyFifo);
 		return PACKET_HANDLED;
 	}
 	else return PACKET_RETRY;	// try later
@@ -447,8 +748,8 @@ InputPacketStatus handleEthernetIp4Packet(Fifo *fifo, const EthernetHeader *ethe
 }
 
 InputPacketStatus ethernetArpRequest(const Ip4Address* ip4Address) {
-	if (enetIoFifoCanWrite()) {
-		Fifo *writer = enetIoFifoWriteBegin();
+	Fifo *writer = txBegin();
+	if (writer!=0) {
 		const EthernetHeader ethernetHeader = {
 			.destinationAddress = ETHERNET_ADDRESS_BROADCAST,
 			.sourceAddress = ip4NetworkConfiguration->ethernetAddress,
@@ -468,7 +769,7 @@ InputPacketStatus ethernetArpRequest(const Ip4Address* ip4Address) {
 		fifoPutnetEthernetHeader(writer,&ethernetHeader);
 		fifoPutnetEthernetArpHeader(writer,&ethernetArpHeader);
 		// no message body
-		enetIoFifoWriteEnd();
+		txEnd(writer);
 		return PACKET_HANDLED;
 	}
 	else return PACKET_RETRY;
@@ -486,10 +787,10 @@ InputPacketStatus handleEthernetArpPacket(Fifo *fifo, const EthernetHeader *ethe
 			sysTickTimeMs
 		);
 		DEBUG( fifoPrintLn(&out); )
+		Fifo *response;
 		if (ip4IsEqual(&arpHeader.destinationIp4Address,&ip4NetworkConfiguration->ip4Address)
 		&& arpHeader.operation==1	// request
-		&& enetIoFifoCanWrite()) {
-			Fifo *response = enetIoFifoWriteBegin();
+		&& (response = txBegin())!=0) {
 			const EthernetHeader responseEthernetHeader = {
 				.destinationAddress = ethernetHeader->sourceAddress,
 				.sourceAddress = ip4NetworkConfiguration->ethernetAddress,
@@ -504,7 +805,7 @@ InputPacketStatus handleEthernetArpPacket(Fifo *fifo, const EthernetHeader *ethe
 			fifoPutnetEthernetHeader(response,&responseEthernetHeader);
 			fifoPutnetEthernetArpHeader(response,&arpHeader);
 			fifoPrintString(response,"FC200 rules!");
-			enetIoFifoWriteEnd();
+			txEnd(response);
 			DEBUG(
 				fifoPrintString(&out,"Sent back: ");
 				fifoPrintEthernetArpHeader(&out,&arpHeader);
@@ -552,3 +853,21 @@ InputPacketStatus handleEthernetPacket(Fifo *fifo) {
 	}
 }
 
+int handleEthernetPackets(int n) {
+	Fifo *frames[IP_STACK_BURST];
+	const int received = enetIoRxBurst(frames,MIN(n,IP_STACK_BURST));
+
+	inBurst = true;
+	int handled = 0;
+	for ( ; handled<received; handled++) {
+		burstFrame = frames[handled];
+		burstFrameWhole = *frames[handled];
+		if (handleEthernetPacket(frames[handled])==PACKET_RETRY) break;	// this one and all following again
+	}
+	burstFrame = 0;
+	inBurst = false;
+
+	enetIoTxDoorbell();		// before releasing frames queued in place
+	enetIoRxRelease(handled);
+	return handled;
+}
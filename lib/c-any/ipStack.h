@@ -5,7 +5,8 @@
  * @brief A light IP4 on top of Ethernet, interface enetIoFifo.h .
  *
  * This IP stack processes an incoming packet using predefined handlers plus user-supplied callback handlers.
- * Implemented protocols are: ARP, ICMP echo, ICMP port unreachable, UDP.
+ * Implemented protocols are: ARP, ICMP echo, ICMP port unreachable, UDP. TCP connections are handled by ipStackTcp.h,
+ * if used. Otherwise TCP segments are passed to the user-supplied handler.
  */
 
 #include <ethernet.h>
@@ -16,6 +17,11 @@
 #include <ip4Tcp.h>
 #include <fifo.h>
 #include <enetIoFifo.h>		// not strictly neccessary at this point
+#include <enetIoRing.h>
+
+enum {
+	IP_STACK_BURST	=16,		///< maximum number of frames handled by handleEthernetPackets()
+};
 
 extern volatile int sysTickTimeMs;	///< time base for ARP
 
@@ -44,11 +50,10 @@ typedef enum {
  */
 typedef bool UdpHandler(Fifo *input, int port, const Ip4SocketAddress *inputAddress);
 
-/** A function that handles TCP processing. This function must be supplied by the user.
- * @param input incoming TCP datagram message body. Possibly only a fragment of the body.
- * @param inputAddress the sender's IP-address and port
- * @param port the TCP port targeted
- * @return true, if the packet was processed by the handler, false otherwise (resulting in a port unavailable message.
+/** A function that handles raw TCP segments, if the TCP engine (ipStackTcp.h) is not used.
+ * @param input incoming TCP segment body.
+ * @param tcpHeader the TCP header of the segment.
+ * @return true, if the segment was processed by the handler, false otherwise.
  */
 typedef bool TcpHandler(Fifo *input, const TcpHeader *tcpHeader);
 
@@ -80,16 +85,88 @@ void ipStackInit(
 Fifo* udpSendBegin(const Ip4SocketAddress *destination, Uint16 sourcePort);
 
 /** Allows the current contents of the fifo to be transmitted.
- * The network device is allowed to transmit fragments of the UDP packet.
+ * The network device is allowed to transmit fragments of the UDP packet. The checksum of the payload written since
+ * the last commit is accumulated here, while the data is still in the cache.
  * @param fifo the UDP buffer.
  */
 void udpSendCommit(Fifo *fifo);
 
-/** Marks the end of the UDP packet. The Fifo contents will be sent as soon as possible.
+/** Writes payload and accumulates its checksum in the same pass. This can be mixed with other writes to the fifo.
+ * @param fifo the UDP buffer.
+ * @param data the payload.
+ * @param n the number of bytes.
+ * @return true, if the data fitted, false otherwise (and nothing written).
+ */
+bool udpSendWrite(Fifo *fifo, const void *data, size_t n);
+
+/** Marks the end of the UDP packet. The Fifo contents will be sent as soon as possible. Only the payload not yet
+ * committed is read for the checksum, the headers are updated in place.
  * @param fifo the UDP buffer.
  */
 void udpSendEnd(Fifo *fifo);
 
+enum {
+	UDP_FLOW_HEADER_SIZE	=sizeof(EthernetHeader) + sizeof(Ip4Header) + sizeof(UdpHeader),
+	UDP_FLOW_PAYLOAD_MAX	=1500 - sizeof(Ip4Header) - sizeof(UdpHeader),	///< largest payload of an unfragmented
+										///< datagram on Ethernet
+};
+
+/** Datagrams from one local port to one destination. The Ethernet, IP4 and UDP headers are built once into a template,
+ * using the ARP cache entry of the next hop. The template is valid as long as that entry is neither updated nor
+ * expired, then it is built again. Initialize with udpFlowInit().
+ */
+typedef struct {
+	Ip4SocketAddress		destination;
+	Uint16				sourcePort;
+	bool				valid;		///< the template is built
+	const EthernetArpCacheEntry	*arpEntry;	///< the next hop, 0 for broadcasts
+	int				arpTime;	///< the installation time of arpEntry, when the template was built
+	Uint16				sumBase;	///< UDP checksum: pseudo header without length and the ports
+	Uint8				header[UDP_FLOW_HEADER_SIZE];	///< network order, lengths and checksums of an
+									///< empty datagram
+} UdpFlow;
+
+/** The payload of one datagram of a flow.
+ */
+typedef struct {
+	const void	*data;
+	size_t		size;
+} UdpFlowPayload;
+
+/** Initializes a flow. The template is built, when the first datagram is sent.
+ * @param flow the flow.
+ * @param destination receiver address.
+ * @param sourcePort the port we're sending from.
+ */
+void udpFlowInit(UdpFlow *flow, const Ip4SocketAddress *destination, Uint16 sourcePort);
+
+/** Sends datagrams of a flow with a single doorbell (or at the end of the current burst). The headers are copied from
+ * the template, only the lengths and checksums are patched.
+ * @param flow the flow.
+ * @param payloads the contents of the datagrams.
+ * @param n the number of datagrams.
+ * @return the number of datagrams sent, less than n if transmit buffers ran out. 0 also, if the next hop is not in
+ *   the ARP cache; an ARP request is sent in this case. -1 without sending anything, if a payload exceeds
+ *   UDP_FLOW_PAYLOAD_MAX, because it would never fit into a transmit buffer.
+ */
+int udpFlowSend(UdpFlow *flow, const UdpFlowPayload *payloads, int n);
+
+/** Prepares transmission of an IP4 packet of a protocol implemented outside this module, like TCP. The Ethernet and
+ * IP4 headers are written, the payload follows.
+ * @param destination receiver address.
+ * @param protocol the IP4 protocol number.
+ * @param ip4Header the IP4 header written, required by ip4SendEnd() and for pseudo-headers.
+ * @return a Fifo for writing the payload, 0 if no buffer is available or the destination is not in the ARP cache.
+ *   In the latter case an ARP request is sent.
+ */
+Fifo* ip4SendBegin(const Ip4Address *destination, Uint8 protocol, Ip4Header *ip4Header);
+
+/** Sets the length and checksum of the IP4 header and sends the packet.
+ * @param fifo the buffer provided by ip4SendBegin(), containing the whole payload.
+ * @param ip4Header the IP4 header from ip4SendBegin().
+ */
+void ip4SendEnd(Fifo *fifo, Ip4Header *ip4Header);
+
 /** Sends an ARP request to resolve an IP-address.
  * @param ip4Address the IP address we're searching an Ethernet address for.
  * @return true if request was sent, false otherwise.
@@ -110,5 +187,13 @@ const EthernetAddress* destinationEthernetAddress(const Ip4Address *ip4Address);
  */
 InputPacketStatus handleEthernetPacket(Fifo *ethernetPacket);
 
+/** Receives a burst of frames from the driver (enetIoRing.h), handles them and sends all replies with a single
+ * doorbell. Echo replies are built in place of the requests. Frames, that cannot be handled now (PACKET_RETRY), are
+ * not released and will be received again.
+ * @param n the maximum number of frames, up to IP_STACK_BURST.
+ * @return the number of frames handled.
+ */
+int handleEthernetPackets(int n);
+
 #endif
 
@@ -0,0 +1,611 @@
+#include <ipStackTcp.h>
+#include <onesComplement.h>
+#include <simpleMath.h>
+#include <macros.h>
+
+enum {
+	TCP_FIN		=1<<0,
+	TCP_SYN		=1<<1,
+	TCP_RST		=1<<2,
+	TCP_PSH		=1<<3,
+	TCP_ACK		=1<<4,
+
+	TCP_MSS_ETHERNET	=1460,
+	TCP_MSS_DEFAULT		=536,		///< if the peer does not tell its MSS
+	TCP_RTO_INITIAL_MS	=1000,
+	TCP_RTO_MIN_MS		=200,
+	TCP_RTO_MAX_MS		=60000,
+};
+
+static TcpConfiguration *tcp = 0;
+
+static inline bool sequenceBefore(Uint32 a, Uint32 b) {
+	return (Int32)(a-b) < 0;
+}
+
+static inline bool timeReached(int timeMs) {
+	return (int)((unsigned)sysTickTimeMs - (unsigned)timeMs) >= 0;
+}
+
+static void timerStart(TcpConnection *c, int durationMs) {
+	c->timerActive = true;
+	c->timerMs = sysTickTimeMs + durationMs;
+}
+
+/** Initial send sequence number: a clock of 4us (RFC 793) plus an offset for connections in the same ms.
+ */
+static Uint32 initialSequence(void) {
+	static Uint32 offset;
+	offset += 64000;
+	return (Uint32)sysTickTimeMs*250 + offset;
+}
+
+void tcpInit(TcpConfiguration *configuration) {
+	if (configuration->mss==0) configuration->mss = TCP_MSS_ETHERNET;
+	if (configuration->receiveWindow==0) configuration->receiveWindow = 4*configuration->mss;
+	if (configuration->sendWindow==0) configuration->sendWindow = 4*TCP_MSS_ETHERNET;
+	if (configuration->delayedAckMs==0) configuration->delayedAckMs = 100;
+	if (configuration->timeWaitMs==0) configuration->timeWaitMs = 1000;
+	if (configuration->retries==0) configuration->retries = 8;
+	tcp = configuration;
+}
+
+void tcpConnectionInit(TcpConnection *c, void *sendBuffer, size_t size, TcpEventHandler *handler) {
+	*c = (TcpConnection) {
+		.state = TCP_CLOSED,
+		.handler = handler,
+	};
+	fifoInitWrite(&c->send,sendBuffer,size);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// segment output
+
+/** Sends a segment. The checksum is calculated over the segment in the transmit buffer, right after copying the data.
+ * @param remote the peer.
+ * @param localPort our port.
+ * @param flags TCP_xxx flags. SYN segments carry our MSS option.
+ * @param data the data to send, at its read position. May be 0 if n==0.
+ * @param n the number of bytes to send.
+ * @return true, if the segment was sent. False if no buffer was available or the peer is not in the ARP cache.
+ */
+static bool segmentSend(const Ip4SocketAddress *remote, Uint16 localPort, Uint32 sequence, Uint32 acknowledge,
+int flags, const Fifo *data, size_t n) {
+	TcpOptions options = {};
+	int optionsSize = 0;
+	if (flags & TCP_SYN) {
+		options.uint8s[0] = TCP_OPTION_MSS;
+		options.uint8s[1] = 4;
+		options.uint8s[2] = tcp->mss >> 8;
+		options.uint8s[3] = tcp->mss & 0xFF;
+		optionsSize = 4;
+	}
+	TcpHeader header = {
+		.source = localPort,
+		.destination = remote->port,
+		.sequence = sequence,
+		.acknowledge = flags & TCP_ACK ? acknowledge : 0,
+		.offsetAndFlags = (sizeof header + optionsSize)/4 << 12 | flags,
+		.window = flags & TCP_RST ? 0 : tcp->receiveWindow,
+		.checksum = 0,
+		.urgentPointer = 0,
+	};
+
+	Ip4Header ip4Header;
+	Fifo *frame = ip4SendBegin(&remote->ip4Address,IP_PROTOCOL_TCP,&ip4Header);
+	if (frame==0) return false;
+	if (fifoCanWrite(frame) < sizeof header + optionsSize + n) return false;	// buffer is used again later
+
+	Fifo segment = *frame;
+	segment.rTotal = frame->wTotal;		// empty
+	segment.rPos = frame->wPos;
+
+	fifoPutnetTcpHeader(frame,&header,&options);
+	if (n>0) {
+		Fifo reader = *data;
+		for (size_t left = n; left>0; ) {
+			const size_t linear = MIN(left,fifoCanReadLinear(&reader));
+			fifoWriteN(frame,fifoReadLinear(&reader),linear);
+			fifoSkipRead(&reader,linear);
+			left -= linear;
+		}
+	}
+	fifoCopyWritePosition(&segment,frame);
+
+	// pseudo header, TCP header and data, still in the cache
+	OnesComplementSum sum = {};
+	onesComplementSumAdd(&sum,&ip4Header.sourceAddress,sizeof(Ip4Address));
+	onesComplementSumAdd(&sum,&ip4Header.destinationAddress,sizeof(Ip4Address));
+	onesComplementSumAdd16(&sum,IP_PROTOCOL_TCP);
+	onesComplementSumAdd16(&sum,fifoCanRead(&segment));
+	Fifo rewriter;
+	fifoInitRewrite(&rewriter,&segment);
+	fifoOnesComplementSumAdd(&sum,&segment);
+	header.checksum = ~onesComplementSumResult(&sum);
+	fifoPutnetTcpHeader(&rewriter,&header,&options);
+
+	ip4SendEnd(frame,&ip4Header);
+	return true;
+}
+
+/** Sends a segment of a connection.
+ * @param flags TCP_xxx flags.
+ * @param sequence the sequence number of the segment, which is also the sequence number of the data.
+ * @param n the number of bytes to send from the send Fifo.
+ */
+static bool connectionSend(TcpConnection *c, int flags, Uint32 sequence, size_t n) {
+	Fifo data = c->send;
+	if (n>0) fifoSkipRead(&data,sequence - c->sendUnacknowledged);
+	if (segmentSend(&c->remote,c->localPort,sequence,c->receiveNext,flags,&data,n)) {
+		if (flags & TCP_ACK) c->ackPending = 0;
+		return true;
+	}
+	else return false;
+}
+
+static void ackSend(TcpConnection *c) {
+	connectionSend(c,TCP_ACK,c->sendNext,0);
+}
+
+/** Sends (or resends) our SYN and starts the retransmission timer, also if sending failed.
+ */
+static void synSend(TcpConnection *c) {
+	connectionSend(c,TCP_SYN | (c->state==TCP_SYN_RECEIVED ? TCP_ACK : 0),c->sendUnacknowledged,0);
+	timerStart(c,c->rtoMs);
+}
+
+/** Sends data and FIN as far as the windows allow.
+ */
+static void tcpOutput(TcpConnection *c) {
+	if (c->state!=TCP_ESTABLISHED && c->state!=TCP_CLOSE_WAIT && c->state!=TCP_FIN_WAIT_1
+	&& c->state!=TCP_CLOSING && c->state!=TCP_LAST_ACK) return;
+
+	const Uint32 window = MIN(c->sendWindow,tcp->sendWindow);
+	for (;;) {
+		const Uint32 dataEnd = c->sendUnacknowledged + fifoCanRead(&c->send);
+		if (sequenceBefore(dataEnd,c->sendNext)) break;		// FIN sent already
+		const Uint32 unsent = dataEnd - c->sendNext;
+		const Uint32 inFlight = c->sendNext - c->sendUnacknowledged;
+		Uint32 n = MIN(unsent,c->mss);
+		if (inFlight+n > window) n = window>inFlight ? window-inFlight : 0;
+		const bool fin = c->finQueued && n==unsent;
+		if (n==0 && !fin) {
+			if (unsent>0 && inFlight==0 && !c->timerActive) timerStart(c,c->rtoMs);	// probe the window later
+			break;
+		}
+
+		if (!connectionSend(c,TCP_ACK | (n==unsent ? TCP_PSH : 0) | (fin ? TCP_FIN : 0),c->sendNext,n)) break;
+		if (!c->rttActive) {
+			c->rttActive = true;
+			c->rttSequence = c->sendNext + n + fin;
+			c->rttStartMs = sysTickTimeMs;
+		}
+		c->sendNext += n + fin;
+		if (sequenceBefore(c->sendMax,c->sendNext)) c->sendMax = c->sendNext;
+		if (!c->timerActive) timerStart(c,c->rtoMs);
+	}
+}
+
+/** Answers a segment, that belongs to no connection (RFC 793, page 36).
+ */
+static void resetReply(const Ip4Header *ip4Header, const TcpHeader *header, size_t length) {
+	if (header->rst) return;
+
+	const Ip4SocketAddress remote = {
+		.ip4Address = ip4Header->sourceAddress,
+		.port = header->source,
+	};
+	if (header->ack) segmentSend(&remote,header->destination,header->acknowledge,0,TCP_RST,0,0);
+	else segmentSend(&remote,header->destination,0,header->sequence + length + header->syn + header->fin,
+		TCP_RST | TCP_ACK,0,0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// state changes
+
+/** Frees a control block or lets it listen again.
+ */
+static void connectionClosed(TcpConnection *c, TcpEvent event) {
+	c->state = c->passive ? TCP_LISTEN : TCP_CLOSED;
+	c->timerActive = false;
+	c->ackPending = 0;
+	fifoReset(&c->send);
+	c->handler(c,event,0);
+}
+
+/** Prepares a control block for a new connection.
+ */
+static void connectionOpen(TcpConnection *c, TcpState state, const Ip4SocketAddress *remote) {
+	const Uint32 sequence = initialSequence();
+	c->state = state;
+	c->remote = *remote;
+	c->sendUnacknowledged = sequence;
+	c->sendNext = sequence+1;		// SYN
+	c->sendMax = sequence+1;
+	c->sendWindow = 0;
+	c->mss = TCP_MSS_DEFAULT;
+	c->finQueued = false;
+	c->ackPending = 0;
+	c->timerActive = false;
+	c->rtoMs = TCP_RTO_INITIAL_MS;
+	c->srttMs8 = 0;
+	c->rttvarMs4 = 0;
+	c->rttActive = false;
+	c->retries = 0;
+	fifoReset(&c->send);
+}
+
+static bool stateIsConnected(TcpState state) {
+	return state!=TCP_CLOSED && state!=TCP_LISTEN && state!=TCP_SYN_SENT;
+}
+
+bool tcpListen(TcpConnection *c, Uint16 port) {
+	if (c->state==TCP_CLOSED) {
+		c->state = TCP_LISTEN;
+		c->passive = true;
+		c->localPort = port;
+		return true;
+	}
+	else return false;
+}
+
+bool tcpConnect(TcpConnection *c, const Ip4SocketAddress *remote, Uint16 localPort) {
+	if (c->state==TCP_CLOSED) {
+		c->passive = false;
+		c->localPort = localPort;
+		connectionOpen(c,TCP_SYN_SENT,remote);
+		synSend(c);
+		return true;
+	}
+	else return false;
+}
+
+void tcpSend(TcpConnection *c) {
+	tcpOutput(c);
+}
+
+void tcpClose(TcpConnection *c) {
+	switch(c->state) {
+		case TCP_LISTEN:
+		case TCP_SYN_SENT:
+			c->passive = false;
+			c->state = TCP_CLOSED;
+			c->timerActive = false;
+			break;
+		case TCP_SYN_RECEIVED:
+			tcpAbort(c);
+			break;
+		case TCP_ESTABLISHED:
+			c->finQueued = true;
+			c->state = TCP_FIN_WAIT_1;
+			tcpOutput(c);
+			break;
+		case TCP_CLOSE_WAIT:
+			c->finQueued = true;
+			c->state = TCP_LAST_ACK;
+			tcpOutput(c);
+			break;
+		default: ;	// closing already
+	}
+}
+
+void tcpAbort(TcpConnection *c) {
+	if (stateIsConnected(c->state)) connectionSend(c,TCP_RST,c->sendNext,0);
+	if (c->state==TCP_LISTEN) c->passive = false;
+	c->state = c->passive ? TCP_LISTEN : TCP_CLOSED;
+	c->timerActive = false;
+	c->ackPending = 0;
+	fifoReset(&c->send);
+}
+
+/** Updates the retransmission timeout from a round trip time sample (RFC 6298).
+ */
+static void rttUpdate(TcpConnection *c, int rttMs) {
+	if (rttMs<1) rttMs = 1;
+	if (c->srttMs8==0) {
+		c->srttMs8 = rttMs*8;
+		c->rttvarMs4 = rttMs*2;
+	}
+	else {
+		const int delta = rttMs - c->srttMs8/8;
+		c->srttMs8 += delta;
+		c->rttvarMs4 += (delta<0 ? -delta : delta) - c->rttvarMs4/4;
+	}
+	c->rtoMs = MAX(TCP_RTO_MIN_MS,MIN(TCP_RTO_MAX_MS,c->srttMs8/8 + c->rttvarMs4));
+}
+
+/** Processes an ACK of new data or of our FIN.
+ * @return false, if the connection is closed now.
+ */
+static bool acknowledged(TcpConnection *c, Uint32 acknowledge) {
+	const Uint32 queued = fifoCanRead(&c->send);
+	const Uint32 acked = acknowledge - c->sendUnacknowledged;
+	const bool finAcked = acked > queued;
+	fifoSkipRead(&c->send,acked - finAcked);
+	c->sendUnacknowledged = acknowledge;
+	if (sequenceBefore(c->sendNext,acknowledge)) c->sendNext = acknowledge;
+	c->retries = 0;
+
+	if (c->rttActive && !sequenceBefore(acknowledge,c->rttSequence)) {
+		rttUpdate(c,sysTickTimeMs - c->rttStartMs);
+		c->rttActive = false;
+	}
+	if (c->sendUnacknowledged==c->sendMax) c->timerActive = false;
+	else timerStart(c,c->rtoMs);
+
+	if (acked - finAcked > 0) {
+		c->handler(c,TCP_EVENT_SENT,0);
+		if (!stateIsConnected(c->state)) return false;
+	}
+
+	if (finAcked) switch(c->state) {
+		case TCP_FIN_WAIT_1:	c->state = TCP_FIN_WAIT_2; break;
+		case TCP_CLOSING:	c->state = TCP_TIME_WAIT;
+					timerStart(c,tcp->timeWaitMs);
+					break;
+		case TCP_LAST_ACK:	connectionClosed(c,TCP_EVENT_CLOSED);
+					return false;
+		default: ;
+	}
+	return true;
+}
+
+/** Processes the peer's FIN, after all data before it.
+ */
+static void finReceived(TcpConnection *c) {
+	c->receiveNext++;
+	ackSend(c);
+	switch(c->state) {
+		case TCP_ESTABLISHED:	c->state = TCP_CLOSE_WAIT; break;
+		case TCP_FIN_WAIT_1:	c->state = TCP_CLOSING; break;
+		case TCP_FIN_WAIT_2:	c->state = TCP_TIME_WAIT;
+					timerStart(c,tcp->timeWaitMs);
+					break;
+		default: ;
+	}
+	c->handler(c,TCP_EVENT_PEER_CLOSED,0);
+}
+
+static bool stateReceives(TcpState state) {
+	return state==TCP_ESTABLISHED || state==TCP_FIN_WAIT_1 || state==TCP_FIN_WAIT_2;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// segment input
+
+/** Reads the MSS option.
+ * @return the MSS announced by the peer or the default MSS.
+ */
+static int optionMss(const TcpOptions *options, int optionsSize) {
+	const Uint8 *o = options->uint8s;
+	for (int i=0; i<optionsSize && o[i]!=TCP_OPTION_EOL; ) {
+		if (o[i]==TCP_OPTION_NOP) i++;
+		else if (i+1<optionsSize && o[i+1]>=2) {
+			if (o[i]==TCP_OPTION_MSS && o[i+1]==4 && i+4<=optionsSize) return o[i+2]<<8 | o[i+3];
+			i += o[i+1];
+		}
+		else break;
+	}
+	return TCP_MSS_DEFAULT;
+}
+
+static InputPacketStatus listenSegment(TcpConnection *c, const Ip4Header *ip4Header, const TcpHeader *header,
+int mss, size_t length) {
+	if (header->rst) return PACKET_DISCARDED;
+	if (header->ack || !header->syn) {
+		resetReply(ip4Header,header,length);
+		return PACKET_HANDLED;
+	}
+
+	const Ip4SocketAddress remote = {
+		.ip4Address = ip4Header->sourceAddress,
+		.port = header->source,
+	};
+	connectionOpen(c,TCP_SYN_RECEIVED,&remote);
+	c->receiveNext = header->sequence+1;
+	c->sendWindow = header->window;
+	c->mss = MIN(mss,TCP_MSS_ETHERNET);
+	synSend(c);
+	return PACKET_HANDLED;
+}
+
+static InputPacketStatus synSentSegment(TcpConnection *c, const Ip4Header *ip4Header, const TcpHeader *header,
+int mss, size_t length) {
+	if (header->ack && header->acknowledge!=c->sendMax) {
+		resetReply(ip4Header,header,length);
+		return PACKET_HANDLED;
+	}
+	if (header->rst) {
+		if (header->ack) connectionClosed(c,TCP_EVENT_ABORTED);	// refused
+		return PACKET_HANDLED;
+	}
+	if (!header->syn || !header->ack) return PACKET_DISCARDED;	// simultaneous open not supported
+
+	c->receiveNext = header->sequence+1;
+	c->sendUnacknowledged = header->acknowledge;
+	c->sendWindow = header->window;
+	c->mss = MIN(mss,TCP_MSS_ETHERNET);
+	c->timerActive = false;
+	c->retries = 0;
+	c->state = TCP_ESTABLISHED;
+	ackSend(c);
+	c->handler(c,TCP_EVENT_CONNECTED,0);
+	tcpOutput(c);
+	return PACKET_HANDLED;
+}
+
+/** Processes a segment in the synchronized states (RFC 793, page 69), simplified.
+ * @param payload the data of the segment.
+ */
+static InputPacketStatus synchronizedSegment(TcpConnection *c, const TcpHeader *header, Fifo *payload) {
+	if (header->rst) {
+		if (header->sequence==c->receiveNext) connectionClosed(c,TCP_EVENT_ABORTED);
+		return PACKET_HANDLED;
+	}
+	if (header->syn) {
+		if (c->state==TCP_SYN_RECEIVED && header->sequence+1==c->receiveNext) synSend(c);	// SYN-ACK lost
+		else ackSend(c);	// challenge ACK (RFC 5961)
+		return PACKET_HANDLED;
+	}
+	if (!header->ack) return PACKET_DISCARDED;
+
+	// ACK
+	if (c->state==TCP_SYN_RECEIVED) {
+		if (header->acknowledge!=c->sendMax) return PACKET_DISCARDED;
+		c->sendUnacknowledged = header->acknowledge;
+		c->timerActive = false;
+		c->retries = 0;
+		c->state = TCP_ESTABLISHED;
+		c->handler(c,TCP_EVENT_CONNECTED,0);
+		if (c->state!=TCP_ESTABLISHED) return PACKET_HANDLED;
+	}
+	else if (sequenceBefore(c->sendMax,header->acknowledge)) {	// acknowledges data not sent yet
+		ackSend(c);
+		return PACKET_HANDLED;
+	}
+	else if (sequenceBefore(c->sendUnacknowledged,header->acknowledge)
+	&& !acknowledged(c,header->acknowledge)) return PACKET_HANDLED;
+	if (header->acknowledge==c->sendUnacknowledged) c->sendWindow = header->window;
+
+	// data and FIN
+	Uint32 sequence = header->sequence;
+	size_t length = fifoCanRead(payload);
+	if (stateReceives(c->state) && (length>0 || header->fin)) {
+		// skip data received before
+		const Uint32 old = c->receiveNext - sequence;
+		if (sequenceBefore(sequence,c->receiveNext) && old<=length) {
+			fifoSkipRead(payload,old);
+			sequence += old;
+			length -= old;
+		}
+		if (sequence!=c->receiveNext) {		// out of order or duplicate
+			ackSend(c);
+			return PACKET_HANDLED;
+		}
+
+		size_t consumed = 0;
+		if (length>0) {
+			c->handler(c,TCP_EVENT_RECEIVED,payload);
+			if (!stateReceives(c->state)) return PACKET_HANDLED;
+			consumed = length - fifoCanRead(payload);
+			if (c->ackPending==0) c->ackDueMs = sysTickTimeMs + tcp->delayedAckMs;
+			c->ackPending += consumed;
+			c->receiveNext += consumed;
+		}
+		if (consumed<length) ackSend(c);	// the rest is sent again by the peer
+		else if (header->fin) finReceived(c);
+	}
+	else if (header->fin) {
+		ackSend(c);	// FIN retransmitted
+		if (c->state==TCP_TIME_WAIT) timerStart(c,tcp->timeWaitMs);
+	}
+
+	tcpOutput(c);	// carries the ACK, if possible
+	if (c->ackPending >= 2*tcp->mss) ackSend(c);
+	return PACKET_HANDLED;
+}
+
+/** Finds the connection of a segment, a listening one if no other matches.
+ */
+static TcpConnection* connectionFind(const Ip4Address *remote, Uint16 remotePort, Uint16 localPort) {
+	TcpConnection *listener = 0;
+	for (int i=0; i<tcp->elements; i++) {
+		TcpConnection *c = &tcp->table[i];
+		if (c->state==TCP_CLOSED || c->localPort!=localPort) continue;
+		if (c->state==TCP_LISTEN) {
+			if (listener==0) listener = c;
+		}
+		else if (c->remote.port==remotePort && ip4IsEqual(&c->remote.ip4Address,remote)) return c;
+	}
+	return listener;
+}
+
+static bool checksumValid(const Fifo *segment, const Ip4Header *ip4Header) {
+	Fifo reader = *segment;
+	OnesComplementSum sum = {};
+	onesComplementSumAdd(&sum,&ip4Header->sourceAddress,sizeof(Ip4Address));
+	onesComplementSumAdd(&sum,&ip4Header->destinationAddress,sizeof(Ip4Address));
+	onesComplementSumAdd16(&sum,IP_PROTOCOL_TCP);
+	onesComplementSumAdd16(&sum,fifoCanRead(&reader));
+	fifoOnesComplementSumAdd(&sum,&reader);
+	return onesComplementSumResult(&sum)==0xFFFF;
+}
+
+InputPacketStatus tcpHandleSegment(Fifo *segment, const Ip4Header *ip4Header) {
+	if (tcp==0) return PACKET_PENDING;
+	if (!checksumValid(segment,ip4Header)) return PACKET_DISCARDED;
+
+	TcpHeader header;
+	TcpOptions options;
+	if (!fifoGetnetTcpHeader(segment,&header,&options)) return PACKET_DISCARDED;
+	const int optionsSize = header.dataOffset4*4 - sizeof header;
+	const size_t length = fifoCanRead(segment);
+
+	const Ip4Address sourceAddress = ip4Header->sourceAddress;	// not aligned in the packed header
+	TcpConnection *c = connectionFind(&sourceAddress,header.source,header.destination);
+	if (c==0) {
+		resetReply(ip4Header,&header,length);
+		return PACKET_HANDLED;
+	}
+	switch(c->state) {
+		case TCP_LISTEN:	return listenSegment(c,ip4Header,&header,optionMss(&options,optionsSize),length);
+		case TCP_SYN_SENT:	return synSentSegment(c,ip4Header,&header,optionMss(&options,optionsSize),length);
+		default:		return synchronizedSegment(c,&header,segment);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// timers
+
+/** Sends one byte beyond a zero window, to learn when the window opens again. sendNext is not advanced, so the byte
+ * is sent again with the following data as soon as the window opens, even if the probe was dropped.
+ */
+static void windowProbe(TcpConnection *c) {
+	const Uint32 dataEnd = c->sendUnacknowledged + fifoCanRead(&c->send);
+	if (c->sendWindow==0 && sequenceBefore(c->sendNext,dataEnd) && connectionSend(c,TCP_ACK,c->sendNext,1)) {
+		if (sequenceBefore(c->sendMax,c->sendNext+1)) c->sendMax = c->sendNext+1;
+		timerStart(c,c->rtoMs);
+	}
+}
+
+static void timerExpired(TcpConnection *c) {
+	if (c->state==TCP_TIME_WAIT) {
+		connectionClosed(c,TCP_EVENT_CLOSED);
+		return;
+	}
+	if (c->sendUnacknowledged!=c->sendMax) {	// retransmission
+		const bool zeroWindow = stateIsConnected(c->state) && c->state!=TCP_SYN_RECEIVED && c->sendWindow==0;
+		if (!zeroWindow && ++c->retries > tcp->retries) {	// a peer announcing a zero window is alive
+			tcpAbort(c);
+			c->handler(c,TCP_EVENT_ABORTED,0);
+			return;
+		}
+		c->rtoMs = MIN(2*c->rtoMs,TCP_RTO_MAX_MS);
+		c->rttActive = false;		// Karn's algorithm
+		if (c->state==TCP_SYN_SENT || c->state==TCP_SYN_RECEIVED) synSend(c);
+		else {
+			c->sendNext = c->sendUnacknowledged;	// go back N
+			if (zeroWindow) windowProbe(c);		// tcpOutput() sends nothing into a zero window
+			if (!c->timerActive) timerStart(c,c->rtoMs);
+		}
+	}
+	else windowProbe(c);
+}
+
+void tcpPoll(void) {
+	if (tcp==0) return;
+
+	for (int i=0; i<tcp->elements; i++) {
+		TcpConnection *c = &tcp->table[i];
+		if (c->state==TCP_CLOSED || c->state==TCP_LISTEN) continue;
+
+		if (c->timerActive && timeReached(c->timerMs)) {
+			c->timerActive = false;
+			timerExpired(c);
+			if (!stateIsConnected(c->state) && c->state!=TCP_SYN_SENT) continue;
+		}
+		if (c->ackPending>0 && timeReached(c->ackDueMs)) ackSend(c);
+		tcpOutput(c);
+	}
+}
+
@@ -0,0 +1,159 @@
+#ifndef ipStackTcp_h
+#define ipStackTcp_h
+
+/** @file
+ * @brief A minimal TCP engine on top of ipStack.h .
+ *
+ * A fixed number of connection control blocks is provided by the user. Each of them is used either for an active open
+ * (tcpConnect()) or for a passive one (tcpListen()). A listening control block accepts one connection at a time and
+ * returns to listening when that connection is closed, so more listening blocks on the same port allow more
+ * concurrent connections.
+ *
+ * Received data is passed to the application in the received frame, without copying. Data to send is written into
+ * the connection's send Fifo, where it stays until acknowledged. Several segments can be in flight, up to the send
+ * window. Retransmission is go-back-N with a timeout estimated from the round trip time (RFC 6298). ACKs are delayed,
+ * except for every second full segment.
+ *
+ * Not implemented: out of order reassembly (such segments are dropped and re-ACKed), urgent data, window scaling,
+ * selective ACKs, congestion control (the send window is a fixed limit).
+ *
+ * Timers are based on sysTickTimeMs. tcpPoll() must be called regularly, every few milliseconds.
+ */
+
+#include <ipStack.h>
+
+typedef enum {
+	TCP_CLOSED,
+	TCP_LISTEN,
+	TCP_SYN_SENT,
+	TCP_SYN_RECEIVED,
+	TCP_ESTABLISHED,
+	TCP_FIN_WAIT_1,
+	TCP_FIN_WAIT_2,
+	TCP_CLOSE_WAIT,
+	TCP_CLOSING,
+	TCP_LAST_ACK,
+	TCP_TIME_WAIT,
+} TcpState;
+
+typedef enum {
+	TCP_EVENT_CONNECTED,		///< the handshake completed, data can be sent.
+	TCP_EVENT_RECEIVED,		///< data was received.
+	TCP_EVENT_SENT,			///< data was acknowledged, there's free space in the send Fifo.
+	TCP_EVENT_PEER_CLOSED,		///< the peer will not send any more data (FIN).
+	TCP_EVENT_CLOSED,		///< the connection is closed after both sides closed it.
+	TCP_EVENT_ABORTED,		///< the connection was reset by the peer or the peer did not respond any more.
+} TcpEvent;
+
+typedef struct TcpConnection TcpConnection;
+
+/** A function that handles the events of a connection. This function must be supplied by the user.
+ * @param connection the connection.
+ * @param event what happened.
+ * @param input the data received for TCP_EVENT_RECEIVED, 0 otherwise. Only the data read by the handler is
+ *   acknowledged, the rest will be sent again by the peer.
+ */
+typedef void TcpEventHandler(TcpConnection *connection, TcpEvent event, Fifo *input);
+
+/** Connection control block. Initialize with tcpConnectionInit(), do not modify the fields except send.
+ */
+struct TcpConnection {
+	TcpState	state;
+	bool		passive;		///< listens again, after the connection was closed
+	TcpEventHandler	*handler;
+	void		*user;			///< free for the application
+	Fifo		send;			///< written by the application, consumed when acknowledged by the peer
+	Uint16		localPort;
+	Ip4SocketAddress remote;
+
+	Uint32		sendUnacknowledged;	///< SND.UNA, the sequence number of the first byte in send
+	Uint32		sendNext;		///< SND.NXT
+	Uint32		sendMax;		///< the highest sequence number sent plus 1, beyond SND.NXT after timeouts
+	Uint16		sendWindow;		///< SND.WND, the peer's window
+	Uint16		mss;			///< the peer's maximum segment size
+	bool		finQueued;		///< close after sending all data
+	Uint32		receiveNext;		///< RCV.NXT
+	Uint32		ackPending;		///< bytes received but not acknowledged yet
+	int		ackDueMs;		///< time of the delayed ACK, if ackPending
+
+	bool		timerActive;
+	int		timerMs;		///< time of retransmission, window probing or end of TIME-WAIT
+	int		rtoMs;			///< retransmission timeout
+	int		srttMs8;		///< smoothed round trip time * 8, 0 before the first measurement
+	int		rttvarMs4;		///< round trip time variation * 4
+	bool		rttActive;		///< a round trip time measurement is running
+	Uint32		rttSequence;		///< the sequence number, whose ACK completes the measurement
+	int		rttStartMs;
+	Uint8		retries;
+};
+
+/** The fixed set of control blocks and the parameters common to all of them.
+ */
+typedef struct {
+	TcpConnection	*table;			///< the control blocks
+	int		elements;		///< the number of control blocks
+	Uint16		mss;			///< the maximum segment size we accept, 0 for 1460
+	Uint16		receiveWindow;		///< the window we announce, 0 for 4 segments
+	Uint16		sendWindow;		///< the maximum number of bytes in flight, 0 for 4 segments
+	Uint16		delayedAckMs;		///< the maximum delay of an ACK, 0 for 100ms
+	Uint16		timeWaitMs;		///< the duration of TIME-WAIT, 0 for 1s
+	Uint8		retries;		///< the number of retransmissions before giving up, 0 for 8
+} TcpConfiguration;
+
+/** Installs the TCP engine. Zero parameters are replaced by their defaults.
+ * @param configuration the control blocks and parameters, which must be available for the whole runtime.
+ */
+void tcpInit(TcpConfiguration *configuration);
+
+/** Initializes a control block.
+ * @param connection a control block of the table of tcpInit().
+ * @param sendBuffer the buffer of the send Fifo.
+ * @param size the size of the send buffer.
+ * @param handler the event handler.
+ */
+void tcpConnectionInit(TcpConnection *connection, void *sendBuffer, size_t size, TcpEventHandler *handler);
+
+/** Waits for a connection on a port.
+ * @param connection a closed control block.
+ * @param port the local port.
+ * @return true, if listening, false if the control block is in use.
+ */
+bool tcpListen(TcpConnection *connection, Uint16 port);
+
+/** Opens a connection. TCP_EVENT_CONNECTED or TCP_EVENT_ABORTED follow.
+ * @param connection a closed control block.
+ * @param remote the peer.
+ * @param localPort our port, which must not be in use by other connections to the same peer.
+ * @return true, if the connection is being established, false if the control block is in use.
+ */
+bool tcpConnect(TcpConnection *connection, const Ip4SocketAddress *remote, Uint16 localPort);
+
+/** Sends the data written into the connection's send Fifo, as far as the window allows. This happens in tcpPoll(),
+ * too, but calling this function saves the delay.
+ * @param connection the connection.
+ */
+void tcpSend(TcpConnection *connection);
+
+/** Closes the sending direction after all data of the send Fifo is sent. Data can be received until the peer closes
+ * its direction, too (TCP_EVENT_CLOSED).
+ * @param connection the connection.
+ */
+void tcpClose(TcpConnection *connection);
+
+/** Resets a connection and discards all data. A listening control block stops listening, unless it was connected.
+ * @param connection the connection.
+ */
+void tcpAbort(TcpConnection *connection);
+
+/** Runs the timers of all connections: delayed ACKs, retransmissions, TIME-WAIT. Sends pending data.
+ */
+void tcpPoll(void);
+
+/** Handles a received segment. Called by ipStack.c .
+ * @param segment the TCP header and data.
+ * @param ip4Header the IP4 header of the segment.
+ * @return the result of processing.
+ */
+InputPacketStatus tcpHandleSegment(Fifo *segment, const Ip4Header *ip4Header);
+
+#endif
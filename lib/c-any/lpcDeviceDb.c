@@ -0,0 +1,483 @@
+/*
+  lpcDeviceDb.c
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <lpcDeviceDb.h>
+#include <string.h>
+#include <crc.h>
+#include <fifoParse.h>
+#include <fifoPrint.h>
+#include <fifoPrintFixedPoint.h>
+#include <int32Pair.h>
+
+static const char lpcDeviceDbMagic[8] = "mxliLPCD";
+
+enum {
+	HASH_SIZE_MIN	=16,
+};
+
+static Uint32 align4 (Uint32 n) {
+	return (n+3) & ~3u;
+}
+
+static Uint32 hashSlot (const LpcDeviceDb *db, Uint32 key) {
+	return key*2654435761u >> 16 & (db->hashSize-1);
+}
+
+static Uint32 hashSize (int nMembers) {
+	Uint32 size = HASH_SIZE_MIN;
+	while (size<2u*nMembers) size *= 2;	// at most half full
+	return size;
+}
+
+static LpcDeviceDbMember* dbMembers (const LpcDeviceDb *db) {
+	return (LpcDeviceDbMember*) ((char*)db + db->offsetMembers);
+}
+
+static LpcFamily* dbFamilies (const LpcDeviceDb *db) {
+	return (LpcFamily*) ((char*)db + db->offsetFamilies);
+}
+
+static LpcIspFamily* dbIspFamilies (const LpcDeviceDb *db) {
+	return (LpcIspFamily*) ((char*)db + db->offsetIspFamilies);
+}
+
+static Uint16* dbHash (const LpcDeviceDb *db) {
+	return (Uint16*) ((char*)db + db->offsetHash);
+}
+
+static Uint16* dbNames (const LpcDeviceDb *db) {
+	return (Uint16*) ((char*)db + db->offsetNames);
+}
+
+static Uint32 dbCrc (const LpcDeviceDb *db) {
+	const Uint32 offset = (const char*)&db->crc - (const char*)db + sizeof db->crc;
+	return crc32FeedN (0, (const Uint8*)db + offset, db->size - offset);
+}
+
+Uint32 lpcDeviceDbSizeMax (int nMembers) {
+	return align4 (sizeof (LpcDeviceDb))
+		+ nMembers * (sizeof (LpcDeviceDbMember) + sizeof (LpcFamily) + sizeof (LpcIspFamily))
+		+ align4 (hashSize (nMembers) * sizeof (Uint16))
+		+ align4 (nMembers * sizeof (Uint16));
+}
+
+/** Checks, if a member of the same name and first part ID appeared earlier in the list.
+ */
+static bool memberListedBefore (const LpcMember *const *list, int index) {
+	for (int i=0; i<index; i++) {
+		if (list[i]->ids[0]==list[index]->ids[0] && 0==strcmp (list[i]->name, list[index]->name)) return true;
+	}
+	return false;
+}
+
+static int familyIndex (const LpcFamily *families, int n, const LpcFamily *family) {
+	for (int f=0; f<n; f++) if (0==memcmp (&families[f], family, sizeof *family)) return f;
+	return -1;
+}
+
+static int ispFamilyIndex (const LpcIspFamily *families, int n, const LpcIspFamily *family) {
+	for (int f=0; f<n; f++) if (0==memcmp (&families[f], family, sizeof *family)) return f;
+	return -1;
+}
+
+/** Inserts the members into the name index by insertion sort, which keeps equal names in list order. There are only
+ * some hundred members.
+ */
+static void nameIndexBuild (LpcDeviceDb *db) {
+	const LpcDeviceDbMember *members = dbMembers (db);
+	Uint16 *names = dbNames (db);
+	for (int m=0; m<db->nMembers; m++) {
+		int i = m;
+		for ( ; i>0 && strcmp (members[names[i-1]].name, members[m].name)>0; i--) names[i] = names[i-1];
+		names[i] = m;
+	}
+}
+
+int lpcDeviceDbBuild (LpcDeviceDb *db, Uint32 size, const LpcMember *const *list) {
+	int n = 0;
+	while (list[n]!=0) n++;
+	if (size<lpcDeviceDbSizeMax (n)) return -1;
+
+	memset (db, 0, lpcDeviceDbSizeMax (n));	// padding included, for reproducible files
+	memcpy (db->magic, lpcDeviceDbMagic, sizeof db->magic);
+	db->version = LPC_DEVICE_DB_VERSION;
+	for (int m=0; m<n; m++) if (!memberListedBefore (list,m)) db->nMembers++;
+	db->hashSize = hashSize (db->nMembers);
+
+	// families are appended after the members while building and moved down finally
+	db->offsetMembers = align4 (sizeof *db);
+	db->offsetHash = db->offsetMembers + db->nMembers*sizeof (LpcDeviceDbMember);
+	db->offsetNames = align4 (db->offsetHash + db->hashSize*sizeof (Uint16));
+	db->offsetFamilies = align4 (db->offsetNames + db->nMembers*sizeof (Uint16));
+	db->offsetIspFamilies = db->offsetFamilies + n*sizeof (LpcFamily);
+
+	LpcDeviceDbMember *members = dbMembers (db);
+	LpcFamily *families = dbFamilies (db);
+	LpcIspFamily *ispFamilies = dbIspFamilies (db);
+	for (int m=0, i=0; m<n; m++) {
+		const LpcMember *member = list[m];
+		if (memberListedBefore (list,m)) continue;
+		if (strlen (member->name)>=LPC_DEVICE_DB_NAME) return -1;
+
+		LpcDeviceDbMember *dbMember = &members[i];
+		strcpy (dbMember->name, member->name);
+		dbMember->sizeFlashK = member->sizeFlashK;
+		memcpy (dbMember->sizeRamKs, member->sizeRamKs, sizeof dbMember->sizeRamKs);
+		memcpy (dbMember->ids, member->ids, sizeof dbMember->ids);
+
+		int f = familyIndex (families, db->nFamilies, member->family);
+		if (f<0) {
+			f = db->nFamilies++;
+			families[f] = *member->family;
+		}
+		dbMember->family = f;
+		int fi = ispFamilyIndex (ispFamilies, db->nIspFamilies, member->ispFamily);
+		if (fi<0) {
+			fi = db->nIspFamilies++;
+			ispFamilies[fi] = *member->ispFamily;
+		}
+		dbMember->ispFamily = fi;
+
+		const Uint32 mask = member->family->idMasks[0];
+		int k = 0;
+		while (k<db->nIdMasks && db->idMasks[k]!=mask) k++;
+		if (k==db->nIdMasks) {
+			if (k>=LPC_DEVICE_DB_MASKS) return -1;
+			db->idMasks[db->nIdMasks++] = mask;
+		}
+
+		Uint16 *hash = dbHash (db);
+		Uint32 slot = hashSlot (db, member->ids[0] & mask);
+		while (hash[slot]!=0) slot = (slot+1) & (db->hashSize-1);
+		hash[slot] = i+1;
+		i++;
+	}
+	nameIndexBuild (db);
+
+	// close the gap between the families and the ISP families
+	LpcIspFamily *ispFamiliesFinal = (LpcIspFamily*) ((char*)db + db->offsetFamilies + db->nFamilies*sizeof (LpcFamily));
+	memmove (ispFamiliesFinal, ispFamilies, db->nIspFamilies*sizeof (LpcIspFamily));
+	db->offsetIspFamilies = (char*)ispFamiliesFinal - (char*)db;
+	db->size = db->offsetIspFamilies + db->nIspFamilies*sizeof (LpcIspFamily);
+	db->crc = dbCrc (db);
+	return db->size;
+}
+
+static bool tableFits (const LpcDeviceDb *db, Uint32 offset, Uint32 n, Uint32 elementSize) {
+	return (offset & 3)==0 && offset>=sizeof *db && offset<=db->size && n<=(db->size-offset)/elementSize;
+}
+
+bool lpcDeviceDbValidate (const LpcDeviceDb *db, Uint32 size) {
+	if (size<sizeof *db
+	|| 0!=memcmp (db->magic, lpcDeviceDbMagic, sizeof db->magic)
+	|| db->version!=LPC_DEVICE_DB_VERSION
+	|| db->size>size || db->size<sizeof *db
+	|| db->crc!=dbCrc (db)
+	|| db->nMembers>0xFFFF || db->nIdMasks>LPC_DEVICE_DB_MASKS
+	|| db->hashSize<db->nMembers || (db->hashSize & (db->hashSize-1))!=0
+	|| !tableFits (db, db->offsetMembers, db->nMembers, sizeof (LpcDeviceDbMember))
+	|| !tableFits (db, db->offsetFamilies, db->nFamilies, sizeof (LpcFamily))
+	|| !tableFits (db, db->offsetIspFamilies, db->nIspFamilies, sizeof (LpcIspFamily))
+	|| !tableFits (db, db->offsetHash, db->hashSize, sizeof (Uint16))
+	|| !tableFits (db, db->offsetNames, db->nMembers, sizeof (Uint16))) return false;
+
+	const LpcDeviceDbMember *members = dbMembers (db);
+	for (int m=0; m<db->nMembers; m++) {
+		if (members[m].family>=db->nFamilies
+		|| members[m].ispFamily>=db->nIspFamilies
+		|| members[m].name[LPC_DEVICE_DB_NAME-1]!=0
+		|| dbNames (db)[m]>=db->nMembers) return false;
+	}
+	bool empty = false;		// at least one empty slot terminates every probe sequence
+	for (int s=0; s<db->hashSize; s++) {
+		if (dbHash (db)[s]>db->nMembers) return false;
+		empty = empty || dbHash (db)[s]==0;
+	}
+	return empty;
+}
+
+static bool memberMatchesIds (const LpcDeviceDb *db, const LpcDeviceDbMember *member, const Uint32 ids[LPC_IDS]) {
+	const LpcFamily *family = &dbFamilies (db)[member->family];
+	for (int i=0; i<LPC_IDS && family->idMasks[i]; i++) if ((ids[i] & family->idMasks[i])!=member->ids[i]) return false;
+	return true;
+}
+
+int lpcDeviceDbFindByIds (const LpcDeviceDb *db, const Uint32 ids[LPC_IDS]) {
+	const LpcDeviceDbMember *members = dbMembers (db);
+	const Uint16 *hash = dbHash (db);
+	int found = -1;		// the lowest index, like a linear search would find
+
+	for (int k=0; k<db->nIdMasks; k++) {
+		const Uint32 mask = db->idMasks[k];
+		for (Uint32 slot = hashSlot (db, ids[0] & mask); hash[slot]!=0; slot = (slot+1) & (db->hashSize-1)) {
+			const int m = hash[slot]-1;
+			if ((found<0 || m<found)
+			&& dbFamilies (db)[members[m].family].idMasks[0]==mask
+			&& memberMatchesIds (db, &members[m], ids)) found = m;
+		}
+	}
+	return found;
+}
+
+/** Compares a member name with the first n characters of a name.
+ */
+static int nameCompare (const char *memberName, const char *name, int n) {
+	const int c = strncmp (memberName, name, n);
+	return c!=0 ? c : memberName[n]!=0;
+}
+
+int lpcDeviceDbFindByName (const LpcDeviceDb *db, const char *name) {
+	const LpcDeviceDbMember *members = dbMembers (db);
+	const Uint16 *names = dbNames (db);
+
+	for (int n=strlen (name); n>0; n--) {	// longest prefix first
+		int low = 0;
+		int high = db->nMembers-1;
+		while (low<=high) {
+			const int middle = (low+high)/2;
+			const int c = nameCompare (members[names[middle]].name, name, n);
+			if (c==0) {	// the first of equal names
+				int first = middle;
+				while (first>0 && 0==nameCompare (members[names[first-1]].name, name, n)) first--;
+				return names[first];
+			}
+			else if (c<0) low = middle+1;
+			else high = middle-1;
+		}
+	}
+	return -1;
+}
+
+const LpcMember* lpcDeviceDbMember (const LpcDeviceDb *db, int index, LpcMember *member) {
+	const LpcDeviceDbMember *dbMember = &dbMembers (db)[index];
+	member->name = dbMember->name;
+	member->sizeFlashK = dbMember->sizeFlashK;
+	memcpy (member->sizeRamKs, dbMember->sizeRamKs, sizeof member->sizeRamKs);
+	memcpy (member->ids, dbMember->ids, sizeof member->ids);
+	member->family = &dbFamilies (db)[dbMember->family];
+	member->ispFamily = &dbIspFamilies (db)[dbMember->ispFamily];
+	return member;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Text representation
+
+bool fifoPrintLpcDeviceDefinition (Fifo *fifo, const LpcMember *member) {
+	const LpcFamily *family = member->family;
+	const LpcIspFamily *ispFamily = member->ispFamily;
+
+	fifoPrintString (fifo,"-N'");
+	fifoPrintString (fifo, member->name);
+	fifoPrintChar (fifo,'\'');
+	fifoPrintString (fifo," -A");
+	for (int b=0; b<family->banks; b++) {
+		if (b!=0) fifoPrintChar (fifo,',');
+		fifoPrintString (fifo,"0x");
+		fifoPrintHex (fifo,family->addressFlashs[b],8,8);
+	}
+	fifoPrintString (fifo," -B");
+	for (int b=0; b<LPC_BLOCK_SIZES && family->blockSizes[b]!=0; b++) {
+		if (b!=0) fifoPrintChar (fifo,',');
+		fifoPrintUint32 (fifo,family->blockSizes[b],1);
+	}
+	fifoPrintString (fifo," -F");
+	for (int g=0; g<LPC_SECTOR_ARRAYS && family->sectorArrays[g].n!=0; g++) {
+		if (g!=0) fifoPrintChar (fifo,',');
+		fifoPrintUint16 (fifo, family->sectorArrays[g].sizeK,1);
+		fifoPrintString (fifo,"kix");
+		fifoPrintUint16 (fifo, family->sectorArrays[g].n,1);
+	}
+	fifoPrintString (fifo," -I");
+	for (int i=0; i<LPC_IDS && family->idMasks[i]!=0; i++) {
+		if (i!=0) fifoPrintChar (fifo,',');
+		Int32Pair pair = { member->ids[i], family->idMasks[i] };
+		if (canPrintInt32HexWithDontCares (&pair)) {
+			fifoPrintString (fifo,"0x");
+			fifoPrintInt32HexWithDontCares (fifo,&pair,'X');
+		}
+		else {
+			fifoPrintString (fifo,"0b");
+			fifoPrintInt32BinWithDontCares (fifo,&pair,'X');
+		}
+	}
+	fifoPrintString (fifo," -M");
+	for (int r=0, nr=0; r<LPC_RAMS; r++) {
+		if (member->sizeRamKs[r]>0) {
+			if (nr!=0) fifoPrintChar (fifo,',');
+			fifoPrintUint32 (fifo,member->sizeRamKs[r],1);
+			fifoPrintString (fifo,"ki@0x");
+			fifoPrintHex (fifo,ispFamily->addressRams[r],8,8);
+			nr++;
+		}
+	}
+	fifoPrintString (fifo," -P");
+	fifoPrintString (fifo,ispFamily->protocol==ISP_PROTOCOL_UUENCODE ? "UUENCODE":"BINARY");
+	fifoPrintString (fifo," -R");
+	for (int i=0; i<LPC_ISP_RAMS; i++) {
+		if (i!=0) fifoPrintChar (fifo,',');
+		const Int32 size = ispFamily->ramUsage[i].size;
+		const Int32 address = ispFamily->ramUsage[i].address;
+		if (size>0) {
+			fifoPrintString (fifo,"0x");
+			fifoPrintHex (fifo,size,3,8);
+		}
+		else {
+			fifoPrintChar (fifo,'-');
+			fifoPrintString (fifo,"0x");
+			fifoPrintHex (fifo,-size,3,8);
+		}
+		fifoPrintString (fifo,"@0x");
+		fifoPrintHex (fifo,address,8,8);
+	}
+	fifoPrintString (fifo," -S");
+	fifoPrintInt16 (fifo,family->checksumVectors,1);
+	fifoPrintChar (fifo,'@');
+	fifoPrintInt16 (fifo,family->checksumVector,1);
+
+	fifoPrintString (fifo," -f");
+	fifoPrintInt32 (fifo,member->sizeFlashK,1);
+	return fifoPrintString (fifo,"ki");
+}
+
+/** Parses a list of integers or pairs of integers.
+ * @param separator the separator of pair elements or 0 for plain integers.
+ * @return the number of elements parsed, -1 in case of a syntax error or too many elements.
+ */
+static int parseList (Fifo *fifo, Int32Pair *pairs, int nMax, char separator) {
+	int n = 0;
+	do {
+		if (n>=nMax
+		|| !fifoParseIntEng (fifo,&pairs[n].fst)
+		|| separator!=0 && !(fifoParseExactChar (fifo,separator) && fifoParseIntEng (fifo,&pairs[n].snd))) return -1;
+		n++;
+	} while (fifoParseExactChar (fifo,','));
+	return n;
+}
+
+static bool parseName (Fifo *fifo, char *name) {
+	const bool quoted = fifoParseExactChar (fifo,'\'');
+	int n = 0;
+	while (fifoCanRead (fifo)) {
+		const char c = fifoLookAhead (fifo);
+		if (quoted ? c=='\'' : c==' ' || c=='\t') break;
+		if (n>=LPC_DEVICE_DB_NAME-1) return false;
+		name[n++] = fifoRead (fifo);
+	}
+	name[n] = 0;
+	return n>0 && (!quoted || fifoParseExactChar (fifo,'\''));
+}
+
+bool fifoParseLpcDeviceDefinition (Fifo *fifo, LpcDeviceDefinition *definition) {
+	LpcFamily *family = &definition->family;
+	LpcIspFamily *ispFamily = &definition->ispFamily;
+	LpcMember *member = &definition->member;
+	memset (definition, 0, sizeof *definition);
+	member->name = definition->name;
+	member->family = family;
+	member->ispFamily = ispFamily;
+
+	bool defined[128] = {};			// options seen
+	Int32 flashSize = -1;
+	Int32Pair pairs[LPC_RAMS];		// the largest list
+	int n;
+
+	for (fifoParseBlanks (fifo); fifoCanRead (fifo); fifoParseBlanks (fifo)) {
+		char option;
+		if (!fifoParseExactChar (fifo,'-') || !fifoParseCharSet (fifo,&option,"ABFIMNPRSf")) return false;
+
+		switch(option) {
+		case 'A':
+			if ((n = parseList (fifo,pairs,LPC_BANKS,0))<0) return false;
+			for (int b=0; b<n; b++) family->addressFlashs[b] = pairs[b].fst;
+			family->banks = n;
+			break;
+		case 'B':
+			if ((n = parseList (fifo,pairs,LPC_BLOCK_SIZES,0))<0) return false;
+			for (int b=0; b<n; b++) family->blockSizes[b] = pairs[b].fst;
+			break;
+		case 'F':
+			if ((n = parseList (fifo,pairs,LPC_SECTOR_ARRAYS,'x'))<0) return false;
+			for (int g=0; g<n; g++) {
+				// sizeK and n are Int8
+				if (pairs[g].fst & 1023 || pairs[g].fst<0 || pairs[g].fst>127*1024
+				|| pairs[g].snd<0 || pairs[g].snd>127) return false;
+				family->sectorArrays[g].sizeK = pairs[g].fst / 1024;
+				family->sectorArrays[g].n = pairs[g].snd;
+			}
+			break;
+		case 'I':
+			n = 0;
+			do {
+				if (n>=LPC_IDS || !fifoParseInt32WithDontCares (fifo,&pairs[n],'X')) return false;
+				member->ids[n] = pairs[n].fst;
+				family->idMasks[n] = pairs[n].snd;
+				n++;
+			} while (fifoParseExactChar (fifo,','));
+			break;
+		case 'M':
+			if ((n = parseList (fifo,pairs,LPC_RAMS,'@'))<0) return false;
+			for (int r=0; r<n; r++) {
+				if (pairs[r].fst & 1023 || pairs[r].snd & 3) return false;
+				member->sizeRamKs[r] = pairs[r].fst / 1024;
+				ispFamily->addressRams[r] = pairs[r].snd;
+			}
+			break;
+		case 'N':
+			if (!parseName (fifo,definition->name)) return false;
+			break;
+		case 'P': {
+			static const char* const protocols[] = { "UUENCODE", "BINARY" };
+			int protocol;
+			if (!fifoParseEnum (fifo,protocols,2,&protocol)) return false;
+			ispFamily->protocol = protocol;
+		}	break;
+		case 'R':
+			if ((n = parseList (fifo,pairs,LPC_ISP_RAMS,'@'))<0) return false;
+			for (int i=0; i<n; i++) {
+				ispFamily->ramUsage[i].size = pairs[i].fst;
+				ispFamily->ramUsage[i].address = pairs[i].snd;
+			}
+			break;
+		case 'S':
+			if (!fifoParseIntEng (fifo,&pairs[0].fst)
+			|| !fifoParseExactChar (fifo,'@') || !fifoParseIntEng (fifo,&pairs[0].snd)) return false;
+			family->checksumVectors = pairs[0].fst;
+			family->checksumVector = pairs[0].snd;
+			break;
+		case 'f':
+			if (!fifoParseIntEng (fifo,&flashSize)) return false;
+			break;
+		}
+		defined[(int)option] = true;
+	}
+	if (!defined['N'] || !defined['F'] || !defined['I'] || !defined['M']) return false;
+
+	// defaults, as on the mxli command line
+	if (!defined['A']) family->banks = 1;
+	if (!defined['B']) family->blockSizes[0] = 1024;
+	if (!defined['R']) {
+		ispFamily->ramUsage[0].address = ispFamily->addressRams[0];
+		ispFamily->ramUsage[0].size = 0x270;		// LPC800 has this (worst) value.
+		ispFamily->ramUsage[1].address = ispFamily->addressRams[0];
+		ispFamily->ramUsage[1].size = - (256 + 32);	// most LPCs use that much stack and top 32 bytes.
+	}
+	if (!defined['S']) {
+		family->checksumVectors = 8;
+		family->checksumVector = 7;
+	}
+	member->sizeFlashK = (flashSize>=0 ? flashSize : lpcFamilyBankSize (family)) / 1024;
+	return true;
+}
+
@@ -0,0 +1,142 @@
+/*
+  lpcDeviceDb.h - indexed binary LPC device database.
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __lpcDeviceDb_h
+#define __lpcDeviceDb_h
+
+#include <lpcMemories.h>
+#include <fifo.h>
+
+/** @file
+ * @brief LPC device descriptions in a single relocatable memory block, that can be written to a file and memory
+ * mapped again.
+ *
+ * The database contains LpcMember records with families referenced by index instead of pointers, plus two indexes:
+ *   - a hash table on the masked first part ID. Because families use different ID masks, a lookup probes once for
+ *     every different mask.
+ *   - the member indexes sorted by name, for binary searches.
+ *
+ * Members are created from a list of LpcMembers, for example the compiled-in table, extended by device definitions in
+ * the syntax of mxli's --deviceDefinition output. The first member of a name and first part ID wins, so definitions
+ * listed first replace compiled-in members. Members of equal names, but different IDs, like silicon revisions, are
+ * all kept. The data is in host byte order.
+ */
+
+enum {
+	LPC_DEVICE_DB_VERSION	=1,
+	LPC_DEVICE_DB_NAME	=48,	///< maximum size of a member name, including the terminating 0
+	LPC_DEVICE_DB_MASKS	=8,	///< maximum number of different first part ID masks
+};
+
+typedef struct __attribute__((packed,aligned(4))) {
+	char	name[LPC_DEVICE_DB_NAME];
+	Uint16	sizeFlashK;
+	Uint16	sizeRamKs[LPC_RAMS];
+	Uint32	ids[LPC_IDS];
+	Uint16	family;			///< index of the LpcFamily
+	Uint16	ispFamily;		///< index of the LpcIspFamily
+} LpcDeviceDbMember;
+
+/** The header of the database, followed by the tables.
+ */
+typedef struct __attribute__((packed,aligned(4))) {
+	char	magic[8];		///< "mxliLPCD", not terminated
+	Uint32	version;		///< LPC_DEVICE_DB_VERSION
+	Uint32	size;			///< total size in bytes, including this header
+	Uint32	crc;			///< CRC-32 of all bytes following this field
+	Uint32	nMembers;
+	Uint32	nFamilies;
+	Uint32	nIspFamilies;
+	Uint32	nIdMasks;
+	Uint32	idMasks[LPC_DEVICE_DB_MASKS];	///< all different masks of the first part ID
+	Uint32	hashSize;		///< number of hash slots, a power of 2
+	Uint32	offsetMembers;		///< LpcDeviceDbMember[nMembers]
+	Uint32	offsetFamilies;		///< LpcFamily[nFamilies]
+	Uint32	offsetIspFamilies;	///< LpcIspFamily[nIspFamilies]
+	Uint32	offsetHash;		///< Uint16[hashSize]: member index+1 by masked first part ID, 0 = empty slot
+	Uint32	offsetNames;		///< Uint16[nMembers]: member indexes in ascending name order
+} LpcDeviceDb;
+
+/** Storage of one member parsed from a device definition.
+ */
+typedef struct {
+	LpcMember	member;		///< refers to the other fields
+	LpcFamily	family;
+	LpcIspFamily	ispFamily;
+	char		name[LPC_DEVICE_DB_NAME];
+} LpcDeviceDefinition;
+
+/** Calculates the maximum size of a database.
+ * @param nMembers the number of members in the list.
+ * @return a size sufficient for lpcDeviceDbBuild.
+ */
+Uint32 lpcDeviceDbSizeMax (int nMembers);
+
+/** Creates a database.
+ * @param db the destination, 4-byte aligned.
+ * @param size the size of the destination.
+ * @param list the members, 0-terminated. The first member of a name and first part ID wins.
+ * @return the size of the database or -1 if it does not fit, a name is too long or there are too many ID masks.
+ */
+int lpcDeviceDbBuild (LpcDeviceDb *db, Uint32 size, const LpcMember *const *list);
+
+/** Checks a database, before any other function is used on it.
+ * @param db the database, 4-byte aligned.
+ * @param size the size of the memory containing the database, typically a file size.
+ * @return true, if the header, the CRC and all indexes are consistent.
+ */
+bool lpcDeviceDbValidate (const LpcDeviceDb *db, Uint32 size);
+
+/** Searches a member by its part IDs, using the hash index.
+ * @param db a valid database.
+ * @param ids the IDs read from the device.
+ * @return the index of the first matching member or -1 if none matches.
+ */
+int lpcDeviceDbFindByIds (const LpcDeviceDb *db, const Uint32 ids[LPC_IDS]);
+
+/** Searches a member by its name, using the name index. Like lpcFindByName, the member name has to be a prefix of
+ * name. If multiple member names qualify, the longest one is chosen, the first one of equal names.
+ * @param db a valid database.
+ * @param name the name to search.
+ * @return the index of the member or -1 if none matches.
+ */
+int lpcDeviceDbFindByName (const LpcDeviceDb *db, const char *name);
+
+/** Provides a member as LpcMember, referring to the database.
+ * @param db a valid database.
+ * @param index the index of the member, 0..db->nMembers-1.
+ * @param member the destination.
+ * @return member.
+ */
+const LpcMember* lpcDeviceDbMember (const LpcDeviceDb *db, int index, LpcMember *member);
+
+/** Prints a member as command-line device definition (-N'name' -A.. -B.. -F.. -I.. -M.. -P.. -R.. -S.. -f..).
+ * @param fifo the destination.
+ * @param member the member.
+ * @return true, if all fitted into the fifo.
+ */
+bool fifoPrintLpcDeviceDefinition (Fifo *fifo, const LpcMember *member);
+
+/** Parses a device definition in the syntax of fifoPrintLpcDeviceDefinition. The options are separated by blanks,
+ * the name may be quoted with '. Defaults of optional options are the same as for the mxli command line: -A0,
+ * -B1024, -PUUENCODE, RAM0 used by the ISP handler as on LPC800, -S8@7 and the full FLASH size.
+ * @param fifo the input, typically one line of a text file. Trailing blanks are skipped.
+ * @param definition the destination.
+ * @return true, if all of fifo was parsed and -N, -F, -I and -M were specified.
+ */
+bool fifoParseLpcDeviceDefinition (Fifo *fifo, LpcDeviceDefinition *definition);
+
+#endif
+
@@ -113,7 +113,7 @@ void lpcSectorIteratorNext (LpcSectorIterator *it) {
  * @param addressTo the highest address of the range.
  * @return true, if the addresses are within the members FLASH range
  */
-bool lpcAddressRangeToSectorRange(LpcMember const *member, Int32Pair *sectorRange, const Uint32Pair *addressRange) {
+bool lpcAddressRangeToSectorRangeIterating(LpcMember const *member, Int32Pair *sectorRange, const Uint32Pair *addressRange) {
 	LpcSectorIterator it = { member };
 
 	while (lpcSectorIteratorHasNext (&it)) {
@@ -130,6 +130,95 @@ bool lpcAddressRangeToSectorRange(LpcMember const *member, Int32Pair *sectorRang
 	return false;	// at least end not found
 }
 
+//SLICE
+/** Extracts the properties of a member, that determine its sectors.
+ */
+static LpcSectorMapKey lpcSectorMapKey (LpcMember const *member) {
+	const LpcFamily *family = member->family;
+	LpcSectorMapKey key = { .sizeFlashK = member->sizeFlashK, .banks = family->banks, };
+	for (int b=0; b<LPC_BANKS; b++) key.addressFlashs [b] = family->addressFlashs [b];
+	for (int g=0; g<LPC_SECTOR_ARRAYS; g++) key.sectorArrays [g] = family->sectorArrays [g];
+	return key;
+}
+
+bool lpcSectorMapMatches (const LpcSectorMap *map, LpcMember const *member) {
+	const LpcFamily *family = member->family;
+	if (member->sizeFlashK != map->key.sizeFlashK || family->banks != map->key.banks) return false;
+	for (int b=0; b<LPC_BANKS; b++) if (family->addressFlashs [b] != map->key.addressFlashs [b]) return false;
+	for (int g=0; g<LPC_SECTOR_ARRAYS; g++) {
+		if (family->sectorArrays [g].sizeK != map->key.sectorArrays [g].sizeK
+		|| family->sectorArrays [g].n != map->key.sectorArrays [g].n) return false;
+	}
+	return true;
+}
+
+bool lpcSectorMapInit (LpcSectorMap *map, LpcMember const *member) {
+	map->key = lpcSectorMapKey (member);
+	map->valid = false;
+	map->n = 0;
+	for (LpcSectorIterator it = { member }; lpcSectorIteratorHasNext (&it); lpcSectorIteratorNext (&it)) {
+		const LpcSector *previous = map->n>0 ? &map->sectors [map->n-1] : 0;
+		if (map->n >= LPC_SECTORS	// too many sectors or binary search impossible
+		|| previous && lpcSectorIteratorAddress (&it) < previous->address + previous->sizeK * 1024
+		|| it.sectorInBank > 0xFF) {
+			map->n = 0;
+			return false;
+		}
+		LpcSector *sector = &map->sectors [map->n++];
+		sector->address = lpcSectorIteratorAddress (&it);
+		sector->sizeK = lpcSectorIteratorSize (&it) / 1024;
+		sector->bank = lpcSectorIteratorBank (&it);
+		sector->sectorInBank = it.sectorInBank;
+	}
+	map->valid = true;
+	return true;
+}
+
+//SLICE
+int lpcSectorMapFind (const LpcSectorMap *map, Uint32 address) {
+	int low = 0;
+	int high = map->n;		// exclusive
+	while (low < high) {
+		const int mid = (low + high) / 2;
+		const LpcSector *sector = &map->sectors [mid];
+		if (address < sector->address) high = mid;
+		else if (address - sector->address >= sector->sizeK * 1024) low = mid+1;
+		else return mid;
+	}
+	return -1;
+}
+
+//SLICE
+const LpcSectorMap* lpcSectorMapCached (LpcMember const *member) {
+	static LpcSectorMap map;
+	static bool built;
+
+	if (!built || !lpcSectorMapMatches (&map, member)) {
+		lpcSectorMapInit (&map, member);
+		built = true;
+	}
+	return map.valid ? &map : 0;
+}
+
+//SLICE
+bool lpcAddressRangeToSectorRange(LpcMember const *member, Int32Pair *sectorRange, const Uint32Pair *addressRange) {
+	const LpcSectorMap *map = lpcSectorMapCached (member);
+	return map!=0 ? lpcSectorMapRange (map, sectorRange, addressRange)
+		: lpcAddressRangeToSectorRangeIterating (member, sectorRange, addressRange);
+}
+
+//SLICE
+bool lpcSectorMapRange (const LpcSectorMap *map, Int32Pair *sectorRange, const Uint32Pair *addressRange) {
+	const int fst = lpcSectorMapFind (map, addressRange->fst);
+	const int snd = lpcSectorMapFind (map, addressRange->snd);
+	if (fst != -1 && (snd == -1 || fst <= snd)) sectorRange->fst = lpcSectorNumber (&map->sectors [fst]);
+	if (snd != -1) {
+		sectorRange->snd = lpcSectorNumber (&map->sectors [snd]);
+		return sectorRange->fst>>_SECTOR_BANK == sectorRange->snd>>_SECTOR_BANK;
+	}
+	else return false;	// at least end not found
+}
+
 //SLICE
 int lpcBankToLastSector (LpcMember const *member, int bank) {
 	const LpcFamily *family = member->family;
@@ -183,6 +272,18 @@ Uint32 lpcFamilyBankSize (LpcFamily const *family) {
 	return size;
 }
 
+//SLICE
+Uint32 lpcFamilyEraseUs (LpcFamily const *family, int sectors) {
+	const int ms = family!=0 && family->eraseSectorMs!=0 ? family->eraseSectorMs : LPC_ERASE_SECTOR_MS;
+	return sectors * ms * 1000;
+}
+
+//SLICE
+Uint32 lpcFamilyProgramUs (LpcFamily const *family, int n) {
+	const int ms = family!=0 && family->programBlockMs!=0 ? family->programBlockMs : LPC_PROGRAM_BLOCK_MS;
+	return (n+255)/256 * ms * 1000;
+}
+
 //SLICE
 // positive result +n = @ address+offset are n bytes available
 // negative result -n = @ address+offset are n byte (at least) used by ISP
@@ -863,6 +964,8 @@ const LpcFamily lpcFamily8xx = {
 	.idMasks = { -1, },
 	.checksumVectors = 8,
 	.checksumVector = 7, 
+	.eraseSectorMs = 105,
+	.programBlockMs = 5,
 };
 
 //SLICE
@@ -1049,6 +1152,8 @@ const LpcFamily lpcFamily11xx = {
 	.idMasks = { -1, },
 	.checksumVectors = 8,
 	.checksumVector = 7, 
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 //SLICE
@@ -1490,6 +1595,8 @@ const LpcFamily lpcFamily11Uxx = {
 	.idMasks = { -1, },
 	.checksumVectors = 8,
 	.checksumVector = 7,
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 //SLICE
@@ -1540,6 +1647,8 @@ const LpcFamily lpcFamily11Exx = {
 	.idMasks = { -1, },
 	.checksumVectors = 8,
 	.checksumVector = 7, 
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 //SLICE
@@ -1650,6 +1759,8 @@ const LpcFamily lpcFamily12xx = {
 	.idMasks = { -1, },
 	.checksumVectors = 8,
 	.checksumVector = 7, 
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 //SLICE
@@ -1751,6 +1862,8 @@ const LpcFamily lpcFamily13xx = {
 	.idMasks = { -1, },
 	.checksumVectors = 8,
 	.checksumVector = 7, 
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 //SLICE
@@ -1771,6 +1884,8 @@ const LpcFamily lpcFamily13x5_6_7 = {
 	.sectorArrays = { { .sizeK=4, .n=16 }, { }, },
 	.blockSizes = { 256, 512, 1024, 4096 },
 	.idMasks = { -1, },
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 /*
@@ -1919,6 +2034,8 @@ const LpcFamily lpcFamily15xx = {
 	.idMasks = { -1, },
 	.checksumVectors = 8,
 	.checksumVector = 7, 
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 //SLICE
@@ -2019,6 +2136,8 @@ const LpcFamily lpcFamily17xx = {
 	.idMasks = { -1, },
 	.checksumVectors = 8,
 	.checksumVector = 7, 
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 /*
@@ -2759,6 +2878,8 @@ const LpcFamily lpcFamily43xx = {
 	.idMasks = { -1, 0x000000FF, },
 	.checksumVectors = 8,
 	.checksumVector = 7, 
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 //SLICE
@@ -2768,6 +2889,8 @@ const LpcFamily lpcFamily43x2 = {
 	.sectorArrays = { { .sizeK=8, .n=8 }, { .sizeK=64, .n=7 }, },
 	.blockSizes = { 512, 1024, 4096 },
 	.idMasks = { -1, 0x000000FF, },
+	.eraseSectorMs = 105,
+	.programBlockMs = 2,
 };
 
 //SLICE
@@ -44,6 +44,9 @@ enum {
 	LPC_RAMS		=6,	///< Maximum number of (on-chip) RAM 
 	LPC_ISP_RAMS		=4,	///< Maximum number of (on-chip) RAM regions the boot-loader uses, increased from 2 to 4 with LPC541xx
 	LPC_ISP_BUFFERS		=3,	///< maximum number of ISP transfer RAM buffers. Must be >=2
+	LPC_SECTORS		=64,	///< Maximum number of sectors (all banks) in a LpcSectorMap
+	LPC_ERASE_SECTOR_MS	=400,	///< sector erase time, if the family does not specify it (slowest known: LPC2xxx)
+	LPC_PROGRAM_BLOCK_MS	=2,	///< time to program 256 bytes, if the family does not specify it
 };
 
 /** The size of individual sectors within one family is the same - what varies is the total number of sectors
@@ -80,6 +83,8 @@ typedef struct __attribute__((packed,aligned(4))) {
 	Uint8		checksumVectors;			///< how many vectors will be checksummed for valid code?
 	Uint8		checksumVector;				///< where to put the checksum per flash bank.
 	Uint8		core;					///< what kind of processor (at least).
+	Uint16		eraseSectorMs;				///< max. time to erase 1 sector, 0 = LPC_ERASE_SECTOR_MS
+	Uint8		programBlockMs;				///< max. time to program 256 bytes, 0 = LPC_PROGRAM_BLOCK_MS
 } LpcFamily;
 
 typedef struct __attribute__((packed)) {
@@ -238,6 +243,80 @@ inline static bool lpcSectorIteratorContainsAddress (const LpcSectorIterator *it
  */
 bool lpcAddressRangeToSectorRange(LpcMember const *member, Int32Pair *sectorRange, const Uint32Pair *addressRange);
 
+/** Reference implementation of lpcAddressRangeToSectorRange, walking all sectors with a LpcSectorIterator.
+ */
+bool lpcAddressRangeToSectorRangeIterating(LpcMember const *member, Int32Pair *sectorRange, const Uint32Pair *addressRange);
+
+/** One sector of a LpcSectorMap.
+ */
+typedef struct __attribute__((packed,aligned(4))) {
+	Uint32	address;	///< absolute start address
+	Uint16	sizeK;		///< size in kiB
+	Uint8	bank;		///< BANK_Z, BANK_A, ...
+	Uint8	sectorInBank;	///< sector id without bank
+} LpcSector;
+
+/** The properties of a member, that determine its sectors. A map stays valid, as long as these don't change, even if
+ * the member is modified in place.
+ */
+typedef struct {
+	Uint32			addressFlashs	[LPC_BANKS];
+	LpcSectorArray		sectorArrays	[LPC_SECTOR_ARRAYS];
+	Uint16			sizeFlashK;
+	Uint8			banks;
+} LpcSectorMapKey;
+
+/** All sectors of a member in ascending address order, for lookups by binary search instead of iterating from
+ * sector 0 each time.
+ */
+typedef struct {
+	LpcSectorMapKey		key;		///< the layout the map was built from
+	bool			valid;		///< lpcSectorMapInit succeeded
+	int			n;		///< number of valid sectors
+	LpcSector		sectors[LPC_SECTORS];
+} LpcSectorMap;
+
+inline static int lpcSectorNumber (const LpcSector *sector) {
+	return sector->bank << _SECTOR_BANK | sector->sectorInBank;
+}
+
+/** Builds the sector map of a member from its family's sectorArrays.
+ * @param map the destination
+ * @param member LPC family member descriptor
+ * @return true, if all sectors fit into the map. If false, the map is empty.
+ */
+bool lpcSectorMapInit (LpcSectorMap *map, LpcMember const *member);
+
+/** Checks, if a map was built from the current sector layout of a member.
+ * @param map a map built by lpcSectorMapInit
+ * @param member LPC family member descriptor
+ * @return true, if the member's FLASH size, banks and sector arrays are those the map was built from.
+ */
+bool lpcSectorMapMatches (const LpcSectorMap *map, LpcMember const *member);
+
+/** Finds the sector containing an address by binary search.
+ * @param map a map built by lpcSectorMapInit
+ * @param address the address of a single byte
+ * @return the index into map->sectors or -1 if address is outside FLASH.
+ */
+int lpcSectorMapFind (const LpcSectorMap *map, Uint32 address);
+
+/** Provides the sector map of a member, rebuilding a single cached map if the sector layout changes. The cache is
+ * shared and therefore not reentrant: concurrent users (threads, interrupts) build their own map with lpcSectorMapInit
+ * and use lpcSectorMapRange.
+ * @param member LPC family member descriptor
+ * @return the map or 0, if the member has too many sectors for a LpcSectorMap.
+ */
+const LpcSectorMap* lpcSectorMapCached (LpcMember const *member);
+
+/** Calculates what sectors are affected from operations within an address range, like lpcAddressRangeToSectorRange.
+ * @param map a valid map built by lpcSectorMapInit
+ * @param sectorRange the result sector range
+ * @param addressRange the lowest/highest address of the range
+ * @return true, if the addresses are within the map's FLASH range and in the same bank, false if not.
+ */
+bool lpcSectorMapRange (const LpcSectorMap *map, Int32Pair *sectorRange, const Uint32Pair *addressRange);
+
 //bool lpcAddressRangeToSectorRange(LpcMember const *member,
 //	int *sectorFrom, int *sectorTo, Uint32 addressFrom, Uint32 addressTo);
 
@@ -288,6 +367,20 @@ int lpcFamilySectorHighest(LpcFamily const *map);
  */
 Uint32 lpcFamilyBankSize (LpcFamily const *family);
 
+/** Estimates the time the LPC needs for erasing sectors, based on the data sheet's maximum erase time.
+ * @param family the LPC family descriptor or 0 for a conservative default.
+ * @param sectors the number of sectors erased by one command.
+ * @return the maximum erase time in us.
+ */
+Uint32 lpcFamilyEraseUs (LpcFamily const *family, int sectors);
+
+/** Estimates the time the LPC needs for programming FLASH (copy RAM to FLASH).
+ * @param family the LPC family descriptor or 0 for a conservative default.
+ * @param n the number of bytes programmed by one command.
+ * @return the maximum programming time in us.
+ */
+Uint32 lpcFamilyProgramUs (LpcFamily const *family, int n);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // RAM handling
 
@@ -0,0 +1,107 @@
+/*
+  lzBlock.c
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <lzBlock.h>
+
+static bool lzPutByte(Uint8 *dst, int dstSize, int *pos, int value) {
+	if (*pos<dstSize) {
+		dst[(*pos)++] = value;
+		return true;
+	}
+	else return false;
+}
+
+/** Writes the extension bytes of a length that did not fit into a token nibble.
+ */
+static bool lzPutLength(Uint8 *dst, int dstSize, int *pos, int length) {
+	for ( ; length>=255; length -= 255) if (!lzPutByte(dst,dstSize,pos,255)) return false;
+	return lzPutByte(dst,dstSize,pos,length);
+}
+
+static bool lzPutSequence(Uint8 *dst, int dstSize, int *pos, const Uint8 *literals, int nLiterals,
+	int offset, int matchLength) {
+
+	const int m = matchLength>0 ? matchLength-LZ_BLOCK_MATCH_MIN : 0;
+	if (!lzPutByte(dst,dstSize,pos, (nLiterals<15 ? nLiterals : 15)<<4 | (m<15 ? m : 15))
+	|| nLiterals>=15 && !lzPutLength(dst,dstSize,pos,nLiterals-15)) return false;
+
+	for (int i=0; i<nLiterals; i++) if (!lzPutByte(dst,dstSize,pos,literals[i])) return false;
+
+	if (matchLength>0) return lzPutByte(dst,dstSize,pos,offset)
+		&& (m<15 || lzPutLength(dst,dstSize,pos,m-15));
+	else return true;
+}
+
+int lzBlockCompress(Uint8 *dst, int dstSize, const Uint8 *src, int n) {
+	int pos = 0;
+	int anchor = 0;		// first literal not yet written
+
+	for (int i=0; i+LZ_BLOCK_MATCH_MIN<=n; ) {
+		int bestLength = 0;
+		int bestOffset = 0;
+		for (int offset=1; offset<=LZ_BLOCK_OFFSET_MAX && offset<=i; offset++) {
+			const Uint8 *match = src+i-offset;
+			int length = 0;
+			while (i+length<n && match[length]==src[i+length]) length++;
+			if (length>bestLength) {
+				bestLength = length;
+				bestOffset = offset;
+				if (i+length==n) break;		// cannot be improved
+			}
+		}
+		if (bestLength>=LZ_BLOCK_MATCH_MIN) {
+			if (!lzPutSequence(dst,dstSize,&pos,src+anchor,i-anchor,bestOffset,bestLength)) return -1;
+			i += bestLength;
+			anchor = i;
+		}
+		else i++;
+	}
+	if (anchor<n && !lzPutSequence(dst,dstSize,&pos,src+anchor,n-anchor,0,0)) return -1;
+
+	return pos;
+}
+
+/** Reads the extension bytes of a length.
+ * @return the length or -1 in case of missing input.
+ */
+static int lzGetLength(const Uint8 *src, int n, int *pos, int length) {
+	if (length==15) for (int more=255; more==255; ) {
+		if (*pos>=n) return -1;
+		more = src[(*pos)++];
+		length += more;
+	}
+	return length;
+}
+
+int lzBlockDecompress(Uint8 *dst, int dstSize, const Uint8 *src, int n) {
+	int out = 0;
+	for (int pos=0; pos<n; ) {
+		const int token = src[pos++];
+		const int nLiterals = lzGetLength(src,n,&pos,token>>4);
+		if (nLiterals<0 || nLiterals>n-pos || nLiterals>dstSize-out) return -1;
+		for (int i=0; i<nLiterals; i++) dst[out++] = src[pos++];
+
+		if (pos<n) {
+			const int offset = src[pos++];
+			const int m = lzGetLength(src,n,&pos,token & 0xF);
+			if (m<0 || offset==0 || offset>out) return -1;
+			const int matchLength = m + LZ_BLOCK_MATCH_MIN;
+			if (matchLength>dstSize-out) return -1;
+			for (int i=0; i<matchLength; i++, out++) dst[out] = dst[out-offset];	// may overlap
+		}
+	}
+	return out;
+}
+
@@ -0,0 +1,59 @@
+/*
+  lzBlock.h - LZ4-style compression of small blocks.
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __lzBlock_h
+#define __lzBlock_h
+
+#include <integers.h>
+
+/** @file
+ * @brief LZ4-style compression of small blocks (up to some hundred bytes).
+ *
+ * The compressed data is a sequence of tokens, each one followed by literals and an optional match:
+ *   - token: upper nibble = number of literals, lower nibble = match length - LZ_BLOCK_MATCH_MIN. A nibble value of 15
+ *     is continued by additional bytes that are added, until a byte is less than 255.
+ *   - the literals.
+ *   - if the compressed data is not exhausted yet: the match offset (1 byte, 1..LZ_BLOCK_OFFSET_MAX) back from the
+ *     current output position. Matches may overlap the output position, so runs of equal bytes compress well.
+ *
+ * Offsets refer to the decompressed block only, so the decompressor needs no memory besides the destination block
+ * and the compressed data. It runs in fixed memory and checks all bounds, making it suitable for boot loaders.
+ */
+
+enum {
+	LZ_BLOCK_MATCH_MIN	=4,	///< shortest match encoded
+	LZ_BLOCK_OFFSET_MAX	=255,	///< largest match distance
+};
+
+/** Compresses a block.
+ * @param dst destination of the compressed data.
+ * @param dstSize maximum size of the compressed data. Choose it smaller than n to detect incompressible data.
+ * @param src the block to compress.
+ * @param n the size of the block.
+ * @return the size of the compressed data, or -1 if it would exceed dstSize.
+ */
+int lzBlockCompress(Uint8 *dst, int dstSize, const Uint8 *src, int n);
+
+/** Decompresses a block.
+ * @param dst destination of the decompressed data.
+ * @param dstSize the size of the destination.
+ * @param src the compressed data.
+ * @param n the size of the compressed data.
+ * @return the size of the decompressed data, or -1 in case of malformed data or insufficient dstSize.
+ */
+int lzBlockDecompress(Uint8 *dst, int dstSize, const Uint8 *src, int n);
+
+#endif
+
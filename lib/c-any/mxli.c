@@ -10,12 +10,22 @@ bool lpcCommand(const LpcIspIo *io, char command, const Uint32 *params, int nPar
 #include <int32Math.h>
 #include <int32Pair.h>
 #include <uu.h>
+#include <crc.h>
+#include <string.h>
 
 #include <ansi.h>
 #include <macros.h>
 
 bool (*lpcIspFlowControlHook)(const LpcIspIo *io, char code) = 0;
 
+/** Processing times of the ISP handler, used for the timeouts of compare and CRC commands.
+ * Conservative values for the LPC running on its IRC.
+ */
+enum {
+	LPC_ISP_COMPARE_US_PER_KI	=1024,	///< 1us per byte
+	LPC_ISP_CRC_US_PER_KI		=8*1024,	///< bitwise CRC32: 8us per byte
+};
+
 // some convenience functions
 //
 
@@ -66,11 +76,34 @@ void debugMessage (const LpcIspIo *io, const char *msg) {
 	}
 }
 
+/** Mirrors received characters to stderr in debug mode, one push per span instead of per character.
+ */
+static void debugReceived (const LpcIspIo *io, const char *data, Uint32 n) {
+	if (io->debugLevel>=LPC_ISP_DEBUG && n>0) {
+		fifoPrintString (io->stderr,BLUE);
+		for (Uint32 i=0; i<n; i++) {
+			if (fifoCanWrite (io->stderr) < 4+sizeof NORMAL) pushStderr (io);
+			fifoPrintCharEscaped (io->stderr,data[i]);
+		}
+		fifoPrintString (io->stderr,NORMAL);
+		pushStderr (io);
+	}
+}
+
+/** Checks, if a character terminates a span of line contents: CR, LF or XON/XOFF.
+ * All of them are below 0x14, so ordinary text costs a single comparison.
+ */
+static inline bool ispSpecialChar (char c) {
+	return (Uint8)c<=0x13 && (c=='\n' || c=='\r' || c==0x11 || c==0x13);
+}
+
 /** This function reads in the answer from the LPC into fifoInLine. Any previous contents of the line is discarded.
  * It quickly reads in all characters up to an CR or LF. CR and LF are both represented by LF in the Fifo.
  * Two different LF/CR in direct succession are avoided. If no CR or LF is found, this function runs into a timeout
  * that should terminate this simple application. The state is hidden in the global variable patch, because in a
  * perfect world, it would not exist at all.
+ * The received data is tokenized span by span: ordinary characters up to the next special character are added to
+ * the line at once, only the special character itself changes the state (patch.lineChar).
  * @return true, if a line was read, false if timeout happened or buffer was too small.
  */
 bool loadNextLine(const LpcIspIo *io) {
@@ -79,52 +112,52 @@ bool loadNextLine(const LpcIspIo *io) {
 	fifoInvalidateWrites(io->lpcInLine);
 
 	while (true) {
-		while (fifoCanRead (io->lpcIn)) {
-			const char c = fifoRead (io->lpcIn);
-			if (io->debugLevel>=LPC_ISP_DEBUG) {
-				fifoPrintString (io->stderr,BLUE);
-				fifoPrintCharEscaped (io->stderr,c);
-				fifoPrintString (io->stderr,NORMAL);
-				pushStderr (io);
+		for (Uint32 n; 0!=(n = fifoCanReadLinear (io->lpcIn)); ) {
+			const char *span = fifoReadLinear (io->lpcIn);
+			Uint32 data = 0;
+			while (data<n && !ispSpecialChar (span[data])) data++;
+
+			if (data>0) {	// line contents
+				fifoSkipRead (io->lpcIn,data);
+				fifoValidateWrites (io->lpcInLine,data);
+				patch.lineChar = 0;
+			}
+			if (data==n) {
+				debugReceived (io,span,data);
+				continue;
 			}
 
-			switch(c) {
-				case 0x13:	// flow control: stop
-				case 0x11:	// flow control: start
-					if (io->debugLevel>=LPC_ISP_NORMAL) {
-						fifoPrintString (io->stderr,"ERROR: Flow control not implemented :-(\n");
-						pushStderr (io);
-					}
-					return false;
-				case '\n':
-				case '\r':
-					if (!patch.lineChar && c!=patch.lineChar) {	// don't recognize different line chars in succession
-						if (io->debugLevel>=LPC_ISP_DEBUG) {
-							fifoPrintString (io->stderr,"LINE BREAK:\\");
-							fifoPrintChar (io->stderr,c=='\n' ? 'n' : 'r');
-							fifoPrintChar (io->stderr,'\n');
-							pushStderr (io);
-						}
-						patch.lineChar = c;
-						return true;
-					}
-					else {	// skip that useless character
-						fifoValidateWrite (io->lpcInLine);	// add it to the line and...
-						fifoRead (io->lpcInLine);		// ... destroy it.
-						if (io->debugLevel>=LPC_ISP_DEBUG) {
-							if (io->debugLevel>=LPC_ISP_DEBUG) {
-								fifoPrintString (io->stderr,"DISCARD:\\");
-								fifoPrintChar (io->stderr,c=='\n' ? 'n' : 'r'); // discard line separators in succession
-								fifoPrintLn (io->stderr);
-								pushStderr (io);
-							}
-						}
-					}
-					patch.lineChar = c;	// remember
-					break;
-				default:
-					fifoValidateWrite (io->lpcInLine);
-					patch.lineChar = 0;
+			const char c = span[data];
+			fifoSkipRead (io->lpcIn,1);
+			debugReceived (io,span,data+1);
+
+			if (c==0x11 || c==0x13) {	// flow control: start/stop
+				if (io->debugLevel>=LPC_ISP_NORMAL) {
+					fifoPrintString (io->stderr,"ERROR: Flow control not implemented :-(\n");
+					pushStderr (io);
+				}
+				return false;
+			}
+			else if (!patch.lineChar) {	// don't recognize different line chars in succession
+				if (io->debugLevel>=LPC_ISP_DEBUG) {
+					fifoPrintString (io->stderr,"LINE BREAK:\\");
+					fifoPrintChar (io->stderr,c=='\n' ? 'n' : 'r');
+					fifoPrintChar (io->stderr,'\n');
+					pushStderr (io);
+				}
+				patch.lineChar = c;
+				return true;
+			}
+			else {	// skip that useless character
+				fifoValidateWrite (io->lpcInLine);	// add it to the line and...
+				fifoRead (io->lpcInLine);		// ... destroy it.
+				if (io->debugLevel>=LPC_ISP_DEBUG) {
+					fifoPrintString (io->stderr,"DISCARD:\\");
+					fifoPrintChar (io->stderr,c=='\n' ? 'n' : 'r'); // discard line separators in succession
+					fifoPrintLn (io->stderr);
+					pushStderr (io);
+				}
+				patch.lineChar = c;	// remember
 			}
 		}
 		// reload for next loop
@@ -153,15 +186,13 @@ bool loadN (const LpcIspIo *io, Uint32 n) {
 	fifoInvalidateWrites(io->lpcInLine);
 
 	while (fifoCanRead(io->lpcInLine)<n) {
-		if (fifoCanRead (io->lpcIn)) {
-			const char c = fifoRead (io->lpcIn);
-			fifoValidateWrite (io->lpcInLine);
-			if (io->debugLevel>=LPC_ISP_DEBUG) {
-				fifoPrintString (io->stderr,BLUE);
-				fifoPrintCharEscaped (io->stderr,c);
-				fifoPrintString (io->stderr,NORMAL);
-				pushStderr (io);
-			}
+		if (fifoCanRead (io->lpcIn)) {	// binary payload: move whole spans
+			const Uint32 missing = n - fifoCanRead (io->lpcInLine);
+			const Uint32 linear = fifoCanReadLinear (io->lpcIn);
+			const Uint32 span = linear<missing ? linear : missing;
+			debugReceived (io,fifoReadLinear (io->lpcIn),span);
+			fifoSkipRead (io->lpcIn,span);
+			fifoValidateWrites (io->lpcInLine,span);
 		}
 		else if (!pullLpcIn (io)) {
 			errorMessage (io,"Data expected from LPC\n");
@@ -320,6 +351,7 @@ bool readUnsignedValues(const LpcIspIo *io, Uint32 *values, int n) {
 /** Maximum detailed diagnostics.
  */
 bool lpcSync(const LpcIspIo *io, int crystalHz) {
+	setTimeoutExtraUs (io,0);
 
 	if (fifoPrintString(io->lpcOut,"?\r\n")
 	&& pushLpcOut(io)) {
@@ -425,6 +457,7 @@ bool lpcGo(const LpcIspIo *io, Uint32 pc, bool thumbMode) {
 
 	Uint32 result;
 	const char *pattern = "G ";
+	setTimeoutExtraUs (io,0);
 	if (fifoPrintString (io->lpcOut, pattern)
 	&& fifoPrintUint32 (io->lpcOut, pc, 1)
 	&& fifoPrintString (io->lpcOut, thumbMode ? " T" : " A")
@@ -460,6 +493,7 @@ bool lpcCommandWrite (const LpcIspIo *io, char command, const Uint32 *params, in
 			return false;
 		}
 	}
+	setTimeoutExtraUs (io,0);	// every command starts with the plain serial timeout
 	bool success = fifoPrintChar (io->lpcOut, command);
 	for (int i=0; i<nParams; i++) {
 		success = success
@@ -488,14 +522,25 @@ bool lpcCommandRead (const LpcIspIo *io, char command, Uint32 *result, Uint32 *r
 	}
 }
 
-bool lpcCommand(const LpcIspIo *io, char command, const Uint32 *params, int nParams, Uint32 *results, int nResults) {
+/** Sends a command and reads its answer, allowing for the time the LPC needs to execute it.
+ * @param us the expected execution time, granted in addition to the serial timeout.
+ */
+bool lpcCommandTimed(const LpcIspIo *io, char command, const Uint32 *params, int nParams, Uint32 *results, int nResults,
+	Uint32 us) {
+
 	Uint32 returnCode;
-	return	lpcCommandWrite (io,command,params,nParams)
-		&& lpcCommandRead (io,command,&returnCode,0,0)
+	if (!lpcCommandWrite (io,command,params,nParams)) return false;
+
+	setTimeoutExtraUs (io,us);
+	return	lpcCommandRead (io,command,&returnCode,0,0)
 		&& returnCode==LPC_ISP_CMD_SUCCESS		// need a successful execution
 		&& readUnsignedValues (io, results,nResults);
 }
 
+bool lpcCommand(const LpcIspIo *io, char command, const Uint32 *params, int nParams, Uint32 *results, int nResults) {
+	return lpcCommandTimed (io,command,params,nParams,results,nResults,0);
+}
+
 bool lpcBaud(const LpcIspIo *io, int baud, int stopBits) {
 	Uint32 params[2] = { baud, stopBits };
 	return lpcCommand (io, 'B', params, 2, 0, 0);
@@ -524,37 +569,87 @@ bool lpcReadBootCodeVersion(const LpcIspIo *io, Uint32 *version) {
 	else return false;
 }
 
+static bool partIdMessage (const LpcIspIo *io, int i, Uint32 id) {
+	if (io->debugLevel>=LPC_ISP_INFO) {
+		fifoPrintString (io->stderr, "got ID[");
+		fifoPrintInt32 (io->stderr, i, 1);
+		fifoPrintString (io->stderr, "]=0x");
+		fifoPrintHex (io->stderr, id,8,8);
+		fifoPrintString (io->stderr, "\n");
+		pushStderr (io);
+	}
+	return true;
+}
+
+static bool partIdFailed (const LpcIspIo *io, int i) {
+	if (io->debugLevel>=LPC_ISP_NORMAL) {
+		fifoPrintString (io->stderr, "Failed to get ID[");
+		fifoPrintInt32 (io->stderr,i,1);
+		fifoPrintString (io->stderr, "\n");
+		pushStderr (io);
+	}
+	return false;
+}
+
+/** Reads the lines of a second J answer, that follows the first one. The first ID is never 0 and every answer starts
+ * with the return code 0. So, if k extra IDs were delivered, the values following the first ID are
+ * id[1]..id[k], 0, id[0], id[1]..id[k]. An echo line J marks the start of the second answer directly.
+ */
+static bool lpcReadPartIdsPipelined (const LpcIspIo *io, Uint32 partIds[LPC_IDS]) {
+	Uint32 values[2*LPC_IDS+1];
+	int n = 0;
+	while (n<ELEMENTS(values)) {
+		if (!loadLineOnDemand (io)) return partIdFailed (io,n);
+
+		if (findStringInLine (io,"J")) {	// echo of second command: n extra IDs
+			Uint32 result;
+			const int extra = n;
+			if (extra>=LPC_IDS
+			|| !readResult (io,"J",&result)
+			|| !readUnsignedValues (io,values,1+extra)
+			|| values[0]!=partIds[0]) return partIdFailed (io,extra);
+			for (int i=1; i<=extra; i++) partIds[i] = values[i];
+			return true;
+		}
+		if (!findUnsigned (io,&values[n++])) return partIdFailed (io,n);
+
+		for (int extra=0; extra<LPC_IDS && extra+2<=n; extra++) {
+			if (values[extra]==LPC_ISP_CMD_SUCCESS && values[extra+1]==partIds[0]) {
+				for (int i=1; i<=extra; i++) partIds[i] = values[i-1];
+				// consume the rest of the second answer
+				const int missing = extra - (n-(extra+2));
+				return readUnsignedValues (io,values,missing);
+			}
+		}
+	}
+	return partIdFailed (io,LPC_IDS);
+}
+
 bool lpcReadPartId(const LpcIspIo *io, LpcMembers const *members, Uint32 partIds[LPC_IDS], int ids) {
+	for (int i=0; i<LPC_IDS; i++) partIds[i] = 0;
+
+	if (ids<=0) {	// probing
+		Uint32 result;
+		if (lpcCommandWrite (io,'J',0,0)
+		&& lpcCommandWrite (io,'J',0,0)
+		&& lpcCommandRead (io,'J',&result,partIds,1)
+		&& partIdMessage (io,0,partIds[0])
+		&& lpcReadPartIdsPipelined (io,partIds)) {
+			for (int i=1; i<LPC_IDS && partIds[i]!=0; i++) partIdMessage (io,i,partIds[i]);
+			return true;
+		}
+		else return false;
+	}
+
 	if (lpcCommand (io,'J', 0,0, partIds, 1)) {	// read one part ID first.
-		int n = ids;
-		if (n<=0) n = members->thePreferred ? lpcMatchNumberOfIds(members->thePreferred,partIds[0]) : 0;
-		if (n<=0) n = lpcFindNumberOfIds(members->list,partIds[0]);
-		for (int i=1; i<n; i++) {
+		for (int i=1; i<ids; i++) {
 			if (loadLineOnDemand (io)
-			&& findUnsigned(io,&partIds[i])) {	// fine
-				if (io->debugLevel>=LPC_ISP_INFO) {
-					fifoPrintString (io->stderr, "got ID[");
-					fifoPrintInt32 (io->stderr, i, 1);
-					fifoPrintString (io->stderr, "]=0x");
-					fifoPrintHex (io->stderr, partIds[i],8,8);
-					fifoPrintString (io->stderr, "\n");
-					pushStderr (io);
-				}
-			}
-			else {
-				if (io->debugLevel>=LPC_ISP_NORMAL) {
-					fifoPrintString (io->stderr, "Failed to get ID[");
-					fifoPrintInt32 (io->stderr,i,1);
-					fifoPrintString (io->stderr, "\n");
-					pushStderr (io);
-				}
-				return false;
-			}
+			&& findUnsigned(io,&partIds[i])) partIdMessage (io,i,partIds[i]);
+			else return partIdFailed (io,i);
 		}
 		return true;
 	}
 	else return false;
-
 }
 
 //Reads out the device serial number. @param sn 4 32-bit integers.
@@ -562,9 +657,9 @@ bool lpcReadUid(const LpcIspIo *io, Uint32 uids[4]) {
 	return lpcCommand (io, 'N', 0,0, uids, 4);
 }
 
-bool lpcCopyRamToFlash(const LpcIspIo *io, Uint32 addressFlash, Uint32 addressRam, int n) {
+bool lpcCopyRamToFlash(const LpcIspIo *io, LpcFamily const *family, Uint32 addressFlash, Uint32 addressRam, int n) {
 	Uint32 params[3] = { addressFlash, addressRam, n };
-	return lpcCommand (io, 'C', params,3, 0,0);
+	return lpcCommandTimed (io, 'C', params,3, 0,0, lpcFamilyProgramUs (family,n));
 }
 
 bool lpcValidateSectors (const LpcIspIo *io, int sectorStart, int sectorEnd) {
@@ -592,14 +687,15 @@ bool lpcPrepareForWrite(const LpcIspIo *io, int sectorStart, int sectorEnd, bool
 	else return false;
 }
 
-bool lpcErase(const LpcIspIo *io, int sectorStart, int sectorEnd, bool banked) {
+bool lpcErase(const LpcIspIo *io, LpcFamily const *family, int sectorStart, int sectorEnd, bool banked) {
 	if (lpcValidateSectors (io,sectorStart,sectorEnd)) {
 		const Uint32 params[3] = {
 			sectorStart & SECTOR_MASK,
 			sectorEnd & SECTOR_MASK,
 			sectorToBankIdx (sectorStart)
 		};
-		return lpcCommand (io,'E', params, banked?3:2, 0,0);
+		const int sectors = (sectorEnd & SECTOR_MASK) - (sectorStart & SECTOR_MASK) + 1;
+		return lpcCommandTimed (io,'E', params, banked?3:2, 0,0, lpcFamilyEraseUs (family,sectors));
 	}
 	else return false;
 }
@@ -611,12 +707,22 @@ bool lpcUnlock(const LpcIspIo *io) {
 
 bool lpcCompare(const LpcIspIo *io, Uint32 addrA, Uint32 addrB, int n) {
 	const Uint32 params[3] = { addrA, addrB, n };
-	return lpcCommand (io,'M',params,3,0,0);
+	Uint32 returnCode = LPC_ISP_UNDEFINED;
+	if (lpcCommandWrite (io,'M',params,3)) {
+		setTimeoutExtraUs (io, (Uint64)n*LPC_ISP_COMPARE_US_PER_KI/1024);
+		if (readResult (io,"M",&returnCode)) return true;
+		else {	// a mismatch is followed by the offset of the first difference, that must be consumed.
+			Uint32 offset;
+			if (returnCode==LPC_ISP_COMPARE_ERROR) readUnsignedValues (io,&offset,1);
+			return false;
+		}
+	}
+	else return false;
 }
 
 bool lpcReadCrc(const LpcIspIo *io, Uint32 addr, int n, Uint32 *crc) {
 	const Uint32 params[2] = { addr, n };
-	return lpcCommand (io,'S',params,2, crc,1);
+	return lpcCommandTimed (io,'S',params,2, crc,1, (Uint64)n*LPC_ISP_CRC_US_PER_KI/1024);
 }
 
 bool lpcSetFlashBank(const LpcIspIo *io, int flashBank) {
@@ -713,6 +819,7 @@ bool lpcWriteBinary(const LpcIspIo *io, const LpcIspConfigCom *com, Uint32 addre
 
 		//if (!flowControlHook('w',"w (write block[%d]).",(int)fifoCanRead(&fifoOut))) return false;
 		if (!pushLpcOut(io)) return errorMessage (io,"IO error.\n");
+		setTimeoutExtraUs (io, lpcIspTransmissionTimeUs (com,n));
 
 		//if (!flowControlHook('r',"W (write block, read answer block[%d]).",(int)cs)) return false;
 
@@ -752,6 +859,8 @@ bool lpcWriteUuencode(const LpcIspIo *io, const LpcIspConfigCom *com, Uint32 add
 			pushStderr (io);
 		}
 
+		// uuencoding adds 1/3 plus line overhead; the checksum arrives after the transmission of 20 lines.
+		setTimeoutExtraUs (io, lpcIspTransmissionTimeUs (com, (n<20*45 ? n : 20*45)*3/2 + 32));
 		Uint32 checksum=0;
 		for (int lineNo=0; fifoCanRead(data); lineNo++) {
 			//if (!flowControlHook('w',"w (write uuencoded line).")) return false;
@@ -810,6 +919,7 @@ bool lpcReadBinary(const LpcIspIo *io, const LpcIspConfigCom *com, Fifo *data, U
 	const Uint32 params[2] = { address, n };
 
 	if (lpcCommand (io,'R',params,2, 0,0)) {
+		setTimeoutExtraUs (io, lpcIspTransmissionTimeUs (com,n));
 		// :o) There's always a \n in the output stream
 		// It seems, LPC800 always prefixes the binary data with a \n
 		if (loadN (io,1)	// skip \n
@@ -830,6 +940,7 @@ bool lpcReadUuencode(const LpcIspIo *io, const LpcIspConfigCom *com, Fifo *data,
 	const Uint32 r0 = fifoCanRead (data);	// initial read position - data may not be empty!
 
 	if (lpcCommand (io,'R',params,2, 0,0)) {
+		setTimeoutExtraUs (io, lpcIspTransmissionTimeUs (com, (n<20*45 ? n : 20*45)*3/2 + 32));
 
 		Uint32 checksum=0;
 		for (int lineNo=0; fifoCanRead (data)-r0 <n; lineNo++) {
@@ -1055,22 +1166,142 @@ bool lpcHandleCrp (
 	else return errorMessage (io, "CRP not contained in this chunk\n");	// CRP not accessible in this chunk!
 }
 
-bool lpcFlash (
-	const LpcIspIo *io,
-	const LpcIspConfigCom *com,
-	const LpcIspFlashOptions *options,
-	const LpcMember *member,
-	const Executable32Segment *segments
-	) {
+/** Resume information of lpcFlash.
+ */
+typedef struct {
+	int				sector;			///< sector being written, -1 if none
+	Executable32SegmentIterator	sectorIterator;		///< image position of its first chunk
+	int				sectorComplete;		///< last completely written sector, -1 if none
+	Executable32SegmentIterator	sectorCompleteIterator;	///< image position of its first chunk
+} LpcFlashProgress;
+
+/** Loads one chunk of the image, padded with 0xFF, with CRP and checksum fixed, if necessary.
+ */
+static bool lpcFlashChunkLoad (const LpcIspIo *io, const LpcIspFlashOptions *options, const LpcMember *member,
+	const Executable32Segment *segment, Fifo *fifoChunk, int chunkSize) {
+
+	fifoReset (fifoChunk);
+	fifoWriteN (fifoChunk, segment->data, segment->size);
+	while (fifoCanRead(fifoChunk)<chunkSize) fifoPrintChar(fifoChunk,0xFF);		// padding
+
+	const Uint32 bankAddress = lpcAddressToBankAddress(member, segment->address);
+	const Uint32 offsetInBank = segment->address - bankAddress;
+
+	// fix CRP, if neccessary.
+	if (offsetInBank <= options->crpOffsetBank
+	&& options->crpOffsetBank < offsetInBank + chunkSize) {
+		const CrpSettings crp = {
+			.address = options->crpOffsetBank,
+			.max = options->crpAllow,
+			.desired = options->crpDesired,
+		};
+		if (!lpcHandleCrp (io, &crp, offsetInBank, fifoChunk)) return false;	// failed to fix CRP
+	}
 
-	// first calculate affected sectors
-	const Uint32 nSegments = executable32Segments (segments);
+	// fix checksum, if neccessary
+	if (offsetInBank==0 && member->family->checksumVectors>0) {
+		return lpcHandleChecksum (io, member, segment->address, fifoChunk);
+	}
+	else return true;
+}
 
-	// try unlock. It's needed for every non-empty image.
-	if (nSegments>0 && !lpcUnlock (io)) return false;
+/** Resets the LPC into the ISP handler after a communication failure, discarding all data in transit.
+ */
+static bool lpcFlashReenterIsp (const LpcIspIo *io, const LpcIspConfigCom *com, const LpcIspFlashOptions *options) {
+	if (!lpcWavePlay (io,options->waveConfiguration,options->waveIsp,"Re-enter ISP")) return false;
+
+	setTimeoutExtraUs (io,0);
+	fifoSkipRead (io->lpcOut, fifoCanRead (io->lpcOut));
+	do {	// drop stale answers
+		fifoSkipRead (io->lpcIn, fifoCanRead (io->lpcIn));
+		*io->lpcInLine = *io->lpcIn;
+		fifoInvalidateWrites (io->lpcInLine);
+	} while (pullLpcIn (io));
+	patch.lineChar = 0;
+
+	return lpcSync (io, com->crystalHz)
+		&& lpcComReconfigure (io, com)
+		&& lpcUnlock (io);
+}
 
-	Int32Pair sectorRanges [nSegments];
-	for (int s=0; s<nSegments; s++) {
+/** Compares the FLASH contents of one sector with the image.
+ * The first 512 bytes of a bank are not compared, because the boot ROM is mapped there in ISP mode.
+ * @param iterator the image position of the first chunk of the sector.
+ * @param ramAddress a transfer RAM chunk used for the comparison.
+ */
+static bool lpcFlashVerifySector (const LpcIspIo *io, const LpcIspConfigCom *com, const LpcIspFlashOptions *options,
+	const LpcMember *member, const Executable32Segment *segments, Executable32SegmentIterator iterator, int sector,
+	Fifo *fifoChunk, int chunkSize, Uint32 ramAddress) {
+
+	enum { BOOT_ROM_MAPPED = 512 };
+	while (true) {
+		const Executable32Segment segment = executable32NextChunk (segments,&iterator,chunkSize);
+		if (segment.size==0 || lpcAddressToSector (member,segment.address)!=sector) return true;
+
+		const Uint32 offsetInBank = segment.address - lpcAddressToBankAddress (member,segment.address);
+		const int skip = offsetInBank<BOOT_ROM_MAPPED ? BOOT_ROM_MAPPED-offsetInBank : 0;
+		if (lpcFlashChunkLoad (io,options,member,&segment,fifoChunk,chunkSize)
+		&& lpcWrite (io,com,ramAddress,fifoChunk)
+		&& (skip>=chunkSize || lpcCompare (io,segment.address+skip,ramAddress+skip,chunkSize-skip))) ;	// fine
+		else return false;
+	}
+}
+
+static bool lpcFlashEraseSector (const LpcIspIo *io, const LpcIspFlashOptions *options, const LpcMember *member,
+	int sector) {
+
+	if (io->debugLevel>=LPC_ISP_PROGRESS) {
+		fifoPrintString (io->stderr, "Erase sector ");
+		fifoPrintSector (io->stderr, sector);
+		fifoPrintString (io->stderr, " for rewriting\n");
+		pushStderr (io);
+	}
+	return lpcPrepareForWrite (io,sector,sector,options->banked)
+		&& lpcErase (io,member->family,sector,sector,options->banked);
+}
+
+/** Re-enters ISP after a communication failure and prepares rewriting the first incomplete sector.
+ * The last complete sector is verified and rewritten, too, if it does not match the image.
+ * @param progress the write progress, updated to restart at progress->sectorIterator.
+ * @return true, if writing can continue at progress->sectorIterator.
+ */
+static bool lpcFlashResume (const LpcIspIo *io, const LpcIspConfigCom *com, const LpcIspFlashOptions *options,
+	const LpcMember *member, const Executable32Segment *segments, LpcFlashProgress *progress,
+	Fifo *fifoChunk, int chunkSize, Uint32 ramAddress) {
+
+	if (options->waveIsp==0) return false;
+
+	warnMessage (io, "communication failure while writing, resuming.\n");
+	if (!lpcFlashReenterIsp (io,com,options)) return errorMessage (io, "cannot re-enter ISP\n");
+
+	if (progress->sectorComplete!=-1
+	&& !lpcFlashVerifySector (io,com,options,member,segments,progress->sectorCompleteIterator,progress->sectorComplete,
+		fifoChunk,chunkSize,ramAddress)) {
+		warnMessage (io, "last completed sector differs from image, rewriting it.\n");
+		if (!lpcFlashEraseSector (io,options,member,progress->sectorComplete)) return false;
+		if (progress->sector==-1) {
+			progress->sector = progress->sectorComplete;
+			progress->sectorIterator = progress->sectorCompleteIterator;
+		}
+		else {	// both sectors are rewritten
+			if (!lpcFlashEraseSector (io,options,member,progress->sector)) return false;
+			progress->sectorIterator = progress->sectorCompleteIterator;
+		}
+		progress->sectorComplete = -1;
+		return true;
+	}
+	// the current sector may be partially written
+	return progress->sector==-1 || lpcFlashEraseSector (io,options,member,progress->sector);
+}
+
+/** Calculates the FLASH sectors covered by every segment.
+ * @param sectorRanges the first and last sector of every segment.
+ * @return true, if all segments are within FLASH.
+ */
+static bool lpcFlashSectorRanges (const LpcIspIo *io, const LpcMember *member, const Executable32Segment *segments,
+	Int32Pair *sectorRanges) {
+
+	for (int s=0; s<executable32Segments (segments); s++) {
 		sectorRanges[s].fst = lpcAddressToSector (member, segments[s].address);
 		sectorRanges[s].snd = lpcAddressToSector (member, segments[s].address + segments[s].size-1);
 		if (sectorRanges[s].fst==-1 || sectorRanges[s].snd==-1) {
@@ -1083,39 +1314,45 @@ bool lpcFlash (
 			return false;
 		}
 	}
+	return true;
+}
 
-	// then erase them, if requested
-	if (options->eraseBeforeWrite) for (int s=0; s<nSegments; s++) {
-		for (int sector=sectorRanges[s].fst; sector<=sectorRanges[s].snd; sector++) {
-			bool blank;
-			if (!options->eraseOnDemand	// erase always, not on demand
-			|| lpcBlankCheck (io,sector,sector,&blank,options->banked) && !blank) {	// erase only if needed
-				if (io->debugLevel>=LPC_ISP_PROGRESS) {
-					fifoPrintString (io->stderr, "Erase sector ");
-					fifoPrintSector (io->stderr, sector);
-					fifoPrintString (io->stderr, " before write\n");
-					pushStderr (io);
-				}
-				if (lpcPrepareForWrite (io,sector,sector,options->banked)
-				&& lpcErase (io,sector,sector,options->banked)) ;	// fine
-				else  {
-					errorMessage (io,"erase on demand failed\n");
-					return false;
-				}
-			}
-			else ;	// already blank
+/** Erases a sector before writing.
+ * @param onDemand only erase the sector, if blank check fails.
+ */
+static bool lpcFlashEraseOnDemand (const LpcIspIo *io, const LpcMember *member, int sector, bool onDemand,
+	bool banked) {
+
+	bool blank;
+	if (!onDemand	// erase always, not on demand
+	|| lpcBlankCheck (io,sector,sector,&blank,banked) && !blank) {	// erase only if needed
+		if (io->debugLevel>=LPC_ISP_PROGRESS) {
+			fifoPrintString (io->stderr, "Erase sector ");
+			fifoPrintSector (io->stderr, sector);
+			fifoPrintString (io->stderr, " before write\n");
+			pushStderr (io);
 		}
+		if (lpcPrepareForWrite (io,sector,sector,banked)
+		&& lpcErase (io,member->family,sector,sector,banked)) return true;
+		else return errorMessage (io,"erase on demand failed\n");
 	}
-	// else assume, they're already blanked
-	
+	else return true;	// already blank
+}
+
+/** Finds the transfer RAM buffers and the size of the chunks they are divided into.
+ * @param buffers the transfer RAM buffers (unpartitioned).
+ * @param nBuffers the number of buffers found.
+ * @return the chunk size, or 0 in case of an error.
+ */
+static int lpcFlashChunkSize (const LpcIspIo *io, const LpcMember *member, LpcIspBuffer buffers[LPC_ISP_BUFFERS],
+	int *nBuffers) {
 
 	// find RAM and block size
-	LpcIspBuffer buffers [LPC_ISP_BUFFERS];
-	const int nBuffers = lpcIspGetBuffers (member,buffers);
+	*nBuffers = lpcIspGetBuffers (member,buffers);
 
 	if (io->debugLevel>=LPC_ISP_INFO) {
 		fifoPrintString (io->stderr, "Transfer RAM buffers (unpartitioned):\n");
-		for (int b=0; b<nBuffers; b++) {
+		for (int b=0; b<*nBuffers; b++) {
 			fifoPrintString (io->stderr,"  #");
 			fifoPrintInt32 (io->stderr,b,2);
 			fifoPrintString (io->stderr," @ 0x");
@@ -1136,20 +1373,56 @@ bool lpcFlash (
 
 	// Default: smallest chunk size. 
 	int chunkSize = member->family->blockSizes[0];	// smallest size
-	if (chunkSize==0) return errorMessage (io,"member->family->blockSizes[0] == 0  (lpcMemories.c invalid data)\n");
-	const int maxRam = chunkSize * lpcIspBufferChunkCount (buffers,nBuffers,chunkSize);
+	if (chunkSize==0) {
+		errorMessage (io,"member->family->blockSizes[0] == 0  (lpcMemories.c invalid data)\n");
+		return 0;
+	}
+	const int maxRam = chunkSize * lpcIspBufferChunkCount (buffers,*nBuffers,chunkSize);
 
 	// now try better (bigger chunks at the expense of up to 50% total size) ...
 	for (int bs=1; bs<LPC_BLOCK_SIZES && member->family->blockSizes[bs]!=0; bs++) {
 		const int blockSize = member->family->blockSizes[bs];
-		if (blockSize * lpcIspBufferChunkCount (buffers,nBuffers,blockSize) >= maxRam / 2) {
+		if (blockSize * lpcIspBufferChunkCount (buffers,*nBuffers,blockSize) >= maxRam / 2) {
 			chunkSize = blockSize;
 		}
 	}
 
 	if (maxRam==0) {
-		return errorMessage (io,"No transfer RAM found\n");
+		errorMessage (io,"No transfer RAM found\n");
+		return 0;
+	}
+	return chunkSize;
+}
+
+bool lpcFlash (
+	const LpcIspIo *io,
+	const LpcIspConfigCom *com,
+	const LpcIspFlashOptions *options,
+	const LpcMember *member,
+	const Executable32Segment *segments
+	) {
+
+	// first calculate affected sectors
+	const Uint32 nSegments = executable32Segments (segments);
+
+	// try unlock. It's needed for every non-empty image.
+	if (nSegments>0 && !lpcUnlock (io)) return false;
+
+	Int32Pair sectorRanges [nSegments];
+	if (!lpcFlashSectorRanges (io,member,segments,sectorRanges)) return false;
+
+	// then erase them, if requested
+	if (options->eraseBeforeWrite) for (int s=0; s<nSegments; s++) {
+		for (int sector=sectorRanges[s].fst; sector<=sectorRanges[s].snd; sector++) {
+			if (!lpcFlashEraseOnDemand (io,member,sector,options->eraseOnDemand,options->banked)) return false;
+		}
 	}
+	// else assume, they're already blanked
+	
+	LpcIspBuffer buffers [LPC_ISP_BUFFERS];
+	int nBuffers;
+	const int chunkSize = lpcFlashChunkSize (io,member,buffers,&nBuffers);
+	if (chunkSize==0) return false;
 
 	const int nChunks = lpcIspBufferChunkCount (buffers,nBuffers,chunkSize);
 	LpcIspBuffer chunks [nChunks];
@@ -1174,45 +1447,33 @@ bool lpcFlash (
 	// we have different granularities: sectors, chunks, segments.
 	// every sector needs a prepare for write before transfering RAM to FLASH.
 	Executable32SegmentIterator iterator = { };	// all zeros
+	Executable32SegmentIterator chunkIterators [nChunks];	// image position of every chunk
 
 	char fifoBuffer [chunkSize];
 	Fifo fifoChunk = { fifoBuffer, sizeof fifoBuffer, };
 
+	// progress, for resuming: all sectors written before 'sector' are complete.
+	LpcFlashProgress progress = { .sector = -1, .sectorComplete = -1, };
+	int retries = options->retries;
+
 	bool finished = false;
 	while (!finished) {
+		bool failed = false;
 		int c = 0;
 		for (; c<nChunks; c++) {
+			chunkIterators [c] = iterator;
 			const Executable32Segment segment = executable32NextChunk (segments,&iterator,chunkSize);
 			if (segment.size>0) {
 				chunkFlashAddresses [c] = segment.address;
 				chunks [c].size = segment.size;
 				//chunks [c].address = unchanged: RAM address
 				// write chunk to LPC
-				fifoReset (&fifoChunk);
-				fifoWriteN (&fifoChunk, segment.data, segment.size);
-				while (fifoCanRead(&fifoChunk)<chunkSize) fifoPrintChar(&fifoChunk,0xFF);		// padding
-
-				const Uint32 bankAddress = lpcAddressToBankAddress(member, segment.address);
-				const Uint32 offsetInBank = segment.address - bankAddress;
-
-				// fix CRP, if neccessary.
-				if (offsetInBank <= options->crpOffsetBank
-				&& options->crpOffsetBank < offsetInBank + chunkSize) {
-					const CrpSettings crp = {
-						.address = options->crpOffsetBank,
-						.max = options->crpAllow,
-						.desired = options->crpDesired,
-					};
-					if (!lpcHandleCrp (io, &crp, offsetInBank, &fifoChunk)) return false;	// failed to fix CRP
-				}
+				if (!lpcFlashChunkLoad (io,options,member,&segment,&fifoChunk,chunkSize)) return false;
 
-				// fix checksum, if neccessary
-				if (offsetInBank==0 && member->family->checksumVectors>0) {
-					if (lpcHandleChecksum (io, member, segment.address, &fifoChunk));	// all fine
-					else return false;
+				if (!lpcWrite (io,com, chunks[c].address,&fifoChunk)) {
+					failed = true;
+					break;
 				}
-
-				if (!lpcWrite (io,com, chunks[c].address,&fifoChunk)) return false;
 			}
 			else {
 				finished = c==0;
@@ -1221,10 +1482,18 @@ bool lpcFlash (
 		}
 
 		// copy RAM-to-FLASH for all chunks
-		for (int tc=0; tc<c; tc++) {
+		for (int tc=0; !failed && tc<c; tc++) {
 			const Uint32 flashAddress = chunkFlashAddresses[tc];
 			const Uint32 ramAddress = chunks[tc].address;
 			const Uint32 sector = lpcAddressToSector (member,flashAddress);
+			if (sector!=progress.sector) {	// the previous sector is complete now
+				if (progress.sector!=-1) {
+					progress.sectorComplete = progress.sector;
+					progress.sectorCompleteIterator = progress.sectorIterator;
+				}
+				progress.sector = sector;
+				progress.sectorIterator = chunkIterators[tc];
+			}
 			// what will we do ? ...
 			if (io->debugLevel >= LPC_ISP_PROGRESS) {
 				fifoPrintString (io->stderr, "RAM 0x");
@@ -1235,10 +1504,20 @@ bool lpcFlash (
 				pushStderr (io);
 			}
 			// ...and do it:
-			if (lpcPrepareForWrite (io, sector,sector,options->banked)
-			&& lpcCopyRamToFlash (io, flashAddress ,ramAddress , chunkSize)) {
+			failed = !lpcPrepareForWrite (io, sector,sector,options->banked)
+				|| !lpcCopyRamToFlash (io, member->family, flashAddress ,ramAddress , chunkSize);
+		}
+
+		if (failed) {	// resuming may fail over the same line, too
+			bool resumed = false;
+			while (!resumed && retries-- > 0) {
+				resumed = lpcFlashResume (io,com,options,member,segments,&progress,&fifoChunk,chunkSize,
+					chunks[0].address);
 			}
-			else return false;
+			if (!resumed) return false;
+			iterator = progress.sectorIterator;
+			progress.sector = -1;
+			finished = false;
 		}
 	}
 	return true;
@@ -1246,30 +1525,486 @@ bool lpcFlash (
 }
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Precompiled flash plans.
+
+static const char lpcFlashPlanMagic[8] = "mxliPLAN";
+
+static Uint32 lpcFlashPlanAlign (Uint32 n) {
+	return n+3 & ~3;
+}
+
+/** CRC-32 of everything following the crc field.
+ */
+static Uint32 lpcFlashPlanCrc (const LpcFlashPlan *plan) {
+	const Uint8 *start = (const Uint8*)plan->name;
+	return crc32FeedN (0, start, plan->size - (start - (const Uint8*)plan));
+}
+
+static const LpcFlashPlanChunk* lpcFlashPlanChunks (const LpcFlashPlan *plan) {
+	return (const LpcFlashPlanChunk*)(plan+1);
+}
+
+/** Copies data into the plan, if it fits.
+ */
+static void lpcFlashPlanPut (LpcFlashPlan *plan, Uint32 size, Uint32 offset, const void *data, Uint32 n) {
+	if (plan!=0 && offset+n<=size) memcpy ((char*)plan+offset, data, n);
+}
+
+/** Encodes a chunk like lpcWriteUuencode transmits it: lines of 45 bytes, a checksum line after every 20 lines.
+ */
+static bool lpcFlashPlanEncode (Fifo *encoded, Fifo *data) {
+	Uint32 checksum = 0;
+	for (int lineNo=0; fifoCanRead(data); lineNo++) {
+		if (!fifoUuEncodeLine (encoded,data,&checksum)) return false;
+		if ((lineNo%20)==19 || !fifoCanRead(data)) {
+			if (!fifoPrintUint32 (encoded,checksum,1)
+			|| !fifoPrintString (encoded,"\r\n")) return false;
+			checksum = 0;
+		}
+	}
+	return true;
+}
+
+/** Upper limit of the encoded size of a chunk.
+ */
+static int lpcFlashPlanEncodedMax (int chunkSize) {
+	const int lines = (chunkSize+44)/45;
+	return lines*(1+60+2) + (lines/20+1)*(10+2);
+}
+
+int lpcFlashPlanCompile (const LpcIspIo *io, LpcFlashPlan *plan, Uint32 size, const LpcIspConfigCom *com,
+	const LpcIspFlashOptions *options, const LpcMember *member, const Executable32Segment *segments) {
+
+	const int nSegments = executable32Segments (segments);
+	if (nSegments>LPC_FLASH_PLAN_RANGES) {
+		errorMessage (io,"too many segments for a flash plan\n");
+		return -1;
+	}
+	Int32Pair sectorRanges [nSegments];
+	if (!lpcFlashSectorRanges (io,member,segments,sectorRanges)) return -1;
+
+	LpcIspBuffer buffers [LPC_ISP_BUFFERS];
+	int nBuffers;
+	const int chunkSize = lpcFlashChunkSize (io,member,buffers,&nBuffers);
+	if (chunkSize==0) return -1;
+
+	const int nRamChunks = lpcIspBufferChunkCount (buffers,nBuffers,chunkSize);
+	LpcIspBuffer ramChunks [nRamChunks];
+	lpcIspBufferChunkPartition (ramChunks,chunkSize, buffers,nBuffers);
+
+	// the number of image chunks determines the start of the payloads
+	Uint32 nChunks = 0;
+	for (Executable32SegmentIterator iterator = {}; executable32NextChunk (segments,&iterator,chunkSize).size>0; )
+		nChunks++;
+
+	LpcFlashPlan header = {
+		.version = LPC_FLASH_PLAN_VERSION,
+		.chunkSize = chunkSize,
+		.protocol = com->ispProtocol,
+		.banked = options->banked,
+		.erase = !options->eraseBeforeWrite ? LPC_FLASH_PLAN_ERASE_NONE
+			: options->eraseOnDemand ? LPC_FLASH_PLAN_ERASE_ON_DEMAND : LPC_FLASH_PLAN_ERASE_RANGES,
+		.nEraseRanges = nSegments,
+		.nChunks = nChunks,
+	};
+	memcpy (header.magic, lpcFlashPlanMagic, sizeof header.magic);
+	for (int i=0; i<sizeof header.name-1 && member->name[i]!=0; i++) header.name[i] = member->name[i];
+	for (int s=0; s<nSegments; s++) header.eraseRanges[s] = sectorRanges[s];
+
+	char fifoBuffer [chunkSize];
+	Fifo fifoChunk = { fifoBuffer, sizeof fifoBuffer, };
+	char encodedBuffer [lpcFlashPlanEncodedMax (chunkSize)];
+	Fifo fifoEncoded = { encodedBuffer, sizeof encodedBuffer, };
+
+	Uint32 offset = sizeof header + nChunks*sizeof (LpcFlashPlanChunk);
+	Executable32SegmentIterator iterator = { };
+	for (Uint32 c=0; c<nChunks; c++) {
+		const Executable32Segment segment = executable32NextChunk (segments,&iterator,chunkSize);
+		if (!lpcFlashChunkLoad (io,options,member,&segment,&fifoChunk,chunkSize)) return -1;
+
+		LpcFlashPlanChunk chunk = {
+			.flashAddress = segment.address,
+			.ramAddress = ramChunks[c%nRamChunks].address,
+			.round = c/nRamChunks,
+			.sector = lpcAddressToSector (member,segment.address),
+			.crc = crc32FeedN (0,(const Uint8*)fifoBuffer,chunkSize),
+			.payloadOffset = offset,
+		};
+		lpcFlashPlanPut (plan,size,offset,fifoBuffer,chunkSize);
+		offset += lpcFlashPlanAlign (chunkSize);
+
+		if (com->ispProtocol==ISP_PROTOCOL_UUENCODE) {
+			fifoReset (&fifoEncoded);
+			if (!lpcFlashPlanEncode (&fifoEncoded,&fifoChunk)) {
+				errorMessage (io,"Uuencode error\n");
+				return -1;
+			}
+			chunk.encodedOffset = offset;
+			chunk.encodedSize = fifoCanRead (&fifoEncoded);
+			lpcFlashPlanPut (plan,size,offset,encodedBuffer,chunk.encodedSize);
+			offset += lpcFlashPlanAlign (chunk.encodedSize);
+		}
+		lpcFlashPlanPut (plan,size,sizeof header + c*sizeof chunk,&chunk,sizeof chunk);
+	}
+
+	header.size = offset;
+	if (plan!=0 && offset<=size) {
+		lpcFlashPlanPut (plan,size,0,&header,sizeof header);
+		plan->crc = lpcFlashPlanCrc (plan);
+	}
+	return offset;
+}
+
+/** Checks, if the encoded text of a chunk is exactly the transmission of its payload.
+ */
+static bool lpcFlashPlanEncodedMatches (const LpcFlashPlan *plan, const LpcFlashPlanChunk *chunk) {
+	const char *payload = (const char*)plan + chunk->payloadOffset;
+	ReadFifo data = { (char*)payload, .size = plan->chunkSize, .wTotal = plan->chunkSize, };
+	char encodedBuffer [lpcFlashPlanEncodedMax (plan->chunkSize)];
+	Fifo fifoEncoded = { encodedBuffer, sizeof encodedBuffer, };
+
+	return lpcFlashPlanEncode (&fifoEncoded,&data)
+		&& fifoCanRead (&fifoEncoded)==chunk->encodedSize
+		&& 0==memcmp (encodedBuffer,(const char*)plan + chunk->encodedOffset,chunk->encodedSize);
+}
+
+bool lpcFlashPlanValidate (const LpcIspIo *io, const LpcFlashPlan *plan, Uint32 size) {
+	if (size<sizeof *plan
+	|| memcmp (plan->magic,lpcFlashPlanMagic,sizeof plan->magic)
+	|| plan->version!=LPC_FLASH_PLAN_VERSION) return errorMessage (io,"not a flash plan (of this version)\n");
+
+	// plan->size must cover the header and the chunk table before anything is read by plan->size.
+	if (plan->size>size
+	|| plan->size<sizeof *plan
+	|| plan->nChunks > (plan->size-sizeof *plan) / sizeof (LpcFlashPlanChunk)) {
+		return errorMessage (io,"flash plan truncated\n");
+	}
+	if (plan->crc!=lpcFlashPlanCrc (plan)) return errorMessage (io,"flash plan CRC mismatch\n");
+
+	if (plan->name[sizeof plan->name-1]!=0
+	|| plan->chunkSize==0 || plan->chunkSize>64*1024
+	|| plan->protocol!=ISP_PROTOCOL_UUENCODE && plan->protocol!=ISP_PROTOCOL_BINARY
+	|| plan->erase>LPC_FLASH_PLAN_ERASE_ON_DEMAND
+	|| plan->nEraseRanges>LPC_FLASH_PLAN_RANGES) return errorMessage (io,"flash plan header invalid\n");
+
+	for (Uint32 r=0; r<plan->nEraseRanges; r++) {
+		const Int32Pair range = plan->eraseRanges[r];
+		if (range.fst<0 || range.fst>range.snd
+		|| range.fst>>_SECTOR_BANK != range.snd>>_SECTOR_BANK) return errorMessage (io,"flash plan erase range invalid\n");
+	}
+
+	const LpcFlashPlanChunk *chunks = lpcFlashPlanChunks (plan);
+	for (Uint32 c=0; c<plan->nChunks; c++) {
+		const LpcFlashPlanChunk *chunk = &chunks[c];
+		if (chunk->payloadOffset>plan->size || plan->size-chunk->payloadOffset<plan->chunkSize
+		|| chunk->encodedOffset>plan->size || plan->size-chunk->encodedOffset<chunk->encodedSize
+		|| c>0 && chunk->round<chunks[c-1].round) return errorMessage (io,"flash plan chunk invalid\n");
+
+		if (chunk->crc!=crc32FeedN (0,(const Uint8*)plan + chunk->payloadOffset,plan->chunkSize)) {
+			return errorMessage (io,"flash plan payload CRC mismatch\n");
+		}
+		if (plan->protocol==ISP_PROTOCOL_UUENCODE && !lpcFlashPlanEncodedMatches (plan,chunk)) {
+			return errorMessage (io,"flash plan encoded data does not match payload\n");
+		}
+	}
+	return true;
+}
+
+bool fifoPrintLpcFlashPlan (Fifo *fifo, const LpcFlashPlan *plan) {
+	static const char* const erase[] = { "none", "ranges", "on demand" };
+	const LpcFlashPlanChunk *chunks = lpcFlashPlanChunks (plan);
+	const Uint32 rounds = plan->nChunks>0 ? chunks[plan->nChunks-1].round+1 : 0;
+
+	bool success = fifoPrintString (fifo, "Flash plan for ")
+		&& fifoPrintString (fifo, plan->name)
+		&& fifoPrintString (fifo, ", ")
+		&& fifoPrintUint32 (fifo, plan->size, 1)
+		&& fifoPrintString (fifo, " bytes, CRC 0x")
+		&& fifoPrintHex (fifo, plan->crc, 8,8)
+		&& fifoPrintString (fifo, plan->protocol==ISP_PROTOCOL_BINARY ? ", BINARY\n" : ", UUENCODE\n")
+		&& fifoPrintString (fifo, "  chunks: ")
+		&& fifoPrintUint32 (fifo, plan->nChunks, 1)
+		&& fifoPrintString (fifo, " of ")
+		&& fifoPrintUint32 (fifo, plan->chunkSize, 1)
+		&& fifoPrintString (fifo, " bytes in ")
+		&& fifoPrintUint32 (fifo, rounds, 1)
+		&& fifoPrintString (fifo, " round(s)\n  erase: ")
+		&& fifoPrintString (fifo, erase[plan->erase]);
+	for (int r=0; r<plan->nEraseRanges; r++) {
+		success = success
+			&& fifoPrintString (fifo, r==0 ? ", sectors " : ", ")
+			&& fifoPrintSector (fifo, plan->eraseRanges[r].fst)
+			&& fifoPrintString (fifo, "..")
+			&& fifoPrintSector (fifo, plan->eraseRanges[r].snd);
+	}
+	return success && fifoPrintLn (fifo);
+}
+
+/** Position after the next line end of a text.
+ */
+static Uint32 lpcTextNextLine (const char *text, Uint32 size, Uint32 pos) {
+	while (pos<size && text[pos++]!='\n') ;
+	return pos;
+}
+
+/** Transmits the pre-encoded text of a chunk like lpcWriteUuencode does. Without echo, 20 lines and their checksum
+ * line are sent at once.
+ */
+static bool lpcWriteUuencoded (const LpcIspIo *io, const LpcIspConfigCom *com, Uint32 address, Uint32 n,
+	const char *text, Uint32 size) {
+
+	Uint32 params[2] = { address, n };
+	if (!lpcCommand (io, 'W', params, 2, 0,0)) return false;	// announce write
+
+	if (io->debugLevel>=LPC_ISP_PROGRESS) {
+		fifoPrintString (io->stderr, "Download to RAM [");
+		fifoPrintUint32 (io->stderr, n, 1);
+		fifoPrintString (io->stderr,"@0x");
+		fifoPrintHex (io->stderr,address,8,8);
+		pushStderr (io);
+	}
+
+	setTimeoutExtraUs (io, lpcIspTransmissionTimeUs (com, (n<20*45 ? n : 20*45)*3/2 + 32));
+	const int lines = (n+44)/45;
+	Uint32 pos = 0;
+	for (int lineNo=0; lineNo<lines; lineNo++) {
+		const Uint32 end = lpcTextNextLine (text,size,pos);
+		if (!fifoPutN (io->lpcOut,text+pos,end-pos)) return errorMessage (io,"output buffer overflow\n");
+		pos = end;
+		if (com->useEcho) {
+			if (!pushLpcOut (io)) return errorMessage (io,"IO error.\n");
+			if (!loadNextLine (io)) return errorMessage (io,"Uuencoded echo line missing.\n");
+		}
+
+		if ((lineNo%20)==19 || lineNo==lines-1) {	// time to send a checksum
+			const Uint32 end = lpcTextNextLine (text,size,pos);
+			Uint32 checksum = 0;
+			for (Uint32 i=pos; i<end && '0'<=text[i] && text[i]<='9'; i++) checksum = checksum*10 + text[i]-'0';
+			Uint32 checksumReturn;
+			if (fifoPutN (io->lpcOut,text+pos,end-pos)
+			&& pushLpcOut (io)
+			&& (!com->useEcho || readUnsignedValues(io,&checksumReturn,1)
+				&& checksum==checksumReturn)	// this checks communication only!
+			&& loadLineOnDemand (io)
+			&& findStringInLineOrError (io,"OK")) {
+				progressMessage (io, ".");	// show progress, checksum confirmed
+			}
+			else return errorMessage (io, "checksum invalid.\n");
+			pos = end;
+		}
+	}
+	progressMessage (io,"]\n");
+	return true;
+}
+
+static bool lpcFlashPlanWrite (const LpcIspIo *io, const LpcIspConfigCom *com, const LpcFlashPlan *plan,
+	const LpcFlashPlanChunk *chunk) {
+
+	const char *payload = (const char*)plan + chunk->payloadOffset;
+	if (plan->protocol==ISP_PROTOCOL_UUENCODE) {
+		return lpcWriteUuencoded (io,com,chunk->ramAddress,plan->chunkSize,
+			(const char*)plan + chunk->encodedOffset,chunk->encodedSize);
+	}
+	else {
+		ReadFifo data = { (char*)payload, .size = plan->chunkSize, .wTotal = plan->chunkSize, };
+		return lpcWriteBinary (io,com,chunk->ramAddress,&data);
+	}
+}
+
+/** Checks the sectors and addresses of a validated plan against the device, as the plan's CRC only detects
+ * accidental corruption.
+ */
+static bool lpcFlashPlanMatchesMember (const LpcMember *member, const LpcFlashPlan *plan) {
+	for (Uint32 r=0; r<plan->nEraseRanges; r++) {
+		const Int32Pair range = plan->eraseRanges[r];
+		const int lastSector = lpcBankToLastSector (member, range.snd>>_SECTOR_BANK);
+		if (lastSector==-1 || range.snd>lastSector) return false;
+	}
+
+	const LpcFlashPlanChunk *chunks = lpcFlashPlanChunks (plan);
+	for (Uint32 c=0; c<plan->nChunks; c++) {
+		const LpcFlashPlanChunk *chunk = &chunks[c];
+		if (chunk->flashAddress+plan->chunkSize < chunk->flashAddress
+		|| lpcAddressToSector (member,chunk->flashAddress)!=chunk->sector
+		|| lpcAddressToSector (member,chunk->flashAddress+plan->chunkSize-1)==-1) return false;
+	}
+	return true;
+}
+
+bool lpcFlashPlanExecute (const LpcIspIo *io, const LpcIspConfigCom *com, const LpcMember *member,
+	const LpcFlashPlan *plan) {
+
+	if (strcmp (plan->name,member->name)) return errorMessage (io,"flash plan compiled for a different device\n");
+	if (plan->protocol!=com->ispProtocol) return errorMessage (io,"flash plan compiled for a different protocol\n");
+	if (!lpcFlashPlanMatchesMember (member,plan)) return errorMessage (io,"flash plan does not match device\n");
+
+	if (plan->nChunks>0 && !lpcUnlock (io)) return false;
+
+	for (int r=0; r<plan->nEraseRanges; r++) {
+		const Int32Pair range = plan->eraseRanges[r];
+		switch (plan->erase) {
+			case LPC_FLASH_PLAN_ERASE_RANGES:
+				if (io->debugLevel>=LPC_ISP_PROGRESS) {
+					fifoPrintString (io->stderr, "Erase sectors ");
+					fifoPrintSector (io->stderr, range.fst);
+					fifoPrintString (io->stderr, "..");
+					fifoPrintSector (io->stderr, range.snd);
+					fifoPrintString (io->stderr, " before write\n");
+					pushStderr (io);
+				}
+				if (!lpcPrepareForWrite (io,range.fst,range.snd,plan->banked)
+				|| !lpcErase (io,member->family,range.fst,range.snd,plan->banked)) {
+					return errorMessage (io,"erase failed\n");
+				}
+				break;
+			case LPC_FLASH_PLAN_ERASE_ON_DEMAND:
+				for (int sector=range.fst; sector<=range.snd; sector++) {
+					if (!lpcFlashEraseOnDemand (io,member,sector,true,plan->banked)) return false;
+				}
+				break;
+			default: ;	// assume, they're already blanked
+		}
+	}
+
+	const LpcFlashPlanChunk *chunks = lpcFlashPlanChunks (plan);
+	for (Uint32 first=0; first<plan->nChunks; ) {
+		Uint32 end = first;
+		for (; end<plan->nChunks && chunks[end].round==chunks[first].round; end++) {
+			if (!lpcFlashPlanWrite (io,com,plan,&chunks[end])) return false;
+		}
+
+		for (Uint32 c=first; c<end; c++) {
+			if (io->debugLevel >= LPC_ISP_PROGRESS) {
+				fifoPrintString (io->stderr, "RAM 0x");
+				fifoPrintHex (io->stderr,chunks[c].ramAddress,8,8);
+				fifoPrintString (io->stderr," -> FLASH 0x");
+				fifoPrintHex (io->stderr,chunks[c].flashAddress,8,8);
+				fifoPrintLn (io->stderr);
+				pushStderr (io);
+			}
+			if (!lpcPrepareForWrite (io, chunks[c].sector,chunks[c].sector,plan->banked)
+			|| !lpcCopyRamToFlash (io, member->family, chunks[c].flashAddress,chunks[c].ramAddress,plan->chunkSize))
+				return false;
+		}
+		first = end;
+	}
+	return true;
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // RTS/DTR wave form definitions.
 //
 
+/** The character of a signal change in -W wave definitions.
+ */
+static char waveSignalChar (char cmd) {
+	switch(cmd) {
+		case WAVE_CMD_D0: return 'd';
+		case WAVE_CMD_D1: return 'D';
+		case WAVE_CMD_R0: return 'r';
+		case WAVE_CMD_R1: return 'R';
+		default: return '?';
+	}
+}
+
+/** Actual timing of a signal change.
+ */
+typedef struct {
+	char	signals[3];		///< the changed signals in -W notation, like "dr"
+	Int32	atUs;			///< completion of the change, relative to the start of the wave
+	Int32	lateUs;			///< completion of the change, relative to its deadline
+} WaveEdge;
+
+static void fifoPrintWaveTiming (Fifo *fifo, const WaveEdge *edges, int nEdges) {
+	Int32 worstUs = 0;
+	fifoPrintString (fifo, "Wave timing:");
+	for (int e=0; e<nEdges; e++) {
+		fifoPrintString (fifo, e==0 ? " " : ", ");
+		fifoPrintString (fifo, edges[e].signals);
+		fifoPrintString (fifo, " at ");
+		fifoPrintSDec (fifo, edges[e].atUs, 1, 10, false);
+		fifoPrintString (fifo, "us (");
+		fifoPrintSDec (fifo, edges[e].lateUs, 1, 10, true);
+		fifoPrintString (fifo, ")");
+		if (edges[e].lateUs>worstUs) worstUs = edges[e].lateUs;
+	}
+	fifoPrintString (fifo, ", worst +");
+	fifoPrintSDec (fifo, worstUs, 1, 10, false);
+	fifoPrintString (fifo, "us\n");
+}
+
+/** Plays a wave. If the IO provides a clock, pauses are deadlines based on the completion of the preceding signal
+ * change. Sleeping inaccuracies do not accumulate over multiple pauses then, while every pulse is at least as long
+ * as requested. The achieved timing is reported with LPC_ISP_INFO.
+ */
 bool lpcWavePlay (const LpcIspIo *io, const WaveConfiguration *conf, const Wave *wave, const char* prompt) {
 	const char *cmds = wave->commands;
+	const bool deadlines = io->clockUs!=0 && io->sleepUntilUs!=0;
+	const Int64 startUs = deadlines ? io->clockUs() : 0;
+	Int64 deadlineUs = startUs;		// end of the pauses since the latest signal change
+	WaveEdge edges[WAVE_CMDS_MAX];
+	int nEdges = 0;
 
+	if (io->setRealtime!=0) io->setRealtime (true);
 	while (*cmds!=WAVE_CMD_END) {
-		switch(*cmds) {
-		case WAVE_CMD_D0: io->setDtr (false); break;
-		case WAVE_CMD_D1: io->setDtr (true); break;
-		case WAVE_CMD_R0: io->setRts (false); break;
-		case WAVE_CMD_R1: io->setRts (true); break;
-		case WAVE_CMD_PAUSE_SHORT: io->sleepUs (conf->pauseShortUs); break;
-		case WAVE_CMD_PAUSE_LONG: io->sleepUs (conf->pauseLongUs); break;
-		case WAVE_CMD_PROMPT:
-			fifoPrintString (io->stderr, prompt);
-			pushStderr (io);
-			lpcIspFlowControlHook (io, '?');
-			break;
-		default:
-			errorMessage (io, "wavePlay() #1.\n");
+		char signals[3] = {};
+
+		// a change of both signals in direct succession is performed at once, if possible
+		const bool dtrThenRts = (cmds[0]==WAVE_CMD_D0 || cmds[0]==WAVE_CMD_D1)
+			&& (cmds[1]==WAVE_CMD_R0 || cmds[1]==WAVE_CMD_R1);
+		const bool rtsThenDtr = (cmds[0]==WAVE_CMD_R0 || cmds[0]==WAVE_CMD_R1)
+			&& (cmds[1]==WAVE_CMD_D0 || cmds[1]==WAVE_CMD_D1);
+		if (io->setRtsDtr!=0 && (dtrThenRts || rtsThenDtr)) {
+			const char dtr = dtrThenRts ? cmds[0] : cmds[1];
+			const char rts = dtrThenRts ? cmds[1] : cmds[0];
+			io->setRtsDtr (rts==WAVE_CMD_R1, dtr==WAVE_CMD_D1);
+			signals[0] = waveSignalChar (cmds[0]);
+			signals[1] = waveSignalChar (cmds[1]);
+			cmds += 2;
+		}
+		else {
+			switch(*cmds) {
+			case WAVE_CMD_D0: io->setDtr (false); break;
+			case WAVE_CMD_D1: io->setDtr (true); break;
+			case WAVE_CMD_R0: io->setRts (false); break;
+			case WAVE_CMD_R1: io->setRts (true); break;
+			case WAVE_CMD_PAUSE_SHORT:
+			case WAVE_CMD_PAUSE_LONG: {
+				const Int32 us = *cmds==WAVE_CMD_PAUSE_SHORT ? conf->pauseShortUs : conf->pauseLongUs;
+				deadlineUs += us;
+				if (deadlines) io->sleepUntilUs (deadlineUs);
+				else io->sleepUs (us);
+			} break;
+			case WAVE_CMD_PROMPT:
+				fifoPrintString (io->stderr, prompt);
+				pushStderr (io);
+				lpcIspFlowControlHook (io, '?');
+				if (deadlines) deadlineUs = io->clockUs();
+				break;
+			default:
+				errorMessage (io, "wavePlay() #1.\n");
+			}
+			signals[0] = *cmds==WAVE_CMD_PAUSE_SHORT || *cmds==WAVE_CMD_PAUSE_LONG || *cmds==WAVE_CMD_PROMPT
+				? 0 : waveSignalChar (*cmds);
+			cmds++;
 		}
-		cmds++;
+
+		if (deadlines && signals[0]!=0) {
+			const Int64 nowUs = io->clockUs();
+			WaveEdge *edge = &edges[nEdges++];
+			memcpy (edge->signals, signals, sizeof edge->signals);
+			edge->atUs = nowUs - startUs;
+			edge->lateUs = nowUs - deadlineUs;
+			deadlineUs = nowUs;
+		}
+	}
+	if (io->setRealtime!=0) io->setRealtime (false);
+
+	if (nEdges>0 && io->debugLevel>=LPC_ISP_INFO) {
+		fifoPrintWaveTiming (io->stderr, edges, nEdges);
+		pushStderr (io);
 	}
 	return true;
 }
@@ -13,7 +13,7 @@
 #include <executable32.h>
 #include <int32PairList.h>
 
-enum {
+typedef enum {
 	LPC_ISP_SILENT =-1,		///< don't show errors.
 	LPC_ISP_NORMAL,			///< show errors and explicit output.
 	LPC_ISP_PROGRESS,		///< show progress bars.
@@ -47,7 +47,13 @@ struct LpcIspIo {
 	bool	(*pushStderr)(const LpcIspIo*);
 	bool	(*setDtr)(bool level);		///< serial DTR signal, used for /RESET (active low, typically)
 	bool	(*setRts)(bool level);		///< serial RTS signal, used for /BOOT (active low, typically)
+	bool	(*setRtsDtr)(bool rts, bool dtr);	///< both signals at the same time. Optional.
 	void	(*sleepUs)(Int32 us);		///< busy delay for generating pulse widths.
+	Int64	(*clockUs)(void);		///< monotonic clock for wave deadlines. Optional.
+	void	(*sleepUntilUs)(Int64 us);	///< waits until clockUs() reaches us. Optional, requires clockUs.
+	void	(*setRealtime)(bool on);	///< raises the scheduling priority during wave playback. Optional.
+	void	(*setTimeoutExtraUs)(Uint32 us);	///< time granted in addition to the serial timeout for the
+						///< answers until the next command. Optional.
 
 	char	debugLevel;
 };
@@ -57,6 +63,12 @@ struct Patch {
 };
 extern struct Patch patch;
 
+/** Reads the next line of the LPC's answer into lpcInLine. CR, LF and broken sequences of them end a line.
+ * @param io the communication channels
+ * @return true, if a line was read, false if timeout happened or buffer was too small.
+ */
+bool loadNextLine(const LpcIspIo *io);
+
 /** Communication parameters, including MCU/boot loader/board specific settings.
  */
 typedef struct {
@@ -132,11 +144,12 @@ bool lpcComReconfigure (const LpcIspIo *io, const LpcIspConfigCom *com);
  */
 bool lpcReadBootCodeVersion(const LpcIspIo *io, Uint32 *version);
 
-/** Reads a device's part ID(s). Some devices have more than 1 ID and the number of IDs is derived from the value of
- * the first ID. This requires the member info.
+/** Reads a device's part ID(s). Some devices have more than 1 ID. When probing, J is sent twice in a row and the
+ * number of IDs is derived from where the second answer starts in the stream, so neither member info nor a timeout
+ * is needed.
  * @param io the communication channels.
- * @param members the list of supported devices.
- * @param partIds the result array.
+ * @param members the list of supported devices. Currently unused.
+ * @param partIds the result array. IDs not delivered by the device are set to 0.
  * @param ids if !=0 then this is the exact number of IDs to read. Set to 0 for probing.
  * @return true on successful execution, false otherwise.
  */
@@ -165,10 +178,16 @@ bool lpcReadBinary (const LpcIspIo *io, const LpcIspConfigCom *com, Fifo *data,
 bool lpcReadUuencode (const LpcIspIo *io, const LpcIspConfigCom *com, Fifo *data, Uint32 address, Uint32 n);
 bool lpcRead (const LpcIspIo *io, const LpcIspConfigCom *com, Fifo *data, Uint32 address, Uint32 n);
 
-bool lpcCopyRamToFlash (const LpcIspIo *io, Uint32 addressFlash, Uint32 addressRam, int n);
+/** Copies RAM to FLASH, waiting for the modelled programming time.
+ * @param family the FLASH timing model, 0 for a conservative default.
+ */
+bool lpcCopyRamToFlash (const LpcIspIo *io, LpcFamily const *family, Uint32 addressFlash, Uint32 addressRam, int n);
 bool lpcValidateSectors (const LpcIspIo *io, int sectorStart, int sectorEnd);
 bool lpcPrepareForWrite (const LpcIspIo *io, int sectorStart, int sectorEnd, bool banked);
-bool lpcErase (const LpcIspIo *io, int sectorStart, int sectorEnd, bool banked);
+/** Erases sectors, waiting for the modelled erase time.
+ * @param family the FLASH timing model, 0 for a conservative default.
+ */
+bool lpcErase (const LpcIspIo *io, LpcFamily const *family, int sectorStart, int sectorEnd, bool banked);
 bool lpcUnlock (const LpcIspIo *io);
 bool lpcCompare (const LpcIspIo *io, Uint32 addrA, Uint32 addrB, int n);
 bool lpcReadCrc (const LpcIspIo *io, Uint32 addr, int n, Uint32 *crc);
@@ -187,6 +206,14 @@ inline static bool pullLpcIn (const LpcIspIo *io) {
 	return io->pullLpcIn (io);
 }
 
+/** Grants additional time for the answers of the current command, like erasing or data transfers.
+ * @param io The communication channels
+ * @param us the time in addition to the serial timeout, until the next command is sent.
+ */
+inline static void setTimeoutExtraUs (const LpcIspIo *io, Uint32 us) {
+	if (io->setTimeoutExtraUs!=0) io->setTimeoutExtraUs (us);
+}
+
 inline static bool pushLpcOut (const LpcIspIo *io) {
 	return io->pushLpcOut (io);
 }
@@ -212,6 +239,10 @@ inline static void debugOut(const LpcIspIo *io, const char *msg) {
  */
 bool errorMessage (const LpcIspIo *io, const char *msg);
 
+/** Outputs the message as a warning, if not in silent mode.
+ */
+void warnMessage (const LpcIspIo *io, const char *msg);
+
 void progressMessage(const LpcIspIo *io, const char *msg);
 
 /** Always returns true, but outputs the message only, if in debug mode.
@@ -232,29 +263,6 @@ bool lpcHandleCrp (
 
 bool lpcHandleChecksum (const LpcIspIo *io, const LpcMember *member, Uint32 address, Fifo *fifoChunk);
 
-typedef struct {
-	bool	eraseBeforeWrite;	///< erase destination sectors before writing
-	bool	eraseOnDemand;		///< blank check before erase.
-	Int8	crpAllow;		///< maximum allowed CRP level
-	Int8	crpDesired;		///< desired CRP level
-	Uint32	crpOffsetBank;		///< location of the CRP word
-	bool	banked;			///< use banked commands?
-} LpcIspFlashOptions;
-
-typedef struct {
-	Uint32		size;		///< size==0 indicates end of list.
-	Uint32		address;
-	const Uint32*	contents;	///< word-aligned data
-} LpcImageSegment;
-
-bool lpcFlash (
-	const LpcIspIo *io,
-	const LpcIspConfigCom *com,
-	const LpcIspFlashOptions *options,
-	const LpcMember *member,
-	const Executable32Segment *segments
-	);
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // RTS/DTR wave form definitions.
 //
@@ -304,7 +312,8 @@ typedef struct {
  */
 bool waveCompile (const LpcIspIo *io, WaveSet *waveSet, Fifo* input);
 
-/** Generates the signals on the serial channel as described in wave.
+/** Generates the signals on the serial channel as described in wave. With io->clockUs and io->sleepUntilUs, pauses
+ * are absolute deadlines and the achieved timing is reported with LPC_ISP_INFO.
  * @param io the communication channels
  * @param conf the signal timing configuration
  * @param wave the signal definition
@@ -313,5 +322,133 @@ bool waveCompile (const LpcIspIo *io, WaveSet *waveSet, Fifo* input);
  */
 bool lpcWavePlay (const LpcIspIo *io, const WaveConfiguration *conf, const Wave *wave, const char *prompt);
 
-#endif
+typedef struct {
+	bool	eraseBeforeWrite;	///< erase destination sectors before writing
+	bool	eraseOnDemand;		///< blank check before erase.
+	Int8	crpAllow;		///< maximum allowed CRP level
+	Int8	crpDesired;		///< desired CRP level
+	Uint32	crpOffsetBank;		///< location of the CRP word
+	bool	banked;			///< use banked commands?
+	int	retries;		///< how often to resume after communication failures, 0: give up on first failure
+	const Wave		*waveIsp;		///< how to re-enter ISP for resuming, 0: no resume
+	const WaveConfiguration	*waveConfiguration;	///< timing of waveIsp
+} LpcIspFlashOptions;
+
+typedef struct {
+	Uint32		size;		///< size==0 indicates end of list.
+	Uint32		address;
+	const Uint32*	contents;	///< word-aligned data
+} LpcImageSegment;
+
+/** Writes an image into FLASH.
+ * Completion is tracked per sector. In case of a communication failure while writing, the LPC is reset into ISP
+ * again (options->waveIsp), the last completed sector is verified by comparing it with the image and writing
+ * resumes with the first incomplete sector, which is erased first.
+ * @param io the communication channels.
+ * @param com the communication parameters, required for re-entering ISP, too.
+ * @param options erase/CRP/resume settings.
+ * @param member the target device.
+ * @param segments the image, in ascending address order.
+ * @return true in case of success, false otherwise.
+ */
+bool lpcFlash (
+	const LpcIspIo *io,
+	const LpcIspConfigCom *com,
+	const LpcIspFlashOptions *options,
+	const LpcMember *member,
+	const Executable32Segment *segments
+	);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Precompiled flash plans.
 
+enum {
+	LPC_FLASH_PLAN_VERSION		=1,
+	LPC_FLASH_PLAN_RANGES		=16,	///< maximum number of sector ranges to erase
+};
+
+/** How a plan erases its sectors before writing.
+ */
+typedef enum {
+	LPC_FLASH_PLAN_ERASE_NONE,		///< assume sectors are blank
+	LPC_FLASH_PLAN_ERASE_RANGES,		///< erase every range at once
+	LPC_FLASH_PLAN_ERASE_ON_DEMAND,		///< blank check every sector and erase it, if necessary
+} LpcFlashPlanErase;
+
+/** A flash plan is the complete result of lpcFlash's host-side work for one device: sector ranges to erase, the
+ * assignment of image chunks to transfer RAM and rounds, the chunk payloads with CRP and vector checksum already
+ * applied and, for the UUENCODE protocol, the encoded text including the checksum lines. Executing a plan is a
+ * sequence of precomputed transmissions only, so it can be compiled once and run on many devices.
+ *
+ * Layout, all 4-byte aligned and in host byte order, suitable for mmap:
+ *   - LpcFlashPlan header
+ *   - LpcFlashPlanChunk [nChunks]
+ *   - payloads and encoded texts, referenced by offsets from the start of the plan.
+ */
+typedef struct __attribute__((packed,aligned(4))) {
+	char		magic[8];	///< "mxliPLAN"
+	Uint32		version;	///< LPC_FLASH_PLAN_VERSION
+	Uint32		size;		///< total size of the plan in bytes
+	Uint32		crc;		///< CRC-32 of all bytes following this field up to size
+	char		name[32];	///< target member name, 0-terminated
+	Uint32		chunkSize;	///< bytes per RAM chunk and per copy RAM to FLASH
+	Uint8		protocol;	///< LpcIspDataProtocol of the payload transmission
+	Uint8		banked;		///< banked FLASH commands
+	Uint8		erase;		///< LpcFlashPlanErase
+	Uint8		reserved;
+	Uint32		nEraseRanges;
+	Int32Pair	eraseRanges[LPC_FLASH_PLAN_RANGES];	///< sector ranges
+	Uint32		nChunks;
+} LpcFlashPlan;
+
+typedef struct __attribute__((packed,aligned(4))) {
+	Uint32		flashAddress;
+	Uint32		ramAddress;
+	Uint32		round;		///< chunks of one round are transmitted, before they are copied into FLASH
+	Uint32		sector;
+	Uint32		crc;		///< CRC-32 of the payload, like the ISP command S (Read CRC) of later families
+	Uint32		payloadOffset;	///< chunkSize bytes of payload
+	Uint32		encodedOffset;	///< UUENCODE protocol: lines and checksum lines, as transmitted
+	Uint32		encodedSize;	///< 0 for the BINARY protocol
+} LpcFlashPlanChunk;
+
+/** Compiles the host-side work of lpcFlash into a plan.
+ * @param io the error channel; no communication with the LPC takes place.
+ * @param plan the destination, 4-byte aligned. May be 0 for calculating the size only.
+ * @param size the size of the destination. If it is too small, only the required size is calculated.
+ * @param com the data protocol to prepare the payloads for.
+ * @param options erase/CRP settings; retries are not part of a plan.
+ * @param member the target device.
+ * @param segments the image, in ascending address order.
+ * @return the size of the complete plan, possibly more than size, or -1 in case of an error.
+ */
+int lpcFlashPlanCompile (const LpcIspIo *io, LpcFlashPlan *plan, Uint32 size, const LpcIspConfigCom *com,
+	const LpcIspFlashOptions *options, const LpcMember *member, const Executable32Segment *segments);
+
+/** Checks a plan for consistency: header, offsets, CRCs and the encoded texts against their payloads.
+ * @param io the error channel.
+ * @param plan the plan, 4-byte aligned.
+ * @param size the number of bytes available, for example the file size.
+ * @return true, if the plan can be executed.
+ */
+bool lpcFlashPlanValidate (const LpcIspIo *io, const LpcFlashPlan *plan, Uint32 size);
+
+/** Prints a human readable summary of a (validated) plan.
+ * @param fifo the destination.
+ * @param plan the plan.
+ * @return true, if the output did not overflow.
+ */
+bool fifoPrintLpcFlashPlan (Fifo *fifo, const LpcFlashPlan *plan);
+
+/** Executes a validated plan: unlock, erase, transmission and copying of all chunks.
+ * There is no resume after communication failures.
+ * @param io the communication channels.
+ * @param com the communication parameters. The data protocol has to match the plan's.
+ * @param member the target device. Its name has to match the plan's.
+ * @param plan the plan, validated by lpcFlashPlanValidate.
+ * @return true in case of success, false otherwise.
+ */
+bool lpcFlashPlanExecute (const LpcIspIo *io, const LpcIspConfigCom *com, const LpcMember *member,
+	const LpcFlashPlan *plan);
+
+#endif
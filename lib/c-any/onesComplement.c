@@ -0,0 +1,127 @@
+/*
+  onesComplement.c
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <onesComplement.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static inline Uint64 add64(Uint64 a, Uint64 b) {
+	const Uint64 sum = a+b;
+	return sum + (sum<b);		// end around carry
+}
+
+static inline Uint16 fold(Uint64 sum) {
+	sum = (sum & 0xFFFFFFFF) + (sum>>32);
+	sum = (sum & 0xFFFFFFFF) + (sum>>32);
+	sum = (sum & 0xFFFF) + (sum>>16);
+	sum = (sum & 0xFFFF) + (sum>>16);
+	return sum;
+}
+
+static inline Uint16 swap16(Uint16 value) {
+	return value<<8 | value>>8;
+}
+
+/** Sums in host byte order.
+ */
+static Uint64 sumNative(const Uint8 *data, size_t n) {
+	Uint64 sum = 0;
+#ifdef __SSE2__
+	if (n>=32) {
+		// 32-bit words zero extended into 64-bit lanes cannot overflow
+		const __m128i zero = _mm_setzero_si128();
+		__m128i sums = zero;
+		for ( ; n>=32; data+=32, n-=32) {
+			const __m128i a = _mm_loadu_si128((const __m128i*)data);
+			const __m128i b = _mm_loadu_si128((const __m128i*)(data+16));
+			sums = _mm_add_epi64(sums,_mm_unpacklo_epi32(a,zero));
+			sums = _mm_add_epi64(sums,_mm_unpackhi_epi32(a,zero));
+			sums = _mm_add_epi64(sums,_mm_unpacklo_epi32(b,zero));
+			sums = _mm_add_epi64(sums,_mm_unpackhi_epi32(b,zero));
+		}
+		Uint64 lanes[2];
+		_mm_storeu_si128((__m128i*)lanes,sums);
+		sum = add64(lanes[0],lanes[1]);
+	}
+#endif
+	for ( ; n>=8; data+=8, n-=8) {
+		Uint64 word;
+		memcpy(&word,data,sizeof word);
+		sum = add64(sum,word);
+	}
+	if (n>=4) {
+		Uint32 word;
+		memcpy(&word,data,sizeof word);
+		sum = add64(sum,word);
+		data += 4;
+		n -= 4;
+	}
+	if (n>=2) {
+		Uint16 word;
+		memcpy(&word,data,sizeof word);
+		sum = add64(sum,word);
+		data += 2;
+		n -= 2;
+	}
+	if (n==1) {
+		const Uint8 last[2] = { data[0], 0 };	// padding
+		Uint16 word;
+		memcpy(&word,last,sizeof word);
+		sum = add64(sum,word);
+	}
+	return sum;
+}
+
+Uint16 onesComplementSumSpan(const void *data, size_t n) {
+	const Uint16 sum = fold(sumNative((const Uint8*)data,n));
+#if __BYTE_ORDER__==__ORDER_LITTLE_ENDIAN__
+	return swap16(sum);
+#else
+	return sum;
+#endif
+}
+
+void onesComplementSumAdd(OnesComplementSum *sum, const void *data, size_t n) {
+	const Uint16 span = onesComplementSumSpan(data,n);
+	// a span at an odd offset pairs its bytes the other way round
+	sum->sum = fold((Uint64)sum->sum + (sum->bytes & 1 ? swap16(span) : span));
+	sum->bytes += n;
+}
+
+void fifoOnesComplementSumAdd(OnesComplementSum *sum, Fifo *fifo) {
+	while (fifoCanRead(fifo)) {
+		const size_t n = fifoCanReadLinear(fifo);
+		onesComplementSumAdd(sum,fifoReadLinear(fifo),n);
+		fifoSkipRead(fifo,n);
+	}
+}
+
+Uint16 onesComplementSumResult(const OnesComplementSum *sum) {
+	return fold(sum->sum);
+}
+
+Uint16 onesComplementChecksumUpdate16(Uint16 checksum, Uint16 oldValue, Uint16 newValue) {
+	return ~fold((Uint16)~checksum + (Uint32)(Uint16)~oldValue + newValue);
+}
+
+Uint16 onesComplementChecksumUpdate32(Uint16 checksum, Uint32 oldValue, Uint32 newValue) {
+	return onesComplementChecksumUpdate16(
+		onesComplementChecksumUpdate16(checksum,oldValue>>16,newValue>>16),
+		oldValue & 0xFFFF, newValue & 0xFFFF);
+}
+
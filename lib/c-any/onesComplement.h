@@ -0,0 +1,94 @@
+/*
+  onesComplement.h - the Internet checksum over contiguous spans and its incremental update.
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __onesComplement_h
+#define __onesComplement_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <integers.h>
+#include <fifo.h>
+
+/** @file
+ * @brief The 16-bit one's complement sum of big endian words used by IP, ICMP, UDP and TCP (RFC 1071).
+ *
+ * Memory is summed 64 bits at a time (16 bytes at a time with SSE2) in host byte order with the carries folded in at
+ * the end only, which gives the same sum byte-swapped on little endian machines. Sums are returned as values of big
+ * endian words, like fifoCalculateOnesComplementSumBigEndian() does. A packet can be summed in several spans with
+ * OnesComplementSum, which takes care of spans starting at odd offsets.
+ *
+ * A checksum, whose covered data changes in a single field only, can be updated without summing the data again
+ * (RFC 1624).
+ */
+
+/** Accumulates the sum of a packet, that is summed span by span.
+ */
+typedef struct {
+	Uint32	sum;		///< the sum so far, not folded
+	Uint32	bytes;		///< the number of bytes summed so far
+} OnesComplementSum;
+
+/** Sums a contiguous span.
+ * @param data the start of the span, no alignment needed.
+ * @param n the number of bytes. An odd last byte is padded with a zero byte.
+ * @return the one's complement sum of the big endian words.
+ */
+Uint16 onesComplementSumSpan(const void *data, size_t n);
+
+/** Adds a span to a packet's sum.
+ * @param sum the accumulator, initially zero.
+ * @param data the span, following the data summed before.
+ * @param n the number of bytes.
+ */
+void onesComplementSumAdd(OnesComplementSum *sum, const void *data, size_t n);
+
+/** Adds a 16-bit value to a packet's sum at an even offset, like header fields.
+ * @param sum the accumulator.
+ * @param value a value in host byte order.
+ */
+static inline void onesComplementSumAdd16(OnesComplementSum *sum, Uint16 value) {
+	sum->sum += value;
+	sum->bytes += 2;
+}
+
+/** Adds all readable bytes of a Fifo to a packet's sum and consumes them.
+ * @param sum the accumulator.
+ * @param fifo the data, at most two contiguous spans.
+ */
+void fifoOnesComplementSumAdd(OnesComplementSum *sum, Fifo *fifo);
+
+/** Provides the final sum.
+ * @param sum the accumulator.
+ * @return the folded one's complement sum. The checksum field is the complement (~) of this value.
+ */
+Uint16 onesComplementSumResult(const OnesComplementSum *sum);
+
+/** Updates a checksum after a 16-bit field of the covered data changed (RFC 1624, equation 3).
+ * @param checksum the old checksum, as stored in the header.
+ * @param oldValue the old value of the field.
+ * @param newValue the new value of the field.
+ * @return the new checksum.
+ */
+Uint16 onesComplementChecksumUpdate16(Uint16 checksum, Uint16 oldValue, Uint16 newValue);
+
+/** Updates a checksum after a 32-bit field at an even offset, like an IP4 address, changed.
+ * @param checksum the old checksum, as stored in the header.
+ * @param oldValue the old value of the field, in host byte order.
+ * @param newValue the new value of the field, in host byte order.
+ * @return the new checksum.
+ */
+Uint16 onesComplementChecksumUpdate32(Uint16 checksum, Uint32 oldValue, Uint32 newValue);
+
+#endif
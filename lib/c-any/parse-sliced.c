@@ -2,6 +2,63 @@
 #include <parse.h>
 #include <string.h>
 
+// The SWAR kernels rely on the first character being the least significant byte of a loaded word.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PARSE_SWAR 1
+#else
+#define PARSE_SWAR 0
+#endif
+
+#define SWAR_ONES 0x0101010101010101ull
+
+static inline int hexDigitValue (char c) {
+	return c<='9' ? c-'0' : (c|0x20)-'a'+0xa;
+}
+
+/** Loads 8 characters into a word, the first character into the least significant byte.
+ */
+static inline Uint64 swarLoad8 (const char *s) {
+	Uint64 v;
+	memcpy (&v,s,8);
+	return v;
+}
+
+/** Marks (bit 7) all bytes of v, that are in the range lo..hi. All bytes of v must be less than 0x80, this way the
+ * additions never carry into the next byte.
+ */
+static inline Uint64 swarInRange (Uint64 v, Uint8 lo, Uint8 hi) {
+	return (v + SWAR_ONES*(0x80-lo)) & ~(v + SWAR_ONES*(0x7F-hi)) & SWAR_ONES*0x80;
+}
+
+/** Decodes 8 hex digits at once.
+ * @return true, if all 8 characters are hex digits, false otherwise (and value unchanged).
+ */
+static inline bool swarHex8 (Uint64 v, Uint32 *value) {
+	if (v & SWAR_ONES*0x80) return false;
+
+	const Uint64 letters = swarInRange (v | SWAR_ONES*0x20,'a','f');
+	if ((swarInRange (v,'0','9') | letters) != SWAR_ONES*0x80) return false;
+
+	const Uint64 nibbles = (v & SWAR_ONES*0x0F) + (letters>>7)*9;
+	const Uint64 bytes = (nibbles & 0x000F000F000F000Full)<<4 | nibbles>>8 & 0x000F000F000F000Full;
+	const Uint64 halves = (bytes & 0x000000FF000000FFull)<<8 | bytes>>16 & 0x000000FF000000FFull;
+	*value = (Uint32)((halves & 0xFFFF)<<16 | halves>>32 & 0xFFFF);
+	return true;
+}
+
+/** Decodes 8 decimal digits at once.
+ * @return true, if all 8 characters are decimal digits, false otherwise (and value unchanged).
+ */
+static inline bool swarDecimal8 (Uint64 v, Uint32 *value) {
+	if (v & SWAR_ONES*0x80
+	|| swarInRange (v,'0','9') != SWAR_ONES*0x80) return false;
+
+	v = (v & SWAR_ONES*0x0F) * 2561 >> 8;
+	v = (v & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+	*value = (Uint32)((v & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+	return true;
+}
+
 //SLICE
 bool isSpace(char c) {
 	switch(c) {
@@ -21,3 +78,66 @@ int baseNDigitToInt(char c) {
 	else return c-'a'+0xa;
 }
 
+
+//SLICE
+size_t parseHexSpan (const char *s, size_t n, Uint32 *value, int *digits, int maxDigits) {
+	size_t i = 0;
+	while (i<n && *digits<maxDigits) {
+		Uint32 chunk;
+		if (PARSE_SWAR && n-i>=8 && maxDigits-*digits>=8 && swarHex8 (swarLoad8 (&s[i]),&chunk)) {
+			*value = chunk;		// 8 digits shift out all previous bits.
+			*digits += 8;
+			i += 8;
+		}
+		else if (isHexDigit (s[i])) {
+			*value = 16**value + hexDigitValue (s[i]);
+			++*digits;
+			i++;
+		}
+		else if (isLegible (s[i])) i++;
+		else break;
+	}
+	return i;
+}
+
+//SLICE
+size_t parseDecimalSpan (const char *s, size_t n, Uint64 *value, int *digits) {
+	const Uint64 overflow = 1ull<<32;	// saturation value, any value beyond 32 bits will do.
+
+	size_t i = 0;
+	while (i<n) {
+		Uint32 chunk;
+		if (PARSE_SWAR && n-i>=8 && swarDecimal8 (swarLoad8 (&s[i]),&chunk)) {
+			*value = *value<overflow ? *value*100000000 + chunk : overflow;
+			*digits += 8;
+			i += 8;
+		}
+		else if (isDigit (s[i])) {
+			*value = *value<overflow ? *value*10 + s[i]-'0' : overflow;
+			++*digits;
+			i++;
+		}
+		else if (isLegible (s[i])) i++;
+		else break;
+	}
+	return i;
+}
+
+//SLICE
+size_t parseHexBytesSpan (const char *s, size_t n, Uint8 *bytes, size_t nBytes) {
+	size_t b = 0;
+	for ( ; PARSE_SWAR && b+4<=nBytes && 2*b+8<=n; b+=4) {
+		Uint32 chunk;
+		if (swarHex8 (swarLoad8 (&s[2*b]),&chunk)) {
+			bytes[b] = chunk>>24;
+			bytes[b+1] = chunk>>16;
+			bytes[b+2] = chunk>>8;
+			bytes[b+3] = chunk;
+		}
+		else break;
+	}
+	for ( ; b<nBytes && 2*b+2<=n && isHexDigit (s[2*b]) && isHexDigit (s[2*b+1]); b++) {
+		bytes[b] = hexDigitValue (s[2*b])<<4 | hexDigitValue (s[2*b+1]);
+	}
+	return b;
+}
@@ -21,6 +21,8 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <integers.h>
 
 /** Check for a digit.
  * @param c character
@@ -83,4 +85,36 @@ bool isSpace(char c);
  */
 int baseNDigitToInt(char baseNDigit);
 
+/** Decodes hex digits from a contiguous span of characters. Runs of 8 digits are decoded at once (SWAR), legibility
+ * characters are skipped like in the character-wise parsers. Decoding stops at the first other character, at the end
+ * of the span or after maxDigits digits. Values exceeding 32 bits wrap around silently.
+ * @param s the first character.
+ * @param n the number of characters available from s on.
+ * @param value the accumulator, updated with every digit.
+ * @param digits the number of digits decoded so far, updated with every digit.
+ * @param maxDigits the maximum value of *digits.
+ * @return the number of characters consumed.
+ */
+size_t parseHexSpan (const char *s, size_t n, Uint32 *value, int *digits, int maxDigits);
+
+/** Decodes decimal digits from a contiguous span of characters. Runs of 8 digits are decoded at once (SWAR), legibility
+ * characters are skipped like in the character-wise parsers. Decoding stops at the first other character or at the
+ * end of the span.
+ * @param s the first character.
+ * @param n the number of characters available from s on.
+ * @param value the accumulator, updated with every digit. Wider than the result to detect overflow.
+ * @param digits the number of digits decoded so far, updated with every digit.
+ * @return the number of characters consumed.
+ */
+size_t parseDecimalSpan (const char *s, size_t n, Uint64 *value, int *digits);
+
+/** Decodes pairs of hex digits (without legibility characters) into bytes, 4 bytes at once, if possible.
+ * @param s the first character.
+ * @param n the number of characters available from s on.
+ * @param bytes the destination.
+ * @param nBytes the maximum number of bytes to decode.
+ * @return the number of bytes decoded. Decoding stops at the first pair that is no valid hex byte.
+ */
+size_t parseHexBytesSpan (const char *s, size_t n, Uint8 *bytes, size_t nBytes);
+
 #endif
@@ -0,0 +1,53 @@
+/*
+  traceRing.c
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <traceRing.h>
+#include <string.h>
+
+static const char traceRingMagic[8] = "mxliTRCE";
+
+TraceRing* traceRingInit (void *memory, size_t size) {
+	if (size<sizeof (TraceRing) + sizeof (TraceRecord)) return 0;
+
+	TraceRing *ring = memory;
+	memcpy (ring->magic, traceRingMagic, sizeof ring->magic);
+	ring->records = (size - sizeof (TraceRing)) / sizeof (TraceRecord);
+	ring->written = 0;
+	return ring;
+}
+
+const TraceRing* traceRingCheck (const void *memory, size_t size) {
+	const TraceRing *ring = memory;
+	if (size>=sizeof (TraceRing)
+	&& 0==memcmp (ring->magic, traceRingMagic, sizeof ring->magic)
+	&& ring->records>0
+	&& ring->records <= (size - sizeof (TraceRing)) / sizeof (TraceRecord)) return ring;
+	else return 0;
+}
+
+void traceRingWrite (TraceRing *ring, Uint32 timeUs, TraceChannel channel, const void *data, size_t n) {
+	const char *bytes = data;
+	do {
+		TraceRecord *record = &ring->record[ring->written % ring->records];
+		const size_t chunk = n<TRACE_RECORD_DATA ? n : TRACE_RECORD_DATA;
+		record->timeUs = timeUs;
+		record->channel = channel;
+		record->n = chunk;
+		memcpy (record->data, bytes, chunk);
+		ring->written++;
+		bytes += chunk;
+		n -= chunk;
+	} while (n>0);
+}
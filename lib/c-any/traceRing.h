@@ -0,0 +1,100 @@
+/*
+  traceRing.h - binary trace of communication in a ring of fixed-size records.
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-any library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __traceRing_h
+#define __traceRing_h
+
+#include <integers.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @file
+ * @brief Binary trace of communication in a ring of fixed-size records.
+ *
+ * Tracing costs a copy of the data and no formatting, so it can stay enabled without changing the timing of the
+ * traced communication. Spans of data are split into records of up to TRACE_RECORD_DATA bytes. When the ring is full,
+ * the oldest records are overwritten. The ring lives in caller-provided memory, for example a memory-mapped file, that
+ * is decoded offline. All fields are in host byte order.
+ */
+
+enum {
+	TRACE_RECORD_DATA	=24,	///< data bytes per record
+};
+
+/** Channels (directions) of traced data.
+ */
+typedef enum {
+	TRACE_TX,		///< data sent to the device
+	TRACE_RX,		///< data received from the device
+	TRACE_NOTE,		///< text annotation of the tracing program, like a timeout
+} TraceChannel;
+
+typedef struct __attribute__((packed,aligned(4))) {
+	Uint32	timeUs;			///< time stamp, wraps after 71 minutes
+	Uint8	channel;		///< TraceChannel
+	Uint8	n;			///< number of valid data bytes
+	Uint16	reserved;
+	char	data[TRACE_RECORD_DATA];
+} TraceRecord;
+
+typedef struct __attribute__((packed,aligned(4))) {
+	char		magic[8];	///< "mxliTRCE"
+	Uint32		records;	///< capacity of the ring
+	Uint32		written;	///< total number of records written, modulo 2^32
+	TraceRecord	record[];
+} TraceRing;
+
+/** Formats memory as an empty trace ring.
+ * @param memory the storage, 4-byte aligned.
+ * @param size the size of the storage in bytes.
+ * @return the ring or 0, if the memory cannot hold at least one record.
+ */
+TraceRing* traceRingInit (void *memory, size_t size);
+
+/** Checks, if memory contains a consistent trace ring.
+ * @param memory the storage, 4-byte aligned.
+ * @param size the size of the storage in bytes.
+ * @return the ring or 0.
+ */
+const TraceRing* traceRingCheck (const void *memory, size_t size);
+
+/** Appends data to the ring.
+ * @param ring the trace ring.
+ * @param timeUs the time stamp of the data.
+ * @param channel the direction of the data.
+ * @param data the bytes to trace.
+ * @param n the number of bytes.
+ */
+void traceRingWrite (TraceRing *ring, Uint32 timeUs, TraceChannel channel, const void *data, size_t n);
+
+/** Counts the records available.
+ * @param ring the trace ring.
+ * @return the number of records, at most the capacity.
+ */
+static inline Uint32 traceRingCount (const TraceRing *ring) {
+	return ring->written<ring->records ? ring->written : ring->records;
+}
+
+/** Retrieves a record, oldest first.
+ * @param ring the trace ring.
+ * @param i the index 0..traceRingCount()-1.
+ * @return the record.
+ */
+static inline const TraceRecord* traceRingRecord (const TraceRing *ring, Uint32 i) {
+	const Uint32 oldest = ring->written<ring->records ? 0 : ring->written % ring->records;
+	return &ring->record[(oldest+i) % ring->records];
+}
+
+#endif
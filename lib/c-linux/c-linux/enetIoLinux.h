@@ -0,0 +1,109 @@
+/*
+  enetIoLinux.h - enetIoFifo on Linux hosts: TAP devices and pcap files.
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-linux library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef __enetIoLinux_h
+#define __enetIoLinux_h
+
+#include <stdbool.h>
+#include <integers.h>
+#include <enetIoFifo.h>
+#include <enetIoRing.h>
+
+/** @file
+ * @brief The Ethernet driver interfaces enetIoRing.h and enetIoFifo.h implemented on Linux, for running the c-any IP
+ * stack off-target.
+ *
+ * Two backends are available, selected by their init functions:
+ *   - a TAP device: the stack becomes a host on a virtual Ethernet interface, that can be pinged and configured like
+ *     any other interface.
+ *   - replay: received frames are taken from a pcap file (or a pcap image in memory), one after the other, optionally
+ *     repeated. Frames are copied from the memory mapped file into the receive ring, like a DMA controller does,
+ *     because the stack may modify them in place.
+ *
+ * Both rings have 32 frames. Transmitted frames are written one by one at the doorbell. Independent of the backend,
+ * they can be recorded into a pcap file. Frames have no Ethernet CRC.
+ */
+
+enum {
+	ENET_IO_LINUX_FRAME	=1536,		///< maximum frame size without CRC
+};
+
+/** Frame counters of the current backend.
+ */
+typedef struct {
+	Uint64	framesRead;		///< frames passed to the stack
+	Uint64	framesWritten;		///< frames committed by the stack
+	Uint64	bytesRead;
+	Uint64	bytesWritten;
+} EnetIoLinuxStatistics;
+
+/** Opens a TAP device. The interface has to be brought up and configured outside (ip link/ip addr), which requires
+ * CAP_NET_ADMIN just like creating it.
+ * @param interfaceName the name of an existing (persistent) or new TAP interface, for example tap0.
+ * @return true, if the device could be opened.
+ */
+bool enetIoLinuxTapInit(const char *interfaceName);
+
+/** The file descriptor of the TAP device, for waiting with poll().
+ * @return the descriptor or -1 if the TAP backend is not active.
+ */
+int enetIoLinuxTapFd(void);
+
+/** Replays the frames of a pcap file (link type Ethernet, micro- or nanosecond time stamps, host byte order).
+ * @param fileName the capture file.
+ * @param repeat the number of passes through the file, 0 for endless.
+ * @return true, if the file could be mapped and is a valid capture file.
+ */
+bool enetIoLinuxReplayFileInit(const char *fileName, int repeat);
+
+/** Replays the frames of a pcap file image in memory. The image is neither copied nor modified.
+ * @param image the pcap file contents, at least 4-byte aligned.
+ * @param size the size of the image in bytes.
+ * @param repeat the number of passes through the file, 0 for endless.
+ * @return true, if the image is a valid capture file.
+ */
+bool enetIoLinuxReplayInit(const void *image, size_t size, int repeat);
+
+/** Records all transmitted frames.
+ * @param fileName the pcap file to create, 0 to stop recording.
+ * @return true, if the file was created.
+ */
+bool enetIoLinuxRecord(const char *fileName);
+
+/** Closes the backend and the recording.
+ */
+void enetIoLinuxClose(void);
+
+/** Provides the frame counters.
+ * @return the counters since the last init.
+ */
+const EnetIoLinuxStatistics* enetIoLinuxStatistics(void);
+
+/** Writes the pcap file header.
+ * @param fifo the destination.
+ * @return true, if the header fitted.
+ */
+bool fifoPutPcapHeader(Fifo *fifo);
+
+/** Writes a pcap record: a record header with the given time stamp followed by the frame.
+ * @param fifo the destination.
+ * @param timeUs the time stamp.
+ * @param frame the frame.
+ * @param size the size of the frame.
+ * @return true, if the whole record fitted.
+ */
+bool fifoPutPcapFrame(Fifo *fifo, Int64 timeUs, const void *frame, size_t size);
+
+#endif
@@ -17,9 +17,15 @@
 #define __fd_h
 
 #include <stdbool.h>
+#include <integers.h>
+#include <fifo.h>
 
 /** @file
  * @brief Basic polling IO on Linux.
+ *
+ * Besides the single character functions, there's a small event loop: fdPollFifos() waits for any of a set of file
+ * descriptors and moves data in blocks between these and their Fifos. Timeouts spanning multiple calls are best
+ * expressed as deadlines based on fdClockMs().
  */
 
 /** Checks if at least one character can be read.
@@ -44,5 +50,73 @@ bool fdCanWrite(int fd);
  */
 void fdWrite(int fd, char c);
 
+/** Reads as many bytes as immediately available and fitting into the Fifo with a single system call. Call this only
+ * if the descriptor is known to be readable, otherwise it may block or wait for a terminal timeout.
+ * @param fd An open file descriptor.
+ * @param fifo the destination.
+ * @return the number of bytes read, 0 if the Fifo is full or the call was interrupted, -1 for error or EOF.
+ */
+int fdReadFifo(int fd, Fifo *fifo);
+
+/** Writes as many bytes as possible from a Fifo with a single system call.
+ * @param fd An open file descriptor.
+ * @param fifo the source.
+ * @return the number of bytes written, 0 if the Fifo is empty or the call was interrupted, -1 for error.
+ */
+int fdWriteFifo(int fd, Fifo *fifo);
+
+/** A file descriptor connected to Fifos for the event loop.
+ */
+typedef struct {
+	int	fd;			///< the descriptor. Negative values are ignored.
+	Fifo	*in;			///< data read from fd, 0 if fd is not read.
+	Fifo	*out;			///< data to be written to fd, 0 if fd is not written.
+	bool	eof;			///< set, if reading reached end of file or any error occured. fd is ignored, then.
+} FdFifo;
+
+/** Waits for IO on a set of descriptors and moves the data between the descriptors and their Fifos. A descriptor is
+ * only watched for reading, if its input Fifo has space, and only watched for writing, if its output Fifo has data.
+ * @param fdFifos the connections.
+ * @param n the number of connections.
+ * @param timeoutMs the maximum time to wait for any IO, -1 for no limit.
+ * @return true, if data was moved or an EOF was detected, false in case of timeout.
+ */
+bool fdPollFifos(FdFifo *fdFifos, int n, int timeoutMs);
+
+/** Reads a monotonic clock.
+ * @return the time in ms since some unspecified starting point.
+ */
+Int64 fdClockMs(void);
+
+/** Calculates the remaining time until a deadline.
+ * @param deadlineMs the deadline in fdClockMs() time. Negative values mean 'no deadline'.
+ * @return the time left in ms, 0 if the deadline has passed, -1 if there's no deadline. Suitable for fdPollFifos().
+ */
+int fdRemainingMs(Int64 deadlineMs);
+
+/** Waits until a descriptor becomes readable, with microsecond resolution.
+ * @param fd An open file descriptor.
+ * @param timeoutUs the maximum waiting time.
+ * @return true, if reading will not block, false in case of timeout.
+ */
+bool fdWaitReadableUs(int fd, Int64 timeoutUs);
+
+/** Waits until a descriptor becomes writable, with microsecond resolution.
+ * @param fd An open file descriptor.
+ * @param timeoutUs the maximum waiting time.
+ * @return true, if writing will not block, false in case of timeout.
+ */
+bool fdWaitWritableUs(int fd, Int64 timeoutUs);
+
+/** Reads a monotonic clock.
+ * @return the time in us since some unspecified starting point.
+ */
+Int64 fdClockUs(void);
+
+/** Sleeps until an absolute time, which avoids accumulating errors of consecutive relative sleeps.
+ * @param deadlineUs the wake-up time in fdClockUs() time.
+ */
+void fdSleepUntilUs(Int64 deadlineUs);
+
 #endif
 
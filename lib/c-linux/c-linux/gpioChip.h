@@ -0,0 +1,68 @@
+/*
+  gpioChip.h 
+  Copyright 2013 Marc Prager
+ 
+  This file is part of the c-linux library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+ 
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ 
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef linux__gpioChip_h
+#define linux__gpioChip_h
+
+#include <stdbool.h>
+#include <integers.h>
+
+/** @file
+ * @brief GPIO outputs via the GPIO character device (/dev/gpiochipN, uAPI v2).
+ *
+ * All lines are requested once and held for the session, every change of outputs is a single ioctl, that may change
+ * several lines at the same time. This replaces the slow and deprecated /sys/class/gpio interface of raspiGpio.h.
+ * The chip name "fake" selects a backend without hardware, that only records the values, for testing.
+ */
+
+enum {
+	GPIO_LINES_MAX	=8,	///< lines per request
+};
+
+typedef struct {
+	int		fd;			///< line request, -1 if not requested; unused by the fake backend
+	bool		fake;			///< no hardware
+	int		nLines;
+	unsigned	offsets[GPIO_LINES_MAX];	///< line numbers of the chip
+	Uint32		values;			///< bit i: current value of line i
+	Uint32		changes;		///< number of successful gpioLinesSet calls
+} GpioLines;
+
+/** Requests lines as outputs.
+ * @param lines the destination of the request.
+ * @param chip the device, like "/dev/gpiochip0", or "fake".
+ * @param offsets the line numbers within the chip, like the BCM GPIO numbers of the Raspberry Pi.
+ * @param n the number of lines, at most GPIO_LINES_MAX.
+ * @param values bit i: initial value of line i.
+ * @param consumer a label shown by tools like gpioinfo.
+ * @return true in case of success, false otherwise.
+ */
+bool gpioLinesRequest (GpioLines *lines, const char *chip, const unsigned *offsets, int n, Uint32 values,
+	const char *consumer);
+
+/** Changes outputs at once.
+ * @param lines the requested lines.
+ * @param mask bit i: change line i.
+ * @param values bit i: new value of line i.
+ * @return true in case of success, false otherwise.
+ */
+bool gpioLinesSet (GpioLines *lines, Uint32 mask, Uint32 values);
+
+/** Releases the lines. Their values are kept or reset as decided by the GPIO driver.
+ * @param lines the requested lines.
+ */
+void gpioLinesRelease (GpioLines *lines);
+
+#endif
@@ -45,4 +45,30 @@ bool serialSetDtr(int fd, bool on);
  */
 bool serialSetRts(int fd, bool on);
 
+/** Settings changed by serialLowLatencyEnable and their original values.
+ */
+typedef struct {
+	int	fd;			///< the serial line
+	bool	asyncLowLatency;	///< true, if ASYNC_LOW_LATENCY was set by us
+	int	serialFlags;		///< original flags of TIOCGSERIAL
+	char	latencyTimerFile[128];	///< sysfs latency timer attribute of FTDI devices, empty if not changed
+	int	latencyTimerMs;		///< original value of the latency timer
+} SerialLowLatency;
+
+/** Minimizes the receive latency of (USB-)serial adapters.
+ * Sets ASYNC_LOW_LATENCY, and if the tty belongs to an FTDI device, lowers its latency timer (16ms by default)
+ * via /sys/bus/usb-serial/devices/<tty>/latency_timer. The latter typically requires write permission to sysfs.
+ * @param saved destination of the original settings for serialLowLatencyRestore.
+ * @param fd file descriptor of the line.
+ * @param latencyTimerMs the FTDI latency timer value, 1..255.
+ * @return true, if at least one setting was applied.
+ */
+bool serialLowLatencyEnable(SerialLowLatency *saved, int fd, int latencyTimerMs);
+
+/** Restores the settings changed by serialLowLatencyEnable.
+ * @param saved the original settings.
+ * @return true in case of success, false otherwise.
+ */
+bool serialLowLatencyRestore(const SerialLowLatency *saved);
+
 #endif
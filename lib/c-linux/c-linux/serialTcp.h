@@ -0,0 +1,102 @@
+/*
+  serialTcp.h
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-linux library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef linux__serialTcp_h
+#define linux__serialTcp_h
+
+#include <stdbool.h>
+#include <integers.h>
+#include <fifo.h>
+
+/** @file
+ * @brief Serial lines of serial port servers (like ser2net), connected via TCP.
+ *
+ * Two kinds of servers are supported:
+ *   tcp://host:port      raw TCP, every byte is passed to the serial line. There are no control lines, the baud rate
+ *                        is configured on the server.
+ *   rfc2217://host:port  telnet with the COM-PORT-OPTION of RFC 2217, which sets the baud rate and the control lines
+ *                        DTR and RTS remotely.
+ *
+ * Nagle's algorithm is disabled and serialTcpWriteFifo() sends all pending data with a single system call, so every
+ * command leaves in one TCP segment without waiting for the ACK of the previous one. The socket is non-blocking and can
+ * be waited for like a local serial line (poll), but must be read by serialTcpRead(), which removes the telnet commands.
+ */
+
+typedef struct {
+	int	fd;		///< the socket, -1 if not connected
+	bool	telnet;		///< RFC 2217, false for raw TCP
+	Uint8	state;		///< telnet receiver state
+	Uint8	verb;		///< the received WILL/WONT/DO/DONT
+} SerialTcp;
+
+/** Checks, if a device name is an URL of a serial port server.
+ * @param name a device name, like /dev/ttyUSB0 or tcp://host:port
+ * @return true for the tcp:// and rfc2217:// schemes, false otherwise.
+ */
+bool serialTcpIsUrl(const char *name);
+
+/** Connects to a serial port server.
+ * @param serial the destination of the connection.
+ * @param url tcp://host:port or rfc2217://host:port . IPv6 addresses are written in brackets.
+ * @param baud the baud rate in bits/s, used with RFC 2217 only. 8 data bits, no parity, 1 stop bit and no flow
+ *   control are configured, too.
+ * @return true in case of success, false otherwise.
+ */
+bool serialTcpOpen(SerialTcp *serial, const char *url, int baud);
+
+/** Closes the connection.
+ * @param serial the connection.
+ */
+void serialTcpClose(SerialTcp *serial);
+
+/** Reads the bytes available. Telnet commands are removed from the data and answered.
+ * @param serial the connection.
+ * @param buffer the destination of the data.
+ * @param n the size of the buffer.
+ * @return the number of data bytes, 0 if only telnet commands were received, -1 in case of error, if no bytes are
+ *   available (errno is EAGAIN then) or if the server closed the connection (errno is ECONNRESET then).
+ */
+int serialTcpRead(SerialTcp *serial, void *buffer, int n);
+
+/** Sends the contents of a Fifo with a single system call for every 4kiB. Telnet IAC bytes are escaped.
+ * @param serial the connection.
+ * @param fifo the data, that is consumed.
+ * @return the number of bytes sent, -1 in case of error.
+ */
+int serialTcpWriteFifo(SerialTcp *serial, Fifo *fifo);
+
+/** Switches the modem control line DTR of the server. Only available with RFC 2217.
+ * @param serial the connection.
+ * @param on true to set this line to 1 in logic levels (inverted compared to RS-232), like serialSetDtr().
+ * @return true in case of success, false otherwise.
+ */
+bool serialTcpSetDtr(SerialTcp *serial, bool on);
+
+/** Switches the modem control line RTS of the server. Only available with RFC 2217.
+ * @param serial the connection.
+ * @param on true to set this line to 1 in logic levels (inverted compared to RS-232), like serialSetRts().
+ * @return true in case of success, false otherwise.
+ */
+bool serialTcpSetRts(SerialTcp *serial, bool on);
+
+/** Switches both modem control lines with a single TCP segment. Only available with RFC 2217.
+ * @param serial the connection.
+ * @param rts the logic level of RTS.
+ * @param dtr the logic level of DTR.
+ * @return true in case of success, false otherwise.
+ */
+bool serialTcpSetRtsDtr(SerialTcp *serial, bool rts, bool dtr);
+
+#endif
@@ -0,0 +1,369 @@
+/*
+  enetIoLinux.c
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-linux library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <c-linux/enetIoLinux.h>
+#include <macros.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+enum {
+	PCAP_MAGIC_US		=0xA1B2C3D4,
+	PCAP_MAGIC_NS		=0xA1B23C4D,
+	PCAP_LINKTYPE_ETHERNET	=1,
+};
+
+typedef struct __attribute__((packed)) {
+	Uint32	magic;
+	Uint16	versionMajor;
+	Uint16	versionMinor;
+	Int32	thisZone;
+	Uint32	sigFigs;
+	Uint32	snapLength;
+	Uint32	linkType;
+} PcapHeader;
+
+typedef struct __attribute__((packed)) {
+	Uint32	seconds;
+	Uint32	fraction;		///< micro- or nanoseconds
+	Uint32	capturedLength;
+	Uint32	length;
+} PcapRecordHeader;
+
+typedef enum {
+	BACKEND_NONE,
+	BACKEND_TAP,
+	BACKEND_REPLAY,
+} Backend;
+
+static Backend backend = BACKEND_NONE;
+static EnetIoLinuxStatistics statistics;
+
+enum {
+	RX_RING		=32,
+	TX_RING		=32,
+};
+
+static Uint8 rxBuffers[RX_RING][ENET_IO_LINUX_FRAME];
+static Fifo rxFrames[RX_RING];
+static int rxOldest;			///< the index of the oldest received frame
+static int rxCount;			///< the number of received frames not released
+
+static Uint8 txBuffers[TX_RING][ENET_IO_LINUX_FRAME];
+static Fifo txFrames[TX_RING];
+static bool txQueued[TX_RING];
+
+typedef struct {
+	const Uint8	*data;
+	size_t		size;
+} TxDescriptor;
+
+static TxDescriptor txDescriptors[TX_RING+RX_RING];	///< tx buffers and rx frames queued in place
+static int txCount;
+
+static Fifo *writeFifo;			///< the buffer of enetIoFifoWriteBegin()
+
+static int tapFd = -1;
+
+static const Uint8 *replayImage;
+static size_t replaySize;
+static size_t replayPos;		///< offset of the next record
+static int replayRepeat;		///< remaining passes, 0 for endless
+static bool replayMapped;		///< the image is our mapping of a file
+
+static FILE *recordFile;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// pcap format
+
+bool fifoPutPcapHeader(Fifo *fifo) {
+	const PcapHeader header = {
+		.magic = PCAP_MAGIC_US,
+		.versionMajor = 2,
+		.versionMinor = 4,
+		.snapLength = ENET_IO_LINUX_FRAME,
+		.linkType = PCAP_LINKTYPE_ETHERNET,
+	};
+	return fifoPutN(fifo,&header,sizeof header);
+}
+
+bool fifoPutPcapFrame(Fifo *fifo, Int64 timeUs, const void *frame, size_t size) {
+	const PcapRecordHeader header = {
+		.seconds = timeUs / 1000000,
+		.fraction = timeUs % 1000000,
+		.capturedLength = size,
+		.length = size,
+	};
+	if (sizeof header + size <= fifoCanWrite(fifo)) {
+		fifoWriteN(fifo,&header,sizeof header);
+		fifoWriteN(fifo,frame,size);
+		return true;
+	}
+	else return false;
+}
+
+static Int64 timeUs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME,&ts);
+	return (Int64)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+static void record(const void *frame, size_t size) {
+	Uint8 buffer[sizeof(PcapRecordHeader) + ENET_IO_LINUX_FRAME];
+	Fifo fifo;
+	fifoInitWrite(&fifo,buffer,sizeof buffer);
+	if (fifoPutPcapFrame(&fifo,timeUs(),frame,size)) fwrite(buffer,1,fifoCanRead(&fifo),recordFile);
+}
+
+bool enetIoLinuxRecord(const char *fileName) {
+	if (recordFile!=0) {
+		fclose(recordFile);
+		recordFile = 0;
+	}
+	if (fileName==0) return true;
+
+	if (0==(recordFile = fopen(fileName,"w"))) return false;
+	Uint8 buffer[sizeof(PcapHeader)];
+	Fifo fifo;
+	fifoInitWrite(&fifo,buffer,sizeof buffer);
+	fifoPutPcapHeader(&fifo);
+	fwrite(buffer,1,sizeof buffer,recordFile);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// backends
+
+void enetIoLinuxClose(void) {
+	if (tapFd>=0) close(tapFd);
+	tapFd = -1;
+	if (replayMapped) munmap((void*)replayImage,replaySize);
+	replayMapped = false;
+	replayImage = 0;
+	rxCount = 0;
+	txCount = 0;
+	memset(txQueued,0,sizeof txQueued);
+	backend = BACKEND_NONE;
+	enetIoLinuxRecord(0);
+}
+
+bool enetIoLinuxTapInit(const char *interfaceName) {
+	enetIoLinuxClose();
+	memset(&statistics,0,sizeof statistics);
+
+	const int fd = open("/dev/net/tun",O_RDWR | O_NONBLOCK);
+	if (fd<0) return false;
+
+	struct ifreq ifr = {
+		.ifr_flags = IFF_TAP | IFF_NO_PI,
+	};
+	strncpy(ifr.ifr_name,interfaceName,IFNAMSIZ-1);
+	if (0!=ioctl(fd,TUNSETIFF,&ifr)) {
+		close(fd);
+		return false;
+	}
+	tapFd = fd;
+	backend = BACKEND_TAP;
+	return true;
+}
+
+int enetIoLinuxTapFd(void) {
+	return tapFd;
+}
+
+bool enetIoLinuxReplayInit(const void *image, size_t size, int repeat) {
+	enetIoLinuxClose();
+	memset(&statistics,0,sizeof statistics);
+
+	const PcapHeader *header = (const PcapHeader*)image;
+	if (size<sizeof *header
+	|| header->magic!=PCAP_MAGIC_US && header->magic!=PCAP_MAGIC_NS
+	|| header->linkType!=PCAP_LINKTYPE_ETHERNET) return false;
+
+	replayImage = (const Uint8*)image;
+	replaySize = size;
+	replayPos = sizeof *header;
+	replayRepeat = repeat;
+	backend = BACKEND_REPLAY;
+	return true;
+}
+
+bool enetIoLinuxReplayFileInit(const char *fileName, int repeat) {
+	const int fd = open(fileName,O_RDONLY);
+	if (fd<0) return false;
+
+	struct stat stat;
+	void *image = MAP_FAILED;
+	if (0==fstat(fd,&stat) && stat.st_size>0) {
+		image = mmap(0,stat.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+	}
+	close(fd);
+	if (image==MAP_FAILED) return false;
+
+	if (enetIoLinuxReplayInit(image,stat.st_size,repeat)) {
+		replayMapped = true;
+		return true;
+	}
+	else {
+		munmap(image,stat.st_size);
+		return false;
+	}
+}
+
+const EnetIoLinuxStatistics* enetIoLinuxStatistics(void) {
+	return &statistics;
+}
+
+/** Copies the next frame of the replay image into a receive buffer, like a DMA controller would.
+ * @param buffer the destination of ENET_IO_LINUX_FRAME bytes.
+ * @return the frame size, 0 if no frame is available.
+ */
+static size_t replayNext(Uint8 *buffer) {
+	for (int pass=0; pass<2; pass++) {
+		if (replayPos + sizeof(PcapRecordHeader) <= replaySize) {
+			const PcapRecordHeader *header = (const PcapRecordHeader*)(replayImage+replayPos);
+			const size_t size = header->capturedLength;
+			const size_t pos = replayPos + sizeof *header;
+			if (pos + size <= replaySize) {
+				replayPos = pos + size;
+				const size_t n = size<=ENET_IO_LINUX_FRAME ? size : ENET_IO_LINUX_FRAME;
+				memcpy(buffer,replayImage+pos,n);
+				return n;
+			}
+		}
+		// end of image (or truncated record): next pass
+		if (replayRepeat==1) return 0;
+		if (replayRepeat>1) replayRepeat--;
+		replayPos = sizeof(PcapHeader);
+	}
+	return 0;	// no frames at all
+}
+
+/** Fills the free receive buffers.
+ */
+static void rxFill(void) {
+	while (rxCount<RX_RING) {
+		const int i = (rxOldest+rxCount) % RX_RING;
+		ssize_t n = 0;
+		switch(backend) {
+			case BACKEND_TAP:	n = read(tapFd,rxBuffers[i],ENET_IO_LINUX_FRAME); break;
+			case BACKEND_REPLAY:	n = replayNext(rxBuffers[i]); break;
+			default: ;
+		}
+		if (n<=0) return;	// EAGAIN, end of replay
+		fifoInitRead(&rxFrames[i],rxBuffers[i],n);
+		rxCount++;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// enetIoRing.h
+
+int enetIoRxBurst(Fifo **frames, int n) {
+	if (rxCount<n) rxFill();
+	if (n>rxCount) n = rxCount;
+	for (int f=0; f<n; f++) {
+		Fifo *frame = &rxFrames[(rxOldest+f) % RX_RING];
+		fifoInitRead(frame,frame->buffer,frame->size);	// whole frame again
+		frames[f] = frame;
+	}
+	return n;
+}
+
+void enetIoRxRelease(int n) {
+	if (n>rxCount) n = rxCount;
+	for (int f=0; f<n; f++) {
+		statistics.framesRead++;
+		statistics.bytesRead += rxFrames[(rxOldest+f) % RX_RING].size;
+	}
+	rxOldest = (rxOldest+n) % RX_RING;
+	rxCount -= n;
+}
+
+int enetIoTxReserve(Fifo **frames, int n) {
+	int f = 0;
+	if (backend!=BACKEND_NONE) for (int i=0; i<TX_RING && f<n; i++) if (!txQueued[i]) {
+		fifoInitWrite(&txFrames[i],txBuffers[i],ENET_IO_LINUX_FRAME);
+		frames[f++] = &txFrames[i];
+	}
+	return f;
+}
+
+void enetIoTxQueue(Fifo *frame) {
+	const int i = frame-txFrames;
+	if (0<=i && i<TX_RING && !txQueued[i]) {
+		txQueued[i] = true;
+		txDescriptors[txCount++] = (TxDescriptor) { .data = txBuffers[i], .size = fifoCanRead(frame) };
+	}
+}
+
+bool enetIoTxQueueRx(Fifo *frame) {
+	if (txCount<ELEMENTS(txDescriptors) && fifoCanRead(frame)==fifoCanReadLinear(frame)) {
+		txDescriptors[txCount++] = (TxDescriptor) { .data = (const Uint8*)fifoReadLinear(frame), .size = fifoCanRead(frame) };
+		return true;
+	}
+	else return false;
+}
+
+void enetIoTxDoorbell(void) {
+	for (int d=0; d<txCount; d++) {
+		const TxDescriptor *descriptor = &txDescriptors[d];
+		if (backend==BACKEND_TAP) write(tapFd,descriptor->data,descriptor->size);
+		if (recordFile!=0) record(descriptor->data,descriptor->size);
+		statistics.framesWritten++;
+		statistics.bytesWritten += descriptor->size;
+	}
+	txCount = 0;
+	memset(txQueued,0,sizeof txQueued);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// enetIoFifo.h, on top of the rings
+
+bool enetIoFifoCanRead(void) {
+	if (rxCount==0) rxFill();
+	return rxCount>0;
+}
+
+Fifo* enetIoFifoReadBegin(void) {
+	Fifo *frame = 0;
+	enetIoRxBurst(&frame,1);
+	return frame;
+}
+
+void enetIoFifoReadEnd(void) {
+	enetIoRxRelease(1);
+}
+
+bool enetIoFifoCanWrite(void) {
+	return backend!=BACKEND_NONE;
+}
+
+Fifo* enetIoFifoWriteBegin(void) {
+	return 1==enetIoTxReserve(&writeFifo,1) ? writeFifo : 0;
+}
+
+void enetIoFifoWriteEnd(void) {
+	enetIoTxQueue(writeFifo);
+	enetIoTxDoorbell();
+}
+
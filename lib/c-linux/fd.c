@@ -13,9 +13,12 @@
   If not see <http://www.gnu.org/licenses/>
  */
 
+#define _GNU_SOURCE	// ppoll()
 #include <c-linux/fd.h>
 #include <poll.h>
 #include <unistd.h>
+#include <errno.h>
+#include <time.h>
 
 bool fdCanRead(int fd) {
 	struct pollfd pollfd = {
@@ -45,3 +48,118 @@ void fdWrite(int fd, char c) {
 	write(fd,&c,1);
 }
 
+
+int fdReadFifo(int fd, Fifo *fifo) {
+	const size_t linear = fifoCanWriteLinear(fifo);
+	if (linear==0) return 0;
+
+	const ssize_t n = read(fd,fifoWriteLinear(fifo),linear);
+	if (n>0) {
+		fifoSkipWrite(fifo,n);
+		return n;
+	}
+	else if (n<0 && (errno==EINTR || errno==EAGAIN)) return 0;
+	else return -1;		// EOF or error
+}
+
+int fdWriteFifo(int fd, Fifo *fifo) {
+	const size_t linear = fifoCanReadLinear(fifo);
+	if (linear==0) return 0;
+
+	const ssize_t n = write(fd,fifoReadLinear(fifo),linear);
+	if (n>=0) {
+		fifoSkipRead(fifo,n);
+		return n;
+	}
+	else if (errno==EINTR || errno==EAGAIN) return 0;
+	else return -1;
+}
+
+bool fdPollFifos(FdFifo *fdFifos, int n, int timeoutMs) {
+	struct pollfd pollfds[n];
+	for (int i=0; i<n; i++) {
+		const FdFifo *f = &fdFifos[i];
+		pollfds[i].events =
+			(f->in!=0 && fifoCanWrite(f->in) ? POLLIN : 0)
+			| (f->out!=0 && fifoCanRead(f->out) ? POLLOUT : 0);
+		// idle descriptors are not watched at all, otherwise a hang-up would be reported over and over.
+		pollfds[i].fd = !f->eof && pollfds[i].events ? f->fd : -1;
+		pollfds[i].revents = 0;
+	}
+
+	if (poll(pollfds,n,timeoutMs)<=0) return false;	// timeout or signal
+
+	bool moved = false;
+	for (int i=0; i<n; i++) {
+		FdFifo *f = &fdFifos[i];
+		const short revents = pollfds[i].revents;
+		if (revents & (POLLIN | POLLHUP | POLLERR) && pollfds[i].events & POLLIN) {
+			const int r = fdReadFifo(f->fd,f->in);
+			if (r<0) f->eof = true;
+			moved = moved || r!=0;
+		}
+		if (revents & POLLOUT) {
+			const int w = fdWriteFifo(f->fd,f->out);
+			if (w<0) f->eof = true;
+			moved = moved || w!=0;
+		}
+		if (revents & (POLLERR | POLLNVAL) && !(pollfds[i].events & POLLIN)) {
+			f->eof = true;
+			moved = true;
+		}
+	}
+	return moved;
+}
+
+Int64 fdClockMs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (Int64)ts.tv_sec*1000 + ts.tv_nsec/1000000;
+}
+
+int fdRemainingMs(Int64 deadlineMs) {
+	if (deadlineMs<0) return -1;
+
+	const Int64 remaining = deadlineMs - fdClockMs();
+	return remaining>0 ? (int)remaining : 0;
+}
+
+bool fdWaitReadableUs(int fd, Int64 timeoutUs) {
+	struct pollfd pollfd = {
+		.fd = fd,
+		.events = POLLIN | POLLPRI,
+		.revents = 0
+	};
+	const struct timespec timeout = {
+		.tv_sec = timeoutUs / 1000000,
+		.tv_nsec = timeoutUs % 1000000 * 1000
+	};
+	return timeoutUs>=0 && 1==ppoll(&pollfd,1,&timeout,0);
+}
+
+bool fdWaitWritableUs(int fd, Int64 timeoutUs) {
+	struct pollfd pollfd = {
+		.fd = fd,
+		.events = POLLOUT,
+		.revents = 0
+	};
+	const struct timespec timeout = {
+		.tv_sec = timeoutUs / 1000000,
+		.tv_nsec = timeoutUs % 1000000 * 1000
+	};
+	return timeoutUs>=0 && 1==ppoll(&pollfd,1,&timeout,0);
+}
+
+Int64 fdClockUs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (Int64)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+void fdSleepUntilUs(Int64 deadlineUs) {
+	const struct timespec ts = {
+		.tv_sec = deadlineUs / 1000000,
+		.tv_nsec = deadlineUs % 1000000 * 1000,
+	};
+	while (EINTR==clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,0));
+}
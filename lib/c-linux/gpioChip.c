@@ -0,0 +1,77 @@
+/*
+  gpioChip.c 
+  Copyright 2013 Marc Prager
+ 
+  This file is part of the c-linux library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+ 
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+ 
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <c-linux/gpioChip.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+bool gpioLinesRequest (GpioLines *lines, const char *chip, const unsigned *offsets, int n, Uint32 values,
+	const char *consumer) {
+
+	if (n<1 || n>GPIO_LINES_MAX) return false;
+
+	*lines = (GpioLines) {
+		.fd = -1,
+		.fake = 0==strcmp (chip,"fake"),
+		.nLines = n,
+		.values = values & (1u<<n)-1,
+	};
+	memcpy (lines->offsets, offsets, n*sizeof *offsets);
+	if (lines->fake) return true;
+
+	struct gpio_v2_line_request request = {
+		.num_lines = n,
+		.config = {
+			.flags = GPIO_V2_LINE_FLAG_OUTPUT,
+			.num_attrs = 1,
+			.attrs[0] = {
+				.attr = {
+					.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES,
+					.values = values,
+				},
+				.mask = (1u<<n)-1,
+			},
+		},
+	};
+	for (int i=0; i<n; i++) request.offsets[i] = offsets[i];
+	strncpy (request.consumer, consumer, sizeof request.consumer-1);
+
+	const int fdChip = open (chip,O_RDWR|O_CLOEXEC);
+	if (fdChip<0) return false;
+	const bool success = ioctl (fdChip,GPIO_V2_GET_LINE_IOCTL,&request)==0;
+	close (fdChip);		// the line request has its own file descriptor
+	if (success) lines->fd = request.fd;
+	return success;
+}
+
+bool gpioLinesSet (GpioLines *lines, Uint32 mask, Uint32 values) {
+	mask &= (1u<<lines->nLines)-1;
+	if (!lines->fake) {
+		struct gpio_v2_line_values lineValues = { .bits = values, .mask = mask, };
+		if (lines->fd<0 || ioctl (lines->fd,GPIO_V2_LINE_SET_VALUES_IOCTL,&lineValues)!=0) return false;
+	}
+	lines->values = lines->values & ~mask | values & mask;
+	lines->changes++;
+	return true;
+}
+
+void gpioLinesRelease (GpioLines *lines) {
+	if (lines->fd>=0) close (lines->fd);
+	lines->fd = -1;
+}
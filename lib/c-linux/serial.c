@@ -19,11 +19,13 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <linux/serial.h>
+#include <stdio.h>
+#include <string.h>
 
 //#define DEBUG(x) x		// uncomment for debugging
 #define DEBUG(x)
 
-DEBUG(#include <stdio.h>)
 
 static int baud2Termios(int baud) {
 	switch(baud) {
@@ -33,6 +35,12 @@ static int baud2Termios(int baud) {
 		case 57600:	return B57600;
 		case 115200:	return B115200;
 		case 230400:	return B230400;
+		case 460800:	return B460800;
+		case 921600:	return B921600;
+		case 1000000:	return B1000000;
+		case 1500000:	return B1500000;
+		case 2000000:	return B2000000;
+		case 3000000:	return B3000000;
 		default:	return B0;
 	}
 }
@@ -129,3 +137,62 @@ bool serialSetRts(int fd, bool on) {
 	else return false;
 }
 
+static bool serialLatencyTimerRead(const char *file, int *ms) {
+	FILE *f = fopen(file,"r");
+	if (f!=0) {
+		const bool success = 1==fscanf(f,"%d",ms);
+		fclose(f);
+		return success;
+	}
+	else return false;
+}
+
+static bool serialLatencyTimerWrite(const char *file, int ms) {
+	FILE *f = fopen(file,"w");
+	if (f!=0) {
+		const bool success = 0<fprintf(f,"%d\n",ms);
+		return 0==fclose(f) && success;
+	}
+	else return false;
+}
+
+bool serialLowLatencyEnable(SerialLowLatency *saved, int fd, int latencyTimerMs) {
+	*saved = (SerialLowLatency) { .fd = fd };
+
+	struct serial_struct serial;
+	if (0==ioctl(fd,TIOCGSERIAL,&serial)) {
+		saved->serialFlags = serial.flags;
+		serial.flags |= ASYNC_LOW_LATENCY;
+		saved->asyncLowLatency = 0==ioctl(fd,TIOCSSERIAL,&serial);
+	}
+
+	// only the ftdi_sio driver provides this attribute.
+	const char *tty = ttyname(fd);
+	const char *name = tty!=0 ? strrchr(tty,'/') : 0;
+	char file[sizeof saved->latencyTimerFile];
+	if (name!=0
+	&& (int)sizeof file > snprintf(file,sizeof file,"/sys/bus/usb-serial/devices/%s/latency_timer",name+1)
+	&& serialLatencyTimerRead(file,&saved->latencyTimerMs)
+	&& serialLatencyTimerWrite(file,latencyTimerMs)) {
+		strcpy(saved->latencyTimerFile,file);
+	}
+	else {
+		DEBUG( fprintf(stderr,"No FTDI latency timer changed\n"); )
+	}
+
+	return saved->asyncLowLatency || saved->latencyTimerFile[0]!=0;
+}
+
+bool serialLowLatencyRestore(const SerialLowLatency *saved) {
+	bool success = true;
+	if (saved->asyncLowLatency) {
+		struct serial_struct serial;
+		success = 0==ioctl(saved->fd,TIOCGSERIAL,&serial);
+		serial.flags = serial.flags & ~ASYNC_LOW_LATENCY | saved->serialFlags & ASYNC_LOW_LATENCY;
+		success = success && 0==ioctl(saved->fd,TIOCSSERIAL,&serial);
+	}
+	if (saved->latencyTimerFile[0]!=0) {
+		success = serialLatencyTimerWrite(saved->latencyTimerFile,saved->latencyTimerMs) && success;
+	}
+	return success;
+}
@@ -0,0 +1,277 @@
+/*
+  serialTcp.c
+  Copyright 2013 Marc Prager
+
+  This file is part of the c-linux library.
+  c-any is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  c-any is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with c-any.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <c-linux/serialTcp.h>
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+enum {
+	TELNET_SE		=240,
+	TELNET_SB		=250,
+	TELNET_WILL		=251,
+	TELNET_WONT		=252,
+	TELNET_DO		=253,
+	TELNET_DONT		=254,
+	TELNET_IAC		=255,
+
+	OPTION_BINARY		=0,
+	OPTION_SGA		=3,	///< suppress go ahead
+	OPTION_COM_PORT		=44,	///< RFC 2217
+
+	COM_PORT_SET_BAUDRATE	=1,
+	COM_PORT_SET_DATASIZE	=2,
+	COM_PORT_SET_PARITY	=3,
+	COM_PORT_SET_STOPSIZE	=4,
+	COM_PORT_SET_CONTROL	=5,
+
+	CONTROL_NO_FLOW_CONTROL	=1,
+	CONTROL_DTR_ON		=8,
+	CONTROL_DTR_OFF		=9,
+	CONTROL_RTS_ON		=11,
+	CONTROL_RTS_OFF		=12,
+
+	PARITY_NONE		=1,
+	STOPSIZE_1		=1,
+};
+
+enum {	// receiver states
+	RX_DATA,
+	RX_IAC,
+	RX_OPTION,		// after WILL/WONT/DO/DONT
+	RX_SB,			// sub-negotiation contents, ignored
+	RX_SB_IAC,
+};
+
+static const char schemeRaw[] = "tcp://";
+static const char schemeRfc2217[] = "rfc2217://";
+
+static bool hasPrefix(const char *s, const char *prefix) {
+	return 0==strncmp(s,prefix,strlen(prefix));
+}
+
+bool serialTcpIsUrl(const char *name) {
+	return hasPrefix(name,schemeRaw) || hasPrefix(name,schemeRfc2217);
+}
+
+/** Sends a buffer completely, waiting for space in the socket's send buffer if necessary.
+ */
+static bool sendAll(int fd, const Uint8 *data, size_t n) {
+	while (n>0) {
+		const ssize_t sent = send(fd,data,n,MSG_NOSIGNAL);
+		if (sent>0) {
+			data += sent;
+			n -= sent;
+		}
+		else if (sent<0 && errno==EINTR) ;
+		else if (sent<0 && errno==EAGAIN) {
+			struct pollfd pfd = { .fd = fd, .events = POLLOUT, };
+			if (poll(&pfd,1,-1)<0 && errno!=EINTR) return false;
+		}
+		else return false;
+	}
+	return true;
+}
+
+/** Appends a COM-PORT-OPTION command with a value of 1 or 4 bytes to a buffer.
+ * @return the new end of the buffer.
+ */
+static Uint8* comPortCommand(Uint8 *p, int command, Uint32 value, int bytes) {
+	*p++ = TELNET_IAC;
+	*p++ = TELNET_SB;
+	*p++ = OPTION_COM_PORT;
+	*p++ = command;
+	for (int i=bytes-1; i>=0; i--) {
+		const Uint8 b = value>>8*i;
+		*p++ = b;
+		if (b==TELNET_IAC) *p++ = TELNET_IAC;
+	}
+	*p++ = TELNET_IAC;
+	*p++ = TELNET_SE;
+	return p;
+}
+
+static Uint8* negotiation(Uint8 *p, int verb, int option) {
+	*p++ = TELNET_IAC;
+	*p++ = verb;
+	*p++ = option;
+	return p;
+}
+
+bool serialTcpOpen(SerialTcp *serial, const char *url, int baud) {
+	*serial = (SerialTcp) { .fd = -1, .telnet = hasPrefix(url,schemeRfc2217), };
+
+	// split host:port, host may be [IPv6]
+	const char *host = url + strlen(serial->telnet ? schemeRfc2217 : schemeRaw);
+	const char *colon = strrchr(host,':');
+	if (colon==0 || colon==host || colon[1]==0) return false;
+	char name[256];
+	const bool bracketed = host[0]=='[' && colon[-1]==']';
+	const size_t length = colon-host - (bracketed ? 2 : 0);
+	if (length>=sizeof name) return false;
+	memcpy(name,host+bracketed,length);
+	name[length] = 0;
+
+	const struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM,
+	};
+	struct addrinfo *addresses;
+	if (0!=getaddrinfo(name,colon+1,&hints,&addresses)) return false;
+	for (const struct addrinfo *a = addresses; a!=0 && serial->fd<0; a = a->ai_next) {
+		serial->fd = socket(a->ai_family,a->ai_socktype,a->ai_protocol);
+		if (serial->fd>=0 && 0!=connect(serial->fd,a->ai_addr,a->ai_addrlen)) {
+			close(serial->fd);
+			serial->fd = -1;
+		}
+	}
+	freeaddrinfo(addresses);
+	if (serial->fd<0) return false;
+
+	// non-blocking like a serial line without VMIN/VTIME: reads never wait, timeouts are up to the caller's poll
+	const int on = 1;
+	const int flags = fcntl(serial->fd,F_GETFL);
+	if (flags<0 || 0!=fcntl(serial->fd,F_SETFL,flags|O_NONBLOCK)
+	|| 0!=setsockopt(serial->fd,IPPROTO_TCP,TCP_NODELAY,&on,sizeof on)) {
+		serialTcpClose(serial);
+		return false;
+	}
+
+	if (serial->telnet) {	// options and line settings in one segment, the server's replies are ignored
+		Uint8 buffer[128];
+		Uint8 *p = buffer;
+		p = negotiation(p,TELNET_WILL,OPTION_BINARY);
+		p = negotiation(p,TELNET_DO,OPTION_BINARY);
+		p = negotiation(p,TELNET_WILL,OPTION_SGA);
+		p = negotiation(p,TELNET_DO,OPTION_SGA);
+		p = negotiation(p,TELNET_WILL,OPTION_COM_PORT);
+		p = comPortCommand(p,COM_PORT_SET_BAUDRATE,baud,4);
+		p = comPortCommand(p,COM_PORT_SET_DATASIZE,8,1);
+		p = comPortCommand(p,COM_PORT_SET_PARITY,PARITY_NONE,1);
+		p = comPortCommand(p,COM_PORT_SET_STOPSIZE,STOPSIZE_1,1);
+		p = comPortCommand(p,COM_PORT_SET_CONTROL,CONTROL_NO_FLOW_CONTROL,1);
+		if (!sendAll(serial->fd,buffer,p-buffer)) {
+			serialTcpClose(serial);
+			return false;
+		}
+	}
+	return true;
+}
+
+void serialTcpClose(SerialTcp *serial) {
+	if (serial->fd>=0) close(serial->fd);
+	serial->fd = -1;
+}
+
+/** Answers the server's negotiation. All options we want were requested in serialTcpOpen(), all others are refused.
+ * Agreeing only once avoids negotiation loops.
+ */
+static void negotiate(SerialTcp *serial, int verb, int option) {
+	const bool wanted = option==OPTION_BINARY || option==OPTION_SGA || (verb==TELNET_DO && option==OPTION_COM_PORT);
+	Uint8 buffer[3];
+	if (verb==TELNET_DO && !wanted) sendAll(serial->fd,buffer,negotiation(buffer,TELNET_WONT,option)-buffer);
+	if (verb==TELNET_WILL && !wanted) sendAll(serial->fd,buffer,negotiation(buffer,TELNET_DONT,option)-buffer);
+}
+
+int serialTcpRead(SerialTcp *serial, void *buffer, int n) {
+	Uint8 *const data = buffer;
+	const int received = read(serial->fd,data,n);
+	if (received==0) errno = ECONNRESET;
+	if (received<=0) return -1;
+	if (!serial->telnet) return received;
+
+	int length = 0;		// data is compacted in place
+	for (int i=0; i<received; i++) {
+		const Uint8 c = data[i];
+		switch(serial->state) {
+			case RX_DATA:
+				if (c==TELNET_IAC) serial->state = RX_IAC;
+				else data[length++] = c;
+				break;
+			case RX_IAC:
+				serial->state = RX_DATA;
+				if (c==TELNET_IAC) data[length++] = c;
+				else if (c>=TELNET_WILL) {
+					serial->verb = c;
+					serial->state = RX_OPTION;
+				}
+				else if (c==TELNET_SB) serial->state = RX_SB;
+				break;	// other commands (NOP, GA,..) are ignored
+			case RX_OPTION:
+				negotiate(serial,serial->verb,c);
+				serial->state = RX_DATA;
+				break;
+			case RX_SB:	// server's confirmations and notifications
+				if (c==TELNET_IAC) serial->state = RX_SB_IAC;
+				break;
+			case RX_SB_IAC:
+				serial->state = c==TELNET_SE ? RX_DATA : RX_SB;
+				break;
+		}
+	}
+	return length;
+}
+
+int serialTcpWriteFifo(SerialTcp *serial, Fifo *fifo) {
+	Uint8 buffer[4096];
+	int total = 0;
+	while (fifoCanRead(fifo)) {
+		size_t n = 0;
+		while (fifoCanRead(fifo) && n<sizeof buffer-1) {
+			const Uint8 c = fifoRead(fifo);
+			buffer[n++] = c;
+			if (serial->telnet && c==TELNET_IAC) buffer[n++] = TELNET_IAC;
+		}
+		if (!sendAll(serial->fd,buffer,n)) return -1;
+		total += n;
+	}
+	return total;
+}
+
+static bool setControl(SerialTcp *serial, const Uint8 *values, int n) {
+	if (!serial->telnet) return false;
+	Uint8 buffer[32];
+	Uint8 *p = buffer;
+	for (int i=0; i<n; i++) p = comPortCommand(p,COM_PORT_SET_CONTROL,values[i],1);
+	return sendAll(serial->fd,buffer,p-buffer);
+}
+
+// logic level 1 is the inactive RS-232 level, like in serial.c
+
+bool serialTcpSetDtr(SerialTcp *serial, bool on) {
+	const Uint8 value = on ? CONTROL_DTR_OFF : CONTROL_DTR_ON;
+	return setControl(serial,&value,1);
+}
+
+bool serialTcpSetRts(SerialTcp *serial, bool on) {
+	const Uint8 value = on ? CONTROL_RTS_OFF : CONTROL_RTS_ON;
+	return setControl(serial,&value,1);
+}
+
+bool serialTcpSetRtsDtr(SerialTcp *serial, bool rts, bool dtr) {
+	const Uint8 values[] = {
+		rts ? CONTROL_RTS_OFF : CONTROL_RTS_ON,
+		dtr ? CONTROL_DTR_OFF : CONTROL_DTR_ON,
+	};
+	return setControl(serial,values,2);
+}
+
@@ -0,0 +1,284 @@
+/*
+  dogsim.c - checks the partial refresh of the EA DOGM128 drivers against a model of the ST7565 controller.
+  Copyright 2013 Marc Prager
+
+  dogsim is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  dogsim is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with dogsim.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <integers.h>
+#include <dogDriver.h>
+#include <st7565.h>
+#include <eadogm128.h>
+#include <fb128x64.h>
+#include <fbConsole.h>
+#include <fonts.h>
+#include <macros.h>
+
+/** @file
+ * @brief Runs fb128x64Update() and fbConsole on the host, with the SPI transfer replaced by a model of the ST7565.
+ *
+ * The model interprets the page, column and start line commands, that eadogm128Flush() encodes into the transfers,
+ * and shows its RAM like the display does. After each update, the display must show the framebuffer, or the text of
+ * a reference console. The bytes on the bus are counted for comparing partial and full refreshes.
+ */
+
+const char *dogsim = "dogsim";
+
+enum {
+	N_X		=16,		///< text columns of fbConsole
+	N_Y		=8,		///< text lines of fbConsole
+	ST7565_COLUMNS	=132,
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The transfer queue, which is emptied by the SPI interrupt on the target, and the ST7565 at the other end.
+
+static DogDriverElement elements[4];		///< few, to exercise the pages left dirty by a full queue
+
+static struct {
+	Uint8		ram[8][ST7565_COLUMNS];
+	int		page;
+	int		column;
+	int		startLine;
+	Uint64		bytes;			///< bytes on the bus
+	int		errors;			///< data written outside the columns of the display
+} st7565;
+
+int dogDriverStartTransfer(const void *data, int n, DogDriverCallback *callback, int subIndex) {
+	return dogDriverTransfer(data,n,callback,subIndex);
+}
+
+static void st7565Byte(DogByte b) {
+	const Uint8 byte = b & 0xFF;
+	st7565.bytes++;
+	if (b & DOG_DATA) {
+		if (st7565.column<ST7565_COLUMNS) st7565.ram[st7565.page][st7565.column++] = byte;
+		else st7565.errors++;
+	}
+	else if ((byte & 0xF0)==DISPLAY_PAGE) st7565.page = byte & 7;
+	else if ((byte & 0xF0)==DISPLAY_COLUMN) st7565.column = (byte & 0xF)<<4 | st7565.column & 0xF;
+	else if ((byte & 0xF0)==0) st7565.column = st7565.column & 0xF0 | byte;
+	else if ((byte & 0xC0)==DISPLAY_SCROLL_Y) st7565.startLine = byte & 63;
+}
+
+/** Plays the queued transfers to the controller, like the SPI interrupt does.
+ * @return the number of bytes transferred.
+ */
+static int drain(void) {
+	const Uint64 bytes = st7565.bytes;
+	while (dogDriverCanRead()) st7565Byte(dogDriverReadByte());
+	return st7565.bytes-bytes;
+}
+
+/** Updates the display until the framebuffer is transferred completely.
+ * @return the number of bytes transferred.
+ */
+static int update(void) {
+	int bytes = 0;
+	while (fb128x64Update()) bytes += drain();
+	return bytes;
+}
+
+static bool displayPixel(int x, int y) {
+	const int row = (y+st7565.startLine) & 63;
+	return st7565.ram[row/8][x]>>(row&7) & 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Checks
+
+static Uint64 expectedBuffer[128];
+static Gfxmono expected = { 128,64, 64,1, expectedBuffer };
+
+/** Compares the display, as selected by the start line, with an image.
+ */
+static bool checkDisplay(const char *what, int test, const Gfxmono *image) {
+	for (int x=0; x<128; x++) for (int y=0; y<64; y++) {
+		if (displayPixel(x,y)!=gfxmonoGetPixelFast(image,x,y)) {
+			fprintf(stderr,"%s: %s, test %d: pixel (%d,%d) differs, start line %d\n",
+				dogsim,what,test,x,y,st7565.startLine);
+			return false;
+		}
+	}
+	return true;
+}
+
+static int randomIn(int from, int to) {
+	return from + rand()%(to-from+1);
+}
+
+/** Draws random boxes and strings and checks the display after each update. The bytes transferred must be the
+ * pages and columns of the dirty area, with 3 command bytes per page, or a full refresh.
+ * @return the number of errors.
+ */
+static int testUpdate(int tests, int *partialBytes) {
+	int errors = 0;
+	fb128x64Clear(false);
+	fb128x64SetStartLine(0);
+	const int full = update();
+	if (full!=1024+8*3+1 || !checkDisplay("full refresh",0,&fb128x64)) errors++;
+	printf("full refresh       : %d bytes\n",full);
+
+	Uint64 bytes = 0;
+	for (int t=0; t<tests; t++) {
+		const int x = randomIn(-20,130), y = randomIn(-20,66);
+		if (t&1) gfxmonoBitBltFill(&fb128x64,x,y,randomIn(0,40),randomIn(0,30),rand()&1);
+		else {
+			char text[4];
+			for (int i=0; i<sizeof text-1; i++) text[i] = randomIn(' ','~');
+			text[sizeof text-1] = 0;
+			gfxmonoDrawString(&fb128x64,x,y,&fontVga8x8,text,rand()&1);
+		}
+		const GfxmonoDirty d = fb128x64.dirty;
+		const bool isFull = d.x0==0 && d.y0==0 && d.x1==128 && d.y1==64;
+		const int expectedBytes = !gfxmonoIsDirty(&fb128x64) ? 0
+			: isFull ? 1024+8*3 : ((d.y1-1)/8 - d.y0/8 + 1) * (3 + d.x1-d.x0);
+		const int n = update();
+		bytes += n;
+		if (n!=expectedBytes) {
+			fprintf(stderr,"%s: update, test %d: %d bytes instead of %d\n",dogsim,t,n,expectedBytes);
+			errors++;
+		}
+		else if (!checkDisplay("update",t,&fb128x64)) errors++;
+	}
+	*partialBytes = tests ? bytes/tests : 0;
+	return errors;
+}
+
+/** The text, that fbConsole is expected to show.
+ */
+static struct {
+	char		lines[N_Y][N_X+1];
+	int		x;
+	int		y;
+} reference;
+
+static void referenceScroll(int nY) {
+	char lines[N_Y][N_X+1] = {};
+	for (int y=0; y<N_Y; y++) if (0<=y-nY && y-nY<N_Y) strcpy(lines[y],reference.lines[y-nY]);
+	memcpy(reference.lines,lines,sizeof lines);
+}
+
+static void referencePrint(const char *text) {
+	for ( ; *text; text++) {
+		if (*text=='\n' || reference.x>=N_X) {
+			reference.x = 0;
+			if (reference.y+1<N_Y) reference.y++;
+			else referenceScroll(-1);
+		}
+		if (*text!='\n') {
+			reference.lines[reference.y][reference.x++] = *text;
+			reference.lines[reference.y][reference.x] = 0;
+		}
+	}
+}
+
+static bool checkConsole(const char *what, int test) {
+	memset(expectedBuffer,0,sizeof expectedBuffer);
+	for (int y=0; y<N_Y; y++) gfxmonoDrawString(&expected,0,fbConsoleY(y),&fontVga8x8,reference.lines[y],true);
+	return checkDisplay(what,test,&expected);
+}
+
+/** Prints lines to fbConsole and updates the display after each line. With scrolling by the start line, only the
+ * lines scrolled in must be transferred, and they must be empty.
+ * @return the number of errors.
+ */
+static int testConsole(int lines, bool byStartLine, int *bytesPerLine) {
+	int errors = 0;
+	fbConsoleInit(true);
+	fbConsoleScrollStartLine(byStartLine);
+	fbConsolePrintChar('\f');
+	memset(&reference,0,sizeof reference);
+	update();
+
+	Uint64 bytes = 0;
+	for (int l=0; l<lines; l++) {
+		char text[32];
+		snprintf(text,sizeof text,l%5==4 ? "\nline %d, too long to fit" : "\nline %d",l);
+		fbConsolePrintString(text);
+		referencePrint(text);
+		const GfxmonoDirty d = fb128x64.dirty;
+		const int n = update();
+		bytes += n;
+		// up to two new lines and the start line, unless they are the last and first of the buffer
+		if (byStartLine && n>2*(3+128)+1 && !(d.y0==0 && d.y1==64)) {
+			fprintf(stderr,"%s: console, start line, test %d: %d bytes transferred\n",dogsim,l,n);
+			errors++;
+		}
+		if (!checkConsole(byStartLine ? "console, start line" : "console",l)) errors++;
+	}
+	*bytesPerLine = lines ? bytes/lines : 0;
+
+	// scrolling down and by several lines clears the lines scrolled in
+	static const int scrolls[] = { 2, -3, N_Y-1, 0, -1 };
+	for (int s=0; s<ELEMENTS(scrolls); s++) {
+		fbConsolePrintString("\nfill");
+		referencePrint("\nfill");
+		fbConsoleScrollY(scrolls[s]);
+		referenceScroll(scrolls[s]);
+		update();
+		if (!checkConsole("console, scroll",scrolls[s])) errors++;
+	}
+
+	// switching the mode keeps the text in place
+	fbConsoleScrollStartLine(!byStartLine);
+	update();
+	if (st7565.startLine!=0 || !checkConsole("console, mode switched",0)) errors++;
+	fbConsoleScrollStartLine(false);
+	return errors;
+}
+
+int main(int argc, char* argv[]) {
+	struct {
+		unsigned tests;
+		unsigned lines;
+	}
+	options = {
+		.tests = 10000,
+		.lines = 100,
+	};
+
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"l:n:h?")); ) switch(optChar) {
+		case 'l':	options.lines = strtol(optarg,0,0); break;
+		case 'n':	options.tests = strtol(optarg,0,0); break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options]\n",dogsim);
+			printf("Checks fb128x64Update() and the scrolling of fbConsole against a model of the EA DOGM128 controller\n");
+			printf("and reports the bytes transferred.\n");
+			printf("options:\n");
+			printf("  -n <n>            : number of random drawings [%u]\n",options.tests);
+			printf("  -l <n>            : number of console lines [%u]\n",options.lines);
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+
+	dogDriverInit(elements,sizeof elements);
+
+	srand(1);
+	int partial, moved, rotated;
+	int errors = testUpdate(options.tests,&partial);
+	printf("random drawing     : %u tests, %d bytes per update\n",options.tests,partial);
+	errors += testConsole(options.lines,false,&moved);
+	printf("console            : %d bytes per line, moving the framebuffer\n",moved);
+	errors += testConsole(options.lines,true,&rotated);
+	printf("console            : %d bytes per line, by the start line\n",rotated);
+	if (st7565.errors!=0) {
+		fprintf(stderr,"%s: %d bytes written beyond the last column\n",dogsim,st7565.errors);
+		errors++;
+	}
+	printf("errors             : %d\n",errors);
+	return errors==0 ? 0 : 1;
+}
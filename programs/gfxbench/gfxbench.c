@@ -0,0 +1,317 @@
+/*
+  gfxbench.c - equivalence and throughput of the gfxmono blitter.
+  Copyright 2013 Marc Prager
+
+  gfxbench is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  gfxbench is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with gfxbench.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <integers.h>
+#include <gfxmono.h>
+#include <fonts.h>
+#include <macros.h>
+
+const char *gfxbench = "gfxbench";
+
+static double timeS(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The pixel by pixel implementation, that the blitter replaced. Fill and scroll clip their areas correctly here.
+
+static void refBitBlt(
+	Gfxmono *dstGfxmono, int dstX, int dstY, int nX, int nY, bool color,
+	const Gfxmono *srcGfxmono, int srcX, int srcY) {
+
+	for (int dx=0; dx<nX; dx++) for (int dy=0; dy<nY; dy++) {
+		const bool pixel = !color ^ ((0<=srcX+dx && srcX+dx<srcGfxmono->nX && 0<=srcY+dy && srcY+dy<srcGfxmono->nY) ?
+				gfxmonoGetPixelFast(srcGfxmono,srcX+dx,srcY+dy) : false);
+
+		if (0<=dstX+dx && dstX+dx<dstGfxmono->nX && 0<=dstY+dy && dstY+dy<dstGfxmono->nY)
+			gfxmonoSetPixelFast(dstGfxmono,dstX+dx,dstY+dy,pixel);
+	}
+}
+
+static void refBitBltFill(Gfxmono *gfx, int x, int y, int nX, int nY, bool color) {
+	for (int dx=0; dx<nX; dx++) for (int dy=0; dy<nY; dy++) gfxmonoSetPixel(gfx,x+dx,y+dy,color);
+}
+
+static void refDrawString(Gfxmono *gfx, int x, int y, Font const *font, const char *string, bool color) {
+	for ( ;*string; string++) {
+		const CharLocation location = font->charLocation(*string);
+		refBitBlt(gfx,x,y,location.nX,font->nY,color,font->gfx,location.x,location.y);
+		x += location.nX;
+	}
+}
+
+static R2 clipWindow(const Gfxmono *gfx, R2 window) {
+	const R2 rGfx = {{ 0,0, gfx->nX-1, gfx->nY-1 }};
+	return r2Intersect(rGfx,window);
+}
+
+static void refScrollY(Gfxmono *gfx, R2 window, int nUp, bool color) {
+	const R2 dest = clipWindow(gfx,window);
+
+	if (nUp>0) {	// scroll up
+		for (int y=dest.y0; y<=dest.y1; ++y) for (int x=dest.x0; x<=dest.x1; ++x)
+			gfxmonoSetPixelFast(gfx,x,y, y+nUp<=dest.y1 ? gfxmonoGetPixelFast(gfx,x,y+nUp) : color);
+	}
+	else {		// scroll down
+		for (int y=dest.y1; y>=dest.y0; --y) for (int x=dest.x0; x<=dest.x1; ++x)
+			gfxmonoSetPixelFast(gfx,x,y, dest.y0<=y+nUp ? gfxmonoGetPixelFast(gfx,x,y+nUp) : color);
+	}
+}
+
+static void refScrollX(Gfxmono *gfx, R2 window, int nLeft, bool color) {
+	const R2 area = clipWindow(gfx,window);
+
+	if (nLeft>0)	// scroll left
+		for (int x=area.x0; x<=area.x1; ++x) for (int y=area.y0; y<=area.y1; ++y)
+			gfxmonoSetPixelFast(gfx,x,y, x+nLeft<=area.x1 ? gfxmonoGetPixelFast(gfx,x+nLeft,y) : color);
+	else		// scroll right
+		for (int x=area.x1; x>=area.x0; --x) for (int y=area.y0; y<=area.y1; ++y)
+			gfxmonoSetPixelFast(gfx,x,y, area.x0<=x+nLeft ? gfxmonoGetPixelFast(gfx,x+nLeft,y) : color);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Surfaces of all memory layouts in use: columns (framebuffers, some fonts), rows (most fonts) and others.
+
+enum {
+	BUFFER_SIZE	=2048,		///< bytes, enough for every surface
+};
+
+typedef struct {
+	const char	*name;
+	Gfxmono		gfx;
+} Surface;
+
+static Surface surfaces[] = {
+	{ "fb128x64",		{ 128,64, 64,1, } },
+	{ "text128x8",		{ 128,8, 8,1, } },
+	{ "columns30x37",	{ 30,37, 39,1, } },
+	{ "rows100x40",		{ 100,40, 1,104, } },
+	{ "rows37x20",		{ 37,20, 1,41, } },
+	{ "other20x10",		{ 20,10, 2,40, } },
+};
+
+static const Font* const fonts[] = {
+	&font7x8, &font8x8, &fontVga6x11, &fontVga8x8, &fontSun8x16, &fontSun12x22, &fontNimbus38x30,
+};
+
+static Uint8 bufferRef[BUFFER_SIZE] __attribute__((aligned(8)));
+static Uint8 bufferNew[BUFFER_SIZE] __attribute__((aligned(8)));
+static Uint8 bufferSrc[BUFFER_SIZE] __attribute__((aligned(8)));
+static Uint8 bufferOld[BUFFER_SIZE] __attribute__((aligned(8)));
+
+static void randomFill(Uint8 *buffer) {
+	for (int i=0; i<BUFFER_SIZE; i++) buffer[i] = rand();
+}
+
+static Gfxmono on(const Surface *surface, Uint8 *buffer) {
+	Gfxmono gfx = surface->gfx;
+	gfx.pixels = buffer;
+	return gfx;
+}
+
+static int randomIn(int from, int to) {
+	return from + rand()%(to-from+1);
+}
+
+/** Compares the results and checks, that all pixels modified are within the dirty area.
+ */
+static bool check(const char *what, const char *surface, int test, const Gfxmono *gfx) {
+	const GfxmonoDirty *d = &gfx->dirty;
+	const Gfxmono old = { gfx->nX, gfx->nY, gfx->unitX, gfx->unitY, bufferOld };
+	for (int x=0; x<gfx->nX; x++) for (int y=0; y<gfx->nY; y++) {
+		if (gfxmonoGetPixelFast(gfx,x,y)!=gfxmonoGetPixelFast(&old,x,y)
+		&& !(d->x0<=x && x<d->x1 && d->y0<=y && y<d->y1)) {
+			fprintf(stderr,"%s: %s on %s, test %d: pixel (%d,%d) modified outside dirty area\n",
+				gfxbench,what,surface,test,x,y);
+			return false;
+		}
+	}
+
+	if (0==memcmp(bufferRef,bufferNew,BUFFER_SIZE)) return true;
+	for (int i=0; i<BUFFER_SIZE; i++) if (bufferRef[i]!=bufferNew[i]) {
+		fprintf(stderr,"%s: %s on %s differs, test %d, byte %d: 0x%02X instead of 0x%02X\n",
+			gfxbench,what,surface,test,i,bufferNew[i],bufferRef[i]);
+		break;
+	}
+	return false;
+}
+
+/** Compares the blitter with the reference implementation on random rectangles, that are partially out of bounds.
+ * @return the number of differences.
+ */
+static int testEquivalence(int tests) {
+	int errors = 0;
+	for (int t=0; t<tests; t++) {
+		const Surface *surface = &surfaces[rand()%ELEMENTS(surfaces)];
+		randomFill(bufferRef);
+		memcpy(bufferNew,bufferRef,BUFFER_SIZE);
+		memcpy(bufferOld,bufferRef,BUFFER_SIZE);
+		Gfxmono ref = on(surface,bufferRef);
+		Gfxmono new = on(surface,bufferNew);
+		const int nX = ref.nX, nY = ref.nY;
+		const int x = randomIn(-20,nX+4), y = randomIn(-20,nY+4);
+		const int w = randomIn(0,nX+8), h = randomIn(0,nY+8);
+		const bool color = rand()&1;
+
+		switch(t%6) {
+			case 0: {	// from another surface
+				const Surface *srcSurface = &surfaces[rand()%ELEMENTS(surfaces)];
+				randomFill(bufferSrc);
+				const Gfxmono src = on(srcSurface,bufferSrc);
+				const int sx = randomIn(-20,src.nX+4), sy = randomIn(-20,src.nY+4);
+				refBitBlt(&ref,x,y,w,h,color,&src,sx,sy);
+				gfxmonoBitBlt(&new,x,y,w,h,color,&src,sx,sy);
+				if (!check("gfxmonoBitBlt",srcSurface->name,t,&new)) errors++;
+			} break;
+			case 1: {	// overlapping, the reference reads from a copy
+				const int sx = randomIn(-4,nX), sy = randomIn(-4,nY);
+				memcpy(bufferSrc,bufferRef,BUFFER_SIZE);
+				const Gfxmono src = on(surface,bufferSrc);
+				refBitBlt(&ref,x,y,w,h,color,&src,sx,sy);
+				gfxmonoBitBlt(&new,x,y,w,h,color,&new,sx,sy);
+				if (!check("gfxmonoBitBlt (overlapping)",surface->name,t,&new)) errors++;
+			} break;
+			case 2:
+				refBitBltFill(&ref,x,y,w,h,color);
+				gfxmonoBitBltFill(&new,x,y,w,h,color);
+				if (!check("gfxmonoBitBltFill",surface->name,t,&new)) errors++;
+				break;
+			case 3: {
+				const R2 window = {{ x,y, x+w,y+h }};
+				const int n = randomIn(-h-2,h+2);
+				refScrollY(&ref,window,n,color);
+				gfxmonoScrollY(&new,window,n,color);
+				if (!check("gfxmonoScrollY",surface->name,t,&new)) errors++;
+			} break;
+			case 4: {
+				const R2 window = {{ x,y, x+w,y+h }};
+				const int n = randomIn(-w-2,w+2);
+				refScrollX(&ref,window,n,color);
+				gfxmonoScrollX(&new,window,n,color);
+				if (!check("gfxmonoScrollX",surface->name,t,&new)) errors++;
+			} break;
+			case 5: {
+				const Font *font = fonts[rand()%ELEMENTS(fonts)];
+				char text[8];
+				for (int i=0; i<sizeof text-1; i++) text[i] = rand();
+				text[sizeof text-1] = 0;
+				if (text[0]==0) text[0] = 'A';
+				refDrawString(&ref,x,y,font,text,color);
+				gfxmonoDrawString(&new,x,y,font,text,color);
+				if (!check("gfxmonoDrawString",surface->name,t,&new)) errors++;
+			} break;
+		}
+	}
+	return errors;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Throughput of typical display operations on the 128x64 framebuffer.
+
+typedef void Blt(
+	Gfxmono *dstGfxmono, int dstX, int dstY, int nX, int nY, bool color,
+	const Gfxmono *srcGfxmono, int srcX, int srcY);
+
+/** Draws a screen full of characters.
+ * @return the time per character in ns.
+ */
+static double benchChars(Blt *blt, const Font *font, int yOffset, int repeat) {
+	Gfxmono fb = on(&surfaces[0],bufferNew);
+	const double t = timeS();
+	int chars = 0;
+	for (int r=0; r<repeat; r++) for (int y=yOffset; y+font->nY<=64; y+=font->nY) {
+		for (int x=0; x<128; ) {
+			const CharLocation location = font->charLocation('!'+chars++%90);
+			blt(&fb,x,y,location.nX,font->nY,true,font->gfx,location.x,location.y);
+			x += location.nX;
+		}
+	}
+	return (timeS()-t)/chars*1e9;
+}
+
+/** Scrolls the framebuffer by one text line.
+ * @return the time per scroll in ns.
+ */
+static double benchScroll(void (*scroll)(Gfxmono *gfx, R2 window, int nUp, bool color), int repeat) {
+	Gfxmono fb = on(&surfaces[0],bufferNew);
+	const R2 window = {{ 0,0, 127,63 }};
+	const double t = timeS();
+	for (int r=0; r<repeat; r++) scroll(&fb,window,8,false);
+	return (timeS()-t)/repeat*1e9;
+}
+
+static void printBench(const char *what, double refNs, double newNs) {
+	printf("  %-30s : %9.1f ns, was %9.1f ns, speedup %.1f\n",what,newNs,refNs,refNs/newNs);
+}
+
+int main(int argc, char* argv[]) {
+	struct {
+		unsigned tests;
+		unsigned repeat;
+	}
+	options = {
+		.tests = 100000,
+		.repeat = 200,
+	};
+
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"n:r:h?")); ) switch(optChar) {
+		case 'n':	options.tests = strtol(optarg,0,0); break;
+		case 'r':	options.repeat = strtol(optarg,0,0); break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options]\n",gfxbench);
+			printf("Compares the gfxmono blitter with the pixel by pixel implementation, checks the dirty areas and reports\n");
+			printf("its speed.\n");
+			printf("options:\n");
+			printf("  -n <n>            : number of random equivalence tests [%u]\n",options.tests);
+			printf("  -r <n>            : repeat every benchmark n times [%u]\n",options.repeat);
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+	if (options.repeat<1) options.repeat = 1;
+
+	srand(1);
+	const int errors = testEquivalence(options.tests);
+	printf("equivalence        : %u tests, %d differences\n",options.tests,errors);
+
+	printf("128x64 framebuffer :\n");
+	printBench("fontVga8x8, page aligned",
+		benchChars(&refBitBlt,&fontVga8x8,0,options.repeat),
+		benchChars(&gfxmonoBitBlt,&fontVga8x8,0,options.repeat));
+	printBench("fontVga8x8, unaligned",
+		benchChars(&refBitBlt,&fontVga8x8,3,options.repeat),
+		benchChars(&gfxmonoBitBlt,&fontVga8x8,3,options.repeat));
+	printBench("font8x8 (columns), aligned",
+		benchChars(&refBitBlt,&font8x8,0,options.repeat),
+		benchChars(&gfxmonoBitBlt,&font8x8,0,options.repeat));
+	printBench("fontSun8x16, unaligned",
+		benchChars(&refBitBlt,&fontSun8x16,5,options.repeat),
+		benchChars(&gfxmonoBitBlt,&fontSun8x16,5,options.repeat));
+	printBench("fontNimbus38x30",
+		benchChars(&refBitBlt,&fontNimbus38x30,2,options.repeat),
+		benchChars(&gfxmonoBitBlt,&fontNimbus38x30,2,options.repeat));
+	printBench("scroll by 8 pixels",
+		benchScroll(&refScrollY,options.repeat),
+		benchScroll(&gfxmonoScrollY,options.repeat));
+
+	return errors==0 ? 0 : 1;
+}
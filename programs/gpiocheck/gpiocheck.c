@@ -0,0 +1,178 @@
+/*
+  gpiocheck.c - plays the mxli reset waves on the fake GPIO backend and checks the line changes.
+  Copyright 2013 Marc Prager
+
+  gpiocheck is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  gpiocheck is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with gpiocheck.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <macros.h>
+#include <mxli.h>
+#include <c-linux/gpioChip.h>
+
+const char *gpiocheck = "gpiocheck";
+
+enum {
+	GPIO_LINE_BOOT,		// RTS, like mxli --raspi-gpio
+	GPIO_LINE_RESET,	// DTR
+	TRACE_MAX	=64,
+};
+
+/** A wave in the notation of mxli -W and the line values expected after each change, as /BOOT and /RESET digits.
+ * The lines start at 1 1.
+ */
+typedef struct {
+	const char	*name;
+	const char	*wave;
+	const char	*expected;		///< with setRtsDtr: adjacent D/R commands are one change
+	const char	*expectedSingle;	///< without setRtsDtr
+} WaveTest;
+
+static const WaveTest waveTests[] = {
+	{ "enter ISP",		"i=drpDPR",	"00 01 11",	"10 00 01 11" },
+	{ "enter ISP, R first",	"i=rdpDPR",	"00 01 11",	"01 00 01 11" },
+	{ "execute",		"x=dRpDPR",	"10 11 11",	"10 10 11 11" },
+	{ "jump",		"j=DRp",	"11",		"11 11" },
+	{ "error",		"e=drp",	"00",		"10 00" },
+	{ "separated",		"i=dpr",	"10 00",	"10 00" },
+	{ "three in a row",	"i=drD",	"00 01",	"10 00 01" },
+	{ "two pairs",		"i=drDR",	"00 11",	"10 00 01 11" },
+};
+
+static GpioLines lines;
+static char trace[TRACE_MAX];
+
+/** Appends the line values after a change to the trace.
+ */
+static bool traced (bool success) {
+	const size_t n = strlen (trace);
+	if (n+4<sizeof trace) snprintf (trace+n, sizeof trace-n, "%s%u%u", n ? " " : "",
+		lines.values>>GPIO_LINE_BOOT & 1, lines.values>>GPIO_LINE_RESET & 1);
+	return success;
+}
+
+static bool setRts (bool level) {
+	return traced (gpioLinesSet (&lines, 1<<GPIO_LINE_BOOT, level<<GPIO_LINE_BOOT));
+}
+
+static bool setDtr (bool level) {
+	return traced (gpioLinesSet (&lines, 1<<GPIO_LINE_RESET, level<<GPIO_LINE_RESET));
+}
+
+static bool setRtsDtr (bool rts, bool dtr) {
+	return traced (gpioLinesSet (&lines, 1<<GPIO_LINE_BOOT | 1<<GPIO_LINE_RESET,
+		rts<<GPIO_LINE_BOOT | dtr<<GPIO_LINE_RESET));
+}
+
+static void sleepUs (Int32 us) {
+}
+
+static char bufferStderr [512];
+static Fifo fifoStderr = { bufferStderr, sizeof bufferStderr, };
+
+static bool adapterPushStderr (const LpcIspIo *io) {
+	while (fifoCanRead (io->stderr)) fputc (fifoRead (io->stderr),stderr);
+	return true;
+}
+
+static LpcIspIo lpcIspIo = {
+	.stderr		= &fifoStderr,
+	.pushStderr	= &adapterPushStderr,
+	.setRts		= &setRts,
+	.setDtr		= &setDtr,
+	.sleepUs	= &sleepUs,
+	.debugLevel	= LPC_ISP_NORMAL,
+};
+
+/** Plays a wave on lines, that start at 1 1.
+ * @return the number of errors.
+ */
+static int runWave (const WaveTest *t, bool pairs, bool verbose) {
+	const char *expected = pairs ? t->expected : t->expectedSingle;
+	const unsigned offsets[] = { [GPIO_LINE_BOOT] = 18, [GPIO_LINE_RESET] = 17 };
+	if (!gpioLinesRequest (&lines, "fake", offsets, ELEMENTS(offsets), 3, gpiocheck)) {
+		printf ("%s: cannot request fake lines\n", t->name);
+		return 1;
+	}
+	lpcIspIo.setRtsDtr = pairs ? &setRtsDtr : 0;
+	*trace = 0;
+
+	char definition[32];
+	Fifo fifo;
+	snprintf (definition, sizeof definition, "%s", t->wave);
+	fifoInitRead (&fifo, definition, strlen (definition));
+	WaveSet waveSet;
+	static const WaveConfiguration conf = { };
+	const int id = t->wave[0]=='i' ? WAVE_ISP : t->wave[0]=='x' ? WAVE_EXECUTE
+		: t->wave[0]=='j' ? WAVE_JUMP : WAVE_ERROR;
+	const bool played = waveCompile (&lpcIspIo, &waveSet, &fifo)
+		&& lpcWavePlay (&lpcIspIo, &conf, &waveSet.waves[id], t->name);
+
+	// the final values are the last ones traced, one change is recorded per trace entry
+	const char *last = strrchr (expected,' ') ? strrchr (expected,' ')+1 : expected;
+	const Uint32 finalValues = (last[0]-'0')<<GPIO_LINE_BOOT | (last[1]-'0')<<GPIO_LINE_RESET;
+	const Uint32 changes = (strlen (expected)+1)/3;
+	gpioLinesRelease (&lines);
+
+	if (verbose) printf ("%-20s %-15s: %s\n", t->name, pairs ? "setRtsDtr" : "setRts/setDtr", trace);
+	if (played && !strcmp (trace,expected) && lines.values==finalValues && lines.changes==changes) return 0;
+	printf ("%s, %s: got \"%s\", final %u%u, %u changes, expected \"%s\"\n", t->name,
+		pairs ? "setRtsDtr" : "setRts/setDtr", trace,
+		lines.values>>GPIO_LINE_BOOT & 1, lines.values>>GPIO_LINE_RESET & 1, lines.changes, expected);
+	return 1;
+}
+
+/** Checks the line count limits and the masking of values beyond the lines requested.
+ * @return the number of errors.
+ */
+static int runRequest (void) {
+	const unsigned offsets[GPIO_LINES_MAX+1] = { };
+	int errors = 0;
+	if (gpioLinesRequest (&lines, "fake", offsets, 0, 0, gpiocheck)
+	|| gpioLinesRequest (&lines, "fake", offsets, GPIO_LINES_MAX+1, 0, gpiocheck)) {
+		printf ("request: invalid line count accepted\n");
+		errors++;
+	}
+	if (!gpioLinesRequest (&lines, "fake", offsets, 2, 0xFF, gpiocheck) || lines.values!=3
+	|| !gpioLinesSet (&lines, 0xFF, 0xFE) || lines.values!=2 || lines.changes!=1) {
+		printf ("request: values beyond the lines requested\n");
+		errors++;
+	}
+	gpioLinesRelease (&lines);
+	return errors;
+}
+
+int main(int argc, char* argv[]) {
+	bool verbose = false;
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"vh?")); ) switch(optChar) {
+		case 'v':	verbose = true; break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options]\n",gpiocheck);
+			printf("Plays reset waves with the GPIO character device backend of mxli --raspi-gpio in its 'fake' mode,\n");
+			printf("with and without changing both lines at once, and checks the line values after each change.\n");
+			printf("options:\n");
+			printf("  -v                : show the line values after each change\n");
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+
+	int failures = runRequest ();
+	for (int i=0; i<ELEMENTS(waveTests); i++) {
+		failures += runWave (&waveTests[i],true,verbose);
+		failures += runWave (&waveTests[i],false,verbose);
+	}
+	printf ("%d waves, %d failures\n",(int)ELEMENTS(waveTests),failures);
+	return failures==0 ? 0 : 1;
+}
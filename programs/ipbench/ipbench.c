@@ -0,0 +1,623 @@
+/*
+  ipbench.c - packet rate of the c-any IP stack on a Linux host, using replayed frames or a TAP device.
+  Copyright 2013 Marc Prager
+
+  ipbench is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  ipbench is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with ipbench.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <c-linux/enetIoLinux.h>
+#include <c-linux/fd.h>
+#include <ipStack.h>
+#include <ipStackTcp.h>
+#include <fifoParse.h>
+#include <macros.h>
+
+const char *ipbench = "ipbench";
+
+volatile int sysTickTimeMs;
+
+enum {
+	PORT_ECHO	=7,		///< UDP datagrams are sent back
+	PORT_DISCARD	=9,		///< UDP datagrams are accepted and dropped
+	PORT_CLOSED	=10,		///< ICMP port unreachable
+	PORT_CHARGEN	=19,		///< TCP only: data is sent until the peer closes
+	PEERS_MAX	=250,
+};
+
+static const Ip4NetworkConfiguration configuration = {
+	.ethernetAddress = { .int8s = { 0x02,0x00,0x00,0x00,0x00,0x01 } },
+	.ip4Address = { .int8s = { 10,0,0,1 } },
+	.gateway = { .int8s = { 10,0,0,254 } },
+	.subnetBits = 8,
+	.ttl = 64,
+};
+
+static Ip4Address peerIp4Address(int peer) {
+	const Ip4Address address = { .int8s = { 10,0,0,2+peer } };
+	return address;
+}
+
+static EthernetAddress peerEthernetAddress(int peer) {
+	const EthernetAddress address = { .int8s = { 0x02,0x00,0x00,0x00,0x01,peer } };
+	return address;
+}
+
+static bool udpHandler(Fifo *input, int port, const Ip4SocketAddress *inputAddress) {
+	switch(port) {
+		case PORT_ECHO: {
+			Fifo *output = udpSendBegin(inputAddress,PORT_ECHO);
+			const size_t n = fifoCanRead(input);
+			if (output==0 || n>fifoCanWrite(output)) return true;	// lost, as UDP may
+			// copy and checksum in one pass, if possible
+			if (fifoCanReadLinear(input)==n) udpSendWrite(output,fifoReadLinear(input),n);
+			else fifoPutFifo(output,input);
+			udpSendEnd(output);
+		} return true;
+		case PORT_DISCARD:	return true;
+		default:		return false;
+	}
+}
+
+/** TCP echo, discard and chargen servers: the data is echoed in the received frame's context, which is the
+ * application's only chance to read it without copying.
+ */
+static void tcpHandler(TcpConnection *connection, TcpEvent event, Fifo *input) {
+	switch(event) {
+		case TCP_EVENT_RECEIVED:
+			if (connection->localPort==PORT_ECHO) {
+				// what does not fit is not acknowledged and sent again by the peer
+				const size_t n = MIN(fifoCanRead(input),fifoCanWrite(&connection->send));
+				Fifo data;
+				fifoParseN(input,&data,n);
+				fifoPutFifo(&connection->send,&data);
+			}
+			else fifoSkipRead(input,fifoCanRead(input));
+			break;
+		case TCP_EVENT_CONNECTED:
+		case TCP_EVENT_SENT:
+			if (connection->localPort==PORT_CHARGEN) {
+				static int column;
+				while (fifoCanWrite(&connection->send)) {
+					fifoWrite(&connection->send,column<72 ? ' '+1+column : '\n');
+					column = column<72 ? column+1 : 0;
+				}
+			}
+			break;
+		case TCP_EVENT_PEER_CLOSED:
+			tcpClose(connection);
+			break;
+		default: ;
+	}
+}
+
+static Ip4Header ip4Header(int peer, int protocol, int payload) {
+	Ip4Header header = {
+		.totalLength = sizeof(Ip4Header) + payload,
+		.ttl = 64,
+		.protocol = protocol,
+		.sourceAddress = peerIp4Address(peer),
+		.destinationAddress = configuration.ip4Address,
+	};
+	header.version = 4;
+	header.headerLength4 = sizeof header / 4;
+	header.headerChecksum = ~ip4HeaderChecksum(&header);
+	return header;
+}
+
+/** Writes one request frame of the given kind from a peer.
+ * @param kind a: ARP request, i: ICMP echo request, u: UDP echo, d: UDP discard, c: UDP to a closed port.
+ * @return true, if the kind is known and the frame fitted.
+ */
+static bool fifoPutFrame(Fifo *fifo, char kind, int peer, int sequence, int payloadSize) {
+	Uint8 payloadBuffer[ENET_IO_LINUX_FRAME];
+	for (int i=0; i<payloadSize; i++) payloadBuffer[i] = i;
+	Fifo payload;
+	fifoInitRead(&payload,payloadBuffer,payloadSize);
+
+	EthernetHeader ethernetHeader = {
+		.destinationAddress = configuration.ethernetAddress,
+		.sourceAddress = peerEthernetAddress(peer),
+		.type = ETHERNET_TYPE_IP4,
+	};
+
+	switch(kind) {
+		case 'a': {
+			ethernetHeader.destinationAddress = ETHERNET_ADDRESS_BROADCAST;
+			ethernetHeader.type = ETHERNET_TYPE_ARP;
+			const EthernetArpHeader arpHeader = {
+				.hardwareAddressType = 1,
+				.protocol = ETHERNET_TYPE_IP4,
+				.hardwareAddressSize = sizeof(EthernetAddress),
+				.protocolAddressSize = sizeof(Ip4Address),
+				.operation = ETHERNET_ARP_OP_REQUEST,
+				.sourceEthernetAddress = peerEthernetAddress(peer),
+				.sourceIp4Address = peerIp4Address(peer),
+				.destinationEthernetAddress = ETHERNET_ADDRESS_INVALID,
+				.destinationIp4Address = configuration.ip4Address,
+			};
+			return fifoPutnetEthernetHeader(fifo,&ethernetHeader)
+				&& fifoPutnetEthernetArpHeader(fifo,&arpHeader);
+		}
+		case 'i': {
+			const Ip4Header header = ip4Header(peer,IP_PROTOCOL_ICMP,
+				sizeof(IcmpHeader)+sizeof(IcmpEcho)+payloadSize);
+			IcmpHeader icmpHeader = { .type = ICMP_TYPE_ECHO_REQUEST, };
+			const IcmpEcho icmpEcho = { .identifier = 0x4242, .sequenceNumber = sequence, };
+			Fifo checksummed = payload;
+			icmpHeader.checksum = ~icmpEchoChecksum(&icmpHeader,&icmpEcho,&checksummed);
+			return fifoPutnetEthernetHeader(fifo,&ethernetHeader)
+				&& fifoPutnetIp4Header(fifo,&header)
+				&& fifoPutnetIcmpHeader(fifo,&icmpHeader)
+				&& fifoPutnetIcmpEcho(fifo,&icmpEcho)
+				&& fifoPutFifo(fifo,&payload);
+		}
+		case 'u':
+		case 'd':
+		case 'c': {
+			const Ip4Header header = ip4Header(peer,IP_PROTOCOL_UDP,sizeof(UdpHeader)+payloadSize);
+			const UdpHeader udpHeader = {
+				.source = 1024+peer,
+				.destination = kind=='u' ? PORT_ECHO : kind=='d' ? PORT_DISCARD : PORT_CLOSED,
+				.length = sizeof(UdpHeader) + payloadSize,
+				.checksum = 0,		// none
+			};
+			return fifoPutnetEthernetHeader(fifo,&ethernetHeader)
+				&& fifoPutnetIp4Header(fifo,&header)
+				&& fifoPutnetUdpHeader(fifo,&udpHeader)
+				&& fifoPutFifo(fifo,&payload);
+		}
+		default: return false;
+	}
+}
+
+/** Creates a pcap image in memory with the request frames of all peers.
+ * @return the size of the image or 0 in case of an unknown kind of frame.
+ */
+static size_t createImage(Uint8 *image, size_t size, const char *mix, int peers, int payloadSize) {
+	Fifo fifo;
+	fifoInitWrite(&fifo,image,size);
+	fifoPutPcapHeader(&fifo);
+
+	int sequence = 0;
+	for (int peer=0; peer<peers; peer++) for (const char *kind=mix; *kind; kind++) {
+		Uint8 frame[ENET_IO_LINUX_FRAME];
+		Fifo frameFifo;
+		fifoInitWrite(&frameFifo,frame,sizeof frame);
+		if (!fifoPutFrame(&frameFifo,*kind,peer,sequence++,payloadSize)
+		|| !fifoPutPcapFrame(&fifo,0,frame,fifoCanRead(&frameFifo))) return 0;
+	}
+	return fifoCanRead(&fifo);
+}
+
+static inline Uint64 cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static double timeS(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+typedef struct {
+	Uint64	status[4];		///< frames by InputPacketStatus
+} Counters;
+
+/** Handles one received frame using the single packet interface, or a burst of frames.
+ * @param burst the maximum number of frames of a burst, 0 for the single packet interface.
+ * @return true, if any frame was handled.
+ */
+static bool handleFrames(Counters *counters, int burst) {
+	if (burst==0) {
+		if (!enetIoFifoCanRead()) return false;
+		const InputPacketStatus status = handleEthernetPacket(enetIoFifoReadBegin());
+		enetIoFifoReadEnd();
+		if (status<ELEMENTS(counters->status)) counters->status[status]++;
+		return true;
+	}
+	else return 0!=handleEthernetPackets(burst);
+}
+
+static void printCounters(const Counters *counters) {
+	const EnetIoLinuxStatistics *stats = enetIoLinuxStatistics();
+	printf("  frames            : %llu received, %llu sent\n",
+		(unsigned long long)stats->framesRead, (unsigned long long)stats->framesWritten);
+	if (counters->status[PACKET_HANDLED]!=0) printf("  status            : %llu handled, %llu pending, %llu discarded, %llu retry\n",
+		(unsigned long long)counters->status[PACKET_HANDLED], (unsigned long long)counters->status[PACKET_PENDING],
+		(unsigned long long)counters->status[PACKET_DISCARDED], (unsigned long long)counters->status[PACKET_RETRY]);
+}
+
+/** Sends datagrams to the first peer's discard port, one by one with udpSendBegin()/udpSendEnd() or in batches of a
+ * UdpFlow.
+ * @param batch the number of datagrams per udpFlowSend(), 0 for udpSendBegin()/udpSendEnd().
+ * @return the time per datagram in ns.
+ */
+static double udpSendBenchmark(unsigned datagrams, unsigned payloadSize, int batch) {
+	const Ip4SocketAddress destination = { .ip4Address = peerIp4Address(0), .port = PORT_DISCARD, };
+	Uint8 payload[ENET_IO_LINUX_FRAME];
+	for (int i=0; i<payloadSize; i++) payload[i] = i;
+
+	const double t = timeS();
+	if (batch==0) for (unsigned d=0; d<datagrams; d++) {
+		Fifo *output = udpSendBegin(&destination,PORT_ECHO);
+		if (output==0) return 0;
+		payload[0] = d;
+		udpSendWrite(output,payload,payloadSize);
+		udpSendEnd(output);
+	}
+	else {
+		UdpFlow flow;
+		udpFlowInit(&flow,&destination,PORT_ECHO);
+		UdpFlowPayload payloads[IP_STACK_BURST];
+		for (int i=0; i<batch; i++) payloads[i] = (UdpFlowPayload) { .data = payload, .size = payloadSize, };
+		for (unsigned d=0; d<datagrams; d+=batch) {
+			payload[0] = d;
+			if (0>=udpFlowSend(&flow,payloads,MIN(batch,datagrams-d))) return 0;
+		}
+	}
+	return (timeS()-t)*1e9/datagrams;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ARP cache against the linear search, that was used before the hash index
+
+static EthernetArpCacheEntry* linearLru(EthernetArpCache *cache, const Ip4Address* ip4Address, int currentTime) {
+	for (int a=0; a<cache->elements; ++a)
+		if (cache->table[a].state!=ETHERNET_ARP_INVALID
+		&& ip4IsEqual(&cache->table[a].ip4Address,ip4Address)) return cache->table+a;
+
+	int eldestIndex = 0;
+	int eldestTime = currentTime;
+	for (int a=0; a<cache->elements; ++a) {
+		if (cache->table[a].state==ETHERNET_ARP_INVALID) return cache->table+a;
+		else if (cache->table[a].timeLookup<eldestTime) {
+			eldestTime = cache->table[a].timeLookup;
+			eldestIndex = a;
+		}
+	}
+	return cache->table+eldestIndex;
+}
+
+static EthernetArpCacheEntry* linearLookup(EthernetArpCache* cache, const Ip4Address *ip4Address, int currentTime) {
+	for (int a=0; a<cache->elements; ++a)
+		if (cache->table[a].state & ETHERNET_ARP_RESOLVED
+		&& cache->table[a].ip4Address.int32==ip4Address->int32) {
+			cache->table[a].timeLookup = currentTime;
+			return cache->table+a;
+		}
+
+	EthernetArpCacheEntry *entry = linearLru(cache,ip4Address,currentTime);
+	entry->ip4Address = *ip4Address;
+	entry->state = ETHERNET_ARP_UNRESOLVED;
+	entry->time = currentTime;
+	return 0;
+}
+
+static void linearSet(EthernetArpCache* cache, const Ip4Address* ip4Address, const EthernetAddress *ethernetAddress,
+	int currentTime) {
+	EthernetArpCacheEntry* entry = linearLru(cache,ip4Address,currentTime);
+	entry->ip4Address = *ip4Address;
+	entry->ethernetAddress = *ethernetAddress;
+	entry->time = currentTime;
+	entry->timeLookup = currentTime;
+	entry->state = ETHERNET_ARP_RESOLVED;
+}
+
+static void linearExpire(EthernetArpCache* cache, int currentTime) {
+	for (int a=0; a<cache->elements; ++a)
+		if (cache->table[a].state!=ETHERNET_ARP_INVALID
+		&& cache->table[a].time+cache->entryLifeTime < currentTime) cache->table[a].state = ETHERNET_ARP_INVALID;
+}
+
+typedef struct {
+	EthernetArpCacheEntry* (*lookup)(EthernetArpCache*, const Ip4Address*, int);
+	void (*set)(EthernetArpCache*, const Ip4Address*, const EthernetAddress*, int);
+	void (*expire)(EthernetArpCache*, int);
+} ArpCacheFunctions;
+
+static const ArpCacheFunctions arpHashed = { &ethernetArpCacheLookup, &ethernetArpCacheSet, &ethernetArpCacheExpire };
+static const ArpCacheFunctions arpLinear = { &linearLookup, &linearSet, &linearExpire };
+
+static Uint32 arpRandom(Uint32 *state) {
+	*state ^= *state<<13;
+	*state ^= *state>>17;
+	*state ^= *state<<5;
+	return *state;
+}
+
+/** One random operation on the cache: 1/16 expire, 7/16 set, 8/16 lookup. There are as many addresses as entries,
+ * so no valid entry is ever replaced.
+ * @return the entry found by a lookup, 0 otherwise.
+ */
+static EthernetArpCacheEntry* arpOperation(const ArpCacheFunctions *f, EthernetArpCache *cache, Uint32 *random,
+	int time) {
+	const Uint32 r = arpRandom(random);
+	const Ip4Address address = { .int32 = 0x0000010A + ((r>>4) % cache->elements << 16) };
+	const EthernetAddress ethernetAddress = { .int8s = { 0x02,0x00,0x00,r>>8,r>>16,r>>24 } };
+	if ((r & 15)==0) f->expire(cache,time);
+	else if ((r & 15)<8) f->set(cache,&address,&ethernetAddress,time);
+	else return f->lookup(cache,&address,time);
+	return 0;
+}
+
+static int arpEntryCompare(const void *a, const void *b) {
+	const EthernetArpCacheEntry *ea = a, *eb = b;
+	if (ea->state==ETHERNET_ARP_INVALID || eb->state==ETHERNET_ARP_INVALID)
+		return (ea->state==ETHERNET_ARP_INVALID) - (eb->state==ETHERNET_ARP_INVALID);
+	return ea->ip4Address.int32<eb->ip4Address.int32 ? -1 : ea->ip4Address.int32>eb->ip4Address.int32;
+}
+
+/** Compares the valid entries of two caches, ignoring their positions in the tables.
+ */
+static bool arpCacheEqual(const EthernetArpCache *a, const EthernetArpCache *b, EthernetArpCacheEntry *sorted) {
+	EthernetArpCacheEntry *sortedA = sorted, *sortedB = sorted+a->elements;
+	for (int e=0; e<a->elements; e++) {
+		sortedA[e] = a->table[e];
+		sortedB[e] = b->table[e];
+	}
+	qsort(sortedA,a->elements,sizeof *sortedA,&arpEntryCompare);
+	qsort(sortedB,b->elements,sizeof *sortedB,&arpEntryCompare);
+	for (int e=0; e<a->elements; e++) {	// invalid entries are sorted last
+		const EthernetArpCacheEntry *ea = &sortedA[e], *eb = &sortedB[e];
+		if (ea->state!=eb->state) return false;
+		if (ea->state==ETHERNET_ARP_INVALID) break;
+		if (!ip4IsEqual(&ea->ip4Address,&eb->ip4Address) || ea->time!=eb->time
+		|| (ea->state & ETHERNET_ARP_RESOLVED && (ea->timeLookup!=eb->timeLookup
+			|| memcmp(&ea->ethernetAddress,&eb->ethernetAddress,sizeof ea->ethernetAddress)))) return false;
+	}
+	return true;
+}
+
+/** Runs the same random operations on the hashed cache and the linear search and compares the lookup results and
+ * the cache contents after each operation. Then both are timed on their own.
+ * @return the number of operations until the first difference or operations, if there was none.
+ */
+static unsigned arpCacheCompare(unsigned elements, unsigned operations, Uint32 seed) {
+	EthernetArpCacheEntry *tables = calloc(4*elements,sizeof *tables);
+	EthernetArpCache hashed = { .table = tables, .elements = elements, .entryLifeTime = 2*elements, };
+	EthernetArpCache linear = { .table = tables+elements, .elements = elements, .entryLifeTime = 2*elements, };
+
+	Uint32 randomHashed = seed, randomLinear = seed;
+	unsigned o = 0;
+	for ( ; o<operations; o++) {
+		const EthernetArpCacheEntry *h = arpOperation(&arpHashed,&hashed,&randomHashed,o);
+		const EthernetArpCacheEntry *l = arpOperation(&arpLinear,&linear,&randomLinear,o);
+		if ((h==0)!=(l==0) || (h!=0 && memcmp(&h->ethernetAddress,&l->ethernetAddress,sizeof h->ethernetAddress))) {
+			printf("  operation %u: lookup results differ\n",o);
+			break;
+		}
+		if (!arpCacheEqual(&hashed,&linear,tables+2*elements)) {
+			char buffer[4096];
+			Fifo fifo = { buffer, sizeof buffer, };
+			printf("  operation %u: cache contents differ, hashed/linear:\n",o);
+			fifoPrintEthernetArpCache(&fifo,&hashed,false);
+			fifoPrintEthernetArpCache(&fifo,&linear,false);
+			while (fifoCanRead(&fifo)) putchar(fifoRead(&fifo));
+			break;
+		}
+	}
+
+	for (int f=0; f<2; f++) {
+		const ArpCacheFunctions *functions = f==0 ? &arpHashed : &arpLinear;
+		EthernetArpCache cache = { .table = tables, .elements = elements, .entryLifeTime = 2*elements, };
+		memset(tables,0,elements*sizeof *tables);
+		Uint32 random = seed;
+		const double t = timeS();
+		for (unsigned p=0; p<operations; p++) arpOperation(functions,&cache,&random,p);
+		printf("  %s            : %.1f ns/operation\n",f==0 ? "hashed" : "linear",(timeS()-t)*1e9/operations);
+	}
+	free(tables);
+	return o;
+}
+
+static volatile bool terminate;
+
+static void signalHandler(int signal) {
+	terminate = true;
+}
+
+int main(int argc, char* argv[]) {
+	struct {
+		unsigned	frames;
+		unsigned	peers;
+		unsigned	arpEntries;
+		unsigned	payload;
+		unsigned	burst;
+		unsigned	udpDatagrams;
+		unsigned	arpOperations;
+		const char	*mix;
+		const char	*replay;
+		const char	*record;
+		const char	*tap;
+		const char	*create;
+	}
+	options = {
+		.frames = 1000000,
+		.peers = 16,
+		.arpEntries = 32,
+		.payload = 64,
+		.burst = IP_STACK_BURST,
+		.mix = "aiudc",
+	};
+
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"a:b:c:m:n:p:r:s:t:u:w:x:h?")); ) switch(optChar) {
+		case 'a':	options.arpEntries = strtol(optarg,0,0); break;
+		case 'b':	options.burst = strtol(optarg,0,0); break;
+		case 'c':	options.create = optarg; break;
+		case 'm':	options.mix = optarg; break;
+		case 'n':	options.frames = strtol(optarg,0,0); break;
+		case 'p':	options.peers = strtol(optarg,0,0); break;
+		case 'r':	options.replay = optarg; break;
+		case 's':	options.payload = strtol(optarg,0,0); break;
+		case 't':	options.tap = optarg; break;
+		case 'u':	options.udpDatagrams = strtol(optarg,0,0); break;
+		case 'w':	options.record = optarg; break;
+		case 'x':	options.arpOperations = strtol(optarg,0,0); break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options]\n",ipbench);
+			printf("Runs the c-any IP stack on frames replayed from memory or a pcap file and reports the packet rate.\n");
+			printf("The stack is 10.0.0.1/24, peers are 10.0.0.2 and up.\n");
+			printf("options:\n");
+			printf("  -a <n>            : ARP cache entries [%u]\n",options.arpEntries);
+			printf("  -b <n>            : frames per burst, 0..%u, 0 for the single packet interface [%u]\n",
+				IP_STACK_BURST,options.burst);
+			printf("  -c <file>         : create a pcap file of the generated frames and exit\n");
+			printf("  -m <kinds>        : frame mix per peer, a=ARP request, i=ICMP echo, u=UDP echo, d=UDP discard,\n");
+			printf("                      c=UDP closed port [%s]\n",options.mix);
+			printf("  -n <n>            : number of frames to process [%u]\n",options.frames);
+			printf("  -p <n>            : number of peers, 1..%u [%u]\n",PEERS_MAX,options.peers);
+			printf("  -r <file>         : replay a pcap file instead of the generated frames\n");
+			printf("  -s <n>            : payload size of ICMP and UDP [%u]\n",options.payload);
+			printf("  -t <interface>    : serve on a TAP interface until interrupted, instead of benchmarking. TCP echo,\n");
+			printf("                      discard and chargen are served on ports 7, 9 and 19\n");
+			printf("  -u <n>            : send n UDP datagrams to 10.0.0.2 instead, one by one and as a UDP flow in\n");
+			printf("                      batches of the burst size, and report the time per datagram\n");
+			printf("  -w <file>         : record all frames sent by the stack into a pcap file\n");
+			printf("  -x <n>            : compare the ARP cache of -a entries with a linear search for n random set,\n");
+			printf("                      lookup and expire operations instead, and report the time per operation\n");
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+	if (options.peers<1 || options.peers>PEERS_MAX || options.arpEntries<1 || options.burst>IP_STACK_BURST
+	|| options.payload>ENET_IO_LINUX_FRAME-sizeof(EthernetHeader)-sizeof(Ip4Header)-sizeof(IcmpHeader)-sizeof(IcmpEcho)) {
+		fprintf(stderr,"%s: invalid option value\n",ipbench);
+		return 1;
+	}
+
+	if (options.arpOperations!=0) {
+		printf("ARP cache, %u entries:\n",options.arpEntries);
+		const unsigned equal = arpCacheCompare(options.arpEntries,options.arpOperations,0x12345678);
+		printf("  operations        : %u, %u equal\n",options.arpOperations,equal);
+		return equal==options.arpOperations ? 0 : 1;
+	}
+
+	EthernetArpCacheEntry *arpTable = calloc(options.arpEntries,sizeof *arpTable);
+	EthernetArpCache arpCache = {
+		.table = arpTable,
+		.elements = options.arpEntries,
+		.entryLifeTime = 60*1000,
+		.entryRefreshTime = 30*1000,
+	};
+	static const Ip4StackHandlers handlers = {
+		.udp = &udpHandler,
+	};
+	ipStackInit(&arpCache,&configuration,&handlers);
+
+	static TcpConnection tcpConnections[6];
+	static Uint8 tcpBuffers[ELEMENTS(tcpConnections)][8192];
+	static TcpConfiguration tcpConfiguration = {
+		.table = tcpConnections,
+		.elements = ELEMENTS(tcpConnections),
+	};
+	tcpInit(&tcpConfiguration);
+	for (int c=0; c<ELEMENTS(tcpConnections); c++) {
+		static const Uint16 ports[] = { PORT_ECHO, PORT_DISCARD, PORT_CHARGEN };
+		tcpConnectionInit(&tcpConnections[c],tcpBuffers[c],sizeof tcpBuffers[c],&tcpHandler);
+		tcpListen(&tcpConnections[c],ports[c % ELEMENTS(ports)]);
+	}
+	sysTickTimeMs = fdClockMs();
+
+	// the generated frames
+	const size_t imageSize = sizeof(Uint32)*8 + options.peers*strlen(options.mix)*(16+ENET_IO_LINUX_FRAME);
+	Uint8 *image = malloc(imageSize);
+	const size_t size = createImage(image,imageSize,options.mix,options.peers,options.payload);
+	if (size==0) {
+		fprintf(stderr,"%s: invalid frame mix %s\n",ipbench,options.mix);
+		return 1;
+	}
+	if (options.create!=0) {
+		FILE *file = fopen(options.create,"w");
+		if (file==0 || size!=fwrite(image,1,size,file) || 0!=fclose(file)) {
+			fprintf(stderr,"%s: cannot write %s\n",ipbench,options.create);
+			return 1;
+		}
+		return 0;
+	}
+
+	bool success = true;
+	if (options.tap!=0) success = enetIoLinuxTapInit(options.tap);
+	else if (options.replay!=0) success = enetIoLinuxReplayFileInit(options.replay,0);
+	else success = enetIoLinuxReplayInit(image,size,0);
+	if (!success) {
+		fprintf(stderr,"%s: cannot open %s\n",ipbench,
+			options.tap!=0 ? options.tap : options.replay!=0 ? options.replay : "frames");
+		return 1;
+	}
+	if (options.record!=0 && !enetIoLinuxRecord(options.record)) {
+		fprintf(stderr,"%s: cannot create %s\n",ipbench,options.record);
+		return 1;
+	}
+
+	Counters counters = {};
+	if (options.udpDatagrams!=0) {
+		const Ip4Address peerIp4 = peerIp4Address(0);
+		const EthernetAddress peerEthernet = peerEthernetAddress(0);
+		ethernetArpCacheSet(&arpCache,&peerIp4,&peerEthernet,sysTickTimeMs);
+		const double single = udpSendBenchmark(options.udpDatagrams,options.payload,0);
+		const double flow = udpSendBenchmark(options.udpDatagrams,options.payload,MAX(options.burst,1));
+		printf("UDP send, %u bytes:\n",options.payload);
+		printCounters(&counters);
+		printf("  udpSendBegin/End  : %.1f ns/datagram\n",single);
+		printf("  udpFlowSend       : %.1f ns/datagram, batches of %u\n",flow,MAX(options.burst,1));
+	}
+	else if (options.tap!=0) {
+		signal(SIGINT,&signalHandler);
+		signal(SIGTERM,&signalHandler);
+		printf("%s: serving on %s, configure it like: ip addr add 10.0.0.2/24 dev %s; ip link set %s up\n",
+			ipbench,options.tap,options.tap,options.tap);
+		while (!terminate) {
+			struct pollfd pollfd = { .fd = enetIoLinuxTapFd(), .events = POLLIN, };
+			poll(&pollfd,1,10);
+			sysTickTimeMs = fdClockMs();
+			while (handleFrames(&counters,options.burst));
+			tcpPoll();
+		}
+		printf("%s:\n",options.tap);
+		printCounters(&counters);
+	}
+	else {
+		const EnetIoLinuxStatistics *stats = enetIoLinuxStatistics();
+		const double t = timeS();
+		const Uint64 c = cycles();
+		for (Uint64 nextTick = 0; stats->framesRead<options.frames; ) {
+			if (stats->framesRead>=nextTick) {
+				sysTickTimeMs = fdClockMs();
+				nextTick = stats->framesRead + 1024;
+			}
+			if (!handleFrames(&counters,options.burst)) break;
+		}
+		const double cyclesPerFrame = (double)(cycles()-c)/stats->framesRead;
+		const double s = timeS()-t;
+
+		printf("%s:\n",options.replay!=0 ? options.replay : options.mix);
+		printCounters(&counters);
+		printf("  rate              : %.0f frames/s, %.1f ns/frame",stats->framesRead/s,s*1e9/stats->framesRead);
+		if (cyclesPerFrame!=0) printf(", %.0f cycles/frame (TSC)",cyclesPerFrame);
+		printf("\n");
+	}
+	enetIoLinuxClose();
+	free(image);
+	free(arpTable);
+	return 0;
+}
+
@@ -0,0 +1,272 @@
+/*
+  ispcheck.c - replays recorded ISP answers through the mxli response parser.
+  Copyright 2013 Marc Prager
+
+  ispcheck is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  ispcheck is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with ispcheck.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <macros.h>
+#include <mxli.h>
+
+const char *ispcheck = "ispcheck";
+
+enum {
+	TRANSCRIPT_MAX	=256,
+	RESULT_MAX	=512,
+};
+
+/** A recorded answer of the LPC and the results expected from parsing it.
+ * In templates, '|' stands for the line end under test. Transcripts without '|' are replayed as they are.
+ */
+typedef struct {
+	const char	*name;
+	const char	*commands;	///< K=boot code version, J=part ID, N=UID, S=CRC, A=echo off, R=read 8 bytes,
+					///< L=all remaining lines
+	const char	*transcript;
+	const char	*expected[4];	///< per line end: CR, LF, CRLF, LFCR. 0 means same as CR.
+} Transcript;
+
+static const char *lineEnds[] = { "\r", "\n", "\r\n", "\n\r" };
+static const char *lineEndNames[] = { "CR", "LF", "CRLF", "LFCR" };
+
+static const Transcript transcripts[] = {
+	{ "lines", "L", "a|bc||d|", { "L a|bc|d" } },
+	{ "boot code", "KL", "0|1|8|", { "K 8.1;L" } },
+	{ "boot code, echo", "KL", "K|0|1|8|", { "K 8.1;L" } },
+	{ "part ID", "JL", "0|67109928|", { "J 0x04000428;L" } },
+	{ "UID", "NL", "0|1|2|3|4|", { "N 1 2 3 4;L" } },
+	{ "CRC", "SL", "0|305419896|", { "S 0x12345678;L" } },
+	{ "error", "KL", "19|1|8|", { "K fail;L 1|8" } },
+	{ "two commands", "KNL", "0|1|8|0|1|2|3|4|", { "K 8.1;N 1 2 3 4;L" } },
+	// binary data follows the line end directly: a single CR or LF is taken as the LPC800's leading LF
+	{ "read", "RL", "0|ABCDEFGH0|", {
+		"R BCDEFGH0;L",
+		"R BCDEFGH0;L",
+		"R ABCDEFGH;L 0",
+		"R ABCDEFGH;L 0",
+	} },
+	{ "read after LF", "RL", "0|\nABCDEFGH0|", {
+		"R ABCDEFGH;L 0",
+		"R ABCDEFGH;L 0",
+		"R \\nABCDEFG;L H0",
+		"R \\nABCDEFG;L H0",
+	} },
+	{ "truncated", "NL", "0|1|2|", { "N fail;L" } },
+	{ "LPC17 echo", "AKL", "A 0\r0\r\n0\r\n1\r\n8\r\n", { "A ok;K 8.1;L" } },
+	{ "mixed", "KNL", "0\r\n1\n8\n\r0\r1\r\n\r\n2\n\n3\r\r4\n", { "K 8.1;N 1 2 3 4;L" } },
+	{ "blank lines", "L", "a\r\n\r\nb\n\nc\r\rd\n\r\n\re", { "L a|b|c|d" } },
+	{ "flow control", "LL", "0\r\n1\x13" "2\r\n", { "L 0;L 2" } },
+};
+
+static struct {
+	const char	*data;
+	Uint32		n;
+	Uint32		position;
+	Uint32		chunk;		///< bytes delivered per pull
+	bool		verbose;
+} replay;
+
+/** A small buffer lets the answers wrap around inside the Fifo.
+ */
+static char bufferLpcIn [32], bufferLpcOut [64], bufferStdout [64], bufferStderr [512];
+static Fifo
+	fifoLpcIn	= { bufferLpcIn,	sizeof bufferLpcIn,	},
+	fifoLpcInLine	= { },
+	fifoLpcOut	= { bufferLpcOut,	sizeof bufferLpcOut,	},
+	fifoStdout	= { bufferStdout,	sizeof bufferStdout,	},
+	fifoStderr	= { bufferStderr,	sizeof bufferStderr,	};
+
+static bool adapterPullLpcIn (const LpcIspIo *io) {
+	Uint32 n = replay.n - replay.position;
+	if (n>replay.chunk) n = replay.chunk;
+	if (n>fifoCanWrite (io->lpcIn)) n = fifoCanWrite (io->lpcIn);
+	fifoWriteN (io->lpcIn,replay.data+replay.position,n);
+	replay.position += n;
+	return n>0;
+}
+
+static bool adapterDiscard (Fifo *fifo) {
+	fifoSkipRead (fifo,fifoCanRead (fifo));
+	return true;
+}
+
+static bool adapterPushLpcOut (const LpcIspIo *io)	{ return adapterDiscard (io->lpcOut);	}
+static bool adapterPushStdout (const LpcIspIo *io)	{ return adapterDiscard (io->stdout);	}
+
+static bool adapterPushStderr (const LpcIspIo *io) {
+	while (replay.verbose && fifoCanRead (io->stderr)) fputc (fifoRead (io->stderr),stderr);
+	return adapterDiscard (io->stderr);
+}
+
+static LpcIspIo lpcIspIo = {
+	.lpcIn		= &fifoLpcIn,
+	.lpcInLine	= &fifoLpcInLine,
+	.lpcOut		= &fifoLpcOut,
+	.stdout		= &fifoStdout,
+	.stderr		= &fifoStderr,
+	.pullLpcIn	= &adapterPullLpcIn,
+	.pushLpcOut	= &adapterPushLpcOut,
+	.pushStdout	= &adapterPushStdout,
+	.pushStderr	= &adapterPushStderr,
+	.debugLevel	= LPC_ISP_SILENT,
+};
+
+static const LpcIspConfigCom com = {
+	.baud		= 115200,
+	.stopBits	= 1,
+	.ispProtocol	= ISP_PROTOCOL_BINARY,
+};
+
+/** Appends the line fifo with CR and LF escaped.
+ */
+static void appendLine (char *result, Fifo *line) {
+	char *end = result + strlen (result);
+	while (fifoCanRead (line) && end+3<result+RESULT_MAX) {
+		const char c = fifoRead (line);
+		if (c=='\r' || c=='\n') {
+			*end++ = '\\';
+			*end++ = c=='\r' ? 'r' : 'n';
+		}
+		else *end++ = c;
+	}
+	*end = 0;
+}
+
+static void append (char *result, const char *text) {
+	strncat (result,text,RESULT_MAX-1-strlen (result));
+}
+
+/** Runs one command against the answers and describes its results.
+ */
+static void runCommand (char command, char *result) {
+	const LpcIspIo *io = &lpcIspIo;
+	char text[80];
+	Uint32 values[4];
+	bool ok;
+
+	snprintf (text,sizeof text,"%s%c ",*result ? ";" : "",command);
+	append (result,text);
+	switch (command) {
+		case 'K':
+			ok = lpcReadBootCodeVersion (io,values);
+			snprintf (text,sizeof text,"%u.%u",values[0]>>8,values[0]&0xFF);
+			break;
+		case 'J': {
+			const LpcMembers members = { };
+			ok = lpcReadPartId (io,&members,values,1);
+			snprintf (text,sizeof text,"0x%08X",values[0]);
+		}	break;
+		case 'N':
+			ok = lpcReadUid (io,values);
+			snprintf (text,sizeof text,"%u %u %u %u",values[0],values[1],values[2],values[3]);
+			break;
+		case 'S':
+			ok = lpcReadCrc (io,0,1024,values);
+			snprintf (text,sizeof text,"0x%08X",values[0]);
+			break;
+		case 'A':
+			ok = lpcEcho (io,false);
+			snprintf (text,sizeof text,"ok");
+			break;
+		case 'R': {
+			char buffer[16];
+			Fifo data = { buffer, sizeof buffer, };
+			ok = lpcReadBinary (io,&com,&data,0x10000000,8);
+			if (ok) appendLine (result,&data);
+			*text = 0;
+		}	break;
+		case 'L':
+			for (bool first=true; loadNextLine (io); first=false) {
+				if (!first) append (result,"|");
+				appendLine (result,io->lpcInLine);
+			}
+			ok = true;
+			*text = 0;
+			break;
+		default:
+			ok = false;
+	}
+	append (result,ok ? text : "fail");
+	// drop the trailing blank of commands without output
+	const size_t n = strlen (result);
+	if (n>0 && result[n-1]==' ') result[n-1] = 0;
+}
+
+/** Replays an answer in chunks of the given size.
+ */
+static void run (const Transcript *t, const char *data, Uint32 n, Uint32 chunk, char *result) {
+	replay.data = data;
+	replay.n = n;
+	replay.position = 0;
+	replay.chunk = chunk;
+	fifoReset (&fifoLpcIn);
+	fifoReset (&fifoLpcOut);
+	patch.lineChar = 0;
+
+	*result = 0;
+	for (const char *c=t->commands; *c; c++) runCommand (*c,result);
+}
+
+/** Replaces '|' by the line end.
+ * @return the length of the transcript.
+ */
+static Uint32 expand (char *data, const char *template, const char *lineEnd) {
+	Uint32 n = 0;
+	for (const char *t=template; *t && n+2<TRANSCRIPT_MAX; t++) {
+		if (*t=='|') for (const char *e=lineEnd; *e; e++) data[n++] = *e;
+		else data[n++] = *t;
+	}
+	data[n] = 0;
+	return n;
+}
+
+int main(int argc, char* argv[]) {
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"vh?")); ) switch(optChar) {
+		case 'v':	replay.verbose = true; lpcIspIo.debugLevel = LPC_ISP_DEBUG; break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options]\n",ispcheck);
+			printf("Replays recorded ISP answers with CR, LF, CRLF, LFCR and mixed line ends in chunks of any size\n");
+			printf("through the mxli response parser and checks the parsed results.\n");
+			printf("options:\n");
+			printf("  -v                : show the ISP debug output\n");
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+
+	int checks = 0, failures = 0;
+	for (int i=0; i<ELEMENTS(transcripts); i++) {
+		const Transcript *t = &transcripts[i];
+		const bool templated = strchr (t->transcript,'|')!=0;
+		for (int e=0; e < (templated ? ELEMENTS(lineEnds) : 1); e++) {
+			char data[TRANSCRIPT_MAX];
+			const Uint32 n = expand (data,t->transcript,lineEnds[e]);
+			const char *expected = t->expected[e] ? t->expected[e] : t->expected[0];
+			for (Uint32 chunk=1; chunk<=n; chunk++) {
+				char result[RESULT_MAX];
+				run (t,data,n,chunk,result);
+				checks++;
+				if (strcmp (result,expected)) {
+					printf ("%s, %s, %u byte chunks: got \"%s\", expected \"%s\"\n", t->name,
+						templated ? lineEndNames[e] : "as recorded", chunk, result, expected);
+					failures++;
+					break;
+				}
+			}
+		}
+	}
+	printf ("%d transcripts, %d checks, %d failures\n",(int)ELEMENTS(transcripts),checks,failures);
+	return failures==0 ? 0 : 1;
+}
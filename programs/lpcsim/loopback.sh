@@ -0,0 +1,49 @@
+#!/bin/sh
+# loopback.sh - checks mxli's serial port server support against lpcsim.
+# usage: loopback.sh image.bin [port]
+# The image is written through a pseudo terminal, raw TCP and RFC 2217, which must leave the same FLASH contents.
+# A target, that stops answering, must let mxli fail within a few seconds.
+
+MXLI=${MXLI:-../mxli3/mxli}
+LPCSIM=${LPCSIM:-./lpcsim}
+IMAGE=$1
+PORT=${2:-7001}
+TMP=${TMPDIR:-/tmp}/lpcsim.$$
+failed=0
+
+[ -f "$IMAGE" ] || { echo "usage: $0 image.bin [port]"; exit 1; }
+
+# run <name> <lpcsim options> -- <device>
+run() {
+	name=$1; shift
+	simOptions=
+	while [ "$1" != "--" ]; do simOptions="$simOptions $1"; shift; done
+	shift
+	$LPCSIM $simOptions >$TMP.$name.out 2>$TMP.$name.log &
+	sleep 0.3
+	timeout 30 $MXLI -d $1 "$IMAGE" >$TMP.mxli 2>&1
+	result=$?
+	wait
+	crc=$(sed -n 's/^FLASH CRC \(0x[0-9A-F]*\).*/\1/p' $TMP.$name.out)
+}
+
+run tty -l $TMP.tty -- $TMP.tty
+[ $result -eq 0 ] || { echo "FAILED: pseudo terminal"; failed=1; }
+reference=$crc
+echo "pseudo terminal: FLASH CRC $reference"
+
+run raw -p $PORT -- tcp://localhost:$PORT
+[ $result -eq 0 -a "$crc" = "$reference" ] || { echo "FAILED: raw TCP"; failed=1; }
+
+run rfc2217 -p $PORT -t -- rfc2217://localhost:$PORT
+[ $result -eq 0 -a "$crc" = "$reference" ] || { echo "FAILED: RFC 2217"; failed=1; }
+grep -q "COM-PORT-OPTION 1 " $TMP.rfc2217.log || { echo "FAILED: RFC 2217 baud rate not set"; failed=1; }
+grep -q "option 1 refused" $TMP.rfc2217.log || { echo "FAILED: RFC 2217 echo not refused"; failed=1; }
+
+start=$(date +%s)
+run timeout -p $PORT -q 0 -- tcp://localhost:$PORT
+[ $result -ne 0 -a $result -ne 124 -a $(($(date +%s)-start)) -lt 10 ] || { echo "FAILED: timeout"; failed=1; }
+
+rm -f $TMP $TMP.*
+[ $failed -eq 0 ] && echo "loopback OK"
+exit $failed
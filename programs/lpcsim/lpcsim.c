@@ -0,0 +1,466 @@
+/*
+  lpcsim.c - simulates the ISP boot loader of a LPC812 on a pseudo terminal or as a serial port server.
+  Copyright 2013 Marc Prager
+
+  lpcsim is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  lpcsim is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with lpcsim.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <integers.h>
+#include <crc.h>
+#include <lpcIsp.h>
+#include <lpcMemories.h>
+
+/** @file
+ * @brief A model of the LPC812 ISP boot loader (binary data protocol) with FLASH and RAM, for testing mxli without
+ * hardware.
+ *
+ * The simulator either creates a pseudo terminal, that mxli uses like a serial line, or accepts one connection on a
+ * TCP port of localhost and so also stands in for a serial port server like ser2net (raw TCP or RFC 2217). When the
+ * host closes the connection, the CRC-32 of the FLASH contents is printed, that can be compared between runs.
+ *
+ * Loopback test of mxli's serial port server support, each of these must print the same FLASH CRC:
+ *   lpcsim -l /tmp/lpc & mxli -d /tmp/lpc image.bin
+ *   lpcsim -p 7001 & mxli -d tcp://localhost:7001 image.bin
+ *   lpcsim -p 7001 -t & mxli -d rfc2217://localhost:7001 image.bin
+ * and a target that stops answering (like a dead target or a wrong baud rate) must let mxli fail within its timeout,
+ * not hang:
+ *   lpcsim -p 7001 -q 0 & mxli -d tcp://localhost:7001 image.bin
+ */
+
+const char *lpcsim = "lpcsim";
+
+enum {
+	FLASH_SIZE	=16*1024,
+	SECTOR_SIZE	=1024,
+	RAM_ADDRESS	=0x10000000,
+	RAM_SIZE	=4*1024,
+	LINE_MAX	=256,
+
+	TELNET_SE	=240,
+	TELNET_SB	=250,
+	TELNET_WILL	=251,
+	TELNET_WONT	=252,
+	TELNET_DO	=253,
+	TELNET_DONT	=254,
+	TELNET_IAC	=255,
+	OPTION_ECHO	=1,
+	OPTION_COM_PORT	=44,
+};
+
+enum {	// telnet receiver states
+	RX_DATA,
+	RX_IAC,
+	RX_OPTION,
+	RX_SB,
+	RX_SB_IAC,
+};
+
+static struct {
+	const char	*link;		///< symbolic link to the pseudo terminal
+	int		port;		///< TCP port, 0 for a pseudo terminal
+	bool		telnet;		///< RFC 2217 framing on the TCP port
+	int		quietAfter;	///< commands answered before the target falls silent, -1 for all
+	const char	*lineEnd;	///< line end of the responses
+} options = { .quietAfter = -1, .lineEnd = "\r\n", };
+
+static int fd = -1;
+static Uint8 flash[FLASH_SIZE];
+static Uint8 ram[RAM_SIZE];
+static bool echo = true;
+static int commands;
+
+static Uint8 inBuffer[4096];
+static int inPos, inEnd;
+static bool connected;		///< the host opened the pseudo terminal
+static bool skipLf;		///< a CR ended the last line, a following LF belongs to it
+
+static struct {
+	int		state;
+	Uint8		verb;
+	Uint8		sb[16];
+	int		nSb;
+} telnet;
+
+static bool quiet (void) {
+	return options.quietAfter>=0 && commands>options.quietAfter;
+}
+
+static void writeAll (const Uint8 *data, int n) {
+	while (n>0) {
+		const int written = write (fd,data,n);
+		if (written<=0) return;
+		data += written;
+		n -= written;
+	}
+}
+
+/** Sends data to the host, IAC escaped with telnet.
+ */
+static void out (const void *data, int n) {
+	if (quiet ()) return;
+	const Uint8 *bytes = data;
+	for (int i=0; i<n; i++) {
+		writeAll (&bytes[i],1);
+		if (options.telnet && bytes[i]==TELNET_IAC) writeAll (&bytes[i],1);
+	}
+}
+
+/** Sends text with every \n replaced by the configured line end.
+ */
+static void outText (const char *text) {
+	for (const char *end; *text; text = end+1) {
+		end = strchr (text,'\n');
+		if (end==0) {
+			out (text,strlen (text));
+			return;
+		}
+		out (text,end-text);
+		out (options.lineEnd,strlen (options.lineEnd));
+	}
+}
+
+static void outValues (const Uint32 *values, int n) {
+	for (int i=0; i<n; i++) {
+		char buffer[16];
+		snprintf (buffer,sizeof buffer,"%u\n",values[i]);
+		outText (buffer);
+	}
+}
+
+static void telnetSubnegotiation (void) {
+	if (telnet.nSb<2 || telnet.sb[0]!=OPTION_COM_PORT) return;
+	Uint32 value = 0;
+	for (int i=2; i<telnet.nSb; i++) value = value<<8 | telnet.sb[i];
+	fprintf (stderr,"%s: COM-PORT-OPTION %d %u\n",lpcsim,telnet.sb[1],value);
+
+	Uint8 reply[sizeof telnet.sb + 8];
+	int n = 0;
+	reply[n++] = TELNET_IAC;
+	reply[n++] = TELNET_SB;
+	reply[n++] = OPTION_COM_PORT;
+	reply[n++] = telnet.sb[1] + 100;	// server to client notification
+	for (int i=2; i<telnet.nSb; i++) {
+		reply[n++] = telnet.sb[i];
+		if (telnet.sb[i]==TELNET_IAC) reply[n++] = TELNET_IAC;
+	}
+	reply[n++] = TELNET_IAC;
+	reply[n++] = TELNET_SE;
+	writeAll (reply,n);
+}
+
+/** Removes telnet commands from a received byte.
+ * @return true, if c is data.
+ */
+static bool telnetData (Uint8 c) {
+	switch (telnet.state) {
+		case RX_DATA:
+			if (c!=TELNET_IAC) return true;
+			telnet.state = RX_IAC;
+			return false;
+		case RX_IAC:
+			telnet.state = RX_DATA;
+			if (c==TELNET_IAC) return true;
+			if (c>=TELNET_WILL) {
+				telnet.verb = c;
+				telnet.state = RX_OPTION;
+			}
+			else if (c==TELNET_SB) {
+				telnet.nSb = 0;
+				telnet.state = RX_SB;
+			}
+			return false;
+		case RX_OPTION:
+			if (telnet.verb==TELNET_WONT || telnet.verb==TELNET_DONT) {
+				fprintf (stderr,"%s: option %d refused\n",lpcsim,c);
+			}
+			telnet.state = RX_DATA;
+			return false;
+		case RX_SB:
+			if (c==TELNET_IAC) telnet.state = RX_SB_IAC;
+			else if (telnet.nSb<sizeof telnet.sb) telnet.sb[telnet.nSb++] = c;
+			return false;
+		case RX_SB_IAC:
+			if (c==TELNET_SE) {
+				telnetSubnegotiation ();
+				telnet.state = RX_DATA;
+			}
+			else {
+				if (telnet.nSb<sizeof telnet.sb) telnet.sb[telnet.nSb++] = c;
+				telnet.state = RX_SB;
+			}
+			return false;
+		default:
+			telnet.state = RX_DATA;
+			return false;
+	}
+}
+
+/** Reads one data byte from the host.
+ * @return the byte or -1, if the host closed the connection.
+ */
+static int readByte (void) {
+	for (;;) {
+		if (inPos==inEnd) {
+			const int n = read (fd,inBuffer,sizeof inBuffer);
+			if (n<0 && errno==EIO && !connected) {	// no host at the pseudo terminal, yet
+				usleep (10*1000);
+				continue;
+			}
+			if (n<=0) return -1;
+			connected = true;
+			inPos = 0;
+			inEnd = n;
+		}
+		const Uint8 c = inBuffer[inPos++];
+		if (!options.telnet || telnetData (c)) return c;
+	}
+}
+
+/** Reads a line ended by CR, LF, CR LF or LF CR (as an empty line).
+ * @param synchronizing answer a '?' at the start of a line with "Synchronized".
+ * @return false, if the host closed the connection.
+ */
+static bool readLine (char *line, bool synchronizing) {
+	int n = 0;
+	for (;;) {
+		const int c = readByte ();
+		if (c<0) return false;
+		if (skipLf) {
+			skipLf = false;
+			if (c=='\n') continue;
+		}
+		if (c=='\r' || c=='\n') {
+			skipLf = c=='\r';
+			line[n] = 0;
+			return true;
+		}
+		if (synchronizing && n==0 && c=='?') outText ("Synchronized\n");
+		else if (n<LINE_MAX-1) line[n++] = c;
+	}
+}
+
+/** Reads binary data following a command line. The LF of a CR LF line end is not part of the data.
+ */
+static bool readData (Uint8 *data, Uint32 n) {
+	for (Uint32 i=0; i<n; ) {
+		const int c = readByte ();
+		if (c<0) return false;
+		if (skipLf && c=='\n') ;
+		else data[i++] = c;
+		skipLf = false;
+	}
+	return true;
+}
+
+/** Maps an address range of the target to the model.
+ * @return the memory or 0, if the range is not completely in FLASH or RAM.
+ */
+static Uint8* memory (Uint32 address, Uint32 n) {
+	if (address<=FLASH_SIZE && n<=FLASH_SIZE-address) return flash+address;
+	if (address>=RAM_ADDRESS && address-RAM_ADDRESS<=RAM_SIZE && n<=RAM_SIZE-(address-RAM_ADDRESS)) {
+		return ram+(address-RAM_ADDRESS);
+	}
+	return 0;
+}
+
+static bool sectorsValid (Uint32 fst, Uint32 snd) {
+	return fst<=snd && snd<FLASH_SIZE/SECTOR_SIZE;
+}
+
+/** Executes one command line.
+ * @return false, if the host closed the connection.
+ */
+static bool command (const char *line) {
+	Uint32 a[3] = {};
+	const int n = sscanf (line+1,"%u %u %u",&a[0],&a[1],&a[2]);
+	Uint8 *x, *y;
+
+	switch (line[0]) {
+		case 'A':	echo = a[0]!=0; outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS },1); break;
+		case 'J':	outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS, LPC_ID_812_M101_JDH16 },2); break;
+		case 'K':	outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS, 13, 4 },3); break;
+		case 'N':	outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS, 1, 2, 3, 4 },5); break;
+		case 'E':
+			if (n!=2 || !sectorsValid (a[0],a[1])) outValues ((Uint32[]){ LPC_ISP_INVALID_SECTOR },1);
+			else {
+				memset (flash+a[0]*SECTOR_SIZE,0xFF,(a[1]-a[0]+1)*SECTOR_SIZE);
+				outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS },1);
+			}
+			break;
+		case 'I':
+			if (n!=2 || !sectorsValid (a[0],a[1])) outValues ((Uint32[]){ LPC_ISP_INVALID_SECTOR },1);
+			else {
+				Uint32 i = a[0]*SECTOR_SIZE;
+				while (i<(a[1]+1)*SECTOR_SIZE && flash[i]==0xFF) i++;
+				if (i==(a[1]+1)*SECTOR_SIZE) outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS },1);
+				else outValues ((Uint32[]){ LPC_ISP_SECTOR_NOT_BLANK, i, flash[i] },3);
+			}
+			break;
+		case 'W':
+			if (n!=2 || 0==(x = memory (a[0],a[1])) || x<ram) outValues ((Uint32[]){ LPC_ISP_ADDR_ERROR },1);
+			else {
+				outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS },1);
+				if (!readData (x,a[1])) return false;
+				if (echo) out (x,a[1]);
+			}
+			break;
+		case 'R':
+			if (n!=2 || 0==(x = memory (a[0],a[1]))) outValues ((Uint32[]){ LPC_ISP_ADDR_ERROR },1);
+			else {
+				outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS },1);
+				out (x,a[1]);
+			}
+			break;
+		case 'C':	// programming can only clear bits
+			if (n!=3 || 0==(x = memory (a[0],a[2])) || x>=ram || 0==(y = memory (a[1],a[2])) || y<ram) {
+				outValues ((Uint32[]){ LPC_ISP_ADDR_ERROR },1);
+			}
+			else {
+				for (Uint32 i=0; i<a[2]; i++) x[i] &= y[i];
+				outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS },1);
+			}
+			break;
+		case 'M':
+			if (n!=3 || 0==(x = memory (a[0],a[2])) || 0==(y = memory (a[1],a[2]))) {
+				outValues ((Uint32[]){ LPC_ISP_ADDR_ERROR },1);
+			}
+			else {
+				Uint32 i = 0;
+				while (i<a[2] && x[i]==y[i]) i++;
+				if (i==a[2]) outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS },1);
+				else outValues ((Uint32[]){ LPC_ISP_COMPARE_ERROR, i },2);
+			}
+			break;
+		case 'S':
+			if (n!=2 || 0==(x = memory (a[0],a[1]))) outValues ((Uint32[]){ LPC_ISP_ADDR_ERROR },1);
+			else outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS, crc32FeedN (0,x,a[1]) },2);
+			break;
+		case 'B':
+		case 'G':
+		case 'P':
+		case 'U':	outValues ((Uint32[]){ LPC_ISP_CMD_SUCCESS },1); break;
+		default:	outValues ((Uint32[]){ LPC_ISP_INVALID_COMMAND },1);
+	}
+	return true;
+}
+
+/** Runs the boot loader until the host closes the connection.
+ */
+static void session (void) {
+	char line[LINE_MAX];
+	if (options.telnet) {	// the client must refuse the echo
+		const Uint8 negotiation[] = { TELNET_IAC, TELNET_DO, OPTION_COM_PORT, TELNET_IAC, TELNET_WILL, OPTION_ECHO };
+		writeAll (negotiation,sizeof negotiation);
+	}
+
+	// autobaud, synchronization word and crystal frequency are acknowledged with their echo
+	do if (!readLine (line,true)) return;
+	while (strcmp (line,"Synchronized"));
+	outText ("Synchronized\nOK\n");
+	if (!readLine (line,false)) return;
+	outText (line);
+	outText ("\nOK\n");
+
+	while (readLine (line,false)) {
+		if (line[0]==0) continue;
+		commands++;
+		if (echo) {
+			outText (line);
+			outText ("\n");
+		}
+		if (!command (line)) return;
+	}
+}
+
+static int openPseudoTerminal (void) {
+	const int master = posix_openpt (O_RDWR|O_NOCTTY);
+	if (master<0 || grantpt (master) || unlockpt (master)) return -1;
+
+	// raw mode on the slave side, that the host reads as its serial line. The slave is closed again, so the end of the
+	// session is seen as EIO on the master.
+	const int slave = open (ptsname (master),O_RDWR|O_NOCTTY);
+	struct termios t;
+	if (slave<0 || tcgetattr (slave,&t)) return -1;
+	cfmakeraw (&t);
+	if (tcsetattr (slave,TCSANOW,&t) || close (slave)) return -1;
+
+	if (options.link!=0) {
+		unlink (options.link);
+		if (symlink (ptsname (master),options.link)) return -1;
+	}
+	else printf ("%s\n",ptsname (master));
+	fflush (stdout);
+	return master;
+}
+
+static int acceptConnection (void) {
+	const int server = socket (AF_INET,SOCK_STREAM,0);
+	const int on = 1;
+	const struct sockaddr_in address = {
+		.sin_family = AF_INET,
+		.sin_port = htons (options.port),
+		.sin_addr.s_addr = htonl (INADDR_LOOPBACK),
+	};
+	if (server<0
+	|| setsockopt (server,SOL_SOCKET,SO_REUSEADDR,&on,sizeof on)
+	|| bind (server,(const struct sockaddr*)&address,sizeof address)
+	|| listen (server,1)) return -1;
+
+	const int connection = accept (server,0,0);
+	close (server);
+	return connection;
+}
+
+int main(int argc, char* argv[]) {
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"e:l:p:q:th?")); ) switch(optChar) {
+		case 'e':
+			options.lineEnd = !strcmp (optarg,"cr") ? "\r" : !strcmp (optarg,"lf") ? "\n"
+				: !strcmp (optarg,"lfcr") ? "\n\r" : "\r\n";
+			break;
+		case 'l':	options.link = optarg; break;
+		case 'p':	options.port = atoi (optarg); break;
+		case 'q':	options.quietAfter = atoi (optarg); break;
+		case 't':	options.telnet = true; break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options]\n",lpcsim);
+			printf("Simulates the ISP boot loader of a LPC812 for one session of mxli.\n");
+			printf("options:\n");
+			printf("  -l link           : symbolic link to the pseudo terminal, instead of printing its name\n");
+			printf("  -p port           : serve on a TCP port of localhost (raw), instead of a pseudo terminal\n");
+			printf("  -t                : with -p: RFC 2217 (telnet) like a serial port server\n");
+			printf("  -q commands       : stop answering after this number of commands\n");
+			printf("  -e cr|lf|crlf|lfcr: line end of the responses, default crlf\n");
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+
+	memset (flash,0xFF,sizeof flash);
+	fd = options.port!=0 ? acceptConnection () : openPseudoTerminal ();
+	if (fd<0) {
+		fprintf(stderr,"%s: cannot open %s\n",lpcsim,options.port!=0 ? "TCP port" : "pseudo terminal");
+		return 1;
+	}
+	session ();
+	printf ("FLASH CRC 0x%08X, %d commands\n",crc32FeedN (0,flash,sizeof flash),commands);
+	return 0;
+}
@@ -0,0 +1,137 @@
+/*
+  lzbench.c - compression ratio and throughput of ramloader's compressed block transfer (cmdWriteLz).
+  Copyright 2013 Marc Prager
+
+  lzbench is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  lzbench is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with lzbench.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <c-linux/hexFile.h>
+#include <lzBlock.h>
+#include <macros.h>
+
+const char *lzbench = "lzbench";
+
+static double timeS(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+typedef struct {
+	Uint32	blocks;			///< number of 256-byte blocks
+	Uint32	blocksCompressed;	///< blocks sent as cmdWriteLz
+	Uint32	bytesRaw;		///< bytes on the wire using cmdWrite only
+	Uint32	bytesLz;		///< bytes on the wire choosing cmdWrite or cmdWriteLz per block
+	double	compressS;		///< time spent compressing
+	double	decompressS;		///< time spent decompressing
+} Statistics;
+
+/** Compresses all blocks of a segment like ramloader does and checks the decompressed data.
+ * @return true, if decompression reproduced all blocks.
+ */
+static bool benchSegment(Statistics *stats, const Segment *segment, int repeat) {
+	for (Uint32 offset=0; offset<segment->size; offset+=256) {
+		Uint8 block[256];
+		memset(block,0xFF,sizeof block);
+		memcpy(block,segment->data+offset,segment->size-offset>=256 ? 256 : segment->size-offset);
+
+		Uint8 compressed[256-2];
+		int n = -1;
+		double t = timeS();
+		for (int r=0; r<repeat; r++) n = lzBlockCompress(compressed,sizeof compressed,block,sizeof block);
+		stats->compressS += timeS()-t;
+
+		stats->blocks++;
+		stats->bytesRaw += 1+256;
+		if (n>0) {
+			Uint8 decompressed[256];
+			int nd = -1;
+			t = timeS();
+			for (int r=0; r<repeat; r++) nd = lzBlockDecompress(decompressed,sizeof decompressed,compressed,n);
+			stats->decompressS += timeS()-t;
+
+			if (nd!=256 || memcmp(block,decompressed,256)) {
+				fprintf(stderr,"%s: block at 0x%08X does not decompress correctly.\n",lzbench,
+					segment->address+offset);
+				return false;
+			}
+			stats->blocksCompressed++;
+			stats->bytesLz += 2+n;
+		}
+		else stats->bytesLz += 1+256;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	struct {
+		unsigned baud;
+		unsigned repeat;
+	}
+	options = {
+		.baud = 115200,
+		.repeat = 10,
+	};
+
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"b:r:h?")); ) switch(optChar) {
+		case 'b':	options.baud = strtol(optarg,0,0); break;
+		case 'r':	options.repeat = strtol(optarg,0,0); break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options] <image-file>...\n",lzbench);
+			printf("Compresses images block by block like ramloader does and reports ratio and throughput.\n");
+			printf("options:\n");
+			printf("  -b <baud rate>    : serial communication speed for effective throughput [%u]\n",options.baud);
+			printf("  -r <n>            : repeat (de)compression n times for timing [%u]\n",options.repeat);
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+	if (options.repeat<1) options.repeat = 1;
+
+	bool success = true;
+	for (int i=optind; i<argc; i++) {
+		static Uint8 ram[0x100000];
+		HexImage hexImage = { ram, sizeof ram };
+		hexImageInit(&hexImage);
+		if (!hexFileLoad(argv[i],&hexImage)) {
+			fprintf(stderr,"%s: cannot load %s\n",lzbench,argv[i]);
+			success = false;
+			continue;
+		}
+
+		Statistics stats = {};
+		for (int s=0; s<ELEMENTS(hexImage.segments); s++) {
+			const Segment *segment = &hexImage.segments[s];
+			if (segment->size!=0) success = benchSegment(&stats,segment,options.repeat) && success;
+		}
+		if (stats.blocks==0) continue;
+
+		const double bytesPerS = options.baud/10.0;	// 8N1
+		const double data = stats.blocks*256.0;
+		const double compressS = stats.compressS/options.repeat;
+		const double decompressS = stats.decompressS/options.repeat;
+		printf("%s:\n",argv[i]);
+		printf("  blocks            : %u, %u compressed\n",stats.blocks,stats.blocksCompressed);
+		printf("  wire bytes        : %u raw, %u compressed, ratio %.3f\n",
+			stats.bytesRaw,stats.bytesLz,(double)stats.bytesLz/stats.bytesRaw);
+		printf("  compression       : %.1f MB/s\n",data/compressS*1e-6);
+		printf("  decompression     : %.1f MB/s (host)\n",stats.blocksCompressed*256.0/decompressS*1e-6);
+		printf("  throughput @%u : %.0f B/s raw, %.0f B/s compressed\n",options.baud,
+			data/(stats.bytesRaw/bytesPerS), data/(stats.bytesLz/bytesPerS + compressS));
+	}
+	return success ? 0 : 1;
+}
+
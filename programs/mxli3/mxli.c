@@ -13,10 +13,19 @@
 // Adaption Linux <-> Fifo
 
 #include <c-linux/serial.h>
+#include <c-linux/serialTcp.h>
+#include <c-linux/fd.h>
+#include <traceRing.h>
 
 #include <time.h>
 #include <unistd.h>
+#include <errno.h>
 #include <stdlib.h>		// getenv()
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sched.h>
 #include <fixedPoint.h>
 #include <ansi.h>
 #include <fifoPrintFixedPoint.h>
@@ -33,6 +42,7 @@ static void adapterSleepUs (Int32 us) {
 }
 
 static int fdLpc = -1;
+static SerialTcp serialTcp = { .fd = -1, };	///< serial port server, if connected: fdLpc is its socket
 
 bool adapterPullIn (Fifo *fifo, int fd) {
 	char c;
@@ -43,6 +53,38 @@ bool adapterPullIn (Fifo *fifo, int fd) {
 	else return false;
 }
 
+enum {
+	MXLI_TRACE_SIZE		=4*1024*1024,	///< trace file size: 128ki records
+};
+
+static TraceRing *traceRing;		///< ISP traffic trace, 0 if disabled
+static Int64 traceStartUs;
+
+/** Records data of the ISP communication, if tracing is enabled.
+ */
+static void adapterTrace (TraceChannel channel, const void *data, size_t n) {
+	if (traceRing!=0) traceRingWrite (traceRing, fdClockUs()-traceStartUs, channel, data, n);
+}
+
+static void adapterTraceNote (const char *note) {
+	adapterTrace (TRACE_NOTE, note, strlen (note));
+}
+
+/** Creates a memory mapped trace file, that survives crashes of mxli.
+ */
+static bool adapterTraceOpen (const char *fileName) {
+	const int fd = open (fileName,O_RDWR|O_CREAT|O_TRUNC,0644);
+	if (fd<0) return false;
+	void *memory = ftruncate (fd,MXLI_TRACE_SIZE)==0
+		? mmap (0,MXLI_TRACE_SIZE,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0) : MAP_FAILED;
+	close (fd);
+	if (memory==MAP_FAILED) return false;
+
+	traceRing = traceRingInit (memory,MXLI_TRACE_SIZE);
+	traceStartUs = fdClockUs();
+	return traceRing!=0;
+}
+
 bool adapterPushOut (Fifo *fifo, int fd) {
 	while (fifoCanRead(fifo)) {
 		const char c = fifoRead(fifo);
@@ -51,7 +93,56 @@ bool adapterPushOut (Fifo *fifo, int fd) {
 	return true;
 }
 
-bool adapterPullLpcIn	(const LpcIspIo *io)	{ return adapterPullIn (io->lpcIn,fdLpc);	}
+static SerialLowLatency serialLowLatency;	///< adapter settings to restore on exit
+static Uint32 lpcTimeoutUs;		///< serial timeout: max. silence of the LPC
+static Uint32 lpcTimeoutExtraUs;	///< additional time granted to the current command
+static Int64 lpcActivityUs;		///< time of the last transmission or reception
+
+static void adapterSetTimeoutExtraUs (Uint32 us) {
+	lpcTimeoutExtraUs = us;
+}
+
+/** Measures the average round trip time of a trivial command (read boot code version).
+ * @return the time in us, or -1 in case of a communication failure.
+ */
+static Int32 adapterRoundTripUs (const LpcIspIo *io) {
+	enum { ROUND_TRIPS = 8 };
+	const Int64 t0 = fdClockUs();
+	for (int i=0; i<ROUND_TRIPS; i++) {
+		Uint32 version;
+		if (!lpcReadBootCodeVersion (io,&version)) return -1;
+	}
+	return (fdClockUs()-t0) / ROUND_TRIPS;
+}
+
+/** Reads all available bytes from the LPC, waiting until the deadline of the current command, if none are available.
+ * The serial port is opened without VTIME, so this deadline has microsecond resolution.
+ */
+bool adapterPullLpcIn	(const LpcIspIo *io)	{
+	// the line still being parsed shares the buffer of lpcIn and must not be overwritten.
+	const int space = fifoCanWrite (io->lpcIn) - fifoCanRead (io->lpcInLine);
+	const Int64 deadlineUs = lpcActivityUs + lpcTimeoutUs + lpcTimeoutExtraUs;
+
+	while (space>0) {
+		char buffer[256];
+		const int size = space<(int)sizeof buffer ? space : (int)sizeof buffer;
+		const int n = serialTcp.fd>=0 ? serialTcpRead (&serialTcp, buffer, size) : read (fdLpc, buffer, size);
+		if (n>0) {
+			fifoWriteN (io->lpcIn,buffer,n);
+			lpcActivityUs = fdClockUs();
+			adapterTrace (TRACE_RX,buffer,n);
+			return true;
+		}
+		else if (n<0 && errno!=EAGAIN && errno!=EINTR) break;
+		else if (!fdWaitReadableUs (fdLpc,deadlineUs-fdClockUs())) {
+			adapterTraceNote ("timeout");
+			return false;
+		}
+	}
+	adapterTraceNote ("read failed");
+	return false;
+}
+
 bool adapterPushLpcOut	(const LpcIspIo *io)	{
 	if (io->debugLevel>=LPC_ISP_DEBUG) {
 		Fifo clone = *io->lpcOut;
@@ -59,7 +150,27 @@ bool adapterPushLpcOut	(const LpcIspIo *io)	{
 		fifoDumpFifoAscii (io->stderr,&clone);
 		//fifoPrintString (io->stderr,NORMAL);
 	}
-	return adapterPushOut (io->lpcOut,fdLpc);
+	bool success = true;
+	if (serialTcp.fd>=0) {	// the whole command in one segment
+		Fifo clone = *io->lpcOut;
+		for (size_t n; 0!=(n = fifoCanReadLinear (&clone)); fifoSkipRead (&clone,n)) {
+			adapterTrace (TRACE_TX,fifoReadLinear (&clone),n);
+		}
+		success = serialTcpWriteFifo (&serialTcp,io->lpcOut)>=0;
+	}
+	else for (size_t n; success && 0!=(n = fifoCanReadLinear (io->lpcOut)); ) {
+		const char *span = fifoReadLinear (io->lpcOut);
+		const int written = write (fdLpc,span,n);
+		if (written>0) {
+			adapterTrace (TRACE_TX,span,written);
+			fifoSkipRead (io->lpcOut,written);
+		}
+		else if (written<0 && errno==EAGAIN) success = fdWaitWritableUs (fdLpc,lpcTimeoutUs);
+		else success = written<0 && errno==EINTR;
+	}
+	if (!success) adapterTraceNote ("write failed");
+	lpcActivityUs = fdClockUs();
+	return success;
 }
 
 bool adapterPullStdin	(const LpcIspIo *io)	{ return adapterPullIn (io->stdin,0);	}
@@ -125,10 +236,13 @@ static Int32
 //	deviceDefinitionCrpOffset	= -1,
 	lockLevelAllowed		= 0,
 	deviceDefinitionProtocol	= -1,
-	serialTimeoutMs			= 500,	// default, according to man page
+	serialTimeoutMs			= 100,	// default, according to man page
 	resetTimeMs			= 100,	// time needed for a /RST to take effect (short delay)
 	raspiGpioBoot			= 18,	// port pin used for /BOOT
-	raspiGpioReset			= 17	// port pin used for /RESET
+	raspiGpioReset			= 17,	// port pin used for /RESET
+	lowLatencyMs			= -1,	// USB-serial latency timer, -1: leave the adapter untouched
+	flashRetries			= 0,	// resume writing after communication failures
+	realtimePriority		= 0	// SCHED_FIFO priority during wave playback, 0: normal scheduling
 	;
 
 enum {
@@ -171,21 +285,156 @@ static Fifo
 	fifoComDevice			= {},
 	fifoUseUcName			= {},	// this value is 'undefined', which is different from 'empty'!
 	fifoDeviceDefinitionName	= {},
-	fifoWaveDefinition		= {};
+	fifoWaveDefinition		= {},
+	fifoPlan			= {},	// flash plan to execute instead of writing images
+	fifoPlanCompile			= {},	// flash plan to create from the images
+	fifoTraceFile			= {},	// binary trace of the ISP communication
+	fifoGpioChip			= {},	// GPIO character device for --raspi-gpio
+	fifoDeviceDb			= {},	// device database to use instead of the compiled-in members
+	fifoDeviceDefinitions		= {},	// text file of additional device definitions
+	fifoDeviceDbBuild		= {};	// device database to create
 
 static char bufferImageFiles	[400];
 static Fifoq
 	fifoqImageFiles			= { bufferImageFiles, sizeof bufferImageFiles, };
 
-// Raspberry pi GPIO
-#include <c-linux/raspiGpio.h>
+// Flash plan and device database files
+
+/** Maps a file into memory, read-only.
+ * @return the contents or 0 in case of an error.
+ */
+static const void* fileMap (const char *fileName, Uint32 *size) {
+	struct stat st;
+	const int fd = open (fileName,O_RDONLY);
+	if (fd<0) return 0;
+	void *contents = fstat (fd,&st)==0 && st.st_size>0 ? mmap (0,st.st_size,PROT_READ,MAP_PRIVATE,fd,0) : MAP_FAILED;
+	close (fd);
+	*size = st.st_size;
+	return contents!=MAP_FAILED ? contents : 0;
+}
+
+static void fileUnmap (const void *contents, Uint32 size) {
+	if (contents!=0) munmap ((void*)contents,size);
+}
+
+static bool fileWrite (const char *fileName, const void *contents, Uint32 size) {
+	const int fd = open (fileName,O_WRONLY|O_CREAT|O_TRUNC,0644);
+	if (fd<0) return false;
+	for (Uint32 n=0; n<size; ) {
+		const int written = write (fd,(const char*)contents+n,size-n);
+		if (written<=0) {
+			close (fd);
+			return false;
+		}
+		n += written;
+	}
+	return close (fd)==0;
+}
+
+// Device database
+
+#include <lpcDeviceDb.h>
+
+enum {
+	MXLI_DEVICE_DEFINITIONS	= 256,	// max. number of members in a device definition file
+};
+
+static LpcDeviceDefinition deviceDefinitions[MXLI_DEVICE_DEFINITIONS];
+
+/** Reads device definitions in --deviceDefinition syntax, one per line. Empty lines and lines starting with # are
+ * skipped.
+ * @return the number of definitions or -1 in case of an error.
+ */
+static int deviceDefinitionsLoad (const LpcIspIo *io, const char *fileName) {
+	Uint32 size;
+	char *text = (char*) fileMap (fileName,&size);
+	if (text==0) {
+		errorMessage (io, "cannot read device definitions\n");
+		return -1;
+	}
+
+	ReadFifo fifoText = { text, .size = size, .wTotal = size, };
+	int n = 0;
+	for (int lineNo=1; fifoCanRead (&fifoText); lineNo++) {
+		Fifo line;
+		if (fifoParseLine (&fifoText,&line,EOL_CR_OR_LF)) ;	// fine
+		else fifoParseStringNonEmpty (&fifoText,&line);		// last line without line end
+
+		fifoParseBlanks (&line);
+		if (!fifoCanRead (&line) || fifoLookAhead (&line)=='#') continue;
+		if (n>=MXLI_DEVICE_DEFINITIONS || !fifoParseLpcDeviceDefinition (&line, &deviceDefinitions[n])) {
+			fifoPrintString (io->stderr, "ERROR: ");
+			fifoPrintString (io->stderr, fileName);
+			fifoPrintChar (io->stderr, ':');
+			fifoPrintInt32 (io->stderr, lineNo, 1);
+			fifoPrintString (io->stderr, n>=MXLI_DEVICE_DEFINITIONS ? ": too many definitions\n" : ": invalid device definition\n");
+			pushStderr (io);
+			n = -1;
+			break;
+		}
+		n++;
+	}
+	munmap (text,size);
+	return n;
+}
+
+/** Builds a device database of the loaded definitions, followed by the members of a database or the compiled-in
+ * members. Definitions replace members of the same name.
+ * @param base the database to extend or 0 for the compiled-in members.
+ * @return the database or 0 in case of an error.
+ */
+static const LpcDeviceDb* deviceDbBuild (const LpcDeviceDb *base, int nDefinitions) {
+	int nBase = 0;
+	if (base!=0) nBase = base->nMembers;
+	else if (!virginMode) while (lpcMembersXxxx[nBase]!=0) nBase++;
+
+	LpcMember *baseMembers = malloc (nBase * sizeof *baseMembers + 1);
+	const LpcMember **list = malloc ((nDefinitions+nBase+1) * sizeof *list);
+	LpcDeviceDb *db = malloc (lpcDeviceDbSizeMax (nDefinitions+nBase));
+	if (baseMembers!=0 && list!=0 && db!=0) {
+		int n = 0;
+		for (int d=0; d<nDefinitions; d++) list[n++] = &deviceDefinitions[d].member;
+		for (int b=0; b<nBase; b++) list[n++] = base!=0 ? lpcDeviceDbMember (base,b,&baseMembers[b]) : lpcMembersXxxx[b];
+		list[n] = 0;
+		if (lpcDeviceDbBuild (db, lpcDeviceDbSizeMax (n), list)<0) {
+			free (db);
+			db = 0;
+		}
+	}
+	free (list);
+	free (baseMembers);
+	return db;
+}
+
+// Raspberry pi GPIO, via the GPIO character device
+#include <c-linux/gpioChip.h>
+
+enum {
+	GPIO_LINE_BOOT,		// RTS
+	GPIO_LINE_RESET,	// DTR
+};
+
+static GpioLines raspiLines = { .fd = -1, };	///< /BOOT and /RESET, requested for the whole session
 
 bool adapterSetRts (bool level)	{
-	return raspiGpio ? raspiLazyGpioWrite (raspiGpioBoot, level) : serialSetRts (fdLpc,level);
+	adapterTraceNote (level ? "RTS 1" : "RTS 0");
+	return raspiGpio ? gpioLinesSet (&raspiLines, 1<<GPIO_LINE_BOOT, level<<GPIO_LINE_BOOT)
+		: serialTcp.fd>=0 ? serialTcpSetRts (&serialTcp,level) : serialSetRts (fdLpc,level);
 }
 
 bool adapterSetDtr (bool level)	{
-	return raspiGpio ? raspiLazyGpioWrite (raspiGpioReset, level) : serialSetDtr (fdLpc,level);
+	adapterTraceNote (level ? "DTR 1" : "DTR 0");
+	return raspiGpio ? gpioLinesSet (&raspiLines, 1<<GPIO_LINE_RESET, level<<GPIO_LINE_RESET)
+		: serialTcp.fd>=0 ? serialTcpSetDtr (&serialTcp,level) : serialSetDtr (fdLpc,level);
+}
+
+/** Changes /BOOT and /RESET with a single ioctl or, with a serial port server, a single TCP segment.
+ */
+static bool adapterSetRtsDtr (bool rts, bool dtr) {
+	adapterTraceNote (rts ? (dtr ? "RTS 1, DTR 1" : "RTS 1, DTR 0") : (dtr ? "RTS 0, DTR 1" : "RTS 0, DTR 0"));
+	return raspiGpio ? gpioLinesSet (&raspiLines, 1<<GPIO_LINE_BOOT | 1<<GPIO_LINE_RESET,
+		rts<<GPIO_LINE_BOOT | dtr<<GPIO_LINE_RESET)
+		: serialTcpSetRtsDtr (&serialTcp,rts,dtr);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -205,11 +454,39 @@ LpcIspIo lpcIspIo = {
 	.setRts		= &adapterSetRts,
 	.setDtr		= &adapterSetDtr,
 	.sleepUs	= &adapterSleepUs,
+	.clockUs	= &fdClockUs,
+	.sleepUntilUs	= &fdSleepUntilUs,
+	.setTimeoutExtraUs = &adapterSetTimeoutExtraUs,
 
 	//.debugLevel	= LPC_ISP_NORMAL,
 	//.debugLevel	= LPC_ISP_DEBUG,
 	//.debugLevel	= LPC_ISP_PROGRESS,
 };
+/** Switches to SCHED_FIFO and back, so that the wave timing does not suffer from other processes.
+ */
+static void adapterSetRealtime (bool on) {
+	static int policy = -1;		// normal scheduling to restore, -1 if not elevated
+	static struct sched_param param;
+	static bool warned;
+
+	if (on && policy<0) {
+		const int normalPolicy = sched_getscheduler (0);
+		const struct sched_param realtime = { .sched_priority = realtimePriority };
+		if (normalPolicy>=0 && 0==sched_getparam (0,&param) && 0==sched_setscheduler (0,SCHED_FIFO,&realtime)) {
+			policy = normalPolicy;
+			adapterTraceNote ("SCHED_FIFO");
+		}
+		else if (!warned) {
+			warnMessage (&lpcIspIo, "cannot switch to SCHED_FIFO, keeping normal scheduling.\n");
+			warned = true;
+		}
+	}
+	if (!on && policy>=0) {
+		sched_setscheduler (0,policy,&param);
+		policy = -1;
+	}
+}
+
 static WaveSet waveSet = {
 	.waves = {
 		{	.commands = {	// enter ISP: /RST with /BOOT=0
@@ -308,6 +585,9 @@ static FifoPoptInt32 optionInt32s[] = {
 	{ .longOption = "crpAddress", .value = (Int32*)&overrideCrpAddress, .parseInt = &fifoParseIntEng,	},
 	{ .longOption = "raspi-boot", .value = &raspiGpioBoot,							},
 	{ .longOption = "raspi-reset", .value = &raspiGpioReset,						},
+	{ .longOption = "low-latency", .value = &lowLatencyMs,	.parseInt = &fifoParseIntEng,			},
+	{ .longOption = "retries", .value = &flashRetries,							},
+	{ .longOption = "realtime", .value = &realtimePriority,							},
 	{}	// EOL
 };
 
@@ -372,6 +652,13 @@ static FifoPoptString optionStrings[] = {
 	{	.shortOption = 'u',	.value = &fifoUseUcName,		},
 	{	.shortOption = 'N',	.value = &fifoDeviceDefinitionName,	},
 	{	.shortOption = 'W',	.value = &fifoWaveDefinition,		},
+	{	.longOption = "plan",		.value = &fifoPlan,		},
+	{	.longOption = "compile-plan",	.value = &fifoPlanCompile,	},
+	{	.longOption = "trace",		.value = &fifoTraceFile,	},
+	{	.longOption = "gpio-chip",	.value = &fifoGpioChip,		},
+	{	.longOption = "device-db",	.value = &fifoDeviceDb,		},
+	{	.longOption = "device-definitions", .value = &fifoDeviceDefinitions, },
+	{	.longOption = "device-db-build", .value = &fifoDeviceDbBuild,	},
 	{}
 };
 
@@ -383,6 +670,9 @@ int main(int argc, const char* argv[]) {
 	char lineBuffer[1024];
 	Fifo fifoqCmdLine = { lineBuffer, sizeof lineBuffer };
 
+	const LpcFlashPlan *plan = 0;	// mapped flash plan: shown offline or executed instead of writing images
+	Uint32 planSize = 0;
+
 	const char * const environmentVariable = "MXLI_PARAMETERS";
 	const char * const environmentParameters = getenv (environmentVariable);
 	if (environmentParameters!=0) {
@@ -463,6 +753,20 @@ int main(int argc, const char* argv[]) {
 		pushStderr (io);
 	}
 
+	// compiling a flash plan is host-side work only
+	if (fifoIsValid (&fifoPlanCompile)) {
+		if (!fifoIsValid (&fifoUseUcName)) {
+			errorMessage (io, "compiling a flash plan requires -u\n");
+			goto failEarly;
+		}
+		if (commandShowBootCodeVersion || commandShowUid || commandProbe || commandExecuteByReset
+		|| readByteCount!=-1 || commandSetActiveFlashBank!=-1 || fifoIsValid (&fifoPlan)) {
+			errorMessage (io, "compiling a flash plan excludes commands needing the device\n");
+			goto failEarly;
+		}
+		commandNoIo = true;
+	}
+
 	// procedure:
 	// early parsing - before opening the connection to LPC
 	// waveform parsing
@@ -628,26 +932,72 @@ int main(int argc, const char* argv[]) {
 		if (!success) goto failEarly;
 	}
 
+	// device database: mapped from a file and/or built with additional definitions
+	const LpcDeviceDb *deviceDb = 0;
+	if (fifoIsValid (&fifoDeviceDb)) {
+		Uint32 size;
+		if (0==(deviceDb = fileMap (fifoReadLinear (&fifoDeviceDb),&size)) || !lpcDeviceDbValidate (deviceDb,size)) {
+			errorMessage (io, "invalid device database\n");
+			goto failEarly;
+		}
+	}
+	if (fifoIsValid (&fifoDeviceDefinitions) || fifoIsValid (&fifoDeviceDbBuild)) {
+		const int nDefinitions = fifoIsValid (&fifoDeviceDefinitions)
+			? deviceDefinitionsLoad (io, fifoReadLinear (&fifoDeviceDefinitions)) : 0;
+		if (nDefinitions<0) goto failEarly;
+		if (0==(deviceDb = deviceDbBuild (deviceDb, nDefinitions))) {
+			errorMessage (io, "cannot build device database\n");
+			goto failEarly;
+		}
+	}
+	LpcMember deviceDbMember;	// the member selected from deviceDb
+
 	// manual device selection => don't detect.
 	// identify device
 	const LpcMembers members = {
 		.thePreferred = lpcMember.name!=0 ? &lpcMember : 0,	// command-line
-		.list = virginMode ? 0 : lpcMembersXxxx,	// compiled-in
+		.list = virginMode || deviceDb!=0 ? 0 : lpcMembersXxxx,	// compiled-in
 	};
 	// show device list, including command-line defined device
 
 	if (commandShowDeviceList) {
 		if (members.thePreferred!=0) fifoPrintStringLn (io->stdout, members.thePreferred->name);
 		for (int m=0; members.list!=0 && members.list[m]!=0; m++) fifoPrintStringLn (io->stdout, members.list[m]->name);
+		for (int m=0; deviceDb!=0 && m<deviceDb->nMembers; m++) {
+			fifoPrintStringLn (io->stdout, lpcDeviceDbMember (deviceDb,m,&deviceDbMember)->name);
+		}
 		pushStdout (io);
 	}
 
+	if (fifoIsValid (&fifoDeviceDbBuild)) {
+		if (!fileWrite (fifoReadLinear (&fifoDeviceDbBuild), deviceDb, deviceDb->size)) {
+			errorMessage (io, "cannot write device database\n");
+			goto failEarly;
+		}
+		if (io->debugLevel>=LPC_ISP_PROGRESS) {
+			fifoPrintString (io->stderr, "Device database: ");
+			fifoPrintUint32 (io->stderr, deviceDb->nMembers, 1);
+			fifoPrintString (io->stderr, " members, ");
+			fifoPrintUint32 (io->stderr, deviceDb->nFamilies, 1);
+			fifoPrintString (io->stderr, " families, ");
+			fifoPrintUint32 (io->stderr, deviceDb->size, 1);
+			fifoPrintString (io->stderr, " bytes\n");
+			pushStderr (io);
+		}
+		goto returnEarly;
+	}
+
 	const LpcMember *selectedMember = 0;
 
 	if (fifoIsValid (&fifoUseUcName)) {	// use device named on command line
+		const char *name = fifoReadLinear (&fifoUseUcName);
+		int index;
 		if (0!=members.thePreferred
-		&& lpcMatchByName (members.thePreferred, fifoReadLinear (&fifoUseUcName))) selectedMember = members.thePreferred;
-		else if (0!=(selectedMember = lpcFindByName (members.list, fifoReadLinear (&fifoUseUcName))) ) ;	// fine
+		&& lpcMatchByName (members.thePreferred, name)) selectedMember = members.thePreferred;
+		else if (0!=(selectedMember = lpcFindByName (members.list, name)) ) ;	// fine
+		else if (deviceDb!=0 && 0<=(index = lpcDeviceDbFindByName (deviceDb, name))) {
+			selectedMember = lpcDeviceDbMember (deviceDb, index, &deviceDbMember);
+		}
 		else {
 			errorMessage (io, "controller not found by name\n");
 			goto failClose;
@@ -660,21 +1010,65 @@ int main(int argc, const char* argv[]) {
 	};
 
 	if (!commandNoIo) {
+		if (fifoIsValid (&fifoTraceFile) && !adapterTraceOpen (fifoReadLinear (&fifoTraceFile))) {
+			errorMessage (io, "cannot create trace file\n");
+			goto failEarly;
+		}
+
 		// open device
-		fdLpc = serialOpenBlockingTimeout (
-			fifoIsValid (&fifoComDevice) ? fifoReadLinear (&fifoComDevice) : "/dev/ttyUSB0",
+		const char *device = fifoIsValid (&fifoComDevice) ? fifoReadLinear (&fifoComDevice) : "/dev/ttyUSB0";
+		if (serialTcpIsUrl (device)) {
+			if (serialTcpOpen (&serialTcp, device, com.baud)) fdLpc = serialTcp.fd;
+		}
+		else fdLpc = serialOpenBlockingTimeout (
+			device,
 			com.baud,
-			com.timeoutUs/(100*1000)
+			0	// no VTIME: adapterPullLpcIn waits for per-command deadlines
 		);
+		lpcTimeoutUs = com.timeoutUs;
 		if (fdLpc<0) {
 			errorMessage (io, "cannot open serial device\n");
 			goto failEarly;
 		}
 
+		if (raspiGpio) {
+			const unsigned offsets[] = {
+				[GPIO_LINE_BOOT] = raspiGpioBoot,
+				[GPIO_LINE_RESET] = raspiGpioReset,
+			};
+			if (!gpioLinesRequest (&raspiLines,
+				fifoIsValid (&fifoGpioChip) ? fifoReadLinear (&fifoGpioChip) : "/dev/gpiochip0",
+				offsets, 2, 1<<GPIO_LINE_BOOT | 1<<GPIO_LINE_RESET, "mxli")) {	// both inactive (high)
+				errorMessage (io, "cannot request GPIO lines\n");
+				goto failClose;
+			}
+			io->setRtsDtr = &adapterSetRtsDtr;
+		}
+		else if (serialTcp.telnet) io->setRtsDtr = &adapterSetRtsDtr;
+		if (realtimePriority>0) io->setRealtime = &adapterSetRealtime;
+
 		if (lpcWavePlay (io,&waveConfiguration, & waveSet.waves[WAVE_ISP], "Enter ISP")
 		&& lpcSync (io, crystalHz)	// fine
 		&& lpcComReconfigure (io,&com) );
 		else goto failClose;
+
+		if (lowLatencyMs>=0 && serialTcp.fd<0) {	// Nagle's algorithm is always disabled for serial port servers
+			const Int32 beforeUs = adapterRoundTripUs (io);
+			if (!serialLowLatencyEnable (&serialLowLatency, fdLpc, lowLatencyMs ? lowLatencyMs : 1)) {
+				warnMessage (io, "cannot set serial line to low latency\n");
+			}
+			const Int32 afterUs = adapterRoundTripUs (io);
+			if (beforeUs<0 || afterUs<0) goto failClose;
+
+			if (io->debugLevel>=LPC_ISP_NORMAL) {
+				fifoPrintString (io->stderr, "Command round trip: ");
+				fifoPrintUint32 (io->stderr, beforeUs, 1);
+				fifoPrintString (io->stderr, "us, with low latency: ");
+				fifoPrintUint32 (io->stderr, afterUs, 1);
+				fifoPrintString (io->stderr, "us\n");
+				pushStderr (io);
+			}
+		}
 	}
 
 	// probing parameters
@@ -684,6 +1078,7 @@ int main(int argc, const char* argv[]) {
 
 	if (!fifoIsValid (&fifoUseUcName)) {	// use device detection
 		Uint32 partIds [LPC_IDS];
+		int index;
 		if (lpcReadPartId (io, &members, partIds, 0)) {
 			if (io->debugLevel>=LPC_ISP_DEBUG) {
 				fifoPrintString (io->stderr, CYAN "Part ID(s): ");
@@ -701,6 +1096,9 @@ int main(int argc, const char* argv[]) {
 		if (0!=members.thePreferred
 		&& lpcMatchByIds (members.thePreferred, partIds)) selectedMember = members.thePreferred;
 		else if (0!=(selectedMember = lpcFindByIds (members.list, partIds))) ; // fine
+		else if (deviceDb!=0 && 0<=(index = lpcDeviceDbFindByIds (deviceDb, partIds))) {
+			selectedMember = lpcDeviceDbMember (deviceDb, index, &deviceDbMember);
+		}
 		else {
 			errorMessage (io, "controller not found by IDs\n");
 			goto failClose;
@@ -759,84 +1157,28 @@ int main(int argc, const char* argv[]) {
 	}
 
 	if (commandShowMemberInfoCmdLine) {
-		fifoPrintString (io->stdout,"-N'");
-		fifoPrintString (io->stdout, selectedMember->name);
-		fifoPrintChar (io->stdout,'\'');
-		fifoPrintString (io->stdout," -A");
-		for (int b=0; b<selectedMember->family->banks; b++) {
-			if (b!=0) fifoPrintChar (io->stdout,',');
-			fifoPrintString (io->stdout,"0x");
-			fifoPrintHex (io->stdout,selectedMember->family->addressFlashs[b],8,8);
-		}
-		fifoPrintString (io->stdout," -B");
-		for (int b=0; b<LPC_BLOCK_SIZES && selectedMember->family->blockSizes[b]!=0; b++) {
-			if (b!=0) fifoPrintChar (io->stdout,',');
-			fifoPrintUint32 (io->stdout,selectedMember->family->blockSizes[b],1);
-		}
-		fifoPrintString (io->stdout," -F");
-		for (int g=0; g<LPC_SECTOR_ARRAYS && selectedMember->family->sectorArrays[g].n!=0; g++) {
-			if (g!=0) fifoPrintChar (io->stdout,',');
-			fifoPrintUint16 (io->stdout, selectedMember->family->sectorArrays[g].sizeK,1);
-			fifoPrintString (io->stdout,"kix");
-			fifoPrintUint16 (io->stdout, selectedMember->family->sectorArrays[g].n,1);
-		}
-		fifoPrintString (io->stdout," -I");
-		for (int i=0; i<LPC_IDS && selectedMember->family->idMasks[i]!=0; i++) {
-			if (i!=0) fifoPrintChar (io->stdout,',');
-			Int32Pair pair = { selectedMember->ids[i], selectedMember->family->idMasks[i] };
-			if (canPrintInt32HexWithDontCares (&pair)) {
-				fifoPrintString (io->stdout,"0x");
-				fifoPrintInt32HexWithDontCares (io->stdout,&pair,'X');
-			}
-			else {
-				fifoPrintString (io->stdout,"0b");
-				fifoPrintInt32BinWithDontCares (io->stdout,&pair,'X');
-			}
-		}
-		fifoPrintString (io->stdout," -M");
-		for (int r=0, nr=0; r<LPC_RAMS; r++) {
-			if (selectedMember->sizeRamKs[r]>0) {
-				if (nr!=0) fifoPrintChar (io->stdout,',');
-				fifoPrintUint32 (io->stdout,selectedMember->sizeRamKs[r],1);
-				fifoPrintString (io->stdout,"ki@0x");
-				fifoPrintHex (io->stdout,selectedMember->ispFamily->addressRams[r],8,8);
-				nr++;
-			}
-		}
-		fifoPrintString (io->stdout," -P");
-		fifoPrintString (io->stdout,selectedMember->ispFamily->protocol==ISP_PROTOCOL_UUENCODE ? "UUENCODE":"BINARY");
-		fifoPrintString (io->stdout," -R");
-		for (int i=0; i<LPC_ISP_RAMS; i++) {
-			if (i!=0) fifoPrintChar (io->stdout,',');
-			const Int32 size = selectedMember->ispFamily->ramUsage[i].size;
-			const Int32 address = selectedMember->ispFamily->ramUsage[i].address;
-			if (size>0) {
-				fifoPrintString (io->stdout,"0x");
-				fifoPrintHex (io->stdout,size,3,8);
-			}
-			else {
-				fifoPrintChar (io->stdout,'-');
-				fifoPrintString (io->stdout,"0x");
-				fifoPrintHex (io->stdout,-size,3,8);
-			}
-			fifoPrintString (io->stdout,"@0x");
-			fifoPrintHex (io->stdout,address,8,8);
-		}
-		fifoPrintString (io->stdout," -S");
-		fifoPrintInt16 (io->stdout,selectedMember->family->checksumVectors,1);
-		fifoPrintChar (io->stdout,'@');
-		fifoPrintInt16 (io->stdout,selectedMember->family->checksumVector,1);
-
-		// adjust flash size with override
-		fifoPrintString (io->stdout," -f");
-		fifoPrintInt32 (io->stdout,selectedMember->sizeFlashK,1);
-		fifoPrintString (io->stdout,"ki");
+		fifoPrintLpcDeviceDefinition (io->stdout,selectedMember);
 		fifoPrintLn (io->stdout);
-
 		pushStdout (io);
 	}
 
-	if (commandNoIo) return true;		// exit here, if no IO allowed
+	// flash plan: shown offline or executed instead of writing images
+	if (fifoIsValid (&fifoPlan)) {
+		if (0==(plan = fileMap (fifoReadLinear (&fifoPlan),&planSize))) {
+			errorMessage (io, "cannot read flash plan\n");
+			goto failClose;
+		}
+		if (!lpcFlashPlanValidate (io,plan,planSize)) goto failClose;
+		if (commandNoIo) {
+			fifoPrintLpcFlashPlan (io->stdout,plan);
+			pushStdout (io);
+		}
+	}
+
+	if (commandNoIo && !fifoIsValid (&fifoPlanCompile)) {	// exit here, if no IO allowed
+		fileUnmap (plan,planSize);
+		goto returnEarly;
+	}
 
 	// check, if we need banked commands...
 	const bool bankedCommands = lpcFamily.banks >= 2;
@@ -998,6 +1340,38 @@ int main(int argc, const char* argv[]) {
 		pushStderr (io);
 	}
 
+	if (fifoIsValid (&fifoPlanCompile)) {
+		const LpcIspFlashOptions flash = {
+			.eraseBeforeWrite = true,
+			.eraseOnDemand = !quickMode,
+			.crpAllow = lockLevelAllowed,
+			.crpDesired = lockLevelRequested,
+			.crpOffsetBank = overrideCrpAddress,
+			.banked = bankedCommands,
+		};
+		const int size = lpcFlashPlanCompile (io, 0,0, &com, &flash, selectedMember, executable);
+		if (size<0) goto failClose;
+		LpcFlashPlan *planCompiled = malloc (size);
+		const bool success = planCompiled!=0
+			&& lpcFlashPlanCompile (io, planCompiled, size, &com, &flash, selectedMember, executable)==size
+			&& fileWrite (fifoReadLinear (&fifoPlanCompile), planCompiled, size);
+		if (success && io->debugLevel>=LPC_ISP_PROGRESS) {
+			fifoPrintLpcFlashPlan (io->stderr, planCompiled);
+			pushStderr (io);
+		}
+		free (planCompiled);
+		if (!success) {
+			errorMessage (io, "cannot write flash plan\n");
+			goto failClose;
+		}
+		goto returnEarly;
+	}
+
+	if (plan!=0 && commandWrite) {
+		errorMessage (io, "a flash plan replaces image files\n");
+		goto failClose;
+	}
+
 	if (	(commandEraseSectorRange.fst != -1
 		|| commandEraseFlashBankRange.fst != -1
 		|| commandWrite
@@ -1019,7 +1393,7 @@ int main(int argc, const char* argv[]) {
 			pushStderr (io);
 		}
 		if (!lpcPrepareForWrite (io,sectorFrom,sectorTo,bankedCommands)
-		|| !lpcErase (io,sectorFrom,sectorTo,bankedCommands)) {
+		|| !lpcErase (io,selectedMember->family,sectorFrom,sectorTo,bankedCommands)) {
 			errorMessage (io, "erase failed\n");
 			goto failClose;
 		}
@@ -1044,7 +1418,7 @@ int main(int argc, const char* argv[]) {
 				pushStderr (io);
 			}
 			if (!lpcPrepareForWrite (io,sectorFrom,sectorTo,bankedCommands)
-			|| !lpcErase (io,sectorFrom,sectorTo,bankedCommands)) {
+			|| !lpcErase (io,selectedMember->family,sectorFrom,sectorTo,bankedCommands)) {
 				errorMessage (io, "erase failed\n");
 				goto failClose;
 			}
@@ -1068,7 +1442,7 @@ int main(int argc, const char* argv[]) {
 				pushStderr (io);
 			}
 			if (!lpcPrepareForWrite (io,sectorFrom,sectorTo,bankedCommands)
-			|| !lpcErase (io,sectorFrom,sectorTo,bankedCommands)) {
+			|| !lpcErase (io,selectedMember->family,sectorFrom,sectorTo,bankedCommands)) {
 				errorMessage (io, "erase failed\n");
 				goto failClose;
 			}
@@ -1087,6 +1461,9 @@ int main(int argc, const char* argv[]) {
 			.crpDesired = lockLevelRequested,	// lockLevelRequested==-1 ? 0 : lockLevelRequested,
 			.crpOffsetBank = overrideCrpAddress,
 			.banked = bankedCommands,
+			.retries = flashRetries,
+			.waveIsp = &waveSet.waves[WAVE_ISP],
+			.waveConfiguration = &waveConfiguration,
 		};
 
 		if (io->debugLevel >= LPC_ISP_PROGRESS) {
@@ -1102,6 +1479,15 @@ int main(int argc, const char* argv[]) {
 		}
 	}
 
+	if (plan!=0) {
+		progressMessage (io, CYAN "Executing flash plan.\n" NORMAL);
+		if (lpcFlashPlanExecute (io, &com, selectedMember, plan)) progressMessage (io, CYAN "Flash plan OK\n" NORMAL);
+		else {
+			errorMessage (io, "flash plan failed\n");
+			goto failClose;
+		}
+	}
+
 	if (commandSetActiveFlashBank != -1) {
 		if (io->debugLevel >= LPC_ISP_PROGRESS) {
 			fifoPrintExecutable32Segments (io->stderr, executable);
@@ -1127,6 +1513,9 @@ int main(int argc, const char* argv[]) {
 	}
 
 	// normal way out...
+	fileUnmap (plan,planSize);
+	serialLowLatencyRestore (&serialLowLatency);
+	gpioLinesRelease (&raspiLines);
 	close(fdLpc);
 	fifoPrintString (io->stderr, NORMAL);	// reset any colors...
 	pushStderr (io);
@@ -1134,6 +1523,9 @@ int main(int argc, const char* argv[]) {
 
 
 	failClose:
+	fileUnmap (plan,planSize);
+	serialLowLatencyRestore (&serialLowLatency);
+	gpioLinesRelease (&raspiLines);
 	close(fdLpc);
 	failEarly:	return 1;
 	returnEarly:	return 0;
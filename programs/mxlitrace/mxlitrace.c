@@ -0,0 +1,221 @@
+/*
+  mxlitrace.c - decodes the ISP traffic trace written by mxli --trace.
+  Copyright 2013 Marc Prager
+
+  mxlitrace is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  mxlitrace is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with mxlitrace.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <traceRing.h>
+#include <lpcIsp.h>
+
+const char *mxlitrace = "mxlitrace";
+
+enum {
+	LINE_MAX_SHOWN	=64,	///< characters shown of a line
+};
+
+static struct {
+	bool		binary;		///< binary data protocol (LPC800): W and R transfer raw bytes
+	bool		raw;		///< print records instead of lines
+} options;
+
+/** One direction of the traffic, re-assembled into lines.
+ */
+typedef struct {
+	char		line[LINE_MAX_SHOWN+1];
+	int		n;		///< characters in line
+	int		total;		///< characters of the line, including those not shown
+	Uint32		timeUs;		///< time of the first character
+	Uint32		binaryPending;	///< raw payload bytes still expected
+	Uint32		binaryTotal;	///< size of the current payload
+	bool		afterCr;	///< the last character was a CR, that may be followed by a LF
+} Direction;
+
+static Direction directions[2];		// TRACE_TX, TRACE_RX
+static char lastLine[LINE_MAX_SHOWN+1];	///< last line sent, for recognizing echoes
+static char lastCommand;		///< last command sent, 0 if the answer was decoded already
+static Uint32 lastCommandCount;		///< byte count parameter of R and W
+static Uint32 previousUs;
+static Uint32 bytes[2];
+
+static const char* commandName (char c) {
+	switch (c) {
+		case 'U': return "unlock";
+		case 'B': return "set baud rate";
+		case 'A': return "set echo";
+		case 'W': return "write to RAM";
+		case 'R': return "read memory";
+		case 'P': return "prepare sectors";
+		case 'C': return "copy RAM to FLASH";
+		case 'G': return "go";
+		case 'E': return "erase sectors";
+		case 'I': return "blank check sectors";
+		case 'J': return "read part ID";
+		case 'K': return "read boot code version";
+		case 'M': return "compare";
+		case 'N': return "read UID";
+		case 'S': return "read CRC";
+		case 'L': return "set active FLASH bank";
+		default: return 0;
+	}
+}
+
+static void printPrefix (Uint32 timeUs, char direction) {
+	printf ("%10.3fms %+9dus %c ", timeUs*1e-3, (int)(timeUs-previousUs), direction);
+	previousUs = timeUs;
+}
+
+static void printEscaped (const char *s, int n) {
+	for (int i=0; i<n; i++) {
+		const unsigned char c = s[i];
+		if (c<32 || c>=127) printf ("\\x%02X",c);
+		else putchar (c);
+	}
+}
+
+/** Prints a complete line with its annotation.
+ */
+static void lineComplete (TraceChannel channel, Direction *d) {
+	const char *annotation = 0;
+	char buffer[64];
+	d->line[d->n] = 0;
+
+	if (channel==TRACE_TX) {
+		const char *name = commandName (d->line[0]);
+		if (d->total==1 && d->line[0]=='?') annotation = "synchronization";
+		else if (name!=0 && (d->total==1 || d->line[1]==' ')) {
+			annotation = name;
+			lastCommand = d->line[0];
+			unsigned address, count;
+			lastCommandCount = 2==sscanf (d->line+1,"%u %u",&address,&count) ? count : 0;
+			if (options.binary && lastCommand=='W') {
+				d->binaryPending = d->binaryTotal = lastCommandCount;
+			}
+		}
+	}
+	else {
+		char *end;
+		const long code = strtol (d->line,&end,10);
+		if (lastCommand!=0 && d->n>0 && *end==0) {
+			snprintf (buffer,sizeof buffer,"%s (%s)",lpcIspErrorMessage (code),commandName (lastCommand));
+			annotation = buffer;
+			if (options.binary && lastCommand=='R' && code==LPC_ISP_CMD_SUCCESS) {
+				directions[TRACE_RX].binaryPending = directions[TRACE_RX].binaryTotal = lastCommandCount;
+			}
+			lastCommand = 0;
+		}
+		else if (0==strcmp (d->line,lastLine)) annotation = "echo";
+	}
+
+	if (channel==TRACE_TX) strcpy (lastLine,d->line);
+
+	printPrefix (d->timeUs, channel==TRACE_TX ? '>' : '<');
+	printEscaped (d->line,d->n);
+	if (d->total>LINE_MAX_SHOWN) printf ("... (%d chars)",d->total);
+	if (annotation) printf ("%*s; %s", d->total<40 ? 40-d->total : 1, "", annotation);
+	printf ("\n");
+	d->n = 0;
+	d->total = 0;
+}
+
+static void feed (TraceChannel channel, Uint32 timeUs, const char *data, int n) {
+	Direction *d = &directions[channel];
+	bytes[channel] += n;
+	for (int i=0; i<n; i++) {
+		const char c = data[i];
+		const bool lfAfterCr = d->afterCr && c=='\n';
+		d->afterCr = false;
+		if (lfAfterCr) continue;	// part of a CR LF line end
+
+		if (d->binaryPending>0) {	// raw payload
+			if (d->binaryPending==d->binaryTotal) {
+				printPrefix (timeUs, channel==TRACE_TX ? '>' : '<');
+				printf ("[%u bytes binary data]\n",d->binaryTotal);
+			}
+			d->binaryPending--;
+			continue;
+		}
+		if (c=='\r' || c=='\n') {
+			d->afterCr = c=='\r';
+			if (d->total>0) lineComplete (channel,d);
+			continue;
+		}
+		if (d->total==0) d->timeUs = timeUs;
+		if (d->n<LINE_MAX_SHOWN) d->line[d->n++] = c;
+		d->total++;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"brh?")); ) switch(optChar) {
+		case 'b':	options.binary = true; break;
+		case 'r':	options.raw = true; break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options] <trace-file>\n",mxlitrace);
+			printf("Decodes the ISP traffic recorded by mxli --trace into annotated commands and responses.\n");
+			printf("options:\n");
+			printf("  -b                : binary data protocol (LPC800): W and R transfer raw bytes\n");
+			printf("  -r                : print raw records instead of lines\n");
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+	if (optind!=argc-1) {
+		fprintf(stderr,"%s: one trace file required.\n",mxlitrace);
+		return 1;
+	}
+
+	FILE *file = fopen (argv[optind],"rb");
+	if (file==0) {
+		fprintf(stderr,"%s: cannot open %s\n",mxlitrace,argv[optind]);
+		return 1;
+	}
+	fseek (file,0,SEEK_END);
+	const long size = ftell (file);
+	rewind (file);
+	void *memory = size>0 ? malloc (size) : 0;
+	const TraceRing *ring = memory!=0 && 1==fread (memory,size,1,file) ? traceRingCheck (memory,size) : 0;
+	fclose (file);
+	if (ring==0) {
+		fprintf(stderr,"%s: %s is not a trace file\n",mxlitrace,argv[optind]);
+		return 1;
+	}
+	if (ring->written>ring->records) printf ("(%u older records overwritten)\n",ring->written-ring->records);
+
+	const Uint32 count = traceRingCount (ring);
+	Uint32 corrupt = 0;
+	for (Uint32 i=0; i<count; i++) {
+		const TraceRecord *record = traceRingRecord (ring,i);
+		if (record->n>TRACE_RECORD_DATA) corrupt++;	// damaged file: the length would read past the record
+		else if (options.raw) {
+			printPrefix (record->timeUs, "><!"[record->channel<=TRACE_NOTE ? record->channel : TRACE_NOTE]);
+			printEscaped (record->data,record->n);
+			printf ("\n");
+		}
+		else if (record->channel==TRACE_NOTE) {
+			printPrefix (record->timeUs,'!');
+			printEscaped (record->data,record->n);
+			printf ("\n");
+		}
+		else if (record->channel<=TRACE_RX) feed (record->channel,record->timeUs,record->data,record->n);
+	}
+	for (int c=TRACE_TX; c<=TRACE_RX; c++) if (directions[c].total>0) lineComplete (c,&directions[c]);
+	if (corrupt>0) printf ("(%u corrupt records skipped)\n",corrupt);
+
+	if (count>0) printf ("%u records, %u bytes sent, %u bytes received in %.3fms\n", count, bytes[TRACE_TX],
+		bytes[TRACE_RX], (traceRingRecord (ring,count-1)->timeUs - traceRingRecord (ring,0)->timeUs)*1e-3);
+	free (memory);
+	return 0;
+}
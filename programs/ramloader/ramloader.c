@@ -17,14 +17,17 @@
 #include <c-linux/fd.h>
 #include <c-linux/hexFile.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <macros.h>
+#include <lzBlock.h>
 
 static char fifoInBuffer[1024]; static Fifo _fifoIn = { fifoInBuffer, sizeof fifoInBuffer, };
 static char fifoOutBuffer[4*1024]; static Fifo _fifoOut = { fifoOutBuffer, sizeof fifoOutBuffer, };
 static char fifoScanBuffer[1024]; static Fifo _fifoScan = { fifoScanBuffer, sizeof fifoScanBuffer, };
-static char fifoUcInBuffer[1024]; static Fifo _fifoUcIn = { fifoUcInBuffer, sizeof fifoUcInBuffer, };
-static char fifoUcOutBuffer[1024]; static Fifo _fifoUcOut = { fifoUcOutBuffer, sizeof fifoUcOutBuffer };
+static char fifoUcInBuffer[4*1024]; static Fifo _fifoUcIn = { fifoUcInBuffer, sizeof fifoUcInBuffer, };
+static char fifoUcOutBuffer[16*1024]; static Fifo _fifoUcOut = { fifoUcOutBuffer, sizeof fifoUcOutBuffer };
 static int fdSerial = -1;
+static int timeoutMs = 1000;		// maximum waiting time for a response of the uC
 
 Fifo
 	*fifoIn = &_fifoIn,		// Console -> prog
@@ -49,44 +52,67 @@ bool fifoPrintCharAnsiEscaped(Fifo *fifo, bool disableAnsi, bool onlyAscii, char
 	else return fifoPrintCharEscaped2(fifo,onlyAscii,c);
 }
 
-void doIo(void) {
-	// uC -> prog
-	if (fifoCanWrite(fifoUcIn) && fdCanRead(fdSerial)) fifoWrite(fifoUcIn,fdRead(fdSerial));
-
-	// prog -> uC
-	while (fifoCanRead(fifoUcOut) && fdCanWrite(fdSerial)) fdWrite(fdSerial,fifoRead(fifoUcOut));
+enum { FD_SERIAL, FD_STDOUT, FD_STDIN, };
 
-	// prog -> console
-	while (fifoCanRead(fifoOut) && fdCanWrite(1)) fdWrite(1,fifoRead(fifoOut));
+static FdFifo fdFifos[] = {
+	[FD_SERIAL] = { .fd = -1, .in = &_fifoUcIn, .out = &_fifoUcOut },	// fd set after opening the port
+	[FD_STDOUT] = { .fd = 1, .out = &_fifoOut },
+	[FD_STDIN] = { .fd = 0, .in = &_fifoIn },
+};
 
+/** Waits for IO and moves data between serial port, console and the Fifos.
+ * @param deadlineMs the latest time (fdClockMs) to return, -1 for waiting without limit.
+ * @return true, if IO happened, false in case of timeout.
+ */
+bool doIo(Int64 deadlineMs) {
+	const bool io = fdPollFifos(fdFifos,ELEMENTS(fdFifos),fdRemainingMs(deadlineMs));
 
-	// console -> prog
-	if (fifoCanWrite(fifoIn) && fdCanRead(0)) {
-		const int c = fdRead(0);
-		if (c>=0) fifoWrite(fifoIn,(char)c);
-		else exit(0);		// EOF program termination
+	if (fdFifos[FD_STDIN].eof) exit(0);		// EOF program termination
+	if (fdFifos[FD_SERIAL].eof) {
+		fprintf(stderr,"\nERROR: serial port closed.\n");
+		exit(1);
 	}
+	return io;
 }
 
 void flushOut(void) {
-	while (fifoCanRead(fifoOut)) fdWrite(1,fifoRead(fifoOut));
+	while (fifoCanRead(fifoOut) && fdWriteFifo(1,fifoOut)>=0) ;
 }
 
 bool sendCommand(const unsigned char *cmd, int n) {
 	if (n<=fifoCanWrite(fifoUcOut)) {
+		const Int64 deadline = fdClockMs() + timeoutMs;
 		fifoWriteN(fifoUcOut,cmd,n);
-		while (fifoCanRead(fifoUcOut)) doIo();
+		while (fifoCanRead(fifoUcOut)) if (!doIo(deadline) && fdRemainingMs(deadline)==0) {
+			fprintf(stderr,"\nERROR: timeout sending to uC.\n");
+			return false;
+		}
 		return true;
 	}
 	else return false;
 }
 
-bool receiveCommand(unsigned char *cmd, int n) {
-	while (fifoCanRead(fifoUcIn) < n) doIo();
+/** Receives n bytes from the uC without complaining about a timeout.
+ * @param cmd destination of the bytes
+ * @param n number of bytes to receive
+ * @param ms maximum waiting time
+ * @return true, if n bytes were received in time.
+ */
+bool receiveCommandWithin(unsigned char *cmd, int n, int ms) {
+	const Int64 deadline = fdClockMs() + ms;
+	while (fifoCanRead(fifoUcIn) < n) if (!doIo(deadline) && fdRemainingMs(deadline)==0) return false;
 	fifoReadN(fifoUcIn,cmd,n);
 	return true;
 }
 
+bool receiveCommand(unsigned char *cmd, int n) {
+	if (receiveCommandWithin(cmd,n,timeoutMs)) return true;
+	else {
+		fprintf(stderr,"\nERROR: timeout waiting for %d bytes from uC.\n",n);
+		return false;
+	}
+}
+
 #include <fifoPrint.h>
 
 #define FORCE(x) if (!(x)) {\
@@ -103,6 +129,23 @@ bool receiveCommand(unsigned char *cmd, int n) {
 
 const char* ramloader = "ramloader";
 
+static const unsigned char cmdResetAddress = 0x1;
+static const unsigned char cmdWrite = 0x2;	// + 256 bytes data, response: 16-bit sum, LSB first
+static const unsigned char cmdSetAddress = 0x7;	// + 4 bytes absolute address.
+static const unsigned char cmdExecute = 0x4;
+static const unsigned char cmdDebug = 0x8;	// keep ramloader UART and start program
+/* Query for pipelining, response: 'W' + max number of commands that may be in flight. Firmware that responds this
+ * way buffers that many cmdWrite blocks (or cmdRead requests) and answers them strictly in order. Older firmware
+ * does not respond at all.
+ */
+static const unsigned char cmdWindow = 0x9;
+/* + 1 byte length n + n bytes lzBlock compressed data, response: 16-bit sum of the decompressed 256 bytes, like
+ * cmdWrite. n=0 queries support for this command, response 'Z'. Older firmware does not respond.
+ */
+static const unsigned char cmdWriteLz = 0xA;
+static const int windowQueryMs = 100;		// time to wait for a response to cmdWindow
+static const int retriesMax = 3;		// number of retransmissions after checksum errors
+
 void ramloaderSync(void) {
 	// flush input
 	fifoSkipRead(fifoUcIn, fifoCanRead(fifoUcIn));
@@ -117,6 +160,37 @@ void ramloaderSync(void) {
 	FORCE((~response & 0xFF)==test);
 }
 
+/** Negotiates the number of blocks in flight with the target.
+ * @param windowMax the maximum number of blocks wanted in flight.
+ * @return the number of blocks in flight both sides agree upon, 1 meaning stop-and-wait.
+ */
+int ramloaderWindow(int windowMax) {
+	if (windowMax<=1) return 1;
+
+	unsigned char response[2];
+	FORCE(sendCommand(&cmdWindow,sizeof cmdWindow));
+	if (receiveCommandWithin(response,sizeof response,windowQueryMs) && response[0]=='W' && response[1]>=1)
+		return response[1]<windowMax ? response[1] : windowMax;
+	else {	// old firmware
+		ramloaderSync();
+		return 1;
+	}
+}
+
+/** Queries the target for cmdWriteLz support.
+ * @return true, if compressed blocks can be sent.
+ */
+bool ramloaderLz(void) {
+	const unsigned char query[] = { cmdWriteLz, 0 };
+	unsigned char response;
+	FORCE(sendCommand(query,sizeof query));
+	if (receiveCommandWithin(&response,sizeof response,windowQueryMs) && response=='Z') return true;
+	else {	// old firmware
+		ramloaderSync();
+		return false;
+	}
+}
+
 /** Calculates the checksum of a 256 byte block.
  */
 Uint16 checksum(const Uint8 *data) {
@@ -125,18 +199,134 @@ Uint16 checksum(const Uint8 *data) {
 	return sum;
 }
 
-bool downloadCode(const char *fnImage, unsigned address, bool verify, bool debug) {
+/** Extracts a 256 byte block from a segment, padding with 0xFF.
+ */
+void segmentBlock(Uint8 *block, const Segment *segment, int b) {
+	const int offset = b*256;
+	memset(block,0xFF,256);
+	memcpy(block,segment->data+offset,segment->size-offset >= 256 ? 256 : segment->size-offset);
+}
+
+/** Sets the target's write address to a block of the segment.
+ * @param segment the segment being written
+ * @param absolute true, if the segment address is valid, false if the target's default address is used.
+ * @param b the block to restart from. Rewinds to block 0, if not absolute.
+ * @return the block the target will write next.
+ */
+int segmentRewind(const Segment *segment, bool absolute, int b) {
+	unsigned char response;
+	if (absolute) {
+		const Uint32 address = segment->address + b*256;
+		const unsigned char setAddress[] = {
+			cmdSetAddress,
+			address & 0xFF,
+			address>>8 & 0xFF,
+			address>>16 & 0xFF,
+			address>>24 & 0xFF
+		};
+		FORCE(sendCommand(setAddress, sizeof setAddress));
+		FORCE(receiveCommand(&response,sizeof response));
+		FORCE(response=='A');
+		return b;
+	}
+	else {
+		FORCE(sendCommand(&cmdResetAddress, sizeof cmdResetAddress));
+		FORCE(receiveCommand(&response,sizeof response));
+		FORCE(response==0xA5);
+		return 0;
+	}
+}
+
+/** Queues a block for transmission, either as cmdWrite or as cmdWriteLz, whichever is shorter.
+ * @param block the 256 bytes of data.
+ * @param lz true, if the target understands cmdWriteLz.
+ * @return the number of bytes queued.
+ */
+int blockQueue(const Uint8 *block, bool lz) {
+	Uint8 compressed[256-2];
+	const int n = lz ? lzBlockCompress(compressed,sizeof compressed,block,256) : -1;
+	if (n>0) {
+		fifoWrite(fifoUcOut,cmdWriteLz);
+		fifoWrite(fifoUcOut,n);
+		fifoWriteN(fifoUcOut,compressed,n);
+		return 2+n;
+	}
+	else {
+		fifoWrite(fifoUcOut,cmdWrite);
+		fifoWriteN(fifoUcOut,block,256);
+		return 1+256;
+	}
+}
+
+/** Writes a segment as 256-byte blocks, keeping up to window blocks in flight.
+ * Checksums are matched in order as they arrive. On a mismatch, the responses of the blocks in flight are drained,
+ * the target address is set back to the failing block and transmission restarts from there.
+ * @param segment the segment, already addressed by cmdSetAddress or cmdResetAddress.
+ * @param absolute true, if the segment address is valid.
+ * @param window the maximum number of unanswered blocks, 1 for stop-and-wait.
+ * @param lz true, if blocks may be sent compressed.
+ * @param wireBytes accumulator for the number of bytes sent.
+ * @return true, if all blocks were confirmed.
+ */
+bool segmentWrite(const Segment *segment, bool absolute, int window, bool lz, Uint32 *wireBytes) {
+	const int nBlocks = (segment->size+255)/256;
+	int sent = 0;
+	int acked = 0;
+	int retries = 0;
+	Int64 deadline = fdClockMs() + timeoutMs;
+
+	while (acked<nBlocks) {
+		while (sent<nBlocks && sent-acked<window && 1+256<=fifoCanWrite(fifoUcOut)) {
+			Uint8 block[256];
+			segmentBlock(block,segment,sent++);
+			*wireBytes += blockQueue(block,lz);
+		}
+
+		if (2<=fifoCanRead(fifoUcIn)) {
+			Uint8 block[256];
+			segmentBlock(block,segment,acked);
+			const Uint16 sum = fifoRead(fifoUcIn) & 0xFF;
+			if ((sum | (fifoRead(fifoUcIn) & 0xFF)<<8)==checksum(block)) {
+				acked++;
+				fifoPrintChar(fifoOut,'.');
+			}
+			else {
+				fifoPrintChar(fifoOut,'!');
+				if (++retries>retriesMax) return false;
+
+				for ( ; acked+1<sent; sent--) {
+					unsigned char ignored[2];
+					if (!receiveCommand(ignored,sizeof ignored)) return false;
+				}
+				sent = acked = segmentRewind(segment,absolute,acked);
+			}
+			deadline = fdClockMs() + timeoutMs;
+		}
+		else if (!doIo(deadline) && fdRemainingMs(deadline)==0) {
+			fprintf(stderr,"\nERROR: timeout waiting for checksum of block %d.\n",acked);
+			return false;
+		}
+	}
+	return true;
+}
+
+bool downloadCode(const char *fnImage, unsigned address, bool verify, bool debug, int windowMax, bool compress) {
 	Uint8	ram[0x20000];
 	HexImage hexImage = { ram, sizeof ram };
 	hexImageInit(&hexImage);
 
-	const unsigned char cmdResetAddress = 0x1;
-	const unsigned char cmdWrite = 0x2;
-	const unsigned char cmdSetAddress = 0x7;	// + 4 bytes absolute address.
-	const unsigned char cmdExecute = 0x4;
-	const unsigned char cmdDebug = 0x8;		// keep ramloader UART and start program
 	fifoPrintString(fifoOut,"<Downloading image>\n");
 	ramloaderSync();		// armloader lost sync at this point for a long time.
+	const int window = ramloaderWindow(windowMax);
+	if (window>1) {
+		fifoPrintString(fifoOut,"<window ");
+		fifoPrintUDec(fifoOut,window,1,3);
+		fifoPrintString(fifoOut,">\n");
+	}
+	const bool lz = compress && ramloaderLz();
+	if (lz) fifoPrintString(fifoOut,"<compressed>\n");
+	Uint32 dataBytes = 0;
+	Uint32 wireBytes = 0;
 	if (hexFileLoad(fnImage,&hexImage)) {
 		for (int s=0; s<=hexImageSegments(&hexImage); s++) {
 			const Segment *segment = &hexImage.segments[s];
@@ -144,50 +334,23 @@ bool downloadCode(const char *fnImage, unsigned address, bool verify, bool debug
 			fifoPrintString(fifoOut," :");
 			if (segment->size==0) continue;
 
-			if (addressIsValid(segment->address)) {	// send setAddress
-				const unsigned char setAddress[] = {
-					cmdSetAddress,
-					segment->address & 0xFF,
-					segment->address>>8 & 0xFF,
-					segment->address>>16 & 0xFF,
-					segment->address>>24 & 0xFF
-				};
-				FORCE(sendCommand(setAddress, sizeof setAddress));
-				unsigned char response;
-				FORCE(receiveCommand(&response,sizeof response));
-				FORCE(response=='A');
-			}
-			else if (s==0) {
-				FORCE(sendCommand(&cmdResetAddress, sizeof cmdResetAddress));
-				unsigned char response;
-				FORCE(receiveCommand(&response,sizeof response));
-				FORCE(response==0xA5);
-			}
-			else {
+			const bool absolute = addressIsValid(segment->address);
+			if (!absolute && s!=0) {
 				fifoPrintString(fifoOut,"Missing segment address.\n");
 				return false;
 			}
+			segmentRewind(segment,absolute,0);
 
-			for (int b=0; b<segment->size; b+=256) {
-				Uint8 block[256];
-				memset(block,0xFF,sizeof block);
-				memcpy(block,segment->data+b,segment->size-b >= 256 ? 256 : segment->size-b);
-				FORCE(sendCommand(&cmdWrite, sizeof cmdWrite));
-				FORCE(sendCommand(block, sizeof block));
-				const Uint16 sum;
-				FORCE(receiveCommand((unsigned char*)&sum,sizeof sum));
-				fifoPrintChar(fifoOut,'.');
-			/*	fifoPrintString(fifoOut,"sum=0x");
-				fifoPrintHex(fifoOut,sum,4,4);
-				fifoPrintString(fifoOut,", sum(block)=0x");
-				fifoPrintHex(fifoOut,checksum(block),4,4);
-				fifoPrintLn(fifoOut);
-			*/
-				flushOut();
-				FORCE(sum==checksum(block));
-			}
+			FORCE(segmentWrite(segment,absolute,window,lz,&wireBytes));
+			dataBytes += (segment->size+255) & ~255;
 			fifoPrintStringLn(fifoOut,"OK.");
 		}
+		if (lz) {
+			fifoPrintUDec(fifoOut,dataBytes,1,10);
+			fifoPrintString(fifoOut," bytes sent as ");
+			fifoPrintUDec(fifoOut,wireBytes,1,10);
+			fifoPrintStringLn(fifoOut,".");
+		}
 		fifoPrintStringLn(fifoOut,"<Executing code>.");
 		if (!debug) {
 			FORCE(write(fdSerial,&cmdExecute,1));
@@ -215,18 +378,23 @@ int main(int argc, char* argv[]) {
 		bool debug;
 		bool disableAnsi;
 		bool onlyAscii;
+		unsigned window;
+		bool compress;
 	}
 	options = {
 		getenv(envTty) ? getenv(envTty) : "/dev/ttyUSB0",
 		.baud = 115200,
 		.address = 0x40000000,
+		.timeoutMs = 1000,
 		.verify = false,		// do not verify by default
 		.debug = getenv(envDebug) ? getenv(envDebug)[0]=='1' : false,	// alternate start of program
 		.disableAnsi = false,
 		.onlyAscii = false,
+		.window = 8,
+		.compress = true,
 	};
 
-	for (int optChar; -1!=(optChar = getopt(argc,argv,"Aab:d:t:hgv?")); ) switch(optChar) {
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"Aab:d:t:w:hgvZ?")); ) switch(optChar) {
 
 		case 'A':	options.onlyAscii = true; break;
 		case 'a':	options.disableAnsi = true; break;
@@ -235,6 +403,8 @@ int main(int argc, char* argv[]) {
 		case 'v':	options.verify = true; break;
 		case 't':	options.timeoutMs = strtol(optarg,0,0); break;
 		case 'g':	options.debug = true; break;
+		case 'w':	options.window = strtol(optarg,0,0); break;
+		case 'Z':	options.compress = false; break;
 		case 'h':
 		case '?':
 			printf("%s 2.1 (formerly known as armloader), (C) Marc Prager, 2005-2012\n",ramloader);
@@ -248,8 +418,10 @@ int main(int argc, char* argv[]) {
 			printf("] optionally set by variable %s\n",envTty);
 			printf("  -g                : run program in debug mode [optionally set by variable %s\n",envDebug);
 			printf("  -A                : ASCII characters only (<128), everything else as \\xXX\n");
-			printf("  -t <timeout/ms>   : serial port receive timeout\n");
+			printf("  -t <timeout/ms>   : serial port receive timeout [%u]\n",options.timeoutMs);
 			printf("  -v                : verify downloaded image\n");
+			printf("  -w <blocks>       : max. 256-byte blocks in flight, 1 = stop-and-wait [%u]\n",options.window);
+			printf("  -Z                : do not compress blocks, even if the target supports it\n");
 			printf("  -h or -?          : help\n\n");
 			return 1;
 		default :
@@ -267,6 +439,8 @@ int main(int argc, char* argv[]) {
 	//printf("%s:tty=%s\n",ramloader,options.port);
 	fdSerial = serialOpenBlockingTimeout(options.port,options.baud,options.timeoutMs/100);
 	FORCE(fdSerial>=0);
+	fdFifos[FD_SERIAL].fd = fdSerial;
+	timeoutMs = options.timeoutMs;
 
 	const char *pattern = "<RAMLOADER: hardware reset>\n";
 	
@@ -279,29 +453,30 @@ int main(int argc, char* argv[]) {
 	usleep(200*1000);
 
 	(void)fifoScan;
-	while (true) {
-		doIo();
+	bool running = true;
+	while (running) {
+		doIo(-1);
 
-		if (fifoCanRead(fifoUcIn)
+		while (running
+		&& fifoCanRead(fifoUcIn)
 		&& 4<=fifoCanWrite(fifoOut)
 		&& fifoCanWrite(fifoScan)) {
 			const char c = fifoRead(fifoUcIn);
 			fifoWrite(fifoScan,c);
 			fifoPrintCharAnsiEscaped(fifoOut,options.disableAnsi,options.onlyAscii,c);
 			if (fifoSearch(fifoScan,pattern)) {
-				if (!downloadCode(fileName,options.address,options.verify,options.debug)) {
+				if (!downloadCode(fileName,options.address,options.verify,options.debug,options.window,options.compress)) {
 					fifoPrintString(fifoErr,"\nERROR: Program NOT started.\n");
-					break;
+					running = false;
 				}
 			}
 			// restart scan.
 			// reset input
 		}
 
-		if (fifoCanRead(fifoIn) &&fifoCanWrite(fifoUcOut)) fifoWrite(fifoUcOut, fifoRead(fifoIn));
-		usleep (86);	// otherwise 100% CPU load
+		while (fifoCanRead(fifoIn) && fifoCanWrite(fifoUcOut)) fifoWrite(fifoUcOut, fifoRead(fifoIn));
 	}
-	doIo();
+	flushOut();
 
 	close(fdSerial);
 	return 0;
@@ -17,6 +17,7 @@
 #include <c-linux/fd.h>
 #include <c-linux/hexFile.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <macros.h>
 #include <int32Math.h>
 
@@ -24,9 +25,10 @@ static char fifoInBuffer[1024]; static Fifo _fifoIn = { fifoInBuffer, sizeof fif
 static char fifoOutBuffer[1024*1024]; static Fifo _fifoOut = { fifoOutBuffer, sizeof fifoOutBuffer, };
 static char fifoErrBuffer[4*1024]; static Fifo _fifoErr = { fifoErrBuffer, sizeof fifoErrBuffer, };
 static char fifoScanBuffer[1024]; static Fifo _fifoScan = { fifoScanBuffer, sizeof fifoScanBuffer, };
-static char fifoUcInBuffer[1024]; static Fifo _fifoUcIn = { fifoUcInBuffer, sizeof fifoUcInBuffer, };
+static char fifoUcInBuffer[16*1024]; static Fifo _fifoUcIn = { fifoUcInBuffer, sizeof fifoUcInBuffer, };
 static char fifoUcOutBuffer[1024]; static Fifo _fifoUcOut = { fifoUcOutBuffer, sizeof fifoUcOutBuffer };
 static int fdSerial = -1;
+static int timeoutMs = 1000;		// maximum waiting time for a response of the uC
 
 Fifo
 	*fifoIn = &_fifoIn,		// Console -> prog
@@ -45,39 +47,70 @@ bool fifoPrintCharEscaped(Fifo *fifo, char c) {
 	else return fifoPrintString(fifo,"\\x") && fifoPrintHex(fifo,(int)c & 0xFF,2,2);
 }
 
-void doIo(void) {
-	// uC -> prog
-	if (fifoCanWrite(fifoUcIn) && fdCanRead(fdSerial)) fifoWrite(fifoUcIn,fdRead(fdSerial));
+enum { FD_SERIAL, FD_STDERR, FD_STDOUT, };
 
-	// prog -> uC
-	while (fifoCanRead(fifoUcOut) && fdCanWrite(fdSerial)) fdWrite(fdSerial,fifoRead(fifoUcOut));
+static FdFifo fdFifos[] = {
+	[FD_SERIAL] = { .fd = -1, .in = &_fifoUcIn, .out = &_fifoUcOut },	// fd set after opening the port
+	[FD_STDERR] = { .fd = 2, .out = &_fifoErr },
+	[FD_STDOUT] = { .fd = 1, .out = &_fifoOut },
+};
 
-	// prog -> console (stderr)
-	while (fifoCanRead(fifoErr) && fdCanWrite(2)) fdWrite(2,fifoRead(fifoErr));
+/** Waits for IO and moves data between serial port, console and the Fifos.
+ * @param deadlineMs the latest time (fdClockMs) to return, -1 for waiting without limit, 0 for polling only.
+ * @return true, if IO happened, false in case of timeout.
+ */
+bool doIo(Int64 deadlineMs) {
+	const bool io = fdPollFifos(fdFifos,ELEMENTS(fdFifos),fdRemainingMs(deadlineMs));
 
-	// prog -> stdout
-	while (fifoCanRead(fifoOut) && fdCanWrite(1)) fdWrite(1,fifoRead(fifoOut));
+	if (fdFifos[FD_SERIAL].eof) {
+		fprintf(stderr,"\nERROR: serial port closed.\n");
+		exit(1);
+	}
+	if (fdFifos[FD_STDOUT].eof) {
+		fprintf(stderr,"\nERROR: cannot write output.\n");
+		exit(1);
+	}
+	return io;
 }
 
 void flushOut(void) {
-	while (fifoCanRead(fifoOut)) fdWrite(1,fifoRead(fifoOut));
+	while (fifoCanRead(fifoOut) && fdWriteFifo(1,fifoOut)>=0) ;
 }
 
 bool sendCommand(const unsigned char *cmd, int n) {
 	if (n<=fifoCanWrite(fifoUcOut)) {
+		const Int64 deadline = fdClockMs() + timeoutMs;
 		fifoWriteN(fifoUcOut,cmd,n);
-		while (fifoCanRead(fifoUcOut)) doIo();
+		while (fifoCanRead(fifoUcOut)) if (!doIo(deadline) && fdRemainingMs(deadline)==0) {
+			fprintf(stderr,"\nERROR: timeout sending to uC.\n");
+			return false;
+		}
 		return true;
 	}
 	else return false;
 }
 
-bool receiveCommand(unsigned char *cmd, int n) {
-	while (fifoCanRead(fifoUcIn) < n) doIo();
+/** Receives n bytes from the uC without complaining about a timeout.
+ * @param cmd destination of the bytes
+ * @param n number of bytes to receive
+ * @param ms maximum waiting time
+ * @return true, if n bytes were received in time.
+ */
+bool receiveCommandWithin(unsigned char *cmd, int n, int ms) {
+	const Int64 deadline = fdClockMs() + ms;
+	while (fifoCanRead(fifoUcIn) < n) if (!doIo(deadline) && fdRemainingMs(deadline)==0) return false;
 	fifoReadN(fifoUcIn,cmd,n);
 	return true;
 }
 
+bool receiveCommand(unsigned char *cmd, int n) {
+	if (receiveCommandWithin(cmd,n,timeoutMs)) return true;
+	else {
+		fprintf(stderr,"\nERROR: timeout waiting for %d bytes from uC.\n",n);
+		return false;
+	}
+}
+
 #include <fifoPrint.h>
 
 #define FORCE(x) if (!(x)) {\
@@ -110,26 +143,53 @@ void ramreaderSync(void) {
 	FORCE((~response & 0xFF)==test);
 }
 
-bool readCode(Fifo *data, unsigned n) {
+/* Query for pipelining, response: 'W' + max number of commands that may be in flight. See ramloader.c.
+ */
+static const unsigned char cmdWindow = 0x9;
+static const int windowQueryMs = 100;		// time to wait for a response to cmdWindow
+
+/** Negotiates the number of blocks in flight with the target.
+ * @param windowMax the maximum number of blocks wanted in flight.
+ * @return the number of blocks in flight both sides agree upon, 1 meaning stop-and-wait.
+ */
+int ramreaderWindow(int windowMax) {
+	if (windowMax<=1) return 1;
+
+	unsigned char response[2];
+	FORCE(sendCommand(&cmdWindow,sizeof cmdWindow));
+	if (receiveCommandWithin(response,sizeof response,windowQueryMs) && response[0]=='W' && response[1]>=1)
+		return response[1]<windowMax ? response[1] : windowMax;
+	else {	// old firmware
+		ramreaderSync();
+		return 1;
+	}
+}
+
+/** Reads n bytes from the target, keeping up to windowMax cmdRead requests in flight.
+ */
+bool readCode(Fifo *data, unsigned n, int windowMax) {
 	const unsigned char cmdResetAddress = 0x1;
-	const unsigned char cmdWrite = 0x2;
 	const unsigned char cmdRead = 0x3;
-	const unsigned char cmdSetAddress = 0x7;	// + 4 bytes absolute address.
 
 	fifoPrintString(fifoErr,"<Reading image>\n");
 	ramreaderSync();		// armloader has lost sync at this point for a long time.
+	const int window = ramreaderWindow(windowMax);
 	FORCE(sendCommand(&cmdResetAddress,sizeof cmdResetAddress));
 	unsigned char a5;
 	FORCE(receiveCommand(&a5,sizeof a5) && a5==0xA5);	// reset address response
+
 	char buffer[256];
-	for (int a=0; a<n; a+=sizeof buffer) {
-		FORCE(sendCommand(&cmdRead,sizeof cmdRead));
+	const int nBlocks = (n+sizeof buffer-1) / sizeof buffer;
+	for (int requested=0, received=0; received<nBlocks; received++) {
+		while (requested<nBlocks && requested-received<window && fifoCanWrite(fifoUcOut)) {
+			fifoWrite(fifoUcOut,cmdRead);
+			requested++;
+		}
 		FORCE(receiveCommand((unsigned char*)buffer,sizeof buffer));
-		const unsigned int nLeft = int32Min(sizeof buffer, n-a);
+		const unsigned int nLeft = int32Min(sizeof buffer, n-received*sizeof buffer);
 		FORCE(fifoCanWrite(data)>=nLeft);
 		fifoWriteN(data,buffer,nLeft);
 		fifoPrintChar(fifoErr,'.');
-		doIo(); 
 	}
 	fifoPrintChar(fifoErr,'\n');
 	return true;
@@ -143,6 +203,7 @@ int main(int argc, char* argv[]) {
 		Uint32 timeResetMs;
 		Uint32 timeoutMs;
 		Uint32 n;
+		Uint32 window;
 	}
 	options = {
 		getenv(envTty) ? getenv(envTty) : "/dev/ttyUSB0",
@@ -150,15 +211,17 @@ int main(int argc, char* argv[]) {
 		200,
 		1000,
 		1024,
+		8,
 	};
 
-	for (char optChar; -1!=(optChar = getopt(argc,argv,"b:d:r:t:T:h?")); ) switch(optChar) {
+	for (char optChar; -1!=(optChar = getopt(argc,argv,"b:d:r:t:T:w:h?")); ) switch(optChar) {
 
 		case 'b':	options.baud = strtol(optarg,0,0); break;
 		case 'd':	options.port = optarg; break;
 		case 'r':	options.n = strtol(optarg,0,0); break;
 		case 't':	options.timeResetMs = strtol(optarg,0,0); break;
 		case 'T':	options.timeoutMs = strtol(optarg,0,0); break;
+		case 'w':	options.window = strtol(optarg,0,0); break;
 		case 'h':
 		case '?':
 		default :
@@ -171,8 +234,9 @@ int main(int argc, char* argv[]) {
 			printf("  -d <device>       : default serial communication device [%s",options.port);
 			printf("] optionally set by variable %s\n",envTty);
 			printf("  -r <n>            : read <n> bytes [%u]\n",options.n);
-			printf("  -t <timeout/ms>   : serial port receive timeout\n");
-			printf("  -T <timeout/ms>   : serial port receive timeout\n");
+			printf("  -t <time/ms>      : duration of the reset pulse [%u]\n",options.timeResetMs);
+			printf("  -T <timeout/ms>   : serial port receive timeout [%u]\n",options.timeoutMs);
+			printf("  -w <blocks>       : max. 256-byte blocks in flight, 1 = stop-and-wait [%u]\n",options.window);
 			printf("  -h or -?          : help\n\n");
 			return 1;
 	}
@@ -187,6 +251,8 @@ int main(int argc, char* argv[]) {
 
 	fdSerial = serialOpenBlockingTimeout(options.port,options.baud,options.timeoutMs/100);
 	FORCE(fdSerial>=0);
+	fdFifos[FD_SERIAL].fd = fdSerial;
+	timeoutMs = options.timeoutMs;
 
 	const char *pattern = "<RAMLOADER: hardware reset>\n";
 	
@@ -199,25 +265,24 @@ int main(int argc, char* argv[]) {
 
 	(void)fifoScan;
 	while (true) {
-		doIo();
+		doIo(-1);
 
-		if (fifoCanRead(fifoUcIn)
+		while (fifoCanRead(fifoUcIn)
 		&& 4<=fifoCanWrite(fifoErr)
 		&& fifoCanWrite(fifoScan)) {
 			const char c = fifoRead(fifoUcIn);
 			fifoWrite(fifoScan,c);
 			fifoPrintCharEscaped(fifoErr,c);
 			if (fifoSearch(fifoScan,pattern)) {
-				readCode(fifoOut,options.n);
+				readCode(fifoOut,options.n,options.window);
 				while (fifoCanRead(fifoOut)
-				|| fifoCanRead(fifoErr)) doIo();
+				|| fifoCanRead(fifoErr)) doIo(-1);
 				return 0;
 			}
 		}
 
-		if (fifoCanRead(fifoIn) &&fifoCanWrite(fifoUcOut)) fifoWrite(fifoUcOut, fifoRead(fifoIn));
 	}
-	doIo();
+	flushOut();
 
 
 	close(fdSerial);
@@ -0,0 +1,60 @@
+#!/bin/sh
+# loopback.sh - checks the block transfer of ramloader and ramreader against ramsim.
+# usage: loopback.sh image.bin
+# The image (a multiple of 256 bytes) is written by stop-and-wait, the sliding window with and without compression
+# and with a checksum error, which must all leave the image in RAM. Then it is read back the same ways.
+
+RAMLOADER=${RAMLOADER:-../ramloader/ramloader}
+RAMREADER=${RAMREADER:-../ramreader/ramreader}
+RAMSIM=${RAMSIM:-./ramsim}
+IMAGE=$1
+TMP=${TMPDIR:-/tmp}/ramsim.$$
+failed=0
+
+[ -f "$IMAGE" ] || { echo "usage: $0 image.bin"; exit 1; }
+size=$(stat -c %s "$IMAGE")
+
+# write <name> <ramsim options> -- <ramloader options>
+writeImage() {
+	name=$1; shift
+	simOptions=
+	while [ "$1" != "--" ]; do simOptions="$simOptions $1"; shift; done
+	shift
+	$RAMSIM -l $TMP.tty -o $TMP.ram $simOptions >$TMP.$name.out 2>&1 &
+	sleep 0.3
+	sleep 3 | timeout 10 $RAMLOADER -d $TMP.tty "$@" "$IMAGE" >$TMP.$name.log 2>&1
+	wait
+	cmp -s "$IMAGE" $TMP.ram || { echo "FAILED: write, $name"; failed=1; }
+	blocks=$(sed -n 's/^\([0-9]*\) blocks written, \([0-9]*\) compressed.*/\1 \2/p' $TMP.$name.out)
+}
+
+# read <name> <ramsim options> -- <ramreader options>
+readBack() {
+	name=$1; shift
+	simOptions=
+	while [ "$1" != "--" ]; do simOptions="$simOptions $1"; shift; done
+	shift
+	$RAMSIM -l $TMP.tty -f "$IMAGE" $simOptions >$TMP.$name.out 2>&1 &
+	sleep 0.3
+	timeout 10 $RAMREADER -d $TMP.tty -r $size "$@" >$TMP.read 2>$TMP.$name.log
+	wait
+	cmp -s "$IMAGE" $TMP.read || { echo "FAILED: read, $name"; failed=1; }
+}
+
+n=$((size/256))
+writeImage stop-and-wait --
+[ "$blocks" = "$n 0" ] || { echo "FAILED: stop-and-wait sent $blocks blocks"; failed=1; }
+writeImage window -w 8 -- -Z
+grep -q "<window 8>" $TMP.window.log || { echo "FAILED: window not negotiated"; failed=1; }
+writeImage window-lz -w 4 -z --
+grep -q "<compressed>" $TMP.window-lz.log || { echo "FAILED: compression not negotiated"; failed=1; }
+writeImage checksum-error -w 8 -c 2 -- -Z
+grep -q '!' $TMP.checksum-error.log || { echo "FAILED: checksum error not detected"; failed=1; }
+[ "${blocks%% *}" -gt $n ] || { echo "FAILED: no retransmission"; failed=1; }
+
+readBack stop-and-wait --
+readBack window -w 8 --
+
+rm -f $TMP $TMP.*
+[ $failed -eq 0 ] && echo "loopback OK"
+exit $failed
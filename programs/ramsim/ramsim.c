@@ -0,0 +1,286 @@
+/*
+  ramsim.c - simulates the ramloader firmware of a LPC target on a pseudo terminal.
+  Copyright 2013 Marc Prager
+
+  ramsim is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  ramsim is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with ramsim.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <integers.h>
+#include <lzBlock.h>
+
+/** @file
+ * @brief A model of the ramloader target firmware with RAM, for testing ramloader and ramreader without hardware.
+ *
+ * The simulator creates a pseudo terminal, that the host programs use like a serial line. The model buffers any
+ * number of commands and answers them strictly in order. Window (cmdWindow) and compression (cmdWriteLz) support
+ * are optional, like with older firmware, that ignores these commands. A checksum error can be injected, to check
+ * the retransmission of the sliding window.
+ *
+ * Loopback test of the block transfer, the RAM contents must equal the image:
+ *   ramsim -l /tmp/uc -o ram.bin & ramloader -d /tmp/uc image.bin
+ *   ramsim -l /tmp/uc -o ram.bin -w 8 -c 3 & ramloader -d /tmp/uc image.bin
+ * and read back:
+ *   ramsim -l /tmp/uc -f image.bin -w 8 & ramreader -d /tmp/uc -r 4096 >read.bin
+ */
+
+const char *ramsim = "ramsim";
+
+enum {
+	RAM_ADDRESS	=0x40000000,
+	RAM_SIZE	=0x20000,
+	BLOCK		=256,
+};
+
+enum {	// commands, see ramloader.c
+	CMD_RESET_ADDRESS	=0x1,
+	CMD_WRITE		=0x2,
+	CMD_READ		=0x3,
+	CMD_EXECUTE		=0x4,
+	CMD_SYNC		=0x5,
+	CMD_SET_ADDRESS		=0x7,
+	CMD_DEBUG		=0x8,
+	CMD_WINDOW		=0x9,
+	CMD_WRITE_LZ		=0xA,
+};
+
+static struct {
+	const char	*link;		///< symbolic link to the pseudo terminal
+	const char	*fileIn;	///< initial RAM contents
+	const char	*fileOut;	///< RAM contents written at the end
+	int		window;		///< answer to cmdWindow, 0 for none
+	bool		lz;		///< cmdWriteLz supported
+	int		corrupt;	///< the checksum of this write (1..) is wrong, 0 for none
+} options;
+
+static int fd = -1;
+static Uint8 ram[RAM_SIZE];
+static Uint32 ramEnd;			///< end of the data written
+static Uint32 address = RAM_ADDRESS;
+
+static Uint8 inBuffer[4096];
+static int inPos, inEnd;
+static bool connected;		///< the host opened the pseudo terminal
+
+static struct {
+	int		writes;
+	int		compressed;
+	int		reads;
+} counts;
+
+static void out (const void *data, int n) {
+	const Uint8 *bytes = data;
+	while (n>0) {
+		const int written = write (fd,bytes,n);
+		if (written<=0) return;
+		bytes += written;
+		n -= written;
+	}
+}
+
+/** Reads one byte from the host.
+ * @return the byte or -1, if the host closed the connection.
+ */
+static int readByte (void) {
+	if (inPos==inEnd) {
+		for (;;) {
+			const int n = read (fd,inBuffer,sizeof inBuffer);
+			if (n<0 && errno==EIO && !connected) {	// no host at the pseudo terminal, yet
+				usleep (10*1000);
+				continue;
+			}
+			if (n<=0) return -1;
+			connected = true;
+			inPos = 0;
+			inEnd = n;
+			break;
+		}
+	}
+	return inBuffer[inPos++];
+}
+
+static bool readData (Uint8 *data, int n) {
+	for (int i=0; i<n; i++) {
+		const int c = readByte ();
+		if (c<0) return false;
+		data[i] = c;
+	}
+	return true;
+}
+
+/** Maps a block of the target to the model.
+ * @return the memory or 0, if the block is not completely in RAM.
+ */
+static Uint8* memory (Uint32 a) {
+	return a>=RAM_ADDRESS && a-RAM_ADDRESS<=RAM_SIZE-BLOCK ? ram+(a-RAM_ADDRESS) : 0;
+}
+
+/** Stores a written block and answers its checksum.
+ */
+static void writeBlock (const Uint8 *block) {
+	Uint8 *destination = memory (address);
+	if (destination!=0) {
+		memcpy (destination,block,BLOCK);
+		if (address+BLOCK-RAM_ADDRESS > ramEnd) ramEnd = address+BLOCK-RAM_ADDRESS;
+	}
+	else fprintf (stderr,"%s: write outside RAM at 0x%08X\n",ramsim,address);
+	address += BLOCK;
+
+	Uint16 sum = 0;
+	for (int i=0; i<BLOCK; i++) sum += block[i];
+	if (++counts.writes==options.corrupt) sum++;
+	const Uint8 response[] = { sum & 0xFF, sum>>8 };
+	out (response,sizeof response);
+}
+
+/** Runs the firmware until the program is started or the host closes the connection.
+ */
+static void session (void) {
+	out ("<RAMLOADER: hardware reset>\n",28);
+	for (int c; 0<=(c = readByte ()); ) {
+		Uint8 data[BLOCK];
+		switch (c) {
+			case CMD_SYNC:
+				if (!readData (data,1)) return;
+				data[0] = ~data[0];
+				out (data,1);
+				break;
+			case CMD_RESET_ADDRESS:
+				address = RAM_ADDRESS;
+				out ("\xA5",1);
+				break;
+			case CMD_SET_ADDRESS:
+				if (!readData (data,4)) return;
+				address = data[0] | data[1]<<8 | data[2]<<16 | (Uint32)data[3]<<24;
+				out ("A",1);
+				break;
+			case CMD_WRITE:
+				if (!readData (data,BLOCK)) return;
+				writeBlock (data);
+				break;
+			case CMD_WRITE_LZ:
+				if (!options.lz) break;		// older firmware: ignored
+				if (!readData (data,1)) return;
+				if (data[0]==0) out ("Z",1);
+				else {
+					Uint8 compressed[BLOCK];
+					const int n = data[0];
+					if (!readData (compressed,n)) return;
+					if (BLOCK!=lzBlockDecompress (data,BLOCK,compressed,n)) {
+						fprintf (stderr,"%s: malformed compressed block\n",ramsim);
+						return;
+					}
+					counts.compressed++;
+					writeBlock (data);
+				}
+				break;
+			case CMD_READ: {
+				const Uint8 *source = memory (address);
+				if (source==0) {
+					memset (data,0xFF,BLOCK);
+					source = data;
+				}
+				out (source,BLOCK);
+				address += BLOCK;
+				counts.reads++;
+			}	break;
+			case CMD_WINDOW:
+				if (options.window>0) out ((Uint8[]){ 'W', options.window },2);
+				break;
+			case CMD_EXECUTE:
+			case CMD_DEBUG:
+				out ("started\n",8);
+				return;
+			default:
+				fprintf (stderr,"%s: unknown command 0x%02X\n",ramsim,c);
+		}
+	}
+}
+
+static int openPseudoTerminal (void) {
+	const int master = posix_openpt (O_RDWR|O_NOCTTY);
+	if (master<0 || grantpt (master) || unlockpt (master)) return -1;
+
+	// raw mode on the slave side, that the host reads as its serial line. The slave is closed again, so the end of the
+	// session is seen as EIO on the master.
+	const int slave = open (ptsname (master),O_RDWR|O_NOCTTY);
+	struct termios t;
+	if (slave<0 || tcgetattr (slave,&t)) return -1;
+	cfmakeraw (&t);
+	if (tcsetattr (slave,TCSANOW,&t) || close (slave)) return -1;
+
+	if (options.link!=0) {
+		unlink (options.link);
+		if (symlink (ptsname (master),options.link)) return -1;
+	}
+	else printf ("%s\n",ptsname (master));
+	fflush (stdout);
+	return master;
+}
+
+int main(int argc, char* argv[]) {
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"c:f:l:o:w:zh?")); ) switch(optChar) {
+		case 'c':	options.corrupt = atoi (optarg); break;
+		case 'f':	options.fileIn = optarg; break;
+		case 'l':	options.link = optarg; break;
+		case 'o':	options.fileOut = optarg; break;
+		case 'w':	options.window = atoi (optarg); break;
+		case 'z':	options.lz = true; break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options]\n",ramsim);
+			printf("Simulates the ramloader firmware of a LPC target for one session of ramloader or ramreader.\n");
+			printf("options:\n");
+			printf("  -l link           : symbolic link to the pseudo terminal, instead of printing its name\n");
+			printf("  -f file           : initial RAM contents, default 0xFF\n");
+			printf("  -o file           : write the RAM contents up to the last block written to file\n");
+			printf("  -w blocks         : answer the window query with this number, default: no answer\n");
+			printf("  -z                : support compressed blocks\n");
+			printf("  -c n              : corrupt the checksum of the n-th block written\n");
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+
+	memset (ram,0xFF,sizeof ram);
+	if (options.fileIn!=0) {
+		FILE *file = fopen (options.fileIn,"rb");
+		if (file==0) {
+			fprintf (stderr,"%s: cannot read \"%s\"\n",ramsim,options.fileIn);
+			return 1;
+		}
+		fread (ram,1,sizeof ram,file);
+		fclose (file);
+	}
+
+	fd = openPseudoTerminal ();
+	if (fd<0) {
+		fprintf (stderr,"%s: cannot open pseudo terminal\n",ramsim);
+		return 1;
+	}
+	session ();
+	printf ("%d blocks written, %d compressed, %d read\n",counts.writes,counts.compressed,counts.reads);
+
+	if (options.fileOut!=0) {
+		FILE *file = fopen (options.fileOut,"wb");
+		if (file==0 || ramEnd!=fwrite (ram,1,ramEnd,file) || fclose (file)) {
+			fprintf (stderr,"%s: cannot write \"%s\"\n",ramsim,options.fileOut);
+			return 1;
+		}
+	}
+	return 0;
+}
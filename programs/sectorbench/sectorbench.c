@@ -0,0 +1,155 @@
+/*
+  sectorbench.c - checks the LpcSectorMap lookup against the sector iterator for all members and times both.
+  Copyright 2013 Marc Prager
+
+  sectorbench is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License
+  as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+  sectorbench is published in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty
+  of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with sectorbench.
+  If not see <http://www.gnu.org/licenses/>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <lpcMemories.h>
+
+const char *sectorbench = "sectorbench";
+
+enum {
+	ADDRESSES_MAX	=8*LPC_SECTORS+8,
+};
+
+static struct {
+	bool		verbose;	///< print every difference
+	int		rounds;		///< timing rounds per member
+} options = { .rounds = 20, };
+
+static double timeS(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+/** Collects the addresses worth checking: sector boundaries +/-1, sector midpoints and addresses outside FLASH.
+ * @return the number of addresses.
+ */
+static int testAddresses (LpcMember const *member, Uint32 *addresses) {
+	int n = 0;
+	for (LpcSectorIterator it = { member }; lpcSectorIteratorHasNext (&it) && n+7<=ADDRESSES_MAX-3;
+	lpcSectorIteratorNext (&it)) {
+		const Uint32 start = lpcSectorIteratorAddress (&it);
+		const Uint32 end = start + lpcSectorIteratorSize (&it);
+		const Uint32 candidates[] = { start-1, start, start+1, start+(end-start)/2, end-1, end, end+1 };
+		for (int c=0; c<7; c++) addresses[n++] = candidates[c];
+	}
+	addresses[n++] = 0;
+	addresses[n++] = 0x10000000;
+	addresses[n++] = 0xFFFFFFFF;
+	return n;
+}
+
+/** Compares lpcAddressRangeToSectorRange with the iterator for all pairs of test addresses.
+ * @return the number of differences.
+ */
+static int compare (LpcMember const *member, Uint32 *checks) {
+	Uint32 addresses[ADDRESSES_MAX];
+	const int n = testAddresses (member,addresses);
+	int differences = 0;
+	for (int i=0; i<n; i++) for (int j=0; j<n; j++) {
+		const Uint32Pair range = { addresses[i], addresses[j] };
+		Int32Pair iterated = { -7, -7 };
+		Int32Pair mapped = { -7, -7 };
+		const bool resultIterated = lpcAddressRangeToSectorRangeIterating (member,&iterated,&range);
+		const bool resultMapped = lpcAddressRangeToSectorRange (member,&mapped,&range);
+		++*checks;
+		if (resultIterated!=resultMapped || iterated.fst!=mapped.fst || iterated.snd!=mapped.snd) {
+			if (options.verbose || differences==0) {
+				printf ("%s: 0x%08X..0x%08X iterator %d %X..%X, map %d %X..%X\n", member->name,
+					range.fst, range.snd, resultIterated, iterated.fst, iterated.snd,
+					resultMapped, mapped.fst, mapped.snd);
+			}
+			differences++;
+		}
+	}
+	return differences;
+}
+
+/** Times single address lookups over all test addresses.
+ * @return the time per lookup in seconds.
+ */
+static double timeLookups (LpcMember const *member, bool iterating) {
+	Uint32 addresses[ADDRESSES_MAX];
+	const int n = testAddresses (member,addresses);
+	volatile Int32 sink = 0;
+	const double t0 = timeS ();
+	for (int r=0; r<options.rounds; r++) for (int i=0; i<n; i++) {
+		const Uint32Pair range = { addresses[i], addresses[i] };
+		Int32Pair sectors;
+		if (iterating ? lpcAddressRangeToSectorRangeIterating (member,&sectors,&range)
+			: lpcAddressRangeToSectorRange (member,&sectors,&range)) sink += sectors.fst;
+	}
+	return (timeS ()-t0) / (options.rounds*n);
+}
+
+/** A member changed in place, like the device definitions of mxli -I do, must not be looked up in a stale map.
+ * @return the number of differences.
+ */
+static int compareModifiedInPlace (LpcMember const *original, Uint32 *checks) {
+	LpcFamily family = *original->family;
+	LpcMember member = *original;
+	member.family = &family;
+
+	int differences = compare (&member,checks);
+	member.sizeFlashK /= 2;
+	differences += compare (&member,checks);
+	if (family.sectorArrays[0].n > 1) {
+		family.sectorArrays[0].n--;
+		differences += compare (&member,checks);
+	}
+	family.addressFlashs[0] += 0x1000;
+	differences += compare (&member,checks);
+	return differences;
+}
+
+int main(int argc, char* argv[]) {
+	for (int optChar; -1!=(optChar = getopt(argc,argv,"n:vh?")); ) switch(optChar) {
+		case 'n':	options.rounds = atoi (optarg); break;
+		case 'v':	options.verbose = true; break;
+		case 'h':
+		case '?':
+		default:
+			printf("usage: %s [options]\n",sectorbench);
+			printf("Checks the binary search of FLASH sectors against the sector iterator for all known members and\n");
+			printf("compares the lookup times.\n");
+			printf("options:\n");
+			printf("  -n rounds         : timing rounds per member, default %d\n",options.rounds);
+			printf("  -v                : print every difference\n");
+			printf("  -h or -?          : help\n\n");
+			return 1;
+	}
+
+	int members = 0, mapped = 0, differences = 0;
+	Uint32 checks = 0;
+	double iteratingS = 0, mappedS = 0;
+	for (LpcMember const * const *m = lpcMembersXxxx; *m!=0; m++) {
+		members++;
+		LpcSectorMap map;
+		if (lpcSectorMapInit (&map,*m)) mapped++;
+		else printf ("%s: no map, the iterator is used\n",(*m)->name);
+		differences += compare (*m,&checks);
+		iteratingS += timeLookups (*m,true);
+		mappedS += timeLookups (*m,false);
+	}
+	const int differencesModified = compareModifiedInPlace (lpcMembersXxxx[0],&checks);
+
+	printf ("%d members, %d mapped, %u comparisons, %d differences, %d after in-place changes\n",
+		members, mapped, checks, differences, differencesModified);
+	if (members>0) printf ("lookup: iterator %.1fns, map %.1fns\n", iteratingS/members*1e9, mappedS/members*1e9);
+	return differences+differencesModified==0 ? 0 : 1;
+}
@@ -20,9 +20,15 @@
 #include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <c-linux/serial.h>
+#include <c-linux/fd.h>
 #include <fifoPopt.h>
+#include <fifoPrint.h>
+#include <macros.h>
 
 const char* histFn = "/tmp/uconsole.hist";
 
@@ -39,6 +45,10 @@ void showHelp(void) {
 	"  -l {CR|LF|CRLF}          : transmission line feed [LF]\n"
 	"  -p <prompt>              : show a prompt\n"
 	"  -o <outputDevice>        : send received data to <outputDevice> [stdout]\n"
+	"  -w <file>                : capture mode: log the received data with time stamps to <file>. The output\n"
+	"                             is best-effort and skips data, if it cannot keep up\n"
+	"  -W <size/MiB>            : maximum size of the capture file [256]\n"
+	"  -r <file>                : replay a capture file to the output with the original timing\n"
 	"\n"
 	"<wave> is a sequence of the chars rRdDpP with the following meanings:\n"
 	"  r : RTS=0, R : RTS=1\n"
@@ -55,11 +65,14 @@ static bool controlCharsShow = false;
 static bool controlCharsShowAll = false;
 static Int32 baud = 115200;
 static Int32 timeoutMs = 100;
+static Int32 captureMiB = 256;
 static int symbolLineFeed = 2;
 static Fifo fifoDevice = {};
 static Fifo fifoWave = {};
 static Fifo fifoPrompt = {};
 static Fifo fifoOutputDevice = {};
+static Fifo fifoCaptureFile = {};
+static Fifo fifoReplayFile = {};
 
 const FifoPoptBool optionBools[] = {
 	{ .shortOption = '?', .value = &helpShow },
@@ -72,6 +85,7 @@ const FifoPoptBool optionBools[] = {
 const FifoPoptInt32 optionInt32s[] = {
 	{ .shortOption = 'b', .value = &baud, },
 	{ .shortOption = 't', .value = &timeoutMs, },
+	{ .shortOption = 'W', .value = &captureMiB, },
 	{}
 };
 
@@ -90,6 +104,8 @@ const FifoPoptString optionStrings[] = {
 	{ .shortOption = 's', .value = &fifoWave },
 	{ .shortOption = 'p', .value = &fifoPrompt },
 	{ .shortOption = 'o', .value = &fifoOutputDevice },
+	{ .shortOption = 'w', .value = &fifoCaptureFile },
+	{ .shortOption = 'r', .value = &fifoReplayFile },
 	{}
 };
 
@@ -118,39 +134,230 @@ typedef struct {
 	volatile bool	run;
 } TControl;
 
-void dumpInputCharacter(int fd, char c) {
-	char buffer[6];
-	int n = 0;
+enum {
+	DUMP_ESCAPE_MAX = 4,		///< maximum number of chars output for one received char
+	DUMP_POLL_MS = 100,		///< maximum latency for noticing the end of the program
+};
+
+bool dumpInputCharacter(Fifo *fifo, char c) {
 	if (c=='\n') {
-		if (controlCharsShowAll) n = snprintf(buffer,sizeof buffer,"\\n\n");	// write symbol and char
-		else n = snprintf(buffer,sizeof buffer,"\n");
+		if (controlCharsShowAll) return fifoPrintString(fifo,"\\n\n");	// write symbol and char
+		else return fifoPrintChar(fifo,'\n');
 	}
 	else if (c=='\r') {
-		if (controlCharsShowAll) n = snprintf(buffer,sizeof buffer,"\\r");	// write symbol only
-		else n = snprintf(buffer,sizeof buffer,"\r");
+		if (controlCharsShowAll) return fifoPrintString(fifo,"\\r");	// write symbol only
+		else return fifoPrintChar(fifo,'\r');
 	}
 	else if (0<=c && c<0x20) {
-		if (controlCharsShow) n = snprintf(buffer,sizeof buffer,"\\x%02X",c & 0xFF);	// write symbol only
-		else n = snprintf(buffer,sizeof buffer,"%c",c);
+		if (controlCharsShow) return fifoPrintString(fifo,"\\x") && fifoPrintHex(fifo,c & 0xFF,2,2);	// write symbol only
+		else return fifoPrintChar(fifo,c);
 	}
-	else n = snprintf(buffer,sizeof buffer,"%c",c);
-
-	write(fd,buffer,n);
+	else return fifoPrintChar(fifo,c);
 }
 
+/** Receiver thread: copies the serial input to the output device in blocks, waiting in poll() instead of
+ * reading single chars.
+ */
 void* dumpInput(TControl *tc) {
-	char c;
-	while (tc->run) {
-		const int n=read(tc->readFd,&c,1);
-		switch(n) {
-			case 0: break;
-			case 1: dumpInputCharacter(tc->writeFd,c); break;
-			default: tc->run = false;
+	static char rxBuffer[4*1024]; Fifo fifoRx = { rxBuffer, sizeof rxBuffer };
+	static char txBuffer[DUMP_ESCAPE_MAX*sizeof rxBuffer]; Fifo fifoTx = { txBuffer, sizeof txBuffer };
+	FdFifo fdFifos[] = {
+		{ .fd = tc->readFd, .in = &fifoRx },
+		{ .fd = tc->writeFd, .out = &fifoTx },
+	};
+
+	while (tc->run && !fdFifos[0].eof && !fdFifos[1].eof) {
+		fdPollFifos(fdFifos,ELEMENTS(fdFifos),DUMP_POLL_MS);
+		while (fifoCanRead(&fifoRx) && DUMP_ESCAPE_MAX<=fifoCanWrite(&fifoTx))
+			dumpInputCharacter(&fifoTx,fifoRead(&fifoRx));
+	}
+	tc->run = false;
+	return 0;
+}
+
+/** Writes received data to the output, with control chars as escape sequences, if requested.
+ * @return false, if the output failed.
+ */
+bool renderBlock(int fd, const char *data, size_t n) {
+	if (!controlCharsShow && !controlCharsShowAll) return n==write(fd,data,n);
+
+	static char txBuffer[4*1024]; Fifo fifoTx = { txBuffer, sizeof txBuffer };
+	for (size_t i=0; i<n; ) {
+		while (i<n && DUMP_ESCAPE_MAX<=fifoCanWrite(&fifoTx)) dumpInputCharacter(&fifoTx,data[i++]);
+		while (fifoCanRead(&fifoTx)) if (fdWriteFifo(fd,&fifoTx)<0) return false;
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Capture mode: the receiver thread reads the tty in blocks directly into a memory mapped log file, without
+// rendering. The log is a single producer, single consumer ring without wrap-around: the renderer thread follows the
+// published end of the log and skips blocks, if it falls behind.
+
+/** Capture file header. All fields are in host byte order.
+ */
+typedef struct __attribute__((packed,aligned(8))) {
+	char		magic[8];	///< "uconCAPT"
+	Uint64		size;		///< bytes of blocks following the header, updated after every block
+	Uint32		baud;
+	Uint32		reserved;
+} CaptureHeader;
+
+/** A block of received data, followed by the data and padding to a multiple of 8 bytes.
+ */
+typedef struct __attribute__((packed,aligned(8))) {
+	Uint64		timeUs;		///< monotonic time of reception, relative to the start of the capture
+	Uint32		n;		///< number of data bytes
+	Uint32		reserved;
+} CaptureBlock;
+
+static const char captureMagic[8] = "uconCAPT";
+
+enum {
+	CAPTURE_READ_MAX	=64*1024,	///< maximum block size
+	RENDER_LAG_MAX		=256*1024,	///< more unrendered data is skipped
+	RENDER_POLL_US		=10*1000,	///< renderer latency, if idle
+};
+
+typedef struct {
+	TControl	tc;		///< devices and run flag, handed over to dumpInput, when the file is full
+	bool		full;		///< the receiver stopped capturing, accessed atomically
+	CaptureHeader	*header;	///< the mapped file
+	Uint8		*blocks;	///< the blocks following the header
+	size_t		size;		///< capacity for blocks
+	size_t		published;	///< the end of the blocks written, accessed atomically
+	Uint64		received;	///< data bytes captured
+	Int64		startUs;
+} Capture;
+
+static inline size_t captureBlockSize(const CaptureBlock *block) {
+	return sizeof *block + (((size_t)block->n+7) & ~(size_t)7);
+}
+
+/** Receiver thread of the capture mode. If the file is full, the renderer takes over the input.
+ */
+void* captureInput(Capture *c) {
+	size_t end = 0;
+	while (c->tc.run) {
+		if (!fdWaitReadableUs(c->tc.readFd,DUMP_POLL_MS*1000)) continue;
+		if (end+sizeof(CaptureBlock)+8 > c->size) {
+			fprintf(stderr,"\nCapture file full, input is shown without capturing.\n");
+			__atomic_store_n(&c->full,true,__ATOMIC_RELEASE);
+			return 0;
 		}
+		CaptureBlock *block = (CaptureBlock*)(c->blocks + end);
+		const size_t space = c->size - end - sizeof *block;
+		const ssize_t n = read(c->tc.readFd,block+1,MIN(space,CAPTURE_READ_MAX));
+		const Int64 timeUs = fdClockUs();
+		if (n==0 || (n<0 && (errno==EINTR || errno==EAGAIN))) continue;
+		if (n<0) break;
+
+		*block = (CaptureBlock) { .timeUs = timeUs - c->startUs, .n = n };
+		end += captureBlockSize(block);
+		c->received += n;
+		c->header->size = end;
+		__atomic_store_n(&c->published,end,__ATOMIC_RELEASE);
 	}
+	c->tc.run = false;
 	return 0;
 }
 
+/** Renderer thread of the capture mode: best-effort output of the captured data. Continues like dumpInput, after
+ * the receiver stopped capturing.
+ */
+void* captureRender(Capture *c) {
+	size_t position = 0;
+	bool full;
+	for (;;) {
+		// full before published: once the receiver stopped, end includes its last block
+		full = __atomic_load_n(&c->full,__ATOMIC_ACQUIRE);
+		const size_t end = __atomic_load_n(&c->published,__ATOMIC_ACQUIRE);
+		if (position==end) {
+			if (full || !c->tc.run) break;
+			usleep(RENDER_POLL_US);
+			continue;
+		}
+		if (end-position > RENDER_LAG_MAX) {
+			size_t skipped = 0;
+			while (end-position > RENDER_LAG_MAX/2) {
+				const CaptureBlock *block = (const CaptureBlock*)(c->blocks + position);
+				skipped += block->n;
+				position += captureBlockSize(block);
+			}
+			char note[64];
+			const int n = snprintf(note,sizeof note,"\n[uconsole: %zu bytes not shown]\n",skipped);
+			write(c->tc.writeFd,note,n);
+		}
+		const CaptureBlock *block = (const CaptureBlock*)(c->blocks + position);
+		renderBlock(c->tc.writeFd,(const char*)(block+1),block->n);
+		position += captureBlockSize(block);
+	}
+	if (full) dumpInput(&c->tc);
+	return 0;
+}
+
+/** Creates the capture file as a sparse file of the maximum size and maps it.
+ */
+bool captureOpen(Capture *c, const char *fileName) {
+	const size_t size = (size_t)captureMiB << 20;
+	const int fd = open(fileName,O_RDWR|O_CREAT|O_TRUNC,0644);
+	if (fd<0) return false;
+	void *memory = size>sizeof(CaptureHeader) && 0==ftruncate(fd,size)
+		? mmap(0,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0) : MAP_FAILED;
+	close(fd);
+	if (memory==MAP_FAILED) return false;
+
+	c->header = memory;
+	memcpy(c->header->magic,captureMagic,sizeof captureMagic);
+	c->header->size = 0;
+	c->header->baud = baud;
+	c->blocks = (Uint8*)(c->header+1);
+	c->size = size - sizeof(CaptureHeader);
+	c->published = 0;
+	c->startUs = fdClockUs();
+	return true;
+}
+
+/** Cuts the capture file to the data captured.
+ */
+bool captureClose(Capture *c, const char *fileName) {
+	const size_t size = sizeof(CaptureHeader) + c->header->size;
+	const size_t mapped = sizeof(CaptureHeader) + c->size;
+	fprintf(stderr,"Captured %llu bytes.\n",(unsigned long long)c->received);
+	return 0==munmap(c->header,mapped) && 0==truncate(fileName,size);
+}
+
+/** Renders a capture file with the original timing.
+ */
+bool replay(const char *fileName, int fdOut) {
+	const int fd = open(fileName,O_RDONLY);
+	if (fd<0) return false;
+	struct stat stat;
+	void *memory = 0==fstat(fd,&stat) && stat.st_size>=sizeof(CaptureHeader)
+		? mmap(0,stat.st_size,PROT_READ,MAP_PRIVATE,fd,0) : MAP_FAILED;
+	close(fd);
+	if (memory==MAP_FAILED) return false;
+
+	const CaptureHeader *header = memory;
+	bool success = 0==memcmp(header->magic,captureMagic,sizeof captureMagic)
+		&& header->size <= stat.st_size-sizeof *header;
+	const Uint8 *blocks = (const Uint8*)(header+1);
+	const Int64 startUs = fdClockUs();
+	for (size_t position = 0; success && position<header->size; ) {
+		const CaptureBlock *block = (const CaptureBlock*)(blocks + position);
+		if (header->size-position < sizeof *block
+		|| block->n > header->size-position-sizeof *block
+		|| header->size-position < captureBlockSize(block)) success = false;
+		else {
+			fdSleepUntilUs(startUs + block->timeUs);
+			success = renderBlock(fdOut,(const char*)(block+1),block->n);
+			position += captureBlockSize(block);
+		}
+	}
+	munmap(memory,stat.st_size);
+	return success;
+}
+
 
 int main(int argc, const char* const*argv) {
 	if (!parseCmdLine(argc,argv)) return 1;
@@ -158,13 +365,6 @@ int main(int argc, const char* const*argv) {
 		showHelp();
 		return 0;
 	}
-	const char *envDefault = getenv("ARM_TTY");
-	const char *device = fifoIsValid(&fifoDevice) ? fifoReadPositionToString(&fifoDevice)
-		: ( envDefault!=0 ? envDefault : "/dev/ttyUSB0");
-		
-	const int fd = serialOpenBlockingTimeout(device,baud,timeoutMs/100);
-	if (fd<0) return 1;
-
 	int fdOut = 1;
 	if (fifoIsValid(&fifoOutputDevice)) {
 		const char *terminal = fifoReadPositionToString(&fifoOutputDevice);
@@ -176,9 +376,33 @@ int main(int argc, const char* const*argv) {
 		}
 	}
 
+	if (fifoIsValid(&fifoReplayFile)) {
+		const char *fileName = fifoReadPositionToString(&fifoReplayFile);
+		if (replay(fileName,fdOut)) return 0;
+		fprintf(stderr,"Error replaying \"%s\"\n",fileName);
+		return 1;
+	}
+
+	const char *envDefault = getenv("ARM_TTY");
+	const char *device = fifoIsValid(&fifoDevice) ? fifoReadPositionToString(&fifoDevice)
+		: ( envDefault!=0 ? envDefault : "/dev/ttyUSB0");
+		
+	const int fd = serialOpenBlockingTimeout(device,baud,timeoutMs/100);
+	if (fd<0) return 1;
+
 	TControl tc = { fd,fdOut,true };
-	pthread_t t;
-	if (0!=pthread_create(&t,0,(void*((*)(void*)))&dumpInput,&tc)) return 1;
+	Capture capture = { .tc = { fd,fdOut,true } };
+	const char *captureFileName = fifoIsValid(&fifoCaptureFile) ? fifoReadPositionToString(&fifoCaptureFile) : 0;
+	pthread_t t, tRender;
+	if (captureFileName!=0) {
+		if (!captureOpen(&capture,captureFileName)) {
+			fprintf(stderr,"Error creating \"%s\"\n",captureFileName);
+			return 1;
+		}
+		if (0!=pthread_create(&t,0,(void*((*)(void*)))&captureInput,&capture)
+		|| 0!=pthread_create(&tRender,0,(void*((*)(void*)))&captureRender,&capture)) return 1;
+	}
+	else if (0!=pthread_create(&t,0,(void*((*)(void*)))&dumpInput,&tc)) return 1;
 
 	if (fifoIsValid(&fifoWave)) {
 		while (fifoCanRead(&fifoWave)) {
@@ -214,6 +438,12 @@ int main(int argc, const char* const*argv) {
 	fprintf(stderr,"Connection closed.\n");
 	tc.run = false;
 	write_history(histFn);
+	if (captureFileName!=0) {
+		capture.tc.run = false;
+		pthread_join(t,0);
+		pthread_join(tRender,0);
+		if (!captureClose(&capture,captureFileName)) return 1;
+	}
 	return 0;
 }
 